@@ -5,6 +5,12 @@
 #include <random>
 #include <cmath>
 #include <cassert>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#include <span>
+#include <algorithm>
 
 // This header-only Random namespace implements a self-seeding Mersenne Twister.
 // Requires C++17 or newer.
@@ -71,9 +77,12 @@ namespace Random
 
 	// We define the return of a normal distribution.
 	// At this moment, we only permit double arguments and return.
-	inline double normal(double mean, double variance)
+	// The second parameter is the standard deviation, like for std::normal_distribution.
+	inline double normal(double mean, double stdDev)
 	{
-		return std::normal_distribution<double>{ mean, variance }(mt);
+		// one distribution object for all calls, so the second normal of each Box-Muller pair is not thrown away
+		static std::normal_distribution<double> standardNormal{ 0.0, 1.0 };
+		return mean + stdDev * standardNormal(mt);
 	}
 
 	inline double chiSquared(double k)
@@ -81,19 +90,9 @@ namespace Random
 		return std::chi_squared_distribution<double>{ k }(mt);
 	}
 
-	inline int poisson(double lam)
-	{
-		return std::poisson_distribution<int>{ lam }(mt);
-	}
-
-	inline double gamma(double alpha, double beta)
-	{
-		return std::gamma_distribution<double>{ alpha, beta }(mt);
-	}
-
-	inline double logNormal(double mean, double variance)
+	inline double logNormal(double mean, double stdDev)
 	{
-		return std::exp(Random::normal(mean, variance));
+		return std::exp(Random::normal(mean, stdDev));
 	}
 
 	// Generate a random floating point number between [min, max)
@@ -123,27 +122,436 @@ namespace Random
 		return randomVector;
 	}
 
-	inline std::vector<double> getVectorNormals(std::vector<double> means, std::vector<double> variances)
+	inline std::vector<double> getVectorNormals(std::vector<double> means, std::vector<double> stdDevs)
 	{
-		assert(std::size(means) == std::size(variances));
+		assert(std::size(means) == std::size(stdDevs));
 		std::vector<double> randomVector(std::size(means));
 		for (std::size_t i{ 0 }; i < std::size(means); ++i)
 		{
-			randomVector[i] = Random::normal(means[i], variances[i]);
+			randomVector[i] = Random::normal(means[i], stdDevs[i]);
 		}
 		return randomVector;
 	}
 
-	inline std::vector<double> getVectorNormals(std::size_t size, double mean, double variance)
+	inline std::vector<double> getVectorNormals(std::size_t size, double mean, double stdDev)
 	{
 		std::vector<double> randomVector(size);
 		for (std::size_t i{ 0 }; i < size; ++i)
 		{
-			randomVector[i] = Random::normal(mean, variance);
+			randomVector[i] = Random::normal(mean, stdDev);
 		}
 		return randomVector;
 	}
 
+	// Philox4x32-10 counter based generator (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3").
+	// The output is a pure function of counter and key, so any position of any stream can be computed directly.
+	// This lets parallel Monte Carlo give every sample its own stream and stay reproducible for any number of threads.
+	inline std::array<std::uint32_t, 4> philox4x32(std::array<std::uint32_t, 4> counter, std::array<std::uint32_t, 2> key)
+	{
+		constexpr std::uint64_t multiplier0{ 0xD2511F53 };
+		constexpr std::uint64_t multiplier1{ 0xCD9E8D57 };
+		constexpr std::uint32_t weyl0{ 0x9E3779B9 };
+		constexpr std::uint32_t weyl1{ 0xBB67AE85 };
+
+		for (int round{ 0 }; round < 10; ++round)
+		{
+			std::uint64_t product0{ multiplier0 * counter[0] };
+			std::uint64_t product1{ multiplier1 * counter[2] };
+			counter = {
+				static_cast<std::uint32_t>(product1 >> 32) ^ counter[1] ^ key[0],
+				static_cast<std::uint32_t>(product1),
+				static_cast<std::uint32_t>(product0 >> 32) ^ counter[3] ^ key[1],
+				static_cast<std::uint32_t>(product0) };
+			key[0] += weyl0;
+			key[1] += weyl1;
+		}
+		return counter;
+	}
+
+	// Poisson and gamma samplers on any source of uniforms in the open interval (0, 1) and of standard normals,
+	// shared by Stream and the global Mersenne Twister
+	namespace Sampling
+	{
+		// below this mean a single uniform is inverted, above it the transformed rejection is faster
+		inline constexpr double poissonInversionLimit{ 10.0 };
+
+		template <typename Uniform>
+		int poissonInversion(Uniform&& uniform, double lam, double expMinusLam)
+		{
+			double u{ uniform() };
+			int count{ 0 };
+			double probability{ expMinusLam };
+			double cumulative{ probability };
+			while (u > cumulative && probability > 0.0)
+			{
+				++count;
+				probability *= lam / static_cast<double>(count);
+				cumulative += probability;
+			}
+			return count;
+		}
+
+		struct PoissonConstants
+		{
+			double lam;
+			double logLam;
+			double b;
+			double a;
+			double logInvAlpha;
+			double vr;
+
+			explicit PoissonConstants(double mean)
+				: lam{ mean }
+				, logLam{ std::log(mean) }
+				, b{ 0.931 + 2.53 * std::sqrt(mean) }
+				, a{ -0.059 + 0.02483 * b }
+				, logInvAlpha{ std::log(1.1239 + 1.1328 / (b - 3.4)) }
+				, vr{ 0.9277 - 3.6224 / (b - 2) }
+			{}
+		};
+
+		// Hoermann's PTRS, "The transformed rejection method for generating Poisson random variables"
+		template <typename Uniform>
+		int poissonRejection(Uniform&& uniform, const PoissonConstants& c)
+		{
+			while (true)
+			{
+				double u{ uniform() - 0.5 };
+				double v{ uniform() };
+				double us{ 0.5 - std::abs(u) };
+				double k{ std::floor((2 * c.a / us + c.b) * u + c.lam + 0.43) };
+				if (us >= 0.07 && v <= c.vr)
+				{
+					return static_cast<int>(k);
+				}
+				if (k < 0 || (us < 0.013 && v > us))
+				{
+					continue;
+				}
+				if (std::log(v) + c.logInvAlpha - std::log(c.a / (us * us) + c.b) <= -c.lam + k * c.logLam - std::lgamma(k + 1))
+				{
+					return static_cast<int>(k);
+				}
+			}
+		}
+
+		struct GammaConstants
+		{
+			double alpha;
+			double d;
+			double c;
+
+			explicit GammaConstants(double shape)
+				: alpha{ shape }
+				, d{ ((shape < 1.0) ? shape + 1.0 : shape) - 1.0 / 3.0 }
+				, c{ 1.0 / std::sqrt(9.0 * d) }
+			{}
+		};
+
+		// Marsaglia and Tsang, "A simple method for generating gamma variables"
+		template <typename Uniform, typename Normal>
+		double standardGamma(Uniform&& uniform, Normal&& normal, const GammaConstants& constants)
+		{
+			double x{};
+			double v{};
+			double sample{};
+			while (true)
+			{
+				do
+				{
+					x = normal();
+					v = 1.0 + constants.c * x;
+				} while (v <= 0.0);
+				v = v * v * v;
+				double u{ uniform() };
+				if (u < 1.0 - 0.0331 * x * x * x * x || std::log(u) < 0.5 * x * x + constants.d * (1.0 - v + std::log(v)))
+				{
+					sample = constants.d * v;
+					break;
+				}
+			}
+			if (constants.alpha < 1.0)
+			{
+				sample *= std::pow(uniform(), 1.0 / constants.alpha);
+			}
+			return sample;
+		}
+
+		// uniform in the open interval (0, 1) with 53 random bits of the global Mersenne Twister
+		inline double openUniform()
+		{
+			std::uint64_t high{ mt() };
+			std::uint64_t low{ mt() };
+			std::uint64_t bits{ ((high << 32) | low) >> 11 };
+			return (static_cast<double>(bits) + 0.5) * 0x1.0p-53;
+		}
+	}
+
+	// Poisson and gamma draws from the global Mersenne Twister, with the same samplers as Stream
+	inline int poisson(double lam)
+	{
+		auto uniform = [] { return Sampling::openUniform(); };
+		return (lam < Sampling::poissonInversionLimit) ? Sampling::poissonInversion(uniform, lam, std::exp(-lam))
+			: Sampling::poissonRejection(uniform, Sampling::PoissonConstants{ lam });
+	}
+
+	inline double gamma(double alpha, double beta)
+	{
+		return beta * Sampling::standardGamma([] { return Sampling::openUniform(); }, [] { return Random::normal(0.0, 1.0); }, Sampling::GammaConstants{ alpha });
+	}
+
+	// Random stream number streamId of the generator seeded with seed.
+	// Satisfies UniformRandomBitGenerator, so it can drive the std distributions as well.
+	class Stream
+	{
+	public:
+		using result_type = std::uint32_t;
+
+		Stream(std::uint64_t seed, std::uint64_t streamId)
+			: m_key{ static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32) }
+			, m_streamId{ streamId }
+		{}
+
+		static constexpr result_type min() { return 0; }
+		static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+		result_type operator()()
+		{
+			if (m_position == 4)
+			{
+				m_block = philox4x32({ static_cast<std::uint32_t>(m_blockIndex), static_cast<std::uint32_t>(m_blockIndex >> 32),
+									   static_cast<std::uint32_t>(m_streamId), static_cast<std::uint32_t>(m_streamId >> 32) }, m_key);
+				++m_blockIndex;
+				m_position = 0;
+			}
+			return m_block[m_position++];
+		}
+
+		// skip the next count 32 bit outputs without generating them
+		void discard(std::uint64_t count)
+		{
+			std::uint64_t target{ m_blockIndex * 4 - (4 - m_position) + count };
+			m_blockIndex = target / 4;
+			m_position = 4;
+			m_hasSpareNormal = false;
+			for (std::uint64_t i{ 0 }; i < target % 4; ++i)
+			{
+				operator()();
+			}
+		}
+
+		// uniform in the open interval (0, 1) with 53 random bits
+		double uniform()
+		{
+			std::uint64_t high{ operator()() };
+			std::uint64_t low{ operator()() };
+			std::uint64_t bits{ ((high << 32) | low) >> 11 };
+			return (static_cast<double>(bits) + 0.5) * 0x1.0p-53;
+		}
+
+		// fills out with uniforms, the same numbers as out.size() calls of uniform()
+		void uniforms(std::span<double> out)
+		{
+			for (double& value : out) { value = uniform(); }
+		}
+
+		// standard normal by the Box-Muller transform, the second normal of each pair is kept for the next call
+		double normal()
+		{
+			if (m_hasSpareNormal)
+			{
+				m_hasSpareNormal = false;
+				return m_spareNormal;
+			}
+			double radius{ std::sqrt(-2.0 * std::log(uniform())) };
+			double angle{ 6.283185307179586476925 * uniform() };
+			m_spareNormal = radius * std::sin(angle);
+			m_hasSpareNormal = true;
+			return radius * std::cos(angle);
+		}
+
+		double normal(double mean, double stdDev)
+		{
+			return mean + stdDev * normal();
+		}
+
+		// Fills out with standard normals, the same numbers as out.size() calls of normal().
+		// The uniforms of a block are drawn first and the Box-Muller transform runs over the block in a loop of its own.
+		void normals(std::span<double> out)
+		{
+			std::size_t index{ 0 };
+			if (m_hasSpareNormal && !out.empty())
+			{
+				out[index++] = m_spareNormal;
+				m_hasSpareNormal = false;
+			}
+			std::array<double, normalBlock> radii{};
+			std::array<double, normalBlock> angles{};
+			while (index < std::size(out))
+			{
+				std::size_t numPairs{ std::min(normalBlock, (std::size(out) - index + 1) / 2) };
+				for (std::size_t i{ 0 }; i < numPairs; ++i)
+				{
+					radii[i] = uniform();
+					angles[i] = uniform();
+				}
+				boxMuller(numPairs, radii.data(), angles.data());
+				for (std::size_t i{ 0 }; i < numPairs; ++i)
+				{
+					out[index++] = radii[i];
+					if (index < std::size(out))
+					{
+						out[index++] = angles[i];
+					}
+					else
+					{
+						m_spareNormal = angles[i];
+						m_hasSpareNormal = true;
+					}
+				}
+			}
+		}
+
+		// Poisson by inversion with a single uniform for small means, by transformed rejection (Hoermann's PTRS) for large ones
+		int poisson(double lam)
+		{
+			return (lam < Sampling::poissonInversionLimit) ? poissonInversion(lam, std::exp(-lam)) : poissonRejection(Sampling::PoissonConstants{ lam });
+		}
+
+		void poissons(std::span<int> out, double lam)
+		{
+			if (lam < Sampling::poissonInversionLimit)
+			{
+				double expMinusLam{ std::exp(-lam) };
+				for (int& value : out) { value = poissonInversion(lam, expMinusLam); }
+			}
+			else
+			{
+				Sampling::PoissonConstants constants{ lam };
+				for (int& value : out) { value = poissonRejection(constants); }
+			}
+		}
+
+		// gamma with shape alpha and scale beta by the method of Marsaglia and Tsang,
+		// shapes below one are sampled with shape alpha + 1 and scaled by U^(1/alpha)
+		double gamma(double alpha, double beta)
+		{
+			return beta * standardGamma(Sampling::GammaConstants{ alpha });
+		}
+
+		void gammas(std::span<double> out, double alpha, double beta)
+		{
+			Sampling::GammaConstants constants{ alpha };
+			for (double& value : out) { value = beta * standardGamma(constants); }
+		}
+
+		// one standard normal from each stream, the same numbers as streams[j].normal().
+		// Batch kernels draw their normals across all lanes at once with it.
+		friend void normals(std::span<Stream> streams, std::span<double> out)
+		{
+			assert(std::size(streams) >= std::size(out));
+			std::array<double, normalBlock> radii{};
+			std::array<double, normalBlock> angles{};
+			for (std::size_t first{ 0 }; first < std::size(out); first += normalBlock)
+			{
+				std::size_t count{ std::min(normalBlock, std::size(out) - first) };
+				for (std::size_t i{ 0 }; i < count; ++i)
+				{
+					Stream& stream{ streams[first + i] };
+					radii[i] = stream.m_hasSpareNormal ? 0.5 : stream.uniform();
+					angles[i] = stream.m_hasSpareNormal ? 0.5 : stream.uniform();
+				}
+				boxMuller(count, radii.data(), angles.data());
+				for (std::size_t i{ 0 }; i < count; ++i)
+				{
+					Stream& stream{ streams[first + i] };
+					if (stream.m_hasSpareNormal)
+					{
+						out[first + i] = stream.m_spareNormal;
+						stream.m_hasSpareNormal = false;
+					}
+					else
+					{
+						out[first + i] = radii[i];
+						stream.m_spareNormal = angles[i];
+						stream.m_hasSpareNormal = true;
+					}
+				}
+			}
+		}
+
+		friend void poissons(std::span<Stream> streams, std::span<int> out, double lam)
+		{
+			assert(std::size(streams) >= std::size(out));
+			if (lam < Sampling::poissonInversionLimit)
+			{
+				double expMinusLam{ std::exp(-lam) };
+				for (std::size_t j{ 0 }; j < std::size(out); ++j) { out[j] = streams[j].poissonInversion(lam, expMinusLam); }
+			}
+			else
+			{
+				Sampling::PoissonConstants constants{ lam };
+				for (std::size_t j{ 0 }; j < std::size(out); ++j) { out[j] = streams[j].poissonRejection(constants); }
+			}
+		}
+
+		friend void gammas(std::span<Stream> streams, std::span<double> out, double alpha, double beta)
+		{
+			assert(std::size(streams) >= std::size(out));
+			Sampling::GammaConstants constants{ alpha };
+			for (std::size_t j{ 0 }; j < std::size(out); ++j) { out[j] = beta * streams[j].standardGamma(constants); }
+		}
+
+	private:
+		static constexpr std::size_t normalBlock{ 64 };
+
+		// turns pairs of uniforms into pairs of standard normals in place
+		static void boxMuller(std::size_t count, double* radii, double* angles)
+		{
+			for (std::size_t i{ 0 }; i < count; ++i)
+			{
+				double radius{ std::sqrt(-2.0 * std::log(radii[i])) };
+				double angle{ 6.283185307179586476925 * angles[i] };
+				radii[i] = radius * std::cos(angle);
+				angles[i] = radius * std::sin(angle);
+			}
+		}
+
+		int poissonInversion(double lam, double expMinusLam)
+		{
+			return Sampling::poissonInversion([this] { return uniform(); }, lam, expMinusLam);
+		}
+
+		int poissonRejection(const Sampling::PoissonConstants& constants)
+		{
+			return Sampling::poissonRejection([this] { return uniform(); }, constants);
+		}
+
+		double standardGamma(const Sampling::GammaConstants& constants)
+		{
+			return Sampling::standardGamma([this] { return uniform(); }, [this] { return normal(); }, constants);
+		}
+
+		std::array<std::uint32_t, 2> m_key{};
+		std::uint64_t m_streamId{ 0 };
+		std::uint64_t m_blockIndex{ 0 };
+		std::array<std::uint32_t, 4> m_block{};
+		std::size_t m_position{ 4 };
+		bool m_hasSpareNormal{ false };
+		double m_spareNormal{ 0.0 };
+	};
+
+	// bulk draws across the streams of a batch, one value per stream
+	void normals(std::span<Stream> streams, std::span<double> out);
+	void poissons(std::span<Stream> streams, std::span<int> out, double lam);
+	void gammas(std::span<Stream> streams, std::span<double> out, double alpha, double beta);
+
+	// fresh seed for Stream from the global Mersenne Twister
+	inline std::uint64_t seed()
+	{
+		return (static_cast<std::uint64_t>(mt()) << 32) | static_cast<std::uint64_t>(mt());
+	}
+
 }
 
 #endif
\ No newline at end of file
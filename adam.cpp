@@ -2,6 +2,33 @@
 #include "options.h"
 #include <cmath>
 #include <iostream>
+#include <string_view>
+
+
+void VectorAdam::set_bounds(std::vector<double> lowerBounds, std::vector<double> upperBounds)
+{
+    assert(std::size(lowerBounds) == m_dimension);
+    assert(std::size(upperBounds) == m_dimension);
+    for (std::size_t i{ 0 }; i < m_dimension; ++i)
+    {
+        assert(lowerBounds[i] <= upperBounds[i]);
+    }
+
+    m_lowerBounds = std::move(lowerBounds);
+    m_upperBounds = std::move(upperBounds);
+}
+
+void VectorAdam::clamp(std::vector<double>& params) const
+{
+    if (std::empty(m_lowerBounds))
+    {
+        return;
+    }
+    for (std::size_t j{ 0 }; j < m_dimension; ++j)
+    {
+        params[j] = std::clamp(params[j], m_lowerBounds[j], m_upperBounds[j]);
+    }
+}
 
 
 void testAdam()
@@ -33,4 +60,60 @@ void testAdam()
     Adam adam{ 0.2 };
     double optVol{ adam.optimize(func, deriv) };
     std::cout << "Adam found vol of " << optVol << ". True vol is " << trueVol << ".\n";
-}
\ No newline at end of file
+}
+
+void testVectorAdam()
+{
+    // Rosenbrock function (1 - x)^2 + 100 (y - x^2)^2 with minimum 0 at (1, 1), the gradient comes with the value
+    auto func
+    {
+        [](std::span<const double> params, std::span<double> gradient)
+        {
+            double x{ params[0] };
+            double y{ params[1] };
+            gradient[0] = -2.0 * (1.0 - x) - 400.0 * x * (y - x * x);
+            gradient[1] = 200.0 * (y - x * x);
+            return (1.0 - x) * (1.0 - x) + 100.0 * (y - x * x) * (y - x * x);
+        }
+    };
+    auto check
+    {
+        [](std::string_view name, const VectorAdam::Result& result, double expectedX, double expectedY)
+        {
+            double error{ std::max(std::abs(result.m_params[0] - expectedX), std::abs(result.m_params[1] - expectedY)) };
+            std::cout << name << " found (" << result.m_params[0] << ", " << result.m_params[1] << ") after " << result.m_iterations
+                << " steps. True minimum is (" << expectedX << ", " << expectedY << ").\n";
+            assert(result.m_converged && error < 1e-4);
+        }
+    };
+
+    VectorAdam optimizer{ 2, 0.02 };
+    optimizer.set_maxIterations(20000);
+    check("Adam", optimizer.optimize(func, { -1.2, 1.0 }, true), 1.0, 1.0);
+
+    optimizer.set_variant(VectorAdam::Variant::amsGrad);
+    check("AMSGrad", optimizer.optimize(func, { -1.2, 1.0 }, true), 1.0, 1.0);
+
+    // Decoupled weight decay balances the normalized step m / sqrt(v) instead of the gradient, which tends to the sign of a
+    // gradient without noise. On (x - 3)^2 + (y + 4)^2 with weight decay 0.5 AdamW therefore settles where 0.5 |p_j| = 1, at (2, -2).
+    auto quadratic
+    {
+        [](std::span<const double> params, std::span<double> gradient)
+        {
+            gradient[0] = 2.0 * (params[0] - 3.0);
+            gradient[1] = 2.0 * (params[1] + 4.0);
+            return (params[0] - 3.0) * (params[0] - 3.0) + (params[1] + 4.0) * (params[1] + 4.0);
+        }
+    };
+    // a shorter memory of the second moment forgets the larger gradients of the way there sooner
+    VectorAdam decayed{ 2, 0.02, 0.9, 0.99 };
+    decayed.set_variant(VectorAdam::Variant::adamW);
+    decayed.set_weightDecay(0.5);
+    decayed.set_maxIterations(20000);
+    check("AdamW", decayed.optimize(quadratic, { 0.0, 0.0 }, true), 2.0, -2.0);
+
+    // with the bound x <= 0.5 the minimum lies on the boundary at (0.5, 0.25)
+    optimizer.set_variant(VectorAdam::Variant::adam);
+    optimizer.set_bounds({ -2.0, -2.0 }, { 0.5, 2.0 });
+    check("Adam with x <= 0.5", optimizer.optimize(func, { -1.2, 1.0 }), 0.5, 0.25);
+}
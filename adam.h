@@ -3,6 +3,11 @@
 
 #include <iostream>
 #include <cmath>
+#include <vector>
+#include <span>
+#include <cassert>
+#include <algorithm>
+#include <limits>
 
 class Adam
 {
@@ -110,6 +115,149 @@ constexpr double Adam::optimize(const auto& func, const auto& deriv, bool verbos
     return m_state.m_weight;
 }
 
+
+// Adam on a whole parameter vector, for calibrations where one call of the pricer gives the objective together with its full gradient.
+// Each parameter gets its own moment estimates, so the step sizes adapt to the very different sensitivities of e.g. the Heston parameters.
+class VectorAdam
+{
+public:
+    enum class Variant
+    {
+        adam,
+        // decoupled weight decay of Loshchilov and Hutter, shrinks the parameters by stepSize * weightDecay each step
+        adamW,
+        // Reddi et al., normalizes by the largest second moment seen so far, so the effective step size never grows
+        amsGrad,
+    };
+
+    explicit VectorAdam(std::size_t dimension = 1,
+                        double stepSize = 0.01,
+                        double firstOrderExpDecay = 0.9,
+                        double secondOrderExpDecay = 0.999,
+                        double eps = 1e-8)
+        : m_dimension{ dimension }
+        , m_stepSize{ stepSize }
+        , m_firstOrderExpDecay{ firstOrderExpDecay }
+        , m_secondOrderExpDecay{ secondOrderExpDecay }
+        , m_eps{ eps }
+    {}
+
+    struct Result
+    {
+        // the parameters with the smallest objective value seen, for AdamW the last ones since the decay is not part of the objective
+        std::vector<double> m_params{};
+        double m_value{ 0.0 };
+        int m_iterations{ 0 };
+        bool m_converged{ false };
+    };
+
+    // setters
+    void set_variant(Variant variant) { m_variant = variant; }
+    void set_weightDecay(double weightDecay) { m_weightDecay = weightDecay; }
+    void set_stepSize(double stepSize) { m_stepSize = stepSize; }
+    // Projects every step onto the box [lowerBounds, upperBounds].
+    void set_bounds(std::vector<double> lowerBounds, std::vector<double> upperBounds);
+    void set_maxIterations(int maxIterations) { m_maxIterations = maxIterations; }
+    // converged once no parameter moves by more than tolerance in one step
+    void set_tolerance(double tolerance) { m_tolerance = tolerance; }
+
+    // Minimizes func starting from initialParams. func(params, gradient) returns the objective value and fills the gradient,
+    // params is a std::span<const double> and gradient a std::span<double> of size dimension.
+    constexpr Result optimize(const auto& func, std::vector<double> initialParams, bool verbose = false);
+
+private:
+    void clamp(std::vector<double>& params) const;
+
+    std::size_t m_dimension{ 1 };
+    double m_stepSize{ 0.01 };
+    double m_firstOrderExpDecay{ 0.9 };
+    double m_secondOrderExpDecay{ 0.999 };
+    double m_eps{ 1e-8 };
+    double m_weightDecay{ 0.0 };
+    double m_tolerance{ 1e-8 };
+    int m_maxIterations{ 1000 };
+    Variant m_variant{ Variant::adam };
+    std::vector<double> m_lowerBounds{};
+    std::vector<double> m_upperBounds{};
+};
+
+
+constexpr VectorAdam::Result VectorAdam::optimize(const auto& func, std::vector<double> initialParams, bool verbose)
+{
+    assert(std::size(initialParams) == m_dimension);
+    std::size_t n{ m_dimension };
+
+    std::vector<double> params{ std::move(initialParams) };
+    clamp(params);
+    std::vector<double> gradient(n);
+    std::vector<double> means(n, 0.0);
+    std::vector<double> variances(n, 0.0);
+    std::vector<double> maxVariances(n, 0.0);
+
+    Result result{ params, std::numeric_limits<double>::infinity() };
+    double firstOrderPower{ 1.0 };
+    double secondOrderPower{ 1.0 };
+    while (result.m_iterations < m_maxIterations && !result.m_converged)
+    {
+        double value{ func(std::span<const double>{ params }, std::span<double>{ gradient }) };
+        if (value < result.m_value || m_variant == Variant::adamW)
+        {
+            result.m_value = value;
+            result.m_params = params;
+        }
+        ++result.m_iterations;
+
+        // bias corrections 1 - beta^t
+        firstOrderPower *= m_firstOrderExpDecay;
+        secondOrderPower *= m_secondOrderExpDecay;
+        double meanCorrection{ 1.0 / (1.0 - firstOrderPower) };
+        double varianceCorrection{ 1.0 / (1.0 - secondOrderPower) };
+
+        double largestStep{ 0.0 };
+        for (std::size_t j{ 0 }; j < n; ++j)
+        {
+            means[j] = m_firstOrderExpDecay * means[j] + (1.0 - m_firstOrderExpDecay) * gradient[j];
+            variances[j] = m_secondOrderExpDecay * variances[j] + (1.0 - m_secondOrderExpDecay) * gradient[j] * gradient[j];
+            // AMSGrad keeps the maximum of the raw estimates, the bias correction of the first steps must not be kept in it
+            if (m_variant == Variant::amsGrad)
+            {
+                maxVariances[j] = std::max(maxVariances[j], variances[j]);
+            }
+            double variance{ ((m_variant == Variant::amsGrad) ? maxVariances[j] : variances[j]) * varianceCorrection };
+
+            double step{ m_stepSize * means[j] * meanCorrection / (std::sqrt(variance) + m_eps) };
+            if (m_variant == Variant::adamW)
+            {
+                step += m_stepSize * m_weightDecay * params[j];
+            }
+            double oldParam{ params[j] };
+            params[j] -= step;
+            if (!std::empty(m_lowerBounds))
+            {
+                params[j] = std::clamp(params[j], m_lowerBounds[j], m_upperBounds[j]);
+            }
+            largestStep = std::max(largestStep, std::abs(params[j] - oldParam));
+        }
+        result.m_converged = largestStep < m_tolerance;
+    }
+
+    // the last step has not been evaluated yet
+    double value{ func(std::span<const double>{ params }, std::span<double>{ gradient }) };
+    if (value < result.m_value || m_variant == Variant::adamW)
+    {
+        result.m_value = value;
+        result.m_params = params;
+    }
+
+    if (verbose)
+    {
+        std::cout << "Adam " << (result.m_converged ? "converged" : "stopped") << " after " << result.m_iterations
+            << " gradient steps with objective value " << result.m_value << ".\n";
+    }
+    return result;
+}
+
 void testAdam();
+void testVectorAdam();
 
 #endif
@@ -1,5 +1,6 @@
-
 #include "calibrate.h"
+#include "volatility.h"
+#include "Timer.h"
 
 
 
@@ -8,39 +9,40 @@ namespace Calibrate
 
 	auto interpolatePrices(const FFT::LogStrikePricePair& pair, const std::vector<double>& strikes) -> std::vector<double>
 	{
-		std::size_t lengthFftStrikes{ std::size(pair.logStrikes) };
-		std::size_t lengthStrikes{ std::size(strikes) };
+		return interpolatePrices(pair.logStrikes, std::span<const double>(pair.prices), strikes);
+	}
 
-		// first, we get the actual strikes from the log strikes
-		std::vector<double> fftStrikes(lengthFftStrikes);
-		for (std::size_t i{ 0 }; i < lengthFftStrikes; ++i)
-		{
-			fftStrikes[i] = std::exp(pair.logStrikes[i]);
-		}
+	auto interpolatePrices(const std::vector<double>& logStrikes, std::span<const double> fftPrices, const std::vector<double>& strikes) -> std::vector<double>
+	{
+		std::size_t lengthFftStrikes{ std::size(logStrikes) };
+		std::size_t lengthStrikes{ std::size(strikes) };
 
 		std::vector<double> prices(lengthStrikes);
-		std::vector<double> fftPrices{ pair.prices };
+		// the log strikes are equidistant, so the bracketing grid points can be computed directly
+		assert(lengthFftStrikes > 1);
+		double lowestLogStrike{ logStrikes[0] };
+		double gridWidthLogStrikeSpace{ logStrikes[1] - logStrikes[0] };
 		// now we interpolate between the prices computed by FFT
 		for (std::size_t i{ 0 }; i < lengthStrikes; ++i)
 		{
 			double queryStrike{ strikes[i] };
-			// we search for the first FFT strike which is greater than the query strike
-			auto found{ std::find_if(std::begin(fftStrikes), std::end(fftStrikes),
-						   [&queryStrike](double val)
-						   {
-							 return val > queryStrike;
-						   }) };
+			// we want the first FFT strike which is greater than the query strike
+			double position{ (std::log(queryStrike) - lowestLogStrike) / gridWidthLogStrikeSpace };
 
 			// we have to make sure that the queried price is lower that the last FFT price...
-			assert(found != std::end(fftStrikes));
 			// ...and higher than the first FFT price.
 			// we don't want to extrapolate, only interpolate. Otherwise the program terminates here.
-			std::size_t index = static_cast<std::size_t>(found - std::begin(fftStrikes));
-			assert(index > 0);
+			assert(position >= 0.0 && position < static_cast<double>(lengthFftStrikes - 1));
+			std::size_t index{ static_cast<std::size_t>(position) + 1 };
+			// correct for rounding in the log if the query strike sits exactly on a grid point
+			if (index < lengthFftStrikes - 1 && std::exp(logStrikes[index]) <= queryStrike) { ++index; }
+			if (index > 1 && std::exp(logStrikes[index - 1]) > queryStrike) { --index; }
 
-			// If the program did not terminate, we now have the index of the lower and higher prices
+			// we now have the index of the lower and higher prices
 			// now, we can interpolate these prices to get the price at the query strike.
-			double t{ (queryStrike - fftStrikes[index - 1]) / (fftStrikes[index] - fftStrikes[index - 1]) };
+			double lowerStrike{ std::exp(logStrikes[index - 1]) };
+			double upperStrike{ std::exp(logStrikes[index]) };
+			double t{ (queryStrike - lowerStrike) / (upperStrike - lowerStrike) };
 
 			double interpolatedPrice{ (1 - t) * fftPrices[index - 1] + t * fftPrices[index] };
 			prices[i] = interpolatedPrice;
@@ -59,6 +61,9 @@ namespace Calibrate
 
 		double newError{ 0.0 };
 
+		// price all maturities at once, they share the strike grid and the FFT plan
+		FFT::LogStrikePriceSurface surface{ FFT::pricingfftSurface(modelParams, marketParams, priceSurface.m_rowVals, params) };
+
 		// add up errors of predicted prices
 		// rows are maturities
 		for (std::size_t row{ 0 }; row < std::size(priceSurface.m_rowVals); ++row)
@@ -66,11 +71,50 @@ namespace Calibrate
 			// adjust maturity of market params
 			marketParams.maturity = priceSurface.m_rowVals[row];
 
-			std::vector<double> modelPrices(priceSurface.m_numCols);
+			// interpolate model prediction to fit the query strikes (cols are strikes)
+			std::vector<double> modelPrices{ interpolatePrices(surface.logStrikes, surface.row(row), priceSurface.m_colVals) };
 
-			// get model prediction and interpolate to fit the query strikes (cols are strikes)
-			FFT::LogStrikePricePair pair{ FFT::pricingfft(modelParams, marketParams, params) };
-			modelPrices = interpolatePrices(pair, priceSurface.m_colVals);
+			// cols are strikes
+			for (std::size_t col{ 0 }; col < std::size(priceSurface.m_colVals); ++col)
+			{
+				// add up the errors
+				double currentError{ (modelPrices[col] - priceSurface.m_table[row][col]) * (modelPrices[col] - priceSurface.m_table[row][col])
+												/ (priceSurface.m_table[row][col] * priceSurface.m_table[row][col]) };
+				newError += currentError;
+				// update model price surface
+				modelPriceSurface.m_table[row][col] = modelPrices[col];
+				errorSurface.m_table[row][col] = currentError;
+			}
+		}
+		// get mean error over all entries
+		newError /= (priceSurface.m_numCols * priceSurface.m_numRows);
+
+		return newError;
+	}
+
+	auto computeFRFTModelMRSE(const LabeledTable& priceSurface,
+		MarketParams& marketParams,
+		const auto& modelParams,
+		const FFT::FRFTParams& params,
+		LabeledTable& modelPriceSurface,
+		LabeledTable& errorSurface) -> double
+	{
+
+		double newError{ 0.0 };
+
+		// price all maturities at once on a grid which only spans the quoted strikes
+		auto [lowestStrike, highestStrike] { std::minmax_element(std::begin(priceSurface.m_colVals), std::end(priceSurface.m_colVals)) };
+		FFT::LogStrikePriceSurface surface{ FFT::pricingfrftSurface(modelParams, marketParams, priceSurface.m_rowVals, *lowestStrike, *highestStrike, params) };
+
+		// add up errors of predicted prices
+		// rows are maturities
+		for (std::size_t row{ 0 }; row < std::size(priceSurface.m_rowVals); ++row)
+		{
+			// adjust maturity of market params
+			marketParams.maturity = priceSurface.m_rowVals[row];
+
+			// interpolate model prediction to fit the query strikes (cols are strikes)
+			std::vector<double> modelPrices{ interpolatePrices(surface.logStrikes, surface.row(row), priceSurface.m_colVals) };
 
 			// cols are strikes
 			for (std::size_t col{ 0 }; col < std::size(priceSurface.m_colVals); ++col)
@@ -90,6 +134,337 @@ namespace Calibrate
 		return newError;
 	}
 
+	auto computeCOSModelMRSE(const LabeledTable& priceSurface,
+		MarketParams& marketParams,
+		const auto& modelParams,
+		const COS::COSParams& params,
+		LabeledTable& modelPriceSurface,
+		LabeledTable& errorSurface) -> double
+	{
+
+		double newError{ 0.0 };
+
+		// add up errors of predicted prices
+		// rows are maturities
+		for (std::size_t row{ 0 }; row < std::size(priceSurface.m_rowVals); ++row)
+		{
+			// adjust maturity of market params
+			marketParams.maturity = priceSurface.m_rowVals[row];
+
+			// the COS method prices the query strikes directly (cols are strikes)
+			std::vector<double> modelPrices{ COS::pricingcos(modelParams, marketParams, priceSurface.m_colVals, params) };
+
+			// cols are strikes
+			for (std::size_t col{ 0 }; col < std::size(priceSurface.m_colVals); ++col)
+			{
+				// add up the errors
+				double currentError{ (modelPrices[col] - priceSurface.m_table[row][col]) * (modelPrices[col] - priceSurface.m_table[row][col])
+												/ (priceSurface.m_table[row][col] * priceSurface.m_table[row][col]) };
+				newError += currentError;
+				// update model price surface
+				modelPriceSurface.m_table[row][col] = modelPrices[col];
+				errorSurface.m_table[row][col] = currentError;
+			}
+		}
+		// get mean error over all entries
+		newError /= (priceSurface.m_numCols * priceSurface.m_numRows);
+
+		return newError;
+	}
+
+	void computeCOSModelResiduals(const LabeledTable& priceSurface,
+		MarketParams& marketParams,
+		const auto& modelParams,
+		const COS::COSParams& params,
+		std::vector<double>& residuals,
+		std::vector<double>& jacobian)
+	{
+		// relative residuals like the terms of the MRSE, row major over the surface
+		std::size_t numCols{ std::size(priceSurface.m_colVals) };
+		residuals.resize(std::size(priceSurface.m_rowVals) * numCols);
+		jacobian.clear();
+
+		// rows are maturities
+		for (std::size_t row{ 0 }; row < std::size(priceSurface.m_rowVals); ++row)
+		{
+			// adjust maturity of market params
+			marketParams.maturity = priceSurface.m_rowVals[row];
+
+			COS::PriceGradients model{ COS::pricingcosGradient(modelParams, marketParams, priceSurface.m_colVals, params) };
+
+			// cols are strikes
+			for (std::size_t col{ 0 }; col < numCols; ++col)
+			{
+				double marketPrice{ priceSurface.m_table[row][col] };
+				residuals[row * numCols + col] = (model.prices[col] - marketPrice) / marketPrice;
+				for (double derivative : model.gradients[col])
+				{
+					jacobian.push_back(derivative / marketPrice);
+				}
+			}
+		}
+	}
+
+	// The model parameters as the gradient based calibrations see them: their values in the order of the constructor arguments
+	// and the box of admissible values. withValues makes model parameters of the same type from such values.
+	struct ParameterVector
+	{
+		std::vector<std::string_view> names{};
+		std::vector<double> values{};
+		std::vector<double> lowerBounds{};
+		std::vector<double> upperBounds{};
+	};
+
+	auto parameterVector(const MertonJumpParams& modelParams) -> ParameterVector
+	{
+		return { { "vol", "meanJumpSize", "stdJumpSize", "expectedJumpsPerYear" },
+			{ modelParams.vol, modelParams.meanJumpSize, modelParams.stdJumpSize, modelParams.expectedJumpsPerYear },
+			{ 1e-4,-1.0,1e-4,0. }, { 5.0,1.0,2.0,10.0 } };
+	}
+
+	auto parameterVector(const HestonParams& modelParams) -> ParameterVector
+	{
+		return { { "reversionRate", "longVariance", "volVol", "correlation", "initialVariance" },
+			{ modelParams.reversionRate, modelParams.longVariance, modelParams.volVol, modelParams.correlation, modelParams.initialVariance },
+			{ 1e-4,1e-4,1e-4,-0.999,1e-4 }, { 10.0,4.0,5.0,0.999,4.0 } };
+	}
+
+	auto parameterVector(const VarianceGammaParams& modelParams) -> ParameterVector
+	{
+		return { { "vol", "drift", "variance" },
+			{ modelParams.vol, modelParams.drift, modelParams.variance },
+			{ 1e-4,-1.0,1e-4 }, { 5.0,1.0,5.0 } };
+	}
+
+	auto withValues(const MertonJumpParams&, std::span<const double> values) -> MertonJumpParams
+	{
+		return MertonJumpParams{ values[0], values[1], values[2], values[3] };
+	}
+
+	auto withValues(const HestonParams&, std::span<const double> values) -> HestonParams
+	{
+		return HestonParams{ values[0], values[1], values[2], values[3], values[4] };
+	}
+
+	auto withValues(const VarianceGammaParams&, std::span<const double> values) -> VarianceGammaParams
+	{
+		return VarianceGammaParams{ values[0], values[1], values[2] };
+	}
+
+	// iterations is set to the number of Levenberg-Marquardt iterations taken
+	auto calibrateLevenbergMarquardt(const LabeledTable& priceSurface, MarketParams& marketParams, const auto& initialParams, int& iterations)
+	{
+		// least squares over the relative residuals of the COS prices, with the analytic Jacobian of the characteristic function
+		ParameterVector start{ parameterVector(initialParams) };
+		COS::COSParams params{};
+		LevenbergMarquardt optimizer{ std::size(start.values) };
+		optimizer.set_bounds(std::move(start.lowerBounds), std::move(start.upperBounds));
+		auto func
+		{
+			[&](std::span<const double> parameters, std::vector<double>& residuals, std::vector<double>& jacobian)
+			{
+				computeCOSModelResiduals(priceSurface, marketParams, withValues(initialParams, parameters), params, residuals, jacobian);
+			}
+		};
+
+		Timer timer{};
+		LevenbergMarquardt::Result result{ optimizer.optimize(func, std::move(start.values), true) };
+		std::cout << "Levenberg-Marquardt calibration took " << timer.elapsed() << " s with mean relative squared error "
+			<< 2.0 * result.m_cost / static_cast<double>(priceSurface.m_numRows * priceSurface.m_numCols) << ".\n";
+		iterations = result.m_iterations;
+		return withValues(initialParams, result.m_params);
+	}
+
+	auto calibrateLevenbergMarquardt(const LabeledTable& priceSurface, MarketParams& marketParams, const auto& initialParams)
+	{
+		int iterations{ 0 };
+		return calibrateLevenbergMarquardt(priceSurface, marketParams, initialParams, iterations);
+	}
+
+	// model prices and errors of calibrated parameters, saved to Data/<fileName>ModelPriceSurface.csv and Data/<fileName>ModelErrorSurface.csv
+	void saveCOSModelSurfaces(const LabeledTable& priceSurface, MarketParams& marketParams, const auto& modelParams, std::string_view surfaceName, std::string_view fileName)
+	{
+		LabeledTable modelPriceSurface{ priceSurface };
+		modelPriceSurface.m_tableName = surfaceName;
+		LabeledTable errorSurface{ priceSurface };
+		errorSurface.m_tableName = "Relative squared error";
+		errorSurface.m_tableLabel = "Error";
+
+		computeTransformModelMRSE(priceSurface, marketParams, modelParams, "cos", modelPriceSurface, errorSurface);
+
+		Saving::write_labeledTable_to_csv("Data/" + std::string{ fileName } + "ModelPriceSurface.csv", modelPriceSurface);
+		Saving::write_labeledTable_to_csv("Data/" + std::string{ fileName } + "ModelErrorSurface.csv", errorSurface);
+	}
+
+	auto calibrateAdam(const LabeledTable& priceSurface, MarketParams& marketParams, const auto& initialParams, int numSteps)
+	{
+		// Adam on the MRSE of the COS prices, whose gradient comes from the analytic Jacobian of the characteristic function.
+		// Adam moves every coordinate by about the step size, so it runs on the parameters in units of their initial magnitude.
+		ParameterVector start{ parameterVector(initialParams) };
+		std::size_t dimension{ std::size(start.values) };
+		std::vector<double> scales(dimension);
+		for (std::size_t j{ 0 }; j < dimension; ++j)
+		{
+			scales[j] = std::max(std::abs(start.values[j]), 0.1);
+			start.values[j] /= scales[j];
+			start.lowerBounds[j] /= scales[j];
+			start.upperBounds[j] /= scales[j];
+		}
+
+		COS::COSParams params{};
+		// The relative errors of short dated wings make the first gradients orders of magnitude larger than later ones,
+		// a short memory of the second moment lets the step sizes recover from them within the few hundred steps.
+		VectorAdam optimizer{ dimension, 0.03, 0.9, 0.9 };
+		optimizer.set_bounds(std::move(start.lowerBounds), std::move(start.upperBounds));
+		optimizer.set_maxIterations(numSteps);
+		std::vector<double> parameters(dimension);
+		std::vector<double> residuals{};
+		std::vector<double> jacobian{};
+		auto func
+		{
+			[&](std::span<const double> scaledParameters, std::span<double> gradient)
+			{
+				for (std::size_t j{ 0 }; j < dimension; ++j)
+				{
+					parameters[j] = scaledParameters[j] * scales[j];
+				}
+				computeCOSModelResiduals(priceSurface, marketParams, withValues(initialParams, parameters), params, residuals, jacobian);
+
+				// MRSE and its gradient 2 Jt r / n, by the chain rule times the scale in the scaled coordinates
+				double numResiduals{ static_cast<double>(std::size(residuals)) };
+				double mrse{ 0.0 };
+				std::fill(std::begin(gradient), std::end(gradient), 0.0);
+				for (std::size_t i{ 0 }; i < std::size(residuals); ++i)
+				{
+					mrse += residuals[i] * residuals[i] / numResiduals;
+					for (std::size_t j{ 0 }; j < dimension; ++j)
+					{
+						gradient[j] += 2.0 * jacobian[i * dimension + j] * residuals[i] * scales[j] / numResiduals;
+					}
+				}
+				return mrse;
+			}
+		};
+
+		Timer timer{};
+		VectorAdam::Result result{ optimizer.optimize(func, std::move(start.values), true) };
+		std::cout << "Adam calibration took " << timer.elapsed() << " s with mean relative squared error " << result.m_value << ".\n";
+		for (std::size_t j{ 0 }; j < dimension; ++j)
+		{
+			result.m_params[j] *= scales[j];
+		}
+		return withValues(initialParams, result.m_params);
+	}
+
+	// COS call prices of the model on a grid of maturities up to two years and strikes of +-20% around the spot,
+	// to test calibrations against known parameters
+	auto syntheticCOSSurface(const auto& modelParams, double riskFreeReturn, double spot, double dividendYield) -> LabeledTable
+	{
+		using namespace std::string_view_literals;
+		LabeledTable priceSurface("Price surface"sv, "Time to maturity"sv, 8, "Strikes"sv, 13, "European call price"sv);
+		priceSurface.m_rowVals = { 1.0 / 12., 2.0 / 12., 3.0 / 12., 6.0 / 12., 9.0 / 12., 1.0, 1.5, 2.0 };
+		priceSurface.m_colVals = np::linspace<double>(0.8 * spot, 1.2 * spot, 13);
+
+		MarketParams marketParams{ 1.0,spot,riskFreeReturn,dividendYield };
+		for (std::size_t row{ 0 }; row < std::size(priceSurface.m_rowVals); ++row)
+		{
+			marketParams.maturity = priceSurface.m_rowVals[row];
+			priceSurface.m_table[row] = COS::pricingcos(modelParams, marketParams, priceSurface.m_colVals, COS::COSParams{});
+		}
+		return priceSurface;
+	}
+
+	// Recovers known parameters from a synthetic surface of their own COS prices. calibrate(priceSurface, marketParams, initialParams)
+	// returns the fitted parameters without saving surfaces, each of which has to lie within tolerance of the true one,
+	// relative to its size (at least 0.1).
+	void testCOSRecovery(std::string_view method, const auto& trueParams, const auto& initialParams, const auto& calibrate, double tolerance)
+	{
+		const double dividendYield{ 0.007 };
+		const double spot{ 175.0 };
+		const double riskFreeReturn{ 0.045 };
+		LabeledTable priceSurface{ syntheticCOSSurface(trueParams, riskFreeReturn, spot, dividendYield) };
+		MarketParams marketParams{ 1.0,spot,riskFreeReturn,dividendYield };
+
+		ParameterVector fitted{ parameterVector(calibrate(priceSurface, marketParams, initialParams)) };
+		ParameterVector truth{ parameterVector(trueParams) };
+		bool recovered{ true };
+		std::cout << "The optimal params found by " << method << " are: \n";
+		for (std::size_t j{ 0 }; j < std::size(truth.values); ++j)
+		{
+			std::cout << truth.names[j] << ": " << fitted.values[j] << " (true " << truth.values[j] << ")\n";
+			recovered = recovered && std::abs(fitted.values[j] - truth.values[j]) <= tolerance * std::max(std::abs(truth.values[j]), 0.1);
+		}
+		std::cout << "All parameters within a relative tolerance of " << tolerance << ": " << (recovered ? "yes" : "no") << "\n";
+		assert(recovered);
+	}
+
+	// Levenberg-Marquardt has to recover the parameters of a synthetic surface within its iteration budget
+	void testLMRecovery(const auto& trueParams, const auto& initialParams, int iterationBudget)
+	{
+		int iterations{ 0 };
+		testCOSRecovery("Levenberg-Marquardt", trueParams, initialParams,
+			[&](const LabeledTable& priceSurface, MarketParams& marketParams, const auto& start) { return calibrateLevenbergMarquardt(priceSurface, marketParams, start, iterations); },
+			1e-4);
+		std::cout << "Iterations: " << iterations << " (budget " << iterationBudget << ")\n";
+		assert(iterations <= iterationBudget);
+	}
+
+	auto computeTransformModelMRSE(const LabeledTable& priceSurface,
+		MarketParams& marketParams,
+		const auto& modelParams,
+		std::string_view pricing,
+		LabeledTable& modelPriceSurface,
+		LabeledTable& errorSurface) -> double
+	{
+		// choose the Fourier pricing method, each with its default parameters
+		if (pricing == "frft")
+		{
+			FFT::FRFTParams params{};
+			return computeFRFTModelMRSE(priceSurface, marketParams, modelParams, params, modelPriceSurface, errorSurface);
+		}
+		if (pricing == "cos")
+		{
+			COS::COSParams params{};
+			return computeCOSModelMRSE(priceSurface, marketParams, modelParams, params, modelPriceSurface, errorSurface);
+		}
+		FFT::FFTParams params{};
+		return computeFFTModelMRSE(priceSurface, marketParams, modelParams, params, modelPriceSurface, errorSurface);
+	}
+
+	auto computeTransformModelMRSE(const LabeledTable& priceSurface,
+		MarketParams marketParams,
+		const auto& modelParams,
+		std::string_view pricing) -> double
+	{
+		// only the error, the model prices of one maturity at a time live in a local buffer
+		std::vector<double> modelPrices{};
+		FFT::LogStrikePriceSurface surface{};
+		if (pricing == "frft")
+		{
+			auto [lowestStrike, highestStrike] { std::minmax_element(std::begin(priceSurface.m_colVals), std::end(priceSurface.m_colVals)) };
+			surface = FFT::pricingfrftSurface(modelParams, marketParams, priceSurface.m_rowVals, *lowestStrike, *highestStrike, FFT::FRFTParams{});
+		}
+		else if (pricing != "cos")
+		{
+			surface = FFT::pricingfftSurface(modelParams, marketParams, priceSurface.m_rowVals, FFT::FFTParams{});
+		}
+
+		double newError{ 0.0 };
+		for (std::size_t row{ 0 }; row < std::size(priceSurface.m_rowVals); ++row)
+		{
+			marketParams.maturity = priceSurface.m_rowVals[row];
+			modelPrices = (pricing == "cos") ? COS::pricingcos(modelParams, marketParams, priceSurface.m_colVals, COS::COSParams{})
+				: interpolatePrices(surface.logStrikes, surface.row(row), priceSurface.m_colVals);
+
+			for (std::size_t col{ 0 }; col < std::size(priceSurface.m_colVals); ++col)
+			{
+				double marketPrice{ priceSurface.m_table[row][col] };
+				newError += (modelPrices[col] - marketPrice) * (modelPrices[col] - marketPrice) / (marketPrice * marketPrice);
+			}
+		}
+		return newError / static_cast<double>(priceSurface.m_numCols * priceSurface.m_numRows);
+	}
+
 	auto computeBSM_MRSE(const LabeledTable& priceSurface,
 		MarketParams& marketParams,
 		const BSMParams& modelParams,
@@ -248,11 +623,12 @@ namespace Calibrate
 			PSO pso{ 100,1 };
 			pso.set_uniformRandomPositions({ 0.1 }, { 0.9 });
 			pso.set_uniformRandomVelocities({ 0.1 }, { 0.9 });
+			pso.set_bounds({ 1e-6 }, { std::numeric_limits<double>::infinity() });
 
 			// define objective function
 			auto func
 			{
-				[&](std::vector<double> vol) {return  computeBachelier_MRSE(priceSurface, marketParams, BachelierParams{vol[static_cast<std::size_t>(0)]}, modelPriceSurface, errorSurface); }
+				[&](std::span<const double> vol) {return  computeBachelier_MRSE(priceSurface, marketParams, BachelierParams{vol[static_cast<std::size_t>(0)]}, modelPriceSurface, errorSurface); }
 			};
 
 			std::vector<double> optVol{ pso.optimize(func,true) };
@@ -333,9 +709,6 @@ namespace Calibrate
 				vols[static_cast<std::size_t>(0)]
 			};
 
-			// define params of FFT pricing method
-			FFT::FFTParams params{};
-
 			// the maturity of the market variable will change later, the other values are fixed
 			MarketParams marketParams{ 1.0,spot,riskFreeReturn,dividendYield };
 
@@ -345,9 +718,9 @@ namespace Calibrate
 				// collect model parameters, compute error and update surfaces
 				BSMParams modelParams{ vol };
 				double newError{};
-				if (pricing == "fft")
+				if (pricing == "fft" || pricing == "frft" || pricing == "cos")
 				{
-					newError = computeFFTModelMRSE(priceSurface, marketParams, modelParams, params, modelPriceSurface, errorSurface);
+					newError = computeTransformModelMRSE(priceSurface, marketParams, modelParams, pricing, modelPriceSurface, errorSurface);
 				}
 				else
 				{
@@ -391,11 +764,12 @@ namespace Calibrate
 			PSO pso{ 100,1 };
 			pso.set_uniformRandomPositions({ 0.1 }, { 0.9 });
 			pso.set_uniformRandomVelocities({ 0.1 }, { 0.9 });
+			pso.set_bounds({ 1e-4 }, { 5.0 });
 
 			// define objective function
 			auto func
 			{
-				[&](std::vector<double> vol) {return  computeBSM_MRSE(priceSurface, marketParams, BSMParams{vol[static_cast<std::size_t>(0)]}, modelPriceSurface, errorSurface); }
+				[&](std::span<const double> vol) {return  computeBSM_MRSE(priceSurface, marketParams, BSMParams{vol[static_cast<std::size_t>(0)]}, modelPriceSurface, errorSurface); }
 			};
 
 			std::vector<double> optVol{ pso.optimize(func,true) };
@@ -428,72 +802,39 @@ namespace Calibrate
 			[[maybe_unused]] double dividendYield{ 0.0 };
 			//[[maybe_unused]] double spot{ 61.27 };
 
-			// calibrate implied vol
-			[[maybe_unused]] double volGuess{ 0.4 };
-			Adam adam{};
-			for (std::size_t row{ 1 }; row < std::size(csvData); ++row)
-			{
+			// implied vols of all contracts at once on the thread pool, the report is printed afterwards
+			std::size_t numContracts{ std::max<std::size_t>(std::size(csvData), 1) - 1 };
+			std::vector<Volatility::Implied::Solution> solutions(numContracts);
+			ThreadPool::global().parallelFor(numContracts, [&](std::size_t begin, std::size_t end)
+				{
+					for (std::size_t i{ begin }; i < end; ++i)
+					{
+						// index for mat is 1
+						// index for price is 5 for mid, or 7 for last traded
+						// index for strike is 2
+						const std::vector<std::string>& contract{ csvData[i + 1] };
+						solutions[i] = Volatility::Implied::solve(std::stod(contract[7]), riskFreeReturn, std::stod(contract[1]), std::stod(contract[2]), spot, dividendYield, "call");
+					}
+				}, 16);
 
+			std::size_t numConverged{ 0 };
+			for (std::size_t i{ 0 }; i < numContracts; ++i)
+			{
+				numConverged += solutions[i].converged ? std::size_t{ 1 } : std::size_t{ 0 };
+				const std::vector<std::string>& contract{ csvData[i + 1] };
+				double strike{ std::stod(contract[2]) };
 
-				// index for mat is 1
-				// index for price is 5 for mid, or 7 for last traded
-				// index for strike is 2
-				[[maybe_unused]]double truePrice{ std::stod(csvData[row][7]) };
-				[[maybe_unused]]double mat{ std::stod(csvData[row][1]) };
-				[[maybe_unused]]double strike{ std::stod(csvData[row][2]) };
-				
-				// Since the BSM implied volatility becomes ill - defined for deep ITM or OTM options, we restrict to near the money
+				// the yahoo finance quotes are only compared near the money
 				if (std::abs(strike - spot) / std::abs(spot) < 0.02)
 				{
-					std::cout << "Current ratio is " << std::abs(strike - spot) / std::abs(spot) << ".\n";
-				
-					// define adam target function and derivative
-					auto func
-					{
-						[&](double vol) {
-							double price{ Options::Pricing::BSM::call(riskFreeReturn, vol, mat, strike, spot, dividendYield) };
-							return (price - truePrice) * (price - truePrice);
-						}
-					};
-					auto deriv
-					{
-						[&](double vol) {
-							double price{ Options::Pricing::BSM::call(riskFreeReturn, vol, mat, strike, spot, dividendYield) };
-							return 2 * (price - truePrice) * Options::Pricing::BSM::callVega(riskFreeReturn, vol, mat, strike, spot, dividendYield);
-						}
-					};
-
-					adam.set_state(volGuess);
-					//adam.set_state(std::stod(csvData[row][6])); // use yahoo finance quoted implied vol as initial value
-					[[maybe_unused]] double calVol{ adam.optimize(func, deriv, false) };
-					std::cout << "Maturity is " << mat << ".\n";
+					std::cout << "Maturity is " << contract[1] << ".\n";
 					std::cout << "Strike is " << strike << ".\n";
-					std::cout << "True price is " << truePrice << ".\n";
-					std::cout << "Yahoo implied vol is " << csvData[row][6] << ". " << "BSM calibrated implied vol is " << calVol << ".\n";
-					std::cout << "The BSM prediction has error " << func(calVol) << ".\n";
-					std::cout << "Using the yfinance implied vol, BSM yields the price " << Options::Pricing::BSM::call(riskFreeReturn, std::stod(csvData[row][6]), mat, strike, spot, dividendYield) << ".\n\n";
-
-					// PSO instead of adam
-					// define pso on 
-					PSO pso{ 1000,1 };
-					pso.set_uniformRandomPositions({ 0.1 }, { 4.9 });
-					pso.set_uniformRandomVelocities({ 0.1 }, { 4.9 });
-
-					auto func2
-					{
-						[&](std::vector<double> vol)
-						{
-							double price{ Options::Pricing::BSM::call(riskFreeReturn, vol[static_cast<std::size_t>(0)], mat, strike, spot, dividendYield) };
-							return (price - truePrice) * (price - truePrice) + (vol[static_cast<std::size_t>(0)] < 0.0) * 1e10;
-						}
-					};
-
-					std::vector<double> optVol{ pso.optimize(func2,false) };
-					std::cout << "PSO found vol of " << optVol[static_cast<std::size_t>(0)] << " with error " << func2(optVol) << ".\n\n";
-
+					std::cout << "True price is " << contract[7] << ".\n";
+					std::cout << "Yahoo implied vol is " << contract[6] << ". " << "BSM implied vol is " << solutions[i].vol << " after " << solutions[i].iterations << " iterations.\n";
+					std::cout << "Using the yfinance implied vol, BSM yields the price " << Options::Pricing::BSM::call(riskFreeReturn, std::stod(contract[6]), std::stod(contract[1]), strike, spot, dividendYield) << ".\n\n";
 				}
-
 			}
+			std::cout << numConverged << " of " << numContracts << " contracts have an implied vol, the others violate the arbitrage bounds.\n";
 		}
 
 		void test()
@@ -582,7 +923,7 @@ namespace Calibrate
 
 	namespace MertonJump
 	{
-		auto Call(const LabeledTable& priceSurface, double riskFreeReturn, double spot, double dividendYield) -> MertonJumpParams
+		auto Call(const LabeledTable& priceSurface, double riskFreeReturn, double spot, double dividendYield, std::string_view pricing) -> MertonJumpParams
 		{
 
 			// Since we need to populate the surface of model generated prices anyway to compute the model error,
@@ -608,9 +949,6 @@ namespace Calibrate
 				expectedJumpsPerYears[static_cast<std::size_t>(0)]
 			};
 
-			// define params of FFT pricing method
-			FFT::FFTParams params{};
-
 			// the maturity of the market variable will change later, the other values are fixed
 			MarketParams marketParams{ 1.0,spot,riskFreeReturn,dividendYield };
 
@@ -625,7 +963,7 @@ namespace Calibrate
 						{
 							// collect model parameters, compute error and update surfaces
 							MertonJumpParams modelParams{ vl,mj,sj,ej };
-							double newError{ computeFFTModelMRSE(priceSurface, marketParams, modelParams, params, modelPriceSurface, errorSurface) };
+							double newError{ computeTransformModelMRSE(priceSurface, marketParams, modelParams, pricing, modelPriceSurface, errorSurface) };
 
 							if (newError < error)
 							{
@@ -647,7 +985,7 @@ namespace Calibrate
 			return finalParams;
 		}
 
-		auto CallPSO(const LabeledTable& priceSurface, double riskFreeReturn, double spot, double dividendYield) -> MertonJumpParams
+		auto CallPSO(const LabeledTable& priceSurface, double riskFreeReturn, double spot, double dividendYield, std::string_view pricing) -> MertonJumpParams
 		{
 			// Since we need to populate the surface of model generated prices anyway to compute the model error,
 			// we store this surface (initialized as a copy of the true surface) 
@@ -660,9 +998,6 @@ namespace Calibrate
 
 			MertonJumpParams finalParams{ };
 
-			// define params of FFT pricing method
-			FFT::FFTParams params{};
-
 			// the maturity of the market variable will change later, the other values are fixed
 			MarketParams marketParams{ 1.0,spot,riskFreeReturn,dividendYield };
 
@@ -670,20 +1005,25 @@ namespace Calibrate
 			PSO pso{ 10,4 };
 			pso.set_uniformRandomPositions({ 0.01,0.0,0.01,0. }, { 2.0,0.3,0.5,2.0 });
 			pso.set_uniformRandomVelocities({ 0.01,0.0,0.01,0. }, { 2.0,0.3,0.5,2.0 });
+			pso.set_bounds({ 1e-4,-1.0,1e-4,0. }, { 5.0,1.0,2.0,10.0 });
 
 			// define objective function
 			auto func
 			{
-				[&](std::vector<double> paremeters)
+				[&](std::span<const double> paremeters)
 				{
 					MertonJumpParams hparams{ paremeters[0], paremeters[1], paremeters[2], paremeters[3]};
-					return computeFFTModelMRSE(priceSurface, marketParams, hparams, params, modelPriceSurface, errorSurface);
+					return computeTransformModelMRSE(priceSurface, marketParams, hparams, pricing);
 				}
 			};
 
+			pso.set_evaluation(PSO::Evaluation::synchronous);
 			std::vector<double> optParams{ pso.optimize(func,true) };
 			finalParams = { optParams[0], optParams[1], optParams[2], optParams[3] };
 
+			// model prices and errors of the calibrated parameters
+			computeTransformModelMRSE(priceSurface, marketParams, finalParams, pricing, modelPriceSurface, errorSurface);
+
 			// save the model price table to file
 			Saving::write_labeledTable_to_csv("Data/MertonJumpModelPriceSurface.csv", modelPriceSurface);
 			Saving::write_labeledTable_to_csv("Data/MertonJumpModelErrorSurface.csv", errorSurface);
@@ -691,6 +1031,26 @@ namespace Calibrate
 			return finalParams;
 		}
 
+		auto CallLM(const LabeledTable& priceSurface, double riskFreeReturn, double spot, double dividendYield, const MertonJumpParams& initialParams) -> MertonJumpParams
+		{
+			// the maturity of the market variable will change later, the other values are fixed
+			MarketParams marketParams{ 1.0,spot,riskFreeReturn,dividendYield };
+
+			MertonJumpParams finalParams{ calibrateLevenbergMarquardt(priceSurface, marketParams, initialParams) };
+			saveCOSModelSurfaces(priceSurface, marketParams, finalParams, "Merton Jump price surface", "MertonJump");
+			return finalParams;
+		}
+
+		auto CallAdam(const LabeledTable& priceSurface, double riskFreeReturn, double spot, double dividendYield, const MertonJumpParams& initialParams, int numSteps) -> MertonJumpParams
+		{
+			// the maturity of the market variable will change later, the other values are fixed
+			MarketParams marketParams{ 1.0,spot,riskFreeReturn,dividendYield };
+
+			MertonJumpParams finalParams{ calibrateAdam(priceSurface, marketParams, initialParams, numSteps) };
+			saveCOSModelSurfaces(priceSurface, marketParams, finalParams, "Merton Jump price surface", "MertonJump");
+			return finalParams;
+		}
+
 		void test()
 		{
 			// initialize the price table
@@ -751,12 +1111,25 @@ namespace Calibrate
 			*/
 
 		}
+
+		void testLM()
+		{
+			testLMRecovery(MertonJumpParams{ 0.15, -0.1, 0.25, 0.8 }, MertonJumpParams{ 0.2, -0.1, 0.2, 1.0 }, 30);
+		}
+
+		void testAdam()
+		{
+			// a few hundred first order steps do not reach the precision of Levenberg-Marquardt
+			testCOSRecovery("Adam", MertonJumpParams{ 0.15, -0.1, 0.25, 0.8 }, MertonJumpParams{ 0.2, -0.1, 0.2, 1.0 },
+				[](const LabeledTable& priceSurface, MarketParams& marketParams, const MertonJumpParams& initialParams) { return calibrateAdam(priceSurface, marketParams, initialParams, 300); },
+				0.05);
+		}
 	}
 
 	namespace Heston
 	{
 
-		auto Call(const LabeledTable& priceSurface, double riskFreeReturn, double spot, double dividendYield) -> HestonParams
+		auto Call(const LabeledTable& priceSurface, double riskFreeReturn, double spot, double dividendYield, std::string_view pricing) -> HestonParams
 		{
 
 			// Since we need to populate the surface of model generated prices anyway to compute the model error,
@@ -793,9 +1166,6 @@ namespace Calibrate
 				initialVariances[static_cast<std::size_t>(0)],
 			};
 
-			// define params of FFT pricing method
-			FFT::FFTParams params{};
-
 			// the maturity of the market variable will change later, the other values are fixed
 			MarketParams marketParams{ 1.0,spot,riskFreeReturn,dividendYield };
 
@@ -812,7 +1182,7 @@ namespace Calibrate
 							{
 								// collect model parameters, compute error and update surfaces
 								HestonParams modelParams{ rr,lv,vv,cr,iv };
-								double newError{ computeFFTModelMRSE(priceSurface, marketParams, modelParams, params, modelPriceSurface, errorSurface) };
+								double newError{ computeTransformModelMRSE(priceSurface, marketParams, modelParams, pricing, modelPriceSurface, errorSurface) };
 
 								if (newError < error)
 								{
@@ -836,7 +1206,7 @@ namespace Calibrate
 		}
 
 
-		auto CallPSO(const LabeledTable& priceSurface, double riskFreeReturn, double spot, double dividendYield) -> HestonParams
+		auto CallPSO(const LabeledTable& priceSurface, double riskFreeReturn, double spot, double dividendYield, std::string_view pricing) -> HestonParams
 		{
 			// Since we need to populate the surface of model generated prices anyway to compute the model error,
 			// we store this surface (initialized as a copy of the true surface) 
@@ -849,9 +1219,6 @@ namespace Calibrate
 
 			HestonParams finalParams{ };
 
-			// define params of FFT pricing method
-			FFT::FFTParams params{};
-
 			// the maturity of the market variable will change later, the other values are fixed
 			MarketParams marketParams{ 1.0,spot,riskFreeReturn,dividendYield };
 
@@ -859,20 +1226,25 @@ namespace Calibrate
 			PSO pso{ 10,5 };
 			pso.set_uniformRandomPositions({ 0.01,0.1,0.1,-0.9,0.1 }, { 2.0,2.0,2.0,0.9,2.0 });
 			pso.set_uniformRandomVelocities({ 0.01,0.1,0.1,-0.9,0.1 }, { 2.0,2.0,2.0,0.9,2.0 });
+			pso.set_bounds({ 1e-4,1e-4,1e-4,-0.999,1e-4 }, { 10.0,4.0,5.0,0.999,4.0 });
 
 			// define objective function
 			auto func
 			{
-				[&](std::vector<double> paremeters)
+				[&](std::span<const double> paremeters)
 				{
 					HestonParams hparams{ paremeters[0], paremeters[1], paremeters[2], paremeters[3], paremeters[4]};
-					return computeFFTModelMRSE(priceSurface, marketParams, hparams, params, modelPriceSurface, errorSurface);
+					return computeTransformModelMRSE(priceSurface, marketParams, hparams, pricing);
 				}
 			};
 
+			pso.set_evaluation(PSO::Evaluation::synchronous);
 			std::vector<double> optParams{ pso.optimize(func,true) };
 			finalParams = { optParams[0], optParams[1], optParams[2], optParams[3], optParams[4] };
 
+			// model prices and errors of the calibrated parameters
+			computeTransformModelMRSE(priceSurface, marketParams, finalParams, pricing, modelPriceSurface, errorSurface);
+
 			// save the model price table to file
 			Saving::write_labeledTable_to_csv("Data/HestonModelPriceSurface.csv", modelPriceSurface);
 			Saving::write_labeledTable_to_csv("Data/HestonModelErrorSurface.csv", errorSurface);
@@ -880,6 +1252,26 @@ namespace Calibrate
 			return finalParams;
 		}
 
+		auto CallLM(const LabeledTable& priceSurface, double riskFreeReturn, double spot, double dividendYield, const HestonParams& initialParams) -> HestonParams
+		{
+			// the maturity of the market variable will change later, the other values are fixed
+			MarketParams marketParams{ 1.0,spot,riskFreeReturn,dividendYield };
+
+			HestonParams finalParams{ calibrateLevenbergMarquardt(priceSurface, marketParams, initialParams) };
+			saveCOSModelSurfaces(priceSurface, marketParams, finalParams, "Heston price surface", "Heston");
+			return finalParams;
+		}
+
+		auto CallAdam(const LabeledTable& priceSurface, double riskFreeReturn, double spot, double dividendYield, const HestonParams& initialParams, int numSteps) -> HestonParams
+		{
+			// the maturity of the market variable will change later, the other values are fixed
+			MarketParams marketParams{ 1.0,spot,riskFreeReturn,dividendYield };
+
+			HestonParams finalParams{ calibrateAdam(priceSurface, marketParams, initialParams, numSteps) };
+			saveCOSModelSurfaces(priceSurface, marketParams, finalParams, "Heston price surface", "Heston");
+			return finalParams;
+		}
+
 		void test()
 		{
 			// initialize the price table
@@ -928,13 +1320,26 @@ namespace Calibrate
 			std::cout << "correlation: " << fitParams.correlation << "\n";
 			std::cout << "initialVariance: " << fitParams.initialVariance << "\n";
 		}
+
+		void testLM()
+		{
+			testLMRecovery(HestonParams{ 2.0, 0.05, 0.6, -0.7, 0.03 }, HestonParams{ 1.0, 0.04, 0.5, -0.5, 0.04 }, 30);
+		}
+
+		void testAdam()
+		{
+			// a few hundred first order steps do not reach the precision of Levenberg-Marquardt
+			testCOSRecovery("Adam", HestonParams{ 2.0, 0.05, 0.6, -0.7, 0.03 }, HestonParams{ 1.0, 0.04, 0.5, -0.5, 0.04 },
+				[](const LabeledTable& priceSurface, MarketParams& marketParams, const HestonParams& initialParams) { return calibrateAdam(priceSurface, marketParams, initialParams, 300); },
+				0.05);
+		}
 	}
 
 	
 	namespace VarianceGamma
 	{
 
-		auto Call(const LabeledTable& priceSurface, double riskFreeReturn, double spot, double dividendYield) -> VarianceGammaParams
+		auto Call(const LabeledTable& priceSurface, double riskFreeReturn, double spot, double dividendYield, std::string_view pricing) -> VarianceGammaParams
 		{
 			// Since we need to populate the surface of model generated prices anyway to compute the model error,
 			// we store this surface (initialized as a copy of the true surface) 
@@ -955,9 +1360,6 @@ namespace Calibrate
 				variances[static_cast<std::size_t>(0)]
 			};
 
-			// define params of FFT pricing method
-			FFT::FFTParams params{};
-
 			// the maturity of the market variable will change later, the other values are fixed
 			MarketParams marketParams{ 1.0,spot,riskFreeReturn,dividendYield };
 
@@ -970,7 +1372,7 @@ namespace Calibrate
 					{
 						// collect model parameters, compute error and update surfaces
 						VarianceGammaParams modelParams{ vol,drift,variance };
-						double newError{ computeFFTModelMRSE(priceSurface, marketParams, modelParams, params, modelPriceSurface, errorSurface) };
+						double newError{ computeTransformModelMRSE(priceSurface, marketParams, modelParams, pricing, modelPriceSurface, errorSurface) };
 
 						if (newError < error)
 						{
@@ -993,7 +1395,7 @@ namespace Calibrate
 			return finalParams;
 		}
 
-		auto CallPSO(const LabeledTable& priceSurface, double riskFreeReturn, double spot, double dividendYield) -> VarianceGammaParams
+		auto CallPSO(const LabeledTable& priceSurface, double riskFreeReturn, double spot, double dividendYield, std::string_view pricing) -> VarianceGammaParams
 		{
 			// Since we need to populate the surface of model generated prices anyway to compute the model error,
 			// we store this surface (initialized as a copy of the true surface) 
@@ -1006,9 +1408,6 @@ namespace Calibrate
 
 			VarianceGammaParams finalParams{ };
 
-			// define params of FFT pricing method
-			FFT::FFTParams params{};
-
 			// the maturity of the market variable will change later, the other values are fixed
 			MarketParams marketParams{ 1.0,spot,riskFreeReturn,dividendYield };
 
@@ -1016,20 +1415,25 @@ namespace Calibrate
 			PSO pso{ 10,3 };
 			pso.set_uniformRandomPositions({ 0.58,0.01,0.001 }, { 0.62,0.1,0.01 });
 			pso.set_uniformRandomVelocities({ 0.58,0.01,0.001 }, { 0.62,0.1,0.01 });
+			pso.set_bounds({ 1e-4,-1.0,1e-4 }, { 5.0,1.0,5.0 });
 
 			// define objective function
 			auto func
 			{
-				[&](std::vector<double> paremeters)
+				[&](std::span<const double> paremeters)
 				{
 					VarianceGammaParams vgparams{ paremeters[0], paremeters[1], paremeters[2]};
-					return computeFFTModelMRSE(priceSurface, marketParams, vgparams, params, modelPriceSurface, errorSurface);
+					return computeTransformModelMRSE(priceSurface, marketParams, vgparams, pricing);
 				}
 			};
 
+			pso.set_evaluation(PSO::Evaluation::synchronous);
 			std::vector<double> optParams{ pso.optimize(func,true) };
 			finalParams = { optParams[0], optParams[1], optParams[2] };
 
+			// model prices and errors of the calibrated parameters
+			computeTransformModelMRSE(priceSurface, marketParams, finalParams, pricing, modelPriceSurface, errorSurface);
+
 			// save the model price table to file
 			Saving::write_labeledTable_to_csv("Data/VGModelPriceSurface.csv", modelPriceSurface);
 			Saving::write_labeledTable_to_csv("Data/VGModelErrorSurface.csv", errorSurface);
@@ -1037,6 +1441,16 @@ namespace Calibrate
 			return finalParams;
 		}
 
+		auto CallLM(const LabeledTable& priceSurface, double riskFreeReturn, double spot, double dividendYield, const VarianceGammaParams& initialParams) -> VarianceGammaParams
+		{
+			// the maturity of the market variable will change later, the other values are fixed
+			MarketParams marketParams{ 1.0,spot,riskFreeReturn,dividendYield };
+
+			VarianceGammaParams finalParams{ calibrateLevenbergMarquardt(priceSurface, marketParams, initialParams) };
+			saveCOSModelSurfaces(priceSurface, marketParams, finalParams, "Variance Gamma price surface", "VG");
+			return finalParams;
+		}
+
 		void test()
 		{
 			// initialize the price table
@@ -1084,6 +1498,11 @@ namespace Calibrate
 			std::cout << "Variance: " << fitParams.variance << "\n";
 		}
 
+		void testLM()
+		{
+			testLMRecovery(VarianceGammaParams{ 0.25, -0.15, 0.3 }, VarianceGammaParams{ 0.2, -0.1, 0.2 }, 30);
+		}
+
 
 	}
 
@@ -4,18 +4,28 @@
 #include "sdes.h"
 #include "numpy.h"
 #include "fft.h"
+#include "cos.h"
 #include "reading.h"
 #include "adam.h"
 #include "options.h"
 #include "pso.h"
+#include "levenbergMarquardt.h"
 #include "saving.h"
 #include <algorithm>
 #include <cassert>
+#include <limits>
 
 namespace Calibrate
 {
 	auto interpolatePrices(const FFT::LogStrikePricePair& pair, const std::vector<double>& strikes) -> std::vector<double>;
+	auto interpolatePrices(const std::vector<double>& logStrikes, std::span<const double> fftPrices, const std::vector<double>& strikes) -> std::vector<double>;
 	auto computeFFTModelMRSE(const LabeledTable& priceSurface, MarketParams& marketParams, const auto& modelParams, const FFT::FFTParams& params, LabeledTable& modelPriceSurface, LabeledTable& errorSurface) -> double;
+	auto computeFRFTModelMRSE(const LabeledTable& priceSurface, MarketParams& marketParams, const auto& modelParams, const FFT::FRFTParams& params, LabeledTable& modelPriceSurface, LabeledTable& errorSurface) -> double;
+	auto computeCOSModelMRSE(const LabeledTable& priceSurface, MarketParams& marketParams, const auto& modelParams, const COS::COSParams& params, LabeledTable& modelPriceSurface, LabeledTable& errorSurface) -> double;
+	void computeCOSModelResiduals(const LabeledTable& priceSurface, MarketParams& marketParams, const auto& modelParams, const COS::COSParams& params, std::vector<double>& residuals, std::vector<double>& jacobian);
+	auto computeTransformModelMRSE(const LabeledTable& priceSurface, MarketParams& marketParams, const auto& modelParams, std::string_view pricing, LabeledTable& modelPriceSurface, LabeledTable& errorSurface) -> double;
+	// the MRSE alone without filling surfaces, safe to call concurrently
+	auto computeTransformModelMRSE(const LabeledTable& priceSurface, MarketParams marketParams, const auto& modelParams, std::string_view pricing) -> double;
 	auto computeBSM_MRSE(const LabeledTable& priceSurface, MarketParams& marketParams, const BSMParams& modelParams, LabeledTable& modelPriceSurface, LabeledTable& errorSurface) -> double;
 	auto computeBachelier_MRSE(const LabeledTable& priceSurface, MarketParams& marketParams, const BachelierParams& modelParams, LabeledTable& modelPriceSurface, LabeledTable& errorSurface) -> double;
 
@@ -37,23 +47,38 @@ namespace Calibrate
 
 	namespace MertonJump
 	{
-		auto Call(const LabeledTable& priceSurface, double riskFreeReturn, double spot, double dividendYield) -> MertonJumpParams;
-		auto CallPSO(const LabeledTable& priceSurface, double riskFreeReturn, double spot, double dividendYield) -> MertonJumpParams;
+		auto Call(const LabeledTable& priceSurface, double riskFreeReturn, double spot, double dividendYield, std::string_view pricing = "fft") -> MertonJumpParams;
+		auto CallPSO(const LabeledTable& priceSurface, double riskFreeReturn, double spot, double dividendYield, std::string_view pricing = "fft") -> MertonJumpParams;
+		// gradient based least squares calibration on COS prices
+		auto CallLM(const LabeledTable& priceSurface, double riskFreeReturn, double spot, double dividendYield, const MertonJumpParams& initialParams = MertonJumpParams{ 0.2, -0.1, 0.2, 1.0 }) -> MertonJumpParams;
+		// the same least squares problem with a few hundred Adam steps on the gradient of the MRSE
+		auto CallAdam(const LabeledTable& priceSurface, double riskFreeReturn, double spot, double dividendYield, const MertonJumpParams& initialParams = MertonJumpParams{ 0.2, -0.1, 0.2, 1.0 }, int numSteps = 300) -> MertonJumpParams;
 		void test();
+		void testLM();
+		void testAdam();
 	}
 	
 	namespace Heston
 	{
-		auto Call(const LabeledTable& priceSurface, double riskFreeReturn, double spot, double dividendYield) -> HestonParams;
-		auto CallPSO(const LabeledTable& priceSurface, double riskFreeReturn, double spot, double dividendYield) -> HestonParams;
+		auto Call(const LabeledTable& priceSurface, double riskFreeReturn, double spot, double dividendYield, std::string_view pricing = "fft") -> HestonParams;
+		auto CallPSO(const LabeledTable& priceSurface, double riskFreeReturn, double spot, double dividendYield, std::string_view pricing = "fft") -> HestonParams;
+		// gradient based least squares calibration on COS prices
+		auto CallLM(const LabeledTable& priceSurface, double riskFreeReturn, double spot, double dividendYield, const HestonParams& initialParams = HestonParams{ 1.0, 0.04, 0.5, -0.5, 0.04 }) -> HestonParams;
+		// the same least squares problem with a few hundred Adam steps on the gradient of the MRSE
+		auto CallAdam(const LabeledTable& priceSurface, double riskFreeReturn, double spot, double dividendYield, const HestonParams& initialParams = HestonParams{ 1.0, 0.04, 0.5, -0.5, 0.04 }, int numSteps = 300) -> HestonParams;
 		void test();
+		void testLM();
+		void testAdam();
 	}
 
 	namespace VarianceGamma
 	{
-		auto Call(const LabeledTable& priceSurface, double riskFreeReturn, double spot, double dividendYield) -> VarianceGammaParams;
-		auto CallPSO(const LabeledTable& priceSurface, double riskFreeReturn, double spot, double dividendYield) -> VarianceGammaParams;
+		auto Call(const LabeledTable& priceSurface, double riskFreeReturn, double spot, double dividendYield, std::string_view pricing = "fft") -> VarianceGammaParams;
+		auto CallPSO(const LabeledTable& priceSurface, double riskFreeReturn, double spot, double dividendYield, std::string_view pricing = "fft") -> VarianceGammaParams;
+		// gradient based least squares calibration on COS prices
+		auto CallLM(const LabeledTable& priceSurface, double riskFreeReturn, double spot, double dividendYield, const VarianceGammaParams& initialParams = VarianceGammaParams{ 0.2, -0.1, 0.2 }) -> VarianceGammaParams;
 		void test();
+		void testLM();
 	}
 
 }
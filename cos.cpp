@@ -0,0 +1,341 @@
+#include "cos.h"
+#include "options.h"
+#include "calibrate.h"
+#include <vector>
+#include <string_view>
+#include <cmath>
+#include <complex>
+#include <cassert>
+#include <algorithm>
+#include <iostream>
+#include <span>
+
+namespace COS
+{
+	auto cumulants(const auto& modelParams, const MarketParams& marketParams) -> Cumulants
+	{
+		// cumulants of the log return log(S_T / S_0) from finite differences of the
+		// cumulant generating function K(h) = log E[exp(h X)] = log phi(-i h), where K(0) = 0.
+		MarketParams returnMarketParams{ marketParams };
+		returnMarketParams.spot = 1.0;
+
+		double stepSize{ 0.1 };
+		auto cgf
+		{
+			[&](double h)
+			{
+				return std::log(std::real(SDE::CharacteristicFunctions::generalCF(std::complex<double>(0.0, -h), modelParams, returnMarketParams)));
+			}
+		};
+		double kPlus{ cgf(stepSize) };
+		double kMinus{ cgf(-stepSize) };
+		double kPlus2{ cgf(2. * stepSize) };
+		double kMinus2{ cgf(-2. * stepSize) };
+
+		Cumulants result{};
+		result.c1 = (kPlus - kMinus) / (2. * stepSize);
+		result.c2 = std::max((kPlus + kMinus) / (stepSize * stepSize), 0.0);
+		result.c4 = std::abs((kPlus2 - 4. * kPlus - 4. * kMinus + kMinus2) / (stepSize * stepSize * stepSize * stepSize));
+		return result;
+	}
+
+	// truncation range and frequencies of the cosine expansion of the log return
+	struct Expansion
+	{
+		Cumulants cumulant{};
+		double halfWidth{ 0.0 };
+		double rangeWidth{ 0.0 };
+		ComplexArray cfArguments{};
+	};
+
+	auto expansion(const auto& modelParams, const MarketParams& marketParams, const COSParams& params) -> Expansion
+	{
+		assert(params.numTerms > 0);
+		Expansion result{};
+		result.cumulant = cumulants(modelParams, marketParams);
+		result.halfWidth = params.truncation * std::sqrt(result.cumulant.c2 + std::sqrt(result.cumulant.c4));
+		result.rangeWidth = 2. * result.halfWidth;
+		result.cfArguments = ComplexArray(params.numTerms);
+		for (std::size_t k{ 0 }; k < params.numTerms; ++k)
+		{
+			result.cfArguments.real[k] = static_cast<double>(k) * PI / result.rangeWidth;
+		}
+		return result;
+	}
+
+	// In y = log(S_T / K) the interval is [a_K, a_K + rangeWidth] with a_K = log(S_0 / K) + c1 - halfWidth.
+	// The characteristic function terms phi(u_k) exp(i u_k (log(S_0 / K) - a_K)) therefore do not depend on the strike
+	// and are shared by all of them. Returns their real parts scaled by 2 / rangeWidth, the first one weighted by one half.
+	auto seriesTerms(const Expansion& range, const ComplexArray& cfValues) -> std::vector<double>
+	{
+		std::size_t numTerms{ range.cfArguments.size() };
+		std::vector<double> terms(numTerms);
+		for (std::size_t k{ 0 }; k < numTerms; ++k)
+		{
+			// real part of phi(u_k) exp(i u_k (halfWidth - c1))
+			double shift{ range.cfArguments.real[k] * (range.halfWidth - range.cumulant.c1) };
+			terms[k] = (cfValues.real[k] * std::cos(shift) - cfValues.imag[k] * std::sin(shift)) * 2. / range.rangeWidth;
+		}
+		terms[0] *= 0.5;
+		return terms;
+	}
+
+	// Sum over k of terms[k] times the cosine coefficient of the put payoff 1 - e^y on [lower, upper] for every set of terms.
+	// The put price per unit of discounted strike is this sum for the terms of the characteristic function.
+	void putSums(const Expansion& range, double lower, double upper, std::span<const std::vector<double>> terms, std::span<double> sums)
+	{
+		double expLower{ std::exp(lower) };
+		double expUpper{ std::exp(upper) };
+		// cos(u_k (upper - lower)) and sin(u_k (upper - lower)) by rotation instead of numTerms trigonometric calls
+		std::complex<double> rotation{ std::exp(IMNUM * PI * (upper - lower) / range.rangeWidth) };
+		std::complex<double> phase{ 1.0 };
+
+		std::fill(std::begin(sums), std::end(sums), 0.0);
+		for (std::size_t k{ 0 }; k < range.cfArguments.size(); ++k)
+		{
+			double u{ range.cfArguments.real[k] };
+			double chi{ (std::real(phase) * expUpper - expLower + u * std::imag(phase) * expUpper) / (1. + u * u) };
+			double psi{ (k == 0) ? upper - lower : std::imag(phase) / u };
+			for (std::size_t j{ 0 }; j < std::size(terms); ++j)
+			{
+				sums[j] += terms[j][k] * (psi - chi);
+			}
+			phase *= rotation;
+		}
+	}
+
+	auto pricingcos(const auto& modelParams, const MarketParams& marketParams, const std::vector<double>& strikes, const COSParams& params, std::string_view type) -> std::vector<double>
+	{
+		// Puts are priced with the COS expansion (their payoff is bounded, which keeps the series stable),
+		// calls follow from put-call parity.
+		double maturity{ marketParams.maturity };
+		double spot{ marketParams.spot };
+		double discount{ std::exp(-marketParams.riskFreeReturn * maturity) };
+		double forwardDiscounted{ spot * std::exp(-marketParams.dividendYield * maturity) };
+
+		Expansion range{ expansion(modelParams, marketParams, params) };
+		MarketParams returnMarketParams{ marketParams };
+		returnMarketParams.spot = 1.0;
+		ComplexArray cfValues{ SDE::CharacteristicFunctions::generalCF(range.cfArguments, modelParams, returnMarketParams) };
+		std::vector<double> cfTerms[]{ seriesTerms(range, cfValues) };
+
+		std::vector<double> prices(std::size(strikes));
+		for (std::size_t i{ 0 }; i < std::size(strikes); ++i)
+		{
+			double strike{ strikes[i] };
+			double lower{ std::log(spot / strike) + range.cumulant.c1 - range.halfWidth };
+			double upper{ std::min(lower + range.rangeWidth, 0.0) };
+
+			// the put pays K (1 - e^y) on [lower, upper], which is empty if the strike lies below the whole range
+			double putPrice{ 0.0 };
+			if (lower < 0.0)
+			{
+				double sum{ 0.0 };
+				putSums(range, lower, upper, cfTerms, std::span<double>{ &sum, 1 });
+				putPrice = std::max(discount * strike * sum, 0.0);
+			}
+
+			if (type == "put")
+			{
+				prices[i] = putPrice;
+			}
+			else
+			{
+				prices[i] = putPrice + forwardDiscounted - strike * discount;
+			}
+		}
+
+		return prices;
+	}
+
+	auto gradientcos(const auto& modelParams, const MarketParams& marketParams, const std::vector<double>& strikes, const COSParams& params, std::string_view type) -> PriceGradients
+	{
+		// Put-call parity does not involve the model parameters, so calls and puts have the same gradient.
+		// The expansion is linear in the characteristic function, its derivatives replace it in the series.
+		double maturity{ marketParams.maturity };
+		double spot{ marketParams.spot };
+		double discount{ std::exp(-marketParams.riskFreeReturn * maturity) };
+		double forwardDiscounted{ spot * std::exp(-marketParams.dividendYield * maturity) };
+
+		Expansion range{ expansion(modelParams, marketParams, params) };
+		MarketParams returnMarketParams{ marketParams };
+		returnMarketParams.spot = 1.0;
+
+		// derivatives of the characteristic function by every parameter on the frequency grid
+		std::size_t numTerms{ range.cfArguments.size() };
+		ComplexArray cfValues{ SDE::CharacteristicFunctions::generalCF(range.cfArguments, modelParams, returnMarketParams) };
+		std::vector<ComplexArray> cfGradients{};
+		for (std::size_t k{ 0 }; k < numTerms; ++k)
+		{
+			std::vector<std::complex<double>> gradient{ SDE::CharacteristicFunctions::generalCFGradient(range.cfArguments.real[k], modelParams, returnMarketParams) };
+			cfGradients.resize(std::size(gradient), ComplexArray(numTerms));
+			for (std::size_t j{ 0 }; j < std::size(gradient); ++j)
+			{
+				cfGradients[j].real[k] = std::real(gradient[j]);
+				cfGradients[j].imag[k] = std::imag(gradient[j]);
+			}
+		}
+		std::size_t numParams{ std::size(cfGradients) };
+
+		// terms of the characteristic function first, then those of its derivative by every parameter
+		std::vector<std::vector<double>> terms{ seriesTerms(range, cfValues) };
+		for (const ComplexArray& cfGradient : cfGradients)
+		{
+			terms.push_back(seriesTerms(range, cfGradient));
+		}
+
+		PriceGradients result{ std::vector<double>(std::size(strikes)), std::vector<std::vector<double>>(std::size(strikes), std::vector<double>(numParams, 0.0)) };
+		std::vector<double> sums(numParams + 1);
+		for (std::size_t i{ 0 }; i < std::size(strikes); ++i)
+		{
+			double strike{ strikes[i] };
+			double lower{ std::log(spot / strike) + range.cumulant.c1 - range.halfWidth };
+			double upper{ std::min(lower + range.rangeWidth, 0.0) };
+
+			double putPrice{ 0.0 };
+			if (lower < 0.0)
+			{
+				putSums(range, lower, upper, terms, sums);
+				putPrice = std::max(discount * strike * sums[0], 0.0);
+				// a put price floored at zero does not move with the parameters
+				if (putPrice > 0.0)
+				{
+					for (std::size_t j{ 0 }; j < numParams; ++j)
+					{
+						result.gradients[i][j] = discount * strike * sums[j + 1];
+					}
+				}
+			}
+			result.prices[i] = (type == "put") ? putPrice : putPrice + forwardDiscounted - strike * discount;
+		}
+
+		return result;
+	}
+
+	auto pricingcosHeston(const HestonParams& modelParams, const MarketParams& marketParams, const std::vector<double>& strikes, const COSParams& params, std::string_view type) -> std::vector<double>
+	{
+		return pricingcos(modelParams, marketParams, strikes, params, type);
+	}
+
+	auto pricingcosBSM(const BSMParams& modelParams, const MarketParams& marketParams, const std::vector<double>& strikes, const COSParams& params, std::string_view type) -> std::vector<double>
+	{
+		return pricingcos(modelParams, marketParams, strikes, params, type);
+	}
+
+	auto pricingcosMertonJump(const MertonJumpParams& modelParams, const MarketParams& marketParams, const std::vector<double>& strikes, const COSParams& params, std::string_view type) -> std::vector<double>
+	{
+		return pricingcos(modelParams, marketParams, strikes, params, type);
+	}
+
+	auto pricingcosVarianceGamma(const VarianceGammaParams& modelParams, const MarketParams& marketParams, const std::vector<double>& strikes, const COSParams& params, std::string_view type) -> std::vector<double>
+	{
+		return pricingcos(modelParams, marketParams, strikes, params, type);
+	}
+
+	auto pricingcosGradient(const HestonParams& modelParams, const MarketParams& marketParams, const std::vector<double>& strikes, const COSParams& params, std::string_view type) -> PriceGradients
+	{
+		return gradientcos(modelParams, marketParams, strikes, params, type);
+	}
+
+	auto pricingcosGradient(const BSMParams& modelParams, const MarketParams& marketParams, const std::vector<double>& strikes, const COSParams& params, std::string_view type) -> PriceGradients
+	{
+		return gradientcos(modelParams, marketParams, strikes, params, type);
+	}
+
+	auto pricingcosGradient(const MertonJumpParams& modelParams, const MarketParams& marketParams, const std::vector<double>& strikes, const COSParams& params, std::string_view type) -> PriceGradients
+	{
+		return gradientcos(modelParams, marketParams, strikes, params, type);
+	}
+
+	auto pricingcosGradient(const VarianceGammaParams& modelParams, const MarketParams& marketParams, const std::vector<double>& strikes, const COSParams& params, std::string_view type) -> PriceGradients
+	{
+		return gradientcos(modelParams, marketParams, strikes, params, type);
+	}
+
+	namespace UnitTests
+	{
+		void pricingcos()
+		{
+			// BSM has closed form prices, Heston is compared to the Carr-Madan FFT
+			MarketParams marketParams{ 0.5, 100.0, 0.03, 0.01 };
+			std::vector<double> strikes{ np::linspace<double>(70.,130.,13) };
+			COSParams params{};
+
+			BSMParams bsmParams{ 0.2 };
+			std::vector<double> bsmPrices{ COS::pricingcos(bsmParams, marketParams, strikes, params) };
+			double maxErrorBSM{ 0.0 };
+			for (std::size_t i{ 0 }; i < std::size(strikes); ++i)
+			{
+				double truePrice{ Options::Pricing::BSM::call(marketParams.riskFreeReturn, bsmParams.vol, marketParams.maturity, strikes[i], marketParams.spot, marketParams.dividendYield) };
+				maxErrorBSM = std::max(maxErrorBSM, std::abs(bsmPrices[i] - truePrice));
+			}
+			std::cout << "Maximal deviation between COS and analytic BSM prices is " << maxErrorBSM << "\n";
+
+			HestonParams hestonParams{ 0.1, 0.04, 0.2, -0.5, 0.04 };
+			std::vector<double> hestonPrices{ COS::pricingcos(hestonParams, marketParams, strikes, params) };
+			std::vector<double> fftPrices{ Calibrate::interpolatePrices(FFT::pricingfft(hestonParams, marketParams, FFT::FFTParams{}), strikes) };
+			double maxErrorHeston{ 0.0 };
+			for (std::size_t i{ 0 }; i < std::size(strikes); ++i)
+			{
+				maxErrorHeston = std::max(maxErrorHeston, std::abs(hestonPrices[i] - fftPrices[i]));
+			}
+			std::cout << "Maximal deviation between COS and FFT Heston prices is " << maxErrorHeston << "\n";
+		}
+
+		void pricingcosGradient()
+		{
+			// The analytic gradients are compared to central differences of the COS prices. The truncation range moves with
+			// the parameters in the differences, but with the default truncation the prices do not depend on it.
+			MarketParams marketParams{ 0.5, 100.0, 0.03, 0.01 };
+			std::vector<double> strikes{ np::linspace<double>(70.,130.,13) };
+			COSParams params{};
+
+			auto check
+			{
+				[&](std::string_view name, const auto& modelParams, auto withParameter)
+				{
+					PriceGradients analytic{ COS::pricingcosGradient(modelParams, marketParams, strikes, params) };
+					double maxError{ 0.0 };
+					for (std::size_t j{ 0 }; j < std::size(analytic.gradients[0]); ++j)
+					{
+						double stepSize{ 1e-5 };
+						std::vector<double> pricesUp{ COS::pricingcos(withParameter(j, stepSize), marketParams, strikes, params) };
+						std::vector<double> pricesDown{ COS::pricingcos(withParameter(j, -stepSize), marketParams, strikes, params) };
+						for (std::size_t i{ 0 }; i < std::size(strikes); ++i)
+						{
+							maxError = std::max(maxError, std::abs(analytic.gradients[i][j] - (pricesUp[i] - pricesDown[i]) / (2. * stepSize)));
+						}
+					}
+					std::cout << "Maximal deviation between analytic and finite difference " << name << " price gradients is " << maxError << "\n";
+				}
+			};
+
+			BSMParams bsmParams{ 0.2 };
+			check("BSM", bsmParams, [&](std::size_t, double shift) { return BSMParams{ bsmParams.vol + shift }; });
+
+			HestonParams hestonParams{ 1.5, 0.04, 0.5, -0.6, 0.05 };
+			check("Heston", hestonParams, [&](std::size_t j, double shift)
+				{
+					std::vector<double> values{ hestonParams.reversionRate, hestonParams.longVariance, hestonParams.volVol, hestonParams.correlation, hestonParams.initialVariance };
+					values[j] += shift;
+					return HestonParams{ values[0], values[1], values[2], values[3], values[4] };
+				});
+
+			MertonJumpParams mertonParams{ 0.15, -0.1, 0.2, 0.8 };
+			check("Merton jump", mertonParams, [&](std::size_t j, double shift)
+				{
+					std::vector<double> values{ mertonParams.vol, mertonParams.meanJumpSize, mertonParams.stdJumpSize, mertonParams.expectedJumpsPerYear };
+					values[j] += shift;
+					return MertonJumpParams{ values[0], values[1], values[2], values[3] };
+				});
+
+			VarianceGammaParams vgParams{ 0.2, -0.1, 0.2 };
+			check("Variance Gamma", vgParams, [&](std::size_t j, double shift)
+				{
+					std::vector<double> values{ vgParams.vol, vgParams.drift, vgParams.variance };
+					values[j] += shift;
+					return VarianceGammaParams{ values[0], values[1], values[2] };
+				});
+		}
+	}
+}
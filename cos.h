@@ -0,0 +1,55 @@
+#ifndef COS_H
+#define COS_H
+#include "sdes.h"
+#include "fft.h"
+#include <vector>
+#include <complex>
+#include <string_view>
+
+// Fourier-cosine (COS) method of Fang and Oosterlee. The density of the log return is expanded
+// in a cosine series on a truncated interval, whose coefficients follow directly from the characteristic function.
+// Prices of arbitrary strikes come out without an FFT grid or interpolation.
+namespace COS
+{
+	struct COSParams
+	{
+		std::size_t numTerms{ 256 };
+		// the log return is truncated to c1 +- truncation * sqrt(c2 + sqrt(c4))
+		double truncation{ 10.0 };
+	};
+
+	struct Cumulants
+	{
+		double c1{ 0.0 };
+		double c2{ 0.0 };
+		double c4{ 0.0 };
+	};
+
+	auto pricingcos(const auto& modelParams, const MarketParams& marketParams, const std::vector<double>& strikes, const COSParams& params, std::string_view type = "call") -> std::vector<double>;
+	auto pricingcosHeston(const HestonParams& modelParams, const MarketParams& marketParams, const std::vector<double>& strikes, const COSParams& params, std::string_view type = "call") -> std::vector<double>;
+	auto pricingcosBSM(const BSMParams& modelParams, const MarketParams& marketParams, const std::vector<double>& strikes, const COSParams& params, std::string_view type = "call") -> std::vector<double>;
+	auto pricingcosMertonJump(const MertonJumpParams& modelParams, const MarketParams& marketParams, const std::vector<double>& strikes, const COSParams& params, std::string_view type = "call") -> std::vector<double>;
+	auto pricingcosVarianceGamma(const VarianceGammaParams& modelParams, const MarketParams& marketParams, const std::vector<double>& strikes, const COSParams& params, std::string_view type = "call") -> std::vector<double>;
+
+	// prices together with their derivatives by the model parameters, gradients[i][j] is the derivative of prices[i]
+	// by parameter j in the order of the parameters' constructor arguments. The characteristic function is differentiated
+	// analytically inside the expansion, the truncation range is held fixed.
+	struct PriceGradients
+	{
+		std::vector<double> prices{};
+		std::vector<std::vector<double>> gradients{};
+	};
+
+	auto pricingcosGradient(const HestonParams& modelParams, const MarketParams& marketParams, const std::vector<double>& strikes, const COSParams& params, std::string_view type = "call") -> PriceGradients;
+	auto pricingcosGradient(const BSMParams& modelParams, const MarketParams& marketParams, const std::vector<double>& strikes, const COSParams& params, std::string_view type = "call") -> PriceGradients;
+	auto pricingcosGradient(const MertonJumpParams& modelParams, const MarketParams& marketParams, const std::vector<double>& strikes, const COSParams& params, std::string_view type = "call") -> PriceGradients;
+	auto pricingcosGradient(const VarianceGammaParams& modelParams, const MarketParams& marketParams, const std::vector<double>& strikes, const COSParams& params, std::string_view type = "call") -> PriceGradients;
+
+	namespace UnitTests
+	{
+		void pricingcos();
+		void pricingcosGradient();
+	}
+}
+
+#endif
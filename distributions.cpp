@@ -1,8 +1,96 @@
 #include "distributions.h"
+#include <algorithm>
+#include <cassert>
 #include <cmath>
+#include <bit>
+#include <cstdint>
+#include <utility>
 
 namespace Distributions
 {
+	namespace
+	{
+		// Chebyshev coefficients of (z + 4) exp(z^2) erfc(z) for z >= 0 in the variable y = (z - 4) / (z + 4), which maps [0, inf) onto [-1, 1).
+		// The factor z + 4 keeps the expansion away from zero, so its accuracy of 1e-16 stays relative as exp(z^2) erfc(z) decays like 1 / z.
+		constexpr double erfcxCoefficients[]{
+			3.2641957563930517e+00, -1.5054329427054698e+00, 5.9032141828889451e-01, -1.9828527172011035e-01, 5.6908430228468698e-02,
+			-1.3773973050870096e-02, 2.7290167331352321e-03, -4.1361807903024755e-04, 3.8914183807960599e-05, 4.7954855033648178e-07,
+			-8.6991070813798253e-07, 1.2116707094396558e-07, 3.7919670260818199e-09, -3.4533646779963824e-09, 2.7488625703813610e-10,
+			6.8139593753185107e-11, -1.3568522747316355e-11, -1.0463235067416098e-12, 4.8510703212434560e-13, 8.4587581729792363e-15,
+			-1.6469363733616713e-14, 2.5314850886802834e-16, 5.7572443933799385e-16, -1.8245979193136522e-17, -2.1356377031912541e-17 };
+
+		// exp(z^2) erfc(z) for z >= 0 by the Clenshaw recurrence, unrolled at compile time (j runs from the last coefficient down to 1)
+		template <std::size_t... J>
+		inline auto scaledErfc(double z, std::index_sequence<J...>) -> double
+		{
+			constexpr std::size_t last{ std::size(erfcxCoefficients) - 1 };
+			double y{ 1. - 8. / (z + 4.) };
+			double current{ 0. };
+			double previous{ 0. };
+			double next{ 0. };
+			((next = 2. * y * current - previous + erfcxCoefficients[last - J], previous = current, current = next), ...);
+			return (y * current - previous + 0.5 * erfcxCoefficients[0]) / (z + 4.);
+		}
+
+		inline auto scaledErfc(double z) -> double
+		{
+			return scaledErfc(z, std::make_index_sequence<std::size(erfcxCoefficients) - 1>{});
+		}
+
+		// condition ? a : b by a bit mask. Written as a conditional, gcc moves the computation of a or b into a branch
+		// (it does not evaluate floating point operations speculatively while trapping math is on), which keeps loops from vectorizing.
+		inline auto select(bool condition, double a, double b) -> double
+		{
+			std::uint64_t mask{ std::uint64_t{ 0 } - static_cast<std::uint64_t>(condition) };
+			return std::bit_cast<double>((std::bit_cast<std::uint64_t>(a) & mask) | (std::bit_cast<std::uint64_t>(b) & ~mask));
+		}
+
+		// exp(x) without branches or library calls, so loops over it vectorize. x = k ln(2) + r with |r| <= ln(2) / 2,
+		// ln(2) split in two parts of which k ln(2) is exact in the first (Cody and Waite), e^r by its Taylor polynomial of
+		// degree 13 and 2^k from the exponent bits in two factors, which also covers subnormal results. Relative error 1.4e-16
+		// against std::exp over [-746, 0], results below 2^-1075 round to zero and above 2^1024 overflow to infinity.
+		inline auto exp(double x) -> double
+		{
+			constexpr double log2e{ 1.44269504088896338700 };
+			constexpr double ln2High{ 6.93147180369123816490e-01 };
+			constexpr double ln2Low{ 1.90821492927058770002e-10 };
+			// adding 1.5 * 2^52 rounds to an integer which ends up in the low bits of the mantissa
+			constexpr double shifter{ 6755399441055744.0 };
+			double shifted{ x * log2e + shifter };
+			double k{ shifted - shifter };
+			// unsigned, so the integer arithmetic wraps instead of overflowing for arguments outside the range selected below
+			std::uint64_t exponent{ std::bit_cast<std::uint64_t>(shifted) - std::bit_cast<std::uint64_t>(shifter) };
+			double r{ (x - k * ln2High) - k * ln2Low };
+			double polynomial{ ((((((((((((1. / 6227020800. * r + 1. / 479001600.) * r + 1. / 39916800.) * r + 1. / 3628800.) * r + 1. / 362880.) * r
+				+ 1. / 40320.) * r + 1. / 5040.) * r + 1. / 720.) * r + 1. / 120.) * r + 1. / 24.) * r + 1. / 6.) * r + 0.5) * r + 1.) * r + 1. };
+			// k / 2 rounded down by the same shift (k / 2 - 1 / 4 lies a quarter away from the nearest integer), as AVX2 has no arithmetic shift of 64 bit integers
+			double shiftedHalf{ 0.5 * k - 0.25 + shifter };
+			std::uint64_t half{ std::bit_cast<std::uint64_t>(shiftedHalf) - std::bit_cast<std::uint64_t>(shifter) };
+			double scale1{ std::bit_cast<double>((half + 1023) << 52) };
+			double scale2{ std::bit_cast<double>((exponent - half + 1023) << 52) };
+			// results outside the range are selected at the end, clamping the argument lets gcc fold the clamped constants into separate branches
+			return select(x > 710., INFINITY, select(x < -746., 0., polynomial * scale1 * scale2));
+		}
+
+		// exp(-x^2 / 2), x^2 is split into the exact square of x rounded to 1/16 and a small remainder,
+		// so the rounding of x^2 does not cost relative accuracy in the tails. The rounding adds and subtracts 1.5 * 2^52
+		// instead of calling std::trunc, which gcc does not vectorize unless trapping math is switched off.
+		inline auto gaussianKernel(double x) -> double
+		{
+			constexpr double shifter{ 6755399441055744.0 };
+			double rounded{ (16. * x + shifter - shifter) / 16. };
+			return exp(-0.5 * rounded * rounded) * exp(-0.5 * (x - rounded) * (x + rounded));
+		}
+
+		// lower tail 0.5 erfc(|x| / sqrt(2)) of the normal distribution, which keeps its relative accuracy for large |x|
+		inline auto normalTail(double x) -> double
+		{
+			double absX{ std::abs(x) };
+			absX = select(absX > 40., 40., absX);
+			return 0.5 * gaussianKernel(absX) * scaledErfc(absX * 0.70710678118654752440);
+		}
+	}
+
 	namespace MomentGeneratingFunctions
 	{
 		auto normal(double argument, double mean, double volatility) -> double
@@ -24,26 +112,59 @@ namespace Distributions
 		}
 		auto standardNormal(double x) -> double
 		{
-			// taken from https://www.johndcook.com/blog/cpp_phi/
-			// constants
-			double a1 = 0.254829592;
-			double a2 = -0.284496736;
-			double a3 = 1.421413741;
-			double a4 = -1.453152027;
-			double a5 = 1.061405429;
-			double p = 0.3275911;
+			// the upper tail is the complement of the lower one
+			double tail{ normalTail(x) };
+			return select(x < 0., tail, 1. - tail);
+		}
 
-			// Save the sign of x
-			int sign = 1;
-			if (x < 0)
-				sign = -1;
-			x = fabs(x) / sqrt(2.0);
+		void standardNormal(std::span<const double> x, std::span<double> out)
+		{
+			assert(std::size(x) == std::size(out));
+			for (std::size_t i{ 0 }; i < std::size(x); ++i)
+			{
+				double tail{ normalTail(x[i]) };
+				out[i] = select(x[i] < 0., tail, 1. - tail);
+			}
+		}
+	}
 
-			// A&S formula 7.1.26
-			double t = 1.0 / (1.0 + p * x);
-			double y = 1.0 - (((((a5 * t + a4) * t) + a3) * t + a2) * t + a1) * t * exp(-x * x);
+	namespace InverseCDFs
+	{
+		auto standardNormal(double p) -> double
+		{
+			// rational approximation of Acklam (relative error 1.15e-9) in the lower half, refined by one Halley step
+			// with the accurate CDF, which gives full double precision. The upper half follows by symmetry, 1 - p is exact there.
+			// Both regions are evaluated and selected without branches.
+			constexpr double a[]{ -3.969683028665376e+01, 2.209460984245205e+02, -2.759285104469687e+02, 1.383577518672690e+02, -3.066479806614716e+01, 2.506628277459239e+00 };
+			constexpr double b[]{ -5.447609879822406e+01, 1.615858368580409e+02, -1.556989798598866e+02, 6.680131188771972e+01, -1.328068155288572e+01 };
+			constexpr double c[]{ -7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00, -2.549732539343734e+00, 4.374664141464968e+00, 2.938163982698783e+00 };
+			constexpr double d[]{ 7.784695709041462e-03, 3.224671290700398e-01, 2.445134137142996e+00, 3.754408661907416e+00 };
+			constexpr double pLow{ 0.02425 };
+
+			double lower{ std::min(p, 1. - p) };
+			double q{ std::sqrt(-2. * std::log(lower)) };
+			double tailX{ (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) / ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1.) };
+			double centered{ lower - 0.5 };
+			double r{ centered * centered };
+			double centralX{ (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5]) * centered / (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1.) };
+			double x{ lower < pLow ? tailX : centralX };
+
+			double error{ CDFs::standardNormal(x) - lower };
+			double u{ error * 2.50662827463100050242 / gaussianKernel(x) };
+			x -= u / (1. + 0.5 * x * u);
+
+			x = p > 0.5 ? -x : x;
+			x = p <= 0. ? -INFINITY : x;
+			return p >= 1. ? INFINITY : x;
+		}
 
-			return 0.5 * (1.0 + sign * y);
+		void standardNormal(std::span<const double> p, std::span<double> out)
+		{
+			assert(std::size(p) == std::size(out));
+			for (std::size_t i{ 0 }; i < std::size(p); ++i)
+			{
+				out[i] = standardNormal(p[i]);
+			}
 		}
 	}
 
@@ -59,14 +180,22 @@ namespace Distributions
 		}
 		auto standardNormal(double x) -> double
 		{
-			double pi = 3.1415926535;
-			return 1.0 / sqrt(2 * pi) * exp(-x * x / 2.0);
+			return 0.39894228040143267794 * gaussianKernel(x);
 		}
+
+		void standardNormal(std::span<const double> x, std::span<double> out)
+		{
+			assert(std::size(x) == std::size(out));
+			for (std::size_t i{ 0 }; i < std::size(x); ++i)
+			{
+				out[i] = 0.39894228040143267794 * gaussianKernel(x[i]);
+			}
+		}
+
 		// derivative of pdf
 		auto standardNormal_dx(double x) -> double
 		{
-			double pi = 3.1415926535;
-			return - x / sqrt(2 * pi) * exp(-x * x / 2.0);
+			return -x * standardNormal(x);
 		}
 	}
 
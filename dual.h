@@ -0,0 +1,243 @@
+#ifndef DUAL_H
+#define DUAL_H
+
+#include <array>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+
+// Forward mode automatic differentiation. A Dual<N> carries a value together with its derivatives in N directions,
+// every arithmetic operation and elementary function applies the chain rule to all of them at once. Evaluating a formula
+// on Duals seeded with variable() therefore gives its value and its gradient by N inputs in one pass,
+// at a cost of roughly N + 1 evaluations but without the truncation error of bumped revaluations.
+// Code written for double picks the overloads up by argument dependent lookup, so call exp, log, ... unqualified
+// after "using std::exp;" etc. in templates which should work for both.
+namespace AD
+{
+	template <std::size_t N>
+	struct Dual
+	{
+		double value{ 0.0 };
+		std::array<double, N> gradient{};
+
+		constexpr Dual() = default;
+		// constants have no derivatives, the conversion is implicit so they mix freely with Duals
+		constexpr Dual(double constant)
+			: value{ constant }
+		{}
+		constexpr Dual(double val, const std::array<double, N>& grad)
+			: value{ val }
+			, gradient{ grad }
+		{}
+
+		// the input number index of a gradient, with derivative one in its own direction
+		static constexpr auto variable(double val, std::size_t index) -> Dual
+		{
+			Dual result{ val };
+			result.gradient[index] = 1.0;
+			return result;
+		}
+
+		// value f(x) and derivative f'(x) of a function applied to this Dual
+		constexpr auto chain(double val, double derivative) const -> Dual
+		{
+			Dual result{ val };
+			for (std::size_t i{ 0 }; i < N; ++i)
+			{
+				result.gradient[i] = derivative * gradient[i];
+			}
+			return result;
+		}
+
+		constexpr auto operator+=(const Dual& other) -> Dual&
+		{
+			value += other.value;
+			for (std::size_t i{ 0 }; i < N; ++i) { gradient[i] += other.gradient[i]; }
+			return *this;
+		}
+		constexpr auto operator-=(const Dual& other) -> Dual&
+		{
+			value -= other.value;
+			for (std::size_t i{ 0 }; i < N; ++i) { gradient[i] -= other.gradient[i]; }
+			return *this;
+		}
+		constexpr auto operator*=(const Dual& other) -> Dual&
+		{
+			for (std::size_t i{ 0 }; i < N; ++i) { gradient[i] = gradient[i] * other.value + value * other.gradient[i]; }
+			value *= other.value;
+			return *this;
+		}
+		constexpr auto operator/=(const Dual& other) -> Dual&
+		{
+			double inverse{ 1.0 / other.value };
+			value *= inverse;
+			for (std::size_t i{ 0 }; i < N; ++i) { gradient[i] = (gradient[i] - value * other.gradient[i]) * inverse; }
+			return *this;
+		}
+
+		friend constexpr auto operator-(const Dual& x) -> Dual { return x.chain(-x.value, -1.0); }
+		friend constexpr auto operator+(Dual x, const Dual& y) -> Dual { return x += y; }
+		friend constexpr auto operator-(Dual x, const Dual& y) -> Dual { return x -= y; }
+		friend constexpr auto operator*(Dual x, const Dual& y) -> Dual { return x *= y; }
+		friend constexpr auto operator/(Dual x, const Dual& y) -> Dual { return x /= y; }
+
+		// comparisons look at the values only, branches select a formula and are not differentiated
+		friend constexpr auto operator==(const Dual& x, const Dual& y) -> bool { return x.value == y.value; }
+		friend constexpr auto operator<(const Dual& x, const Dual& y) -> bool { return x.value < y.value; }
+		friend constexpr auto operator>(const Dual& x, const Dual& y) -> bool { return x.value > y.value; }
+		friend constexpr auto operator<=(const Dual& x, const Dual& y) -> bool { return x.value <= y.value; }
+		friend constexpr auto operator>=(const Dual& x, const Dual& y) -> bool { return x.value >= y.value; }
+	};
+
+	template <std::size_t N>
+	auto exp(const Dual<N>& x) -> Dual<N>
+	{
+		double value{ std::exp(x.value) };
+		return x.chain(value, value);
+	}
+
+	template <std::size_t N>
+	auto log(const Dual<N>& x) -> Dual<N>
+	{
+		return x.chain(std::log(x.value), 1.0 / x.value);
+	}
+
+	template <std::size_t N>
+	auto sqrt(const Dual<N>& x) -> Dual<N>
+	{
+		double value{ std::sqrt(x.value) };
+		return x.chain(value, 0.5 / value);
+	}
+
+	template <std::size_t N>
+	auto pow(const Dual<N>& x, double exponent) -> Dual<N>
+	{
+		double value{ std::pow(x.value, exponent) };
+		return x.chain(value, exponent * std::pow(x.value, exponent - 1.0));
+	}
+
+	template <std::size_t N>
+	auto pow(const Dual<N>& x, const Dual<N>& exponent) -> Dual<N>
+	{
+		return exp(exponent * log(x));
+	}
+
+	template <std::size_t N>
+	auto sin(const Dual<N>& x) -> Dual<N>
+	{
+		return x.chain(std::sin(x.value), std::cos(x.value));
+	}
+
+	template <std::size_t N>
+	auto cos(const Dual<N>& x) -> Dual<N>
+	{
+		return x.chain(std::cos(x.value), -std::sin(x.value));
+	}
+
+	template <std::size_t N>
+	auto atan2(const Dual<N>& y, const Dual<N>& x) -> Dual<N>
+	{
+		// d atan2(y, x) = (x dy - y dx) / (x^2 + y^2)
+		double inverseSquare{ 1.0 / (x.value * x.value + y.value * y.value) };
+		Dual<N> result{ std::atan2(y.value, x.value) };
+		for (std::size_t i{ 0 }; i < N; ++i)
+		{
+			result.gradient[i] = (x.value * y.gradient[i] - y.value * x.gradient[i]) * inverseSquare;
+		}
+		return result;
+	}
+
+	template <std::size_t N>
+	auto abs(const Dual<N>& x) -> Dual<N>
+	{
+		return (x.value < 0.0) ? -x : x;
+	}
+
+	// Complex numbers with Dual real and imaginary parts for characteristic functions (std::complex is only defined
+	// for floating point types). The elementary functions use the principal branches, like std::complex.
+	template <std::size_t N>
+	struct ComplexDual
+	{
+		Dual<N> re{};
+		Dual<N> im{};
+
+		constexpr ComplexDual() = default;
+		constexpr ComplexDual(const Dual<N>& real, const Dual<N>& imag = Dual<N>{})
+			: re{ real }
+			, im{ imag }
+		{}
+		constexpr ComplexDual(double real, double imag = 0.0)
+			: re{ real }
+			, im{ imag }
+		{}
+		constexpr ComplexDual(std::complex<double> z)
+			: re{ z.real() }
+			, im{ z.imag() }
+		{}
+
+		// the value without derivatives
+		constexpr auto value() const -> std::complex<double> { return { re.value, im.value }; }
+		// the derivative in direction index
+		constexpr auto derivative(std::size_t index) const -> std::complex<double> { return { re.gradient[index], im.gradient[index] }; }
+
+		friend constexpr auto operator-(const ComplexDual& z) -> ComplexDual { return { -z.re, -z.im }; }
+		friend constexpr auto operator+(const ComplexDual& z, const ComplexDual& w) -> ComplexDual { return { z.re + w.re, z.im + w.im }; }
+		friend constexpr auto operator-(const ComplexDual& z, const ComplexDual& w) -> ComplexDual { return { z.re - w.re, z.im - w.im }; }
+		friend constexpr auto operator*(const ComplexDual& z, const ComplexDual& w) -> ComplexDual
+		{
+			return { z.re * w.re - z.im * w.im, z.re * w.im + z.im * w.re };
+		}
+		friend constexpr auto operator/(const ComplexDual& z, const ComplexDual& w) -> ComplexDual
+		{
+			Dual<N> inverseNorm{ 1.0 / (w.re * w.re + w.im * w.im) };
+			return { (z.re * w.re + z.im * w.im) * inverseNorm, (z.im * w.re - z.re * w.im) * inverseNorm };
+		}
+	};
+
+	template <std::size_t N>
+	auto exp(const ComplexDual<N>& z) -> ComplexDual<N>
+	{
+		Dual<N> modulus{ exp(z.re) };
+		return { modulus * cos(z.im), modulus * sin(z.im) };
+	}
+
+	template <std::size_t N>
+	auto log(const ComplexDual<N>& z) -> ComplexDual<N>
+	{
+		return { 0.5 * log(z.re * z.re + z.im * z.im), atan2(z.im, z.re) };
+	}
+
+	template <std::size_t N>
+	auto sqrt(const ComplexDual<N>& z) -> ComplexDual<N>
+	{
+		// sqrt(|z|) exp(i arg(z) / 2) with arg in (-pi, pi], the branch of std::sqrt
+		Dual<N> root{ sqrt(sqrt(z.re * z.re + z.im * z.im)) };
+		Dual<N> halfAngle{ 0.5 * atan2(z.im, z.re) };
+		return { root * cos(halfAngle), root * sin(halfAngle) };
+	}
+
+	template <std::size_t N>
+	auto pow(const ComplexDual<N>& z, const Dual<N>& exponent) -> ComplexDual<N>
+	{
+		return exp(ComplexDual<N>{ exponent } * log(z));
+	}
+
+	// the complex numbers over a scalar type, std::complex<double> for double and ComplexDual<N> for Dual<N>,
+	// so that a characteristic function can be written once for both
+	template <typename T>
+	struct ComplexOf
+	{
+		using type = std::complex<T>;
+	};
+
+	template <std::size_t N>
+	struct ComplexOf<Dual<N>>
+	{
+		using type = ComplexDual<N>;
+	};
+
+	template <typename T>
+	using Complex = typename ComplexOf<T>::type;
+}
+
+#endif
@@ -1,9 +1,14 @@
 #include "fft.h"
+#include "cos.h"
 #include <vector>
 #include <string_view>
 #include <cmath>
 #include <complex>
 #include <cassert>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <unordered_map>
 
 
 namespace FFT
@@ -60,41 +65,165 @@ namespace FFT
 		return fourierTrafo;
 	}
 
-	auto fft(const std::vector<std::complex<double>>& vec) -> std::vector<std::complex<double>>
+	FFTPlan::FFTPlan(std::size_t len)
+		: length{ len }
 	{
-		
-		std::size_t length{ std::size(vec) };
-		assert(length % 2 == 0); // fft only works for arrays with length which is a power of 2
+		assert(length > 0 && (length & (length - 1)) == 0); // fft only works for arrays with length which is a power of 2
 
-		// build vector of factors for current length
-		std::vector<std::complex<double>> terms(length);
+		// index pairs which have to be swapped to bring the input into bit-reversed order
+		std::size_t numBits{ 0 };
+		while ((static_cast<std::size_t>(1) << numBits) < length)
+		{
+			++numBits;
+		}
 		for (std::size_t i{ 0 }; i < length; ++i)
 		{
-			terms[i] = std::exp(-2.0 * IMNUM * PI * static_cast<double>(i) / static_cast<double>(length));
+			std::size_t reversed{ 0 };
+			for (std::size_t bit{ 0 }; bit < numBits; ++bit)
+			{
+				reversed |= ((i >> bit) & 1) << (numBits - 1 - bit);
+			}
+			if (i < reversed)
+			{
+				bitReversalSwaps.emplace_back(i, reversed);
+			}
 		}
 
-		if (length <= static_cast<std::size_t>(2))
+		// twiddle factors exp(-2 pi i k / (2 * halfSize)) for every stage, stored contiguously per stage
+		twiddles.reserve(length > 1 ? length - 1 : 0);
+		for (std::size_t halfSize{ 1 }; halfSize < length; halfSize *= 2)
 		{
-			return dft(vec);
+			for (std::size_t k{ 0 }; k < halfSize; ++k)
+			{
+				twiddles.push_back(std::exp(-IMNUM * PI * static_cast<double>(k) / static_cast<double>(halfSize)));
+			}
 		}
-		else
+	}
+
+	auto getPlan(std::size_t length) -> const FFTPlan&
+	{
+		// plans are cached for the lifetime of the program. Calibrations price thousands of
+		// times on the same grid, so the bit reversal and twiddles are only computed once.
+		// References into an unordered_map stay valid when other plans are inserted.
+		static std::mutex cacheMutex{};
+		static std::unordered_map<std::size_t, FFTPlan> cache{};
+
+		std::lock_guard<std::mutex> lock{ cacheMutex };
+		auto found{ cache.find(length) };
+		if (found == std::end(cache))
 		{
-			ModePair modePair{ separateModes(vec) };
-			std::vector<std::complex<double>> evens{ fft(modePair.evens) };
-			std::vector<std::complex<double>> odds{ fft(modePair.odds) };
+			found = cache.emplace(length, FFTPlan{ length }).first;
+		}
+		return found->second;
+	}
 
+	void fftInPlace(std::vector<std::complex<double>>& vec, const FFTPlan& plan)
+	{
+		assert(std::size(vec) == plan.length);
 
-			std::vector<std::complex<double>> firstPart(length / 2);
-			std::vector<std::complex<double>> secondPart(length / 2);
-			for (std::size_t i{ 0 }; i < length / 2; ++i)
+		for (const auto& [i, j] : plan.bitReversalSwaps)
+		{
+			std::swap(vec[i], vec[j]);
+		}
+
+		// butterflies, stage by stage
+		const std::complex<double>* stageTwiddles{ plan.twiddles.data() };
+		for (std::size_t halfSize{ 1 }; halfSize < plan.length; halfSize *= 2)
+		{
+			for (std::size_t start{ 0 }; start < plan.length; start += 2 * halfSize)
 			{
-				firstPart[i] = evens[i] + terms[i] * odds[i];
-				secondPart[i] = evens[i] + terms[i + length / 2] * odds[i];
+				for (std::size_t k{ 0 }; k < halfSize; ++k)
+				{
+					std::complex<double> even{ vec[start + k] };
+					std::complex<double> odd{ stageTwiddles[k] * vec[start + k + halfSize] };
+					vec[start + k] = even + odd;
+					vec[start + k + halfSize] = even - odd;
+				}
 			}
+			stageTwiddles += halfSize;
+		}
+	}
+
+	auto fft(const std::vector<std::complex<double>>& vec) -> std::vector<std::complex<double>>
+	{
+		std::vector<std::complex<double>> fourierTrafo{ vec };
+		fftInPlace(fourierTrafo, getPlan(std::size(vec)));
+		return fourierTrafo;
+	}
 
-			return concatenate(firstPart, secondPart);
+	FRFTPlan::FRFTPlan(std::size_t len, double frac)
+		: length{ len }
+		, fraction{ frac }
+		, chirp(len)
+		, kernelTransform(2 * len)
+	{
+		assert(length > 0 && (length & (length - 1)) == 0); // the convolution uses ffts of length 2 * length
+
+		// with 2 j m = j^2 + m^2 - (m - j)^2 the fractional transform becomes the convolution
+		// of x_j exp(-pi i fraction j^2) with exp(pi i fraction k^2), followed by another chirp.
+		for (std::size_t j{ 0 }; j < length; ++j)
+		{
+			double phase{ PI * fraction * static_cast<double>(j * j) };
+			chirp[j] = std::exp(-IMNUM * phase);
+			kernelTransform[j] = std::conj(chirp[j]);
 		}
+		// negative indices of the convolution wrap around, index length itself is never used
+		for (std::size_t j{ 1 }; j < length; ++j)
+		{
+			kernelTransform[2 * length - j] = kernelTransform[j];
+		}
+		fftInPlace(kernelTransform, getPlan(2 * length));
+	}
+
+	auto getFRFTPlan(std::size_t length, double fraction) -> const FRFTPlan&
+	{
+		// cached like the FFT plans, a calibration prices the same strike window on the same grid over and over
+		static std::mutex cacheMutex{};
+		static std::map<std::pair<std::size_t, double>, FRFTPlan> cache{};
 
+		std::lock_guard<std::mutex> lock{ cacheMutex };
+		auto found{ cache.find({ length, fraction }) };
+		if (found == std::end(cache))
+		{
+			found = cache.emplace(std::pair{ length, fraction }, FRFTPlan{ length, fraction }).first;
+		}
+		return found->second;
+	}
+
+	void frftInPlace(std::vector<std::complex<double>>& vec, const FRFTPlan& plan)
+	{
+		assert(std::size(vec) == plan.length);
+		std::size_t length{ plan.length };
+
+		// the zero padded buffer is kept per thread, so repeated transforms do not allocate
+		thread_local std::vector<std::complex<double>> padded{};
+		padded.assign(2 * length, std::complex<double>{ 0.0 });
+		for (std::size_t j{ 0 }; j < length; ++j)
+		{
+			padded[j] = vec[j] * plan.chirp[j];
+		}
+
+		const FFTPlan& fftPlan{ getPlan(2 * length) };
+		fftInPlace(padded, fftPlan);
+		for (std::size_t j{ 0 }; j < 2 * length; ++j)
+		{
+			// the inverse fft is computed as conj(fft(conj(x))) / n
+			padded[j] = std::conj(padded[j] * plan.kernelTransform[j]);
+		}
+		fftInPlace(padded, fftPlan);
+
+		double normalization{ 1.0 / static_cast<double>(2 * length) };
+		for (std::size_t j{ 0 }; j < length; ++j)
+		{
+			vec[j] = plan.chirp[j] * std::conj(padded[j]) * normalization;
+		}
+	}
+
+	auto frft(const std::vector<std::complex<double>>& vec, double fraction) -> std::vector<std::complex<double>>
+	{
+		std::vector<std::complex<double>> fourierTrafo{ vec };
+		frftInPlace(fourierTrafo, getFRFTPlan(std::size(vec), fraction));
+		return fourierTrafo;
 	}
 
 	auto pricingfft(const auto& modelParams, const MarketParams& marketParams, const FFTParams& params, std::string_view type) -> LogStrikePricePair
@@ -111,28 +240,36 @@ namespace FFT
 		double spot{ marketParams.spot };
 		double riskFreeReturn{ marketParams.riskFreeReturn };
 
-		int gridNum{ intPow(2,gridExponent) };
+		std::size_t gridNum{ static_cast<std::size_t>(intPow(2,gridExponent)) };
 		// step - size in log strike space
-		double gridWidthLogStrikeSpace{ (2. * PI / gridNum) / gridWidth };
+		double gridWidthLogStrikeSpace{ (2. * PI / static_cast<double>(gridNum)) / gridWidth };
 		// smallest value in log strike space
-		double lowestLogStrike{ std::log(spot) - gridNum * gridWidthLogStrikeSpace / 2. };
+		double lowestLogStrike{ std::log(spot) - static_cast<double>(gridNum) * gridWidthLogStrikeSpace / 2. };
 
 
 		// forming vector x and strikes km for m = 1, ..., N
-		std::vector<double> logStrikes{};
-		std::vector<std::complex<double>> xX{};
+		std::vector<double> logStrikes(gridNum);
+		std::vector<std::complex<double>> xX(gridNum);
 
 		// discount factor
 		double discount{ std::exp(-riskFreeReturn * maturity) };
 
 
+		// evaluate the characteristic function on the whole frequency grid at once
+		ComplexArray cfArguments(gridNum);
+		for (std::size_t j{ 0 }; j < gridNum; ++j)
+		{
+			cfArguments.real[j] = static_cast<double>(j) * gridWidth;
+			cfArguments.imag[j] = -(decayParam + 1);
+		}
+		ComplexArray cfValues{ SDE::CharacteristicFunctions::generalCF(cfArguments, modelParams, marketParams) };
+
 		for (std::size_t j{ 0 }; j < gridNum; ++j)
 		{
-			double nuJ{ j * gridWidth };
-			logStrikes.push_back(lowestLogStrike + j * gridWidthLogStrikeSpace);
+			double nuJ{ static_cast<double>(j) * gridWidth };
+			logStrikes[j] = lowestLogStrike + static_cast<double>(j) * gridWidthLogStrikeSpace;
 
-			// generalCF(double argument, std::string_view model, const auto & modelParams, const MarketParams & marketParams)
-			std::complex<double> psi_nuJ{ discount * SDE::CharacteristicFunctions::generalCF(nuJ - (decayParam + 1) * IMNUM, modelParams, marketParams) / ((decayParam + IMNUM * nuJ) * (decayParam + 1. + IMNUM * nuJ)) };
+			std::complex<double> psi_nuJ{ discount * std::complex<double>(cfValues.real[j], cfValues.imag[j]) / ((decayParam + IMNUM * nuJ) * (decayParam + 1. + IMNUM * nuJ)) };
 			double weight{};
 			if (j == 0)
 			{
@@ -143,18 +280,18 @@ namespace FFT
 				weight = gridWidth;
 			}
 
-			xX.push_back(std::exp(-IMNUM * lowestLogStrike * nuJ) * psi_nuJ * weight);
+			xX[j] = std::exp(-IMNUM * lowestLogStrike * nuJ) * psi_nuJ * weight;
 		}
 
-		// compute fft 
-		std::vector<std::complex<double>> yY{ fft(xX) };
+		// compute fft in place on the cached plan for this grid size
+		fftInPlace(xX, getPlan(gridNum));
 		// ----------------
 
-		std::vector<double> prices{};
+		std::vector<double> prices(gridNum);
 		for (std::size_t j{ 0 }; j < gridNum; ++j)
 		{
 			double multiplier{ std::exp(-decayParam * logStrikes[j]) / PI };
-			prices.push_back(multiplier * std::real(yY[j]));
+			prices[j] = multiplier * std::real(xX[j]);
 		}
 
 		LogStrikePricePair result{ logStrikes,prices };
@@ -162,6 +299,211 @@ namespace FFT
 		return result;
 	}
 
+	auto pricingfftDual(const auto& modelParams, const MarketParams& marketParams, const FFTParams& params, std::string_view type)
+	{
+		// Same scheme as pricingfft on the characteristic function with its parameter derivatives. The prices are linear
+		// in the characteristic function, so the value and every derivative direction go through the same FFT.
+		using CFDual = decltype(SDE::CharacteristicFunctions::generalCFDual(std::complex<double>{}, modelParams, marketParams));
+		constexpr std::size_t dimension{ std::tuple_size_v<decltype(CFDual{}.re.gradient)> };
+
+		double decayParam{ params.decayParam };
+		if (type == "put") { decayParam = -params.decayParam; }
+		double gridWidth{ params.gridWidth };
+		std::size_t gridNum{ static_cast<std::size_t>(intPow(2,params.gridExponent)) };
+		double gridWidthLogStrikeSpace{ (2. * PI / static_cast<double>(gridNum)) / gridWidth };
+		double lowestLogStrike{ std::log(marketParams.spot) - static_cast<double>(gridNum) * gridWidthLogStrikeSpace / 2. };
+		double discount{ std::exp(-marketParams.riskFreeReturn * marketParams.maturity) };
+
+		// row 0 holds the integrand of the prices, row 1 + i the one of their derivatives in direction i
+		std::vector<std::vector<std::complex<double>>> xX(dimension + 1, std::vector<std::complex<double>>(gridNum));
+		LogStrikeDualPrices<dimension> result{ std::vector<double>(gridNum), std::vector<AD::Dual<dimension>>(gridNum) };
+		for (std::size_t j{ 0 }; j < gridNum; ++j)
+		{
+			double nuJ{ static_cast<double>(j) * gridWidth };
+			double weight{ (j == 0) ? gridWidth / 2.0 : gridWidth };
+			result.logStrikes[j] = lowestLogStrike + static_cast<double>(j) * gridWidthLogStrikeSpace;
+
+			CFDual cfValue{ SDE::CharacteristicFunctions::generalCFDual(std::complex<double>(nuJ, -(decayParam + 1)), modelParams, marketParams) };
+			std::complex<double> factor{ discount * std::exp(-IMNUM * lowestLogStrike * nuJ) * weight / ((decayParam + IMNUM * nuJ) * (decayParam + 1. + IMNUM * nuJ)) };
+			xX[0][j] = factor * cfValue.value();
+			for (std::size_t i{ 0 }; i < dimension; ++i)
+			{
+				xX[i + 1][j] = factor * cfValue.derivative(i);
+			}
+		}
+
+		const FFTPlan& plan{ getPlan(gridNum) };
+		for (auto& row : xX)
+		{
+			fftInPlace(row, plan);
+		}
+
+		for (std::size_t j{ 0 }; j < gridNum; ++j)
+		{
+			double multiplier{ std::exp(-decayParam * result.logStrikes[j]) / PI };
+			result.prices[j].value = multiplier * std::real(xX[0][j]);
+			for (std::size_t i{ 0 }; i < dimension; ++i)
+			{
+				result.prices[j].gradient[i] = multiplier * std::real(xX[i + 1][j]);
+			}
+		}
+		return result;
+	}
+
+	auto pricingfftSurface(const auto& modelParams, const MarketParams& marketParams, const std::vector<double>& maturities, const FFTParams& params, std::string_view type) -> LogStrikePriceSurface
+	{
+		// Same Carr-Madan scheme as pricingfft, but all maturities share the log strike grid,
+		// the frequency grid, the integration weights and the FFT plan. Only the characteristic
+		// function and the discount factor depend on the maturity.
+		double decayParam{ params.decayParam };
+		if (type == "put") { decayParam = -params.decayParam; }
+		double gridWidth{ params.gridWidth };
+		std::size_t gridNum{ static_cast<std::size_t>(intPow(2,params.gridExponent)) };
+
+		double spot{ marketParams.spot };
+		double riskFreeReturn{ marketParams.riskFreeReturn };
+
+		double gridWidthLogStrikeSpace{ (2. * PI / static_cast<double>(gridNum)) / gridWidth };
+		double lowestLogStrike{ std::log(spot) - static_cast<double>(gridNum) * gridWidthLogStrikeSpace / 2. };
+
+		LogStrikePriceSurface surface{};
+		surface.maturities = maturities;
+		surface.logStrikes.resize(gridNum);
+		surface.prices.resize(gridNum * std::size(maturities));
+
+		// maturity independent parts of the integrand and of the inverse transform
+		ComplexArray cfArguments(gridNum);
+		std::vector<std::complex<double>> integrandFactors(gridNum);
+		std::vector<double> multipliers(gridNum);
+		for (std::size_t j{ 0 }; j < gridNum; ++j)
+		{
+			double nuJ{ static_cast<double>(j) * gridWidth };
+			double weight{ (j == 0) ? gridWidth / 2.0 : gridWidth };
+			surface.logStrikes[j] = lowestLogStrike + static_cast<double>(j) * gridWidthLogStrikeSpace;
+			cfArguments.real[j] = nuJ;
+			cfArguments.imag[j] = -(decayParam + 1);
+			integrandFactors[j] = std::exp(-IMNUM * lowestLogStrike * nuJ) * weight / ((decayParam + IMNUM * nuJ) * (decayParam + 1. + IMNUM * nuJ));
+			multipliers[j] = std::exp(-decayParam * surface.logStrikes[j]) / PI;
+		}
+
+		const FFTPlan& plan{ getPlan(gridNum) };
+		std::vector<std::complex<double>> xX(gridNum);
+		MarketParams currentMarketParams{ marketParams };
+		for (std::size_t row{ 0 }; row < std::size(maturities); ++row)
+		{
+			currentMarketParams.maturity = maturities[row];
+			double discount{ std::exp(-riskFreeReturn * maturities[row]) };
+			ComplexArray cfValues{ SDE::CharacteristicFunctions::generalCF(cfArguments, modelParams, currentMarketParams) };
+			for (std::size_t j{ 0 }; j < gridNum; ++j)
+			{
+				xX[j] = discount * std::complex<double>(cfValues.real[j], cfValues.imag[j]) * integrandFactors[j];
+			}
+
+			fftInPlace(xX, plan);
+
+			double* rowPrices{ surface.prices.data() + row * gridNum };
+			for (std::size_t j{ 0 }; j < gridNum; ++j)
+			{
+				rowPrices[j] = multipliers[j] * std::real(xX[j]);
+			}
+		}
+
+		return surface;
+	}
+
+	auto pricingfrftSurface(const auto& modelParams, const MarketParams& marketParams, const std::vector<double>& maturities, double lowestStrike, double highestStrike, const FRFTParams& params, std::string_view type) -> LogStrikePriceSurface
+	{
+		// Carr-Madan pricing like pricingfft, but the log strike grid only spans [lowestStrike, highestStrike].
+		// Since the log strike spacing no longer has to be 2 pi / (gridNum * gridWidth),
+		// the sum over frequencies is a fractional FFT instead of an ordinary one.
+		assert(0.0 < lowestStrike && lowestStrike <= highestStrike);
+		double decayParam{ params.decayParam };
+		if (type == "put") { decayParam = -params.decayParam; }
+		double gridWidth{ params.gridWidth };
+		assert(params.gridExponent <= params.maxGridExponent);
+
+		// The frequency spacing is kept and the grid doubled until the integrand has decayed at its end. The modulus of
+		// the integrand relative to its value at zero does not depend on the discount factor.
+		auto integrandModulus
+		{
+			[&](double frequency, const MarketParams& currentMarketParams)
+			{
+				std::complex<double> cf{ SDE::CharacteristicFunctions::generalCF(std::complex<double>(frequency, -(decayParam + 1)), modelParams, currentMarketParams) };
+				return std::abs(cf / ((decayParam + IMNUM * frequency) * (decayParam + 1. + IMNUM * frequency)));
+			}
+		};
+		int gridExponent{ params.gridExponent };
+		MarketParams currentMarketParams{ marketParams };
+		for (double maturity : maturities)
+		{
+			currentMarketParams.maturity = maturity;
+			double threshold{ params.truncationTolerance * integrandModulus(0.0, currentMarketParams) };
+			while (gridExponent < params.maxGridExponent && integrandModulus(gridWidth * intPow(2, gridExponent), currentMarketParams) > threshold)
+			{
+				++gridExponent;
+			}
+		}
+		std::size_t gridNum{ static_cast<std::size_t>(intPow(2, gridExponent)) };
+		assert(gridNum > 4);
+
+		double riskFreeReturn{ marketParams.riskFreeReturn };
+
+		// the window is padded by two grid points on either side, so that all strikes in it
+		// can be interpolated. A single strike gets a window of one percent around it.
+		double logStrikeRange{ std::max(std::log(highestStrike / lowestStrike), 0.02) };
+		double gridWidthLogStrikeSpace{ logStrikeRange / static_cast<double>(gridNum - 5) };
+		double lowestLogStrike{ 0.5 * (std::log(lowestStrike) + std::log(highestStrike)) - 0.5 * logStrikeRange - 2. * gridWidthLogStrikeSpace };
+
+		LogStrikePriceSurface surface{};
+		surface.maturities = maturities;
+		surface.logStrikes.resize(gridNum);
+		surface.prices.resize(gridNum * std::size(maturities));
+
+		// maturity independent parts of the integrand and of the inverse transform
+		ComplexArray cfArguments(gridNum);
+		std::vector<std::complex<double>> integrandFactors(gridNum);
+		std::vector<double> multipliers(gridNum);
+		for (std::size_t j{ 0 }; j < gridNum; ++j)
+		{
+			double nuJ{ static_cast<double>(j) * gridWidth };
+			double weight{ (j == 0) ? gridWidth / 2.0 : gridWidth };
+			surface.logStrikes[j] = lowestLogStrike + static_cast<double>(j) * gridWidthLogStrikeSpace;
+			cfArguments.real[j] = nuJ;
+			cfArguments.imag[j] = -(decayParam + 1);
+			integrandFactors[j] = std::exp(-IMNUM * lowestLogStrike * nuJ) * weight / ((decayParam + IMNUM * nuJ) * (decayParam + 1. + IMNUM * nuJ));
+			multipliers[j] = std::exp(-decayParam * surface.logStrikes[j]) / PI;
+		}
+
+		const FRFTPlan& plan{ getFRFTPlan(gridNum, gridWidth * gridWidthLogStrikeSpace / (2. * PI)) };
+		std::vector<std::complex<double>> xX(gridNum);
+		for (std::size_t row{ 0 }; row < std::size(maturities); ++row)
+		{
+			currentMarketParams.maturity = maturities[row];
+			double discount{ std::exp(-riskFreeReturn * maturities[row]) };
+			ComplexArray cfValues{ SDE::CharacteristicFunctions::generalCF(cfArguments, modelParams, currentMarketParams) };
+			for (std::size_t j{ 0 }; j < gridNum; ++j)
+			{
+				xX[j] = discount * std::complex<double>(cfValues.real[j], cfValues.imag[j]) * integrandFactors[j];
+			}
+
+			frftInPlace(xX, plan);
+
+			double* rowPrices{ surface.prices.data() + row * gridNum };
+			for (std::size_t j{ 0 }; j < gridNum; ++j)
+			{
+				rowPrices[j] = multipliers[j] * std::real(xX[j]);
+			}
+		}
+
+		return surface;
+	}
+
+	auto pricingfrft(const auto& modelParams, const MarketParams& marketParams, double lowestStrike, double highestStrike, const FRFTParams& params, std::string_view type) -> LogStrikePricePair
+	{
+		LogStrikePriceSurface surface{ pricingfrftSurface(modelParams, marketParams, std::vector<double>{ marketParams.maturity }, lowestStrike, highestStrike, params, type) };
+		return LogStrikePricePair{ std::move(surface.logStrikes), std::move(surface.prices) };
+	}
+
 	auto pricingfftHeston(const HestonParams& modelParams, const MarketParams& marketParams, const FFTParams& params, std::string_view type) -> LogStrikePricePair
 	{
 		return pricingfft(modelParams, marketParams, params, type);
@@ -184,6 +526,66 @@ namespace FFT
 
 
 
+	auto pricingfftSurfaceHeston(const HestonParams& modelParams, const MarketParams& marketParams, const std::vector<double>& maturities, const FFTParams& params, std::string_view type) -> LogStrikePriceSurface
+	{
+		return pricingfftSurface(modelParams, marketParams, maturities, params, type);
+	}
+
+	auto pricingfftSurfaceBSM(const BSMParams& modelParams, const MarketParams& marketParams, const std::vector<double>& maturities, const FFTParams& params, std::string_view type) -> LogStrikePriceSurface
+	{
+		return pricingfftSurface(modelParams, marketParams, maturities, params, type);
+	}
+
+	auto pricingfftSurfaceMertonJump(const MertonJumpParams& modelParams, const MarketParams& marketParams, const std::vector<double>& maturities, const FFTParams& params, std::string_view type) -> LogStrikePriceSurface
+	{
+		return pricingfftSurface(modelParams, marketParams, maturities, params, type);
+	}
+
+	auto pricingfftSurfaceVarianceGamma(const VarianceGammaParams& modelParams, const MarketParams& marketParams, const std::vector<double>& maturities, const FFTParams& params, std::string_view type) -> LogStrikePriceSurface
+	{
+		return pricingfftSurface(modelParams, marketParams, maturities, params, type);
+	}
+
+	auto pricingfftDual(const HestonParams& modelParams, const MarketParams& marketParams, const FFTParams& params, std::string_view type) -> LogStrikeDualPrices<5>
+	{
+		return pricingfftDual<>(modelParams, marketParams, params, type);
+	}
+
+	auto pricingfftDual(const BSMParams& modelParams, const MarketParams& marketParams, const FFTParams& params, std::string_view type) -> LogStrikeDualPrices<1>
+	{
+		return pricingfftDual<>(modelParams, marketParams, params, type);
+	}
+
+	auto pricingfftDual(const MertonJumpParams& modelParams, const MarketParams& marketParams, const FFTParams& params, std::string_view type) -> LogStrikeDualPrices<4>
+	{
+		return pricingfftDual<>(modelParams, marketParams, params, type);
+	}
+
+	auto pricingfftDual(const VarianceGammaParams& modelParams, const MarketParams& marketParams, const FFTParams& params, std::string_view type) -> LogStrikeDualPrices<3>
+	{
+		return pricingfftDual<>(modelParams, marketParams, params, type);
+	}
+
+	auto pricingfrftHeston(const HestonParams& modelParams, const MarketParams& marketParams, double lowestStrike, double highestStrike, const FRFTParams& params, std::string_view type) -> LogStrikePricePair
+	{
+		return pricingfrft(modelParams, marketParams, lowestStrike, highestStrike, params, type);
+	}
+
+	auto pricingfrftBSM(const BSMParams& modelParams, const MarketParams& marketParams, double lowestStrike, double highestStrike, const FRFTParams& params, std::string_view type) -> LogStrikePricePair
+	{
+		return pricingfrft(modelParams, marketParams, lowestStrike, highestStrike, params, type);
+	}
+
+	auto pricingfrftMertonJump(const MertonJumpParams& modelParams, const MarketParams& marketParams, double lowestStrike, double highestStrike, const FRFTParams& params, std::string_view type) -> LogStrikePricePair
+	{
+		return pricingfrft(modelParams, marketParams, lowestStrike, highestStrike, params, type);
+	}
+
+	auto pricingfrftVarianceGamma(const VarianceGammaParams& modelParams, const MarketParams& marketParams, double lowestStrike, double highestStrike, const FRFTParams& params, std::string_view type) -> LogStrikePricePair
+	{
+		return pricingfrft(modelParams, marketParams, lowestStrike, highestStrike, params, type);
+	}
+
 	namespace UnitTests
 	{
 		void separateModes()
@@ -251,6 +653,28 @@ namespace FFT
 			std::cout << "\n";
 		}
 
+		void fft()
+		{
+			// compare the iterative fft against the naive dft on a small grid
+			std::size_t length{ static_cast<std::size_t>(intPow(2,8)) };
+
+			std::vector<std::complex<double>> terms(length);
+			for (std::size_t i{ 0 }; i < length; ++i)
+			{
+				terms[i] = std::complex<double>(std::cos(0.3 * static_cast<double>(i)), std::sin(0.7 * static_cast<double>(i * i)));
+			}
+
+			std::vector<std::complex<double>> slow{ FFT::dft(terms) };
+			std::vector<std::complex<double>> fast{ FFT::fft(terms) };
+
+			double maxError{ 0.0 };
+			for (std::size_t i{ 0 }; i < length; ++i)
+			{
+				maxError = std::max(maxError, std::abs(slow[i] - fast[i]));
+			}
+			std::cout << "Maximal deviation between FFT and DFT is " << maxError << "\n";
+		}
+
 		void pricingfft()
 		{
 			HestonParams hestonParams{};
@@ -274,7 +698,150 @@ namespace FFT
 			std::cout << "\n";
 		}
 
+		void pricingfftSurface()
+		{
+			// the batched surface pricing has to agree with pricing every maturity on its own
+			HestonParams hestonParams{ 0.1, 0.04, 0.2, -0.5, 0.04 };
+			FFTParams params{};
+			MarketParams marketParams{ 1.0, 100.0, 0.03, 0.0 };
+			std::vector<double> maturities{ 0.1, 0.25, 0.5, 1.0 };
+
+			LogStrikePriceSurface surface{ FFT::pricingfftSurface(hestonParams, marketParams, maturities, params) };
+
+			double maxError{ 0.0 };
+			for (std::size_t row{ 0 }; row < std::size(maturities); ++row)
+			{
+				marketParams.maturity = maturities[row];
+				LogStrikePricePair pricePairs{ FFT::pricingfft(hestonParams, marketParams, params) };
+				std::span<const double> surfaceRow{ surface.row(row) };
+				for (std::size_t j{ 0 }; j < std::size(pricePairs.prices); ++j)
+				{
+					// far out in the wings both are dominated by rounding noise, so only compare the relevant strikes
+					double strike{ std::exp(pricePairs.logStrikes[j]) };
+					if (strike < 0.5 * marketParams.spot || strike > 2.0 * marketParams.spot) { continue; }
+					maxError = std::max(maxError, std::abs(surfaceRow[j] - pricePairs.prices[j]));
+				}
+			}
+			std::cout << "Maximal deviation between surface and single maturity pricing is " << maxError << "\n";
+		}
+
+		void pricingfftDual()
+		{
+			// the dual number characteristic function has to agree with the analytic gradient,
+			// the dual number prices with central differences of the FFT prices
+			HestonParams hestonParams{ 1.5, 0.04, 0.5, -0.6, 0.05 };
+			MarketParams marketParams{ 0.5, 100.0, 0.03, 0.01 };
+			FFTParams params{};
+
+			double cfError{ 0.0 };
+			for (double u : { 0.5, 2.0, 10.0, 40.0 })
+			{
+				std::complex<double> argument{ u, -(params.decayParam + 1) };
+				AD::ComplexDual<5> dual{ SDE::CharacteristicFunctions::generalCFDual(argument, hestonParams, marketParams) };
+				std::vector<std::complex<double>> gradient{ SDE::CharacteristicFunctions::generalCFGradient(argument, hestonParams, marketParams) };
+				cfError = std::max(cfError, std::abs(dual.value() - SDE::CharacteristicFunctions::generalCF(argument, hestonParams, marketParams)));
+				for (std::size_t i{ 0 }; i < std::size(gradient); ++i)
+				{
+					cfError = std::max(cfError, std::abs(dual.derivative(i) - gradient[i]));
+				}
+			}
+			std::cout << "Maximal deviation between dual number and analytic Heston characteristic function gradients is " << cfError << "\n";
+
+			LogStrikeDualPrices<5> dualPrices{ FFT::pricingfftDual(hestonParams, marketParams, params) };
+			LogStrikePricePair pricePairs{ FFT::pricingfft(hestonParams, marketParams, params) };
+			double priceError{ 0.0 };
+			double gradientError{ 0.0 };
+			double stepSize{ 1e-5 };
+			for (std::size_t i{ 0 }; i < 5; ++i)
+			{
+				std::vector<double> values{ hestonParams.reversionRate, hestonParams.longVariance, hestonParams.volVol, hestonParams.correlation, hestonParams.initialVariance };
+				values[i] += stepSize;
+				LogStrikePricePair pricesUp{ FFT::pricingfft(HestonParams{ values[0], values[1], values[2], values[3], values[4] }, marketParams, params) };
+				values[i] -= 2. * stepSize;
+				LogStrikePricePair pricesDown{ FFT::pricingfft(HestonParams{ values[0], values[1], values[2], values[3], values[4] }, marketParams, params) };
+				for (std::size_t j{ 0 }; j < std::size(pricePairs.prices); ++j)
+				{
+					double strike{ std::exp(pricePairs.logStrikes[j]) };
+					if (strike < 0.5 * marketParams.spot || strike > 2.0 * marketParams.spot) { continue; }
+					priceError = std::max(priceError, std::abs(dualPrices.prices[j].value - pricePairs.prices[j]));
+					gradientError = std::max(gradientError, std::abs(dualPrices.prices[j].gradient[i] - (pricesUp.prices[j] - pricesDown.prices[j]) / (2. * stepSize)));
+				}
+			}
+			std::cout << "Maximal deviation between dual number and plain FFT prices is " << priceError << "\n";
+			std::cout << "Maximal deviation between dual number and finite difference price gradients is " << gradientError << "\n";
+		}
+
+		void frft()
+		{
+			// the fractional transform has to agree with the direct sum for an arbitrary fraction
+			std::vector<std::complex<double>> vec(64);
+			for (std::size_t j{ 0 }; j < std::size(vec); ++j)
+			{
+				vec[j] = std::complex<double>(std::cos(0.3 * static_cast<double>(j)), std::sin(0.1 * static_cast<double>(j * j)));
+			}
+			double fraction{ 0.0123 };
+			std::vector<std::complex<double>> fractionalTrafo{ FFT::frft(vec, fraction) };
+
+			double maxError{ 0.0 };
+			for (std::size_t m{ 0 }; m < std::size(vec); ++m)
+			{
+				std::complex<double> directSum{ 0.0 };
+				for (std::size_t j{ 0 }; j < std::size(vec); ++j)
+				{
+					directSum += vec[j] * std::exp(-2. * PI * IMNUM * fraction * static_cast<double>(j * m));
+				}
+				maxError = std::max(maxError, std::abs(directSum - fractionalTrafo[m]));
+			}
+			std::cout << "Maximal deviation between fractional FFT and direct sum is " << maxError << "\n";
+		}
+
+		void pricingfrft()
+		{
+			// prices on a small strike window have to agree with the COS method, which needs no strike grid.
+			// The short Variance Gamma maturities have a characteristic function with slow power law decay.
+			MarketParams marketParams{ 0.5, 100.0, 0.03, 0.0 };
+			double lowestStrike{ 80.0 };
+			double highestStrike{ 120.0 };
+			COS::COSParams cosParams{};
+			cosParams.numTerms = 4096;
+
+			auto compare
+			{
+				[&](std::string_view name, const auto& modelParams, double maturity)
+				{
+					marketParams.maturity = maturity;
+					LogStrikePricePair frftPairs{ FFT::pricingfrft(modelParams, marketParams, lowestStrike, highestStrike, FRFTParams{}) };
+					std::vector<double> strikes{};
+					std::vector<double> frftPrices{};
+					for (std::size_t j{ 0 }; j < std::size(frftPairs.logStrikes); ++j)
+					{
+						double strike{ std::exp(frftPairs.logStrikes[j]) };
+						if (strike < lowestStrike || strike > highestStrike) { continue; }
+						strikes.push_back(strike);
+						frftPrices.push_back(frftPairs.prices[j]);
+					}
+					std::vector<double> cosPrices{ COS::pricingcos(modelParams, marketParams, strikes, cosParams) };
+					double maxError{ 0.0 };
+					for (std::size_t i{ 0 }; i < std::size(strikes); ++i)
+					{
+						maxError = std::max(maxError, std::abs(cosPrices[i] - frftPrices[i]));
+					}
+					std::cout << "Maximal deviation between fractional FFT and COS prices for " << name << " at maturity " << maturity
+						<< " is " << maxError << " (" << std::size(frftPairs.logStrikes) << " frequencies)\n";
+					return maxError;
+				}
+			};
+
+			HestonParams hestonParams{ 0.1, 0.04, 0.2, -0.5, 0.04 };
+			VarianceGammaParams varianceGammaParams{ 0.2, -0.1, 0.2 };
+			double hestonError{ compare("Heston", hestonParams, 0.5) };
+			double longError{ compare("Variance Gamma", varianceGammaParams, 0.5) };
+			double mediumError{ compare("Variance Gamma", varianceGammaParams, 0.1) };
+			double shortError{ compare("Variance Gamma", varianceGammaParams, 0.02) };
+			assert(hestonError < 1e-10 && longError < 1e-5 && mediumError < 1e-4 && shortError < 1e-3);
+		}
+
 	}
 	
 
-}
\ No newline at end of file
+}
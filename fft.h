@@ -3,6 +3,9 @@
 #include "sdes.h"
 #include <vector>
 #include <complex>
+#include <span>
+#include <string_view>
+#include <utility>
 
 constexpr std::complex<double> IMNUM(0.0, 1.0);
 constexpr double PI = 3.14159265358979323846;
@@ -21,6 +24,18 @@ namespace FFT
 
 	};
 
+	// Precomputed data of the iterative radix-2 FFT for one grid length.
+	// Twiddle factors are stored stage by stage (1, 2, 4, ..., length/2 factors per stage),
+	// so that every butterfly stage reads them contiguously.
+	struct FFTPlan
+	{
+		std::size_t length{ 0 };
+		std::vector<std::pair<std::size_t, std::size_t>> bitReversalSwaps{};
+		std::vector<std::complex<double>> twiddles{};
+
+		explicit FFTPlan(std::size_t len);
+	};
+
 	struct FFTParams
 	{
 		double decayParam{ 1.5 };
@@ -28,30 +43,103 @@ namespace FFT
 		int gridExponent{ 14 };
 	};
 
+	// Precomputed chirps of the fractional FFT sum_j x_j exp(-2 pi i fraction j m), which is evaluated
+	// as a convolution with two FFTs of twice the length (Bluestein's algorithm).
+	struct FRFTPlan
+	{
+		std::size_t length{ 0 };
+		double fraction{ 0.0 };
+		std::vector<std::complex<double>> chirp{};
+		std::vector<std::complex<double>> kernelTransform{};
+
+		FRFTPlan(std::size_t len, double frac);
+	};
+
+	// The fractional FFT decouples the log strike spacing from the frequency spacing,
+	// so a small grid can be concentrated on the strike window we actually quote.
+	// The grid starts with 2^gridExponent frequencies and is doubled until the integrand at the highest frequency has
+	// decayed below truncationTolerance times its value at zero for every maturity, up to 2^maxGridExponent frequencies.
+	// Short maturities and characteristic functions with power law decay (Variance Gamma) need the larger grids.
+	struct FRFTParams
+	{
+		double decayParam{ 1.5 };
+		double gridWidth{ 0.25 };
+		int gridExponent{ 9 };
+		int maxGridExponent{ 16 };
+		double truncationTolerance{ 1e-8 };
+	};
+
 	struct LogStrikePricePair
 	{
 		std::vector<double> logStrikes{};
 		std::vector<double> prices{};
 	};
 
+	// prices of several maturities on one common log strike grid.
+	// The prices are stored contiguously maturity by maturity, i.e. row i holds the prices for maturities[i].
+	struct LogStrikePriceSurface
+	{
+		std::vector<double> logStrikes{};
+		std::vector<double> maturities{};
+		std::vector<double> prices{};
+
+		auto row(std::size_t index) const -> std::span<const double>
+		{
+			return std::span<const double>(prices).subspan(index * std::size(logStrikes), std::size(logStrikes));
+		}
+	};
+
+	// prices with their derivatives by the model parameters, in the order of the parameters' constructor arguments
+	template <std::size_t N>
+	struct LogStrikeDualPrices
+	{
+		std::vector<double> logStrikes{};
+		std::vector<AD::Dual<N>> prices{};
+	};
+
 	auto separateModes(const std::vector<std::complex<double>>& vec) -> ModePair;
 	auto intPow(int base, int exponent) -> int;
 	template <typename T>
 	auto concatenate(std::vector<T>& vec1, const std::vector<T>& vec2) -> std::vector<T>;
 	auto dft(const std::vector<std::complex<double>>& vec) -> std::vector<std::complex<double>>;
+	auto getPlan(std::size_t length) -> const FFTPlan&;
+	void fftInPlace(std::vector<std::complex<double>>& vec, const FFTPlan& plan);
 	auto fft(const std::vector<std::complex<double>>& vec) -> std::vector<std::complex<double>>;
+	auto getFRFTPlan(std::size_t length, double fraction) -> const FRFTPlan&;
+	void frftInPlace(std::vector<std::complex<double>>& vec, const FRFTPlan& plan);
+	auto frft(const std::vector<std::complex<double>>& vec, double fraction) -> std::vector<std::complex<double>>;
 	auto pricingfft(const auto& modelParams, const MarketParams& marketParams, const FFTParams& params, std::string_view type = "call") -> LogStrikePricePair;
+	auto pricingfftSurface(const auto& modelParams, const MarketParams& marketParams, const std::vector<double>& maturities, const FFTParams& params, std::string_view type = "call") -> LogStrikePriceSurface;
+	auto pricingfrft(const auto& modelParams, const MarketParams& marketParams, double lowestStrike, double highestStrike, const FRFTParams& params, std::string_view type = "call") -> LogStrikePricePair;
+	auto pricingfrftSurface(const auto& modelParams, const MarketParams& marketParams, const std::vector<double>& maturities, double lowestStrike, double highestStrike, const FRFTParams& params, std::string_view type = "call") -> LogStrikePriceSurface;
 	auto pricingfftHeston(const HestonParams& modelParams, const MarketParams& marketParams, const FFTParams& params, std::string_view type = "call") -> LogStrikePricePair;
 	auto pricingfftBSM(const BSMParams& modelParams, const MarketParams& marketParams, const FFTParams& params, std::string_view type = "call") -> LogStrikePricePair;
 	auto pricingfftMertonJump(const MertonJumpParams& modelParams, const MarketParams& marketParams, const FFTParams& params, std::string_view type = "call") -> LogStrikePricePair;
 	auto pricingfftVarianceGamma(const VarianceGammaParams& modelParams, const MarketParams& marketParams, const FFTParams& params, std::string_view type = "call") -> LogStrikePricePair;
+	auto pricingfftSurfaceHeston(const HestonParams& modelParams, const MarketParams& marketParams, const std::vector<double>& maturities, const FFTParams& params, std::string_view type = "call") -> LogStrikePriceSurface;
+	auto pricingfftSurfaceBSM(const BSMParams& modelParams, const MarketParams& marketParams, const std::vector<double>& maturities, const FFTParams& params, std::string_view type = "call") -> LogStrikePriceSurface;
+	auto pricingfftSurfaceMertonJump(const MertonJumpParams& modelParams, const MarketParams& marketParams, const std::vector<double>& maturities, const FFTParams& params, std::string_view type = "call") -> LogStrikePriceSurface;
+	auto pricingfftSurfaceVarianceGamma(const VarianceGammaParams& modelParams, const MarketParams& marketParams, const std::vector<double>& maturities, const FFTParams& params, std::string_view type = "call") -> LogStrikePriceSurface;
+	auto pricingfftDual(const HestonParams& modelParams, const MarketParams& marketParams, const FFTParams& params, std::string_view type = "call") -> LogStrikeDualPrices<5>;
+	auto pricingfftDual(const BSMParams& modelParams, const MarketParams& marketParams, const FFTParams& params, std::string_view type = "call") -> LogStrikeDualPrices<1>;
+	auto pricingfftDual(const MertonJumpParams& modelParams, const MarketParams& marketParams, const FFTParams& params, std::string_view type = "call") -> LogStrikeDualPrices<4>;
+	auto pricingfftDual(const VarianceGammaParams& modelParams, const MarketParams& marketParams, const FFTParams& params, std::string_view type = "call") -> LogStrikeDualPrices<3>;
+	auto pricingfrftHeston(const HestonParams& modelParams, const MarketParams& marketParams, double lowestStrike, double highestStrike, const FRFTParams& params, std::string_view type = "call") -> LogStrikePricePair;
+	auto pricingfrftBSM(const BSMParams& modelParams, const MarketParams& marketParams, double lowestStrike, double highestStrike, const FRFTParams& params, std::string_view type = "call") -> LogStrikePricePair;
+	auto pricingfrftMertonJump(const MertonJumpParams& modelParams, const MarketParams& marketParams, double lowestStrike, double highestStrike, const FRFTParams& params, std::string_view type = "call") -> LogStrikePricePair;
+	auto pricingfrftVarianceGamma(const VarianceGammaParams& modelParams, const MarketParams& marketParams, double lowestStrike, double highestStrike, const FRFTParams& params, std::string_view type = "call") -> LogStrikePricePair;
 
 
 	namespace UnitTests
 	{
 		void separateModes();
 		void dft();
+		void fft();
 		void pricingfft();
+		void pricingfftSurface();
+		void pricingfftDual();
+		void frft();
+		void pricingfrft();
 	}
 }
 
@@ -17,7 +17,7 @@ namespace ShortRateModels
 		{
 			double rateMean{ std::exp(-meanReversion * time) * state + constDrift / meanReversion * (1 - std::exp(-meanReversion * time)) };
 			double rateVar{ vol * vol / 2. / meanReversion * (1 - std::exp(-2 * meanReversion * time)) };
-			return Random::normal(rateMean,rateVar);
+			return Random::normal(rateMean, std::sqrt(rateVar));
 		}
 		auto simulate(double startTime, double endTime, double state, const std::function<double(double)>& drift, double meanReversion, double vol) -> double
 		{
@@ -25,7 +25,7 @@ namespace ShortRateModels
 
 			double rateMean{ std::exp(-meanReversion * (endTime-startTime)) * state + Utils::integrateDriftTrapezoidal(startTime, endTime, meanReversion, drift)};
 			double rateVar{ vol * vol / 2. / meanReversion * (1 - std::exp(-2 * meanReversion * (endTime-startTime))) };
-			return Random::normal(rateMean, rateVar);
+			return Random::normal(rateMean, std::sqrt(rateVar));
 		}
 		auto path(double initialState, double terminalTime, std::size_t timePoints, const std::function<double(double)>& drift, double meanReversion, double vol) -> XYVals
 		{
@@ -0,0 +1,157 @@
+#include "levenbergMarquardt.h"
+
+
+void LevenbergMarquardt::set_bounds(std::vector<double> lowerBounds, std::vector<double> upperBounds)
+{
+    assert(std::size(lowerBounds) == m_dimension);
+    assert(std::size(upperBounds) == m_dimension);
+    for (std::size_t i{ 0 }; i < m_dimension; ++i)
+    {
+        assert(lowerBounds[i] <= upperBounds[i]);
+    }
+
+    m_lowerBounds = std::move(lowerBounds);
+    m_upperBounds = std::move(upperBounds);
+}
+
+void LevenbergMarquardt::clamp(std::vector<double>& params) const
+{
+    if (std::empty(m_lowerBounds))
+    {
+        return;
+    }
+    for (std::size_t j{ 0 }; j < m_dimension; ++j)
+    {
+        params[j] = std::clamp(params[j], m_lowerBounds[j], m_upperBounds[j]);
+    }
+}
+
+auto LevenbergMarquardt::boundedFraction(const std::vector<double>& params, const std::vector<double>& step) const -> double
+{
+    double fraction{ 1.0 };
+    if (std::empty(m_lowerBounds))
+    {
+        return fraction;
+    }
+    // parameters already on a bound are left to clamp, so the fraction stays positive
+    for (std::size_t j{ 0 }; j < m_dimension; ++j)
+    {
+        if (params[j] < m_upperBounds[j] && params[j] + step[j] > m_upperBounds[j])
+        {
+            fraction = std::min(fraction, (m_upperBounds[j] - params[j]) / step[j]);
+        }
+        else if (params[j] > m_lowerBounds[j] && params[j] + step[j] < m_lowerBounds[j])
+        {
+            fraction = std::min(fraction, (m_lowerBounds[j] - params[j]) / step[j]);
+        }
+    }
+    return fraction;
+}
+
+auto LevenbergMarquardt::dampedStep(const std::vector<double>& params, const std::vector<double>& jtj, const std::vector<double>& jtr, double damping, std::vector<double>& step) const -> bool
+{
+    std::size_t n{ m_dimension };
+
+    // the descent direction is -Jtr
+    std::vector<bool> fixed(n, false);
+    if (!std::empty(m_lowerBounds))
+    {
+        for (std::size_t j{ 0 }; j < n; ++j)
+        {
+            fixed[j] = (params[j] <= m_lowerBounds[j] && jtr[j] > 0.0) || (params[j] >= m_upperBounds[j] && jtr[j] < 0.0);
+        }
+    }
+
+    // Marquardt's scaling by the diagonal makes the step independent of the units of the parameters,
+    // the floor keeps parameters the residuals do not depend on from making the system singular
+    double largestDiagonal{ 0.0 };
+    for (std::size_t j{ 0 }; j < n; ++j)
+    {
+        largestDiagonal = std::max(largestDiagonal, jtj[j * n + j]);
+    }
+    std::vector<double> lower(jtj);
+    std::vector<double> rhs(n);
+    for (std::size_t j{ 0 }; j < n; ++j)
+    {
+        lower[j * n + j] += damping * std::max(jtj[j * n + j], 1e-12 * largestDiagonal);
+        rhs[j] = fixed[j] ? 0.0 : -jtr[j];
+        for (std::size_t k{ 0 }; k < n; ++k)
+        {
+            if ((fixed[j] || fixed[k]) && j != k)
+            {
+                lower[j * n + k] = 0.0;
+            }
+        }
+    }
+
+    // Cholesky decomposition in place, lower triangle
+    for (std::size_t j{ 0 }; j < n; ++j)
+    {
+        double diagonal{ lower[j * n + j] };
+        for (std::size_t k{ 0 }; k < j; ++k)
+        {
+            diagonal -= lower[j * n + k] * lower[j * n + k];
+        }
+        if (!(diagonal > 0.0))
+        {
+            return false;
+        }
+        lower[j * n + j] = std::sqrt(diagonal);
+        for (std::size_t i{ j + 1 }; i < n; ++i)
+        {
+            double entry{ lower[i * n + j] };
+            for (std::size_t k{ 0 }; k < j; ++k)
+            {
+                entry -= lower[i * n + k] * lower[j * n + k];
+            }
+            lower[i * n + j] = entry / lower[j * n + j];
+        }
+    }
+
+    // forward and back substitution for L Lt step = -Jtr
+    for (std::size_t i{ 0 }; i < n; ++i)
+    {
+        double value{ rhs[i] };
+        for (std::size_t k{ 0 }; k < i; ++k)
+        {
+            value -= lower[i * n + k] * step[k];
+        }
+        step[i] = value / lower[i * n + i];
+    }
+    for (std::size_t i{ n }; i-- > 0;)
+    {
+        double value{ step[i] };
+        for (std::size_t k{ i + 1 }; k < n; ++k)
+        {
+            value -= lower[k * n + i] * step[k];
+        }
+        step[i] = value / lower[i * n + i];
+    }
+    return true;
+}
+
+
+void testLevenbergMarquardt()
+{
+    // Rosenbrock function as the least squares problem r = (10 (y - x^2), 1 - x) with minimum 0 at (1, 1)
+    auto func
+    {
+        [](std::span<const double> params, std::vector<double>& residuals, std::vector<double>& jacobian)
+        {
+            residuals.resize(2);
+            jacobian.resize(4);
+            residuals[0] = 10.0 * (params[1] - params[0] * params[0]);
+            residuals[1] = 1.0 - params[0];
+            jacobian = { -20.0 * params[0], 10.0, -1.0, 0.0 };
+        }
+    };
+
+    LevenbergMarquardt optimizer{ 2 };
+    LevenbergMarquardt::Result result{ optimizer.optimize(func, { -1.2, 1.0 }, true) };
+    std::cout << "Levenberg-Marquardt found (" << result.m_params[0] << ", " << result.m_params[1] << "). True minimum is (1, 1).\n";
+
+    // with the bound x <= 0.5 the minimum lies on the boundary at (0.5, 0.25)
+    optimizer.set_bounds({ -2.0, -2.0 }, { 0.5, 2.0 });
+    result = optimizer.optimize(func, { -1.2, 1.0 });
+    std::cout << "With x <= 0.5 it found (" << result.m_params[0] << ", " << result.m_params[1] << "). True minimum is (0.5, 0.25).\n";
+}
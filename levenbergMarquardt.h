@@ -0,0 +1,191 @@
+#ifndef LEVENBERGMARQUARDT_H
+#define LEVENBERGMARQUARDT_H
+
+#include <iostream>
+#include <cmath>
+#include <vector>
+#include <span>
+#include <cassert>
+#include <algorithm>
+
+// Levenberg-Marquardt for nonlinear least squares problems like calibrating a model to a price surface.
+// Needs the residuals and their Jacobian, in exchange it converges in a few dozen evaluations instead of thousands.
+
+class LevenbergMarquardt
+{
+public:
+    explicit LevenbergMarquardt(std::size_t dimension = 1)
+        : m_dimension{ dimension }
+    {}
+
+    struct Result
+    {
+        std::vector<double> m_params{};
+        // half the sum of squared residuals
+        double m_cost{ 0.0 };
+        int m_iterations{ 0 };
+        bool m_converged{ false };
+    };
+
+    // setters
+    // Keeps the parameters inside the box [lowerBounds, upperBounds], steps leaving it are shortened to end on its boundary.
+    void set_bounds(std::vector<double> lowerBounds, std::vector<double> upperBounds);
+    void set_maxIterations(int maxIterations) { m_maxIterations = maxIterations; }
+    void set_tolerance(double tolerance) { m_tolerance = tolerance; }
+
+    // Minimizes half the sum of squared residuals starting from initialParams.
+    // func(params, residuals, jacobian) fills the residuals and the row major Jacobian (residuals.size() x dimension),
+    // resizing both as needed. params is a std::span<const double>.
+    constexpr Result optimize(const auto& func, std::vector<double> initialParams, bool verbose = false);
+
+private:
+    // Solves (JtJ + damping diag(JtJ)) step = -Jtr by Cholesky decomposition, false if the system is not positive definite.
+    // Parameters on a bound which the gradient pushes outwards stay fixed, the others take the step of the reduced system.
+    auto dampedStep(const std::vector<double>& params, const std::vector<double>& jtj, const std::vector<double>& jtr, double damping, std::vector<double>& step) const -> bool;
+    void clamp(std::vector<double>& params) const;
+    // largest fraction of step, at most one, which keeps params + fraction * step inside the bounds
+    auto boundedFraction(const std::vector<double>& params, const std::vector<double>& step) const -> double;
+
+    std::size_t m_dimension{ 1 };
+    int m_maxIterations{ 100 };
+    double m_tolerance{ 1e-10 };
+    std::vector<double> m_lowerBounds{};
+    std::vector<double> m_upperBounds{};
+};
+
+
+
+constexpr LevenbergMarquardt::Result LevenbergMarquardt::optimize(const auto& func, std::vector<double> initialParams, bool verbose)
+{
+    assert(std::size(initialParams) == m_dimension);
+    std::size_t n{ m_dimension };
+
+    Result result{ std::move(initialParams) };
+    clamp(result.m_params);
+
+    std::vector<double> residuals{};
+    std::vector<double> jacobian{};
+    auto evaluate
+    {
+        [&](const std::vector<double>& params, std::vector<double>& jtj, std::vector<double>& jtr) -> double
+        {
+            func(std::span<const double>{ params }, residuals, jacobian);
+            assert(std::size(jacobian) == std::size(residuals) * n);
+
+            // normal equations, only the lower triangle of JtJ is accumulated
+            std::fill(std::begin(jtj), std::end(jtj), 0.0);
+            std::fill(std::begin(jtr), std::end(jtr), 0.0);
+            double cost{ 0.0 };
+            for (std::size_t i{ 0 }; i < std::size(residuals); ++i)
+            {
+                const double* row{ jacobian.data() + i * n };
+                for (std::size_t j{ 0 }; j < n; ++j)
+                {
+                    jtr[j] += row[j] * residuals[i];
+                    for (std::size_t k{ 0 }; k <= j; ++k)
+                    {
+                        jtj[j * n + k] += row[j] * row[k];
+                    }
+                }
+                cost += 0.5 * residuals[i] * residuals[i];
+            }
+            for (std::size_t j{ 0 }; j < n; ++j)
+            {
+                for (std::size_t k{ 0 }; k < j; ++k)
+                {
+                    jtj[k * n + j] = jtj[j * n + k];
+                }
+            }
+            return cost;
+        }
+    };
+
+    std::vector<double> jtj(n * n);
+    std::vector<double> jtr(n);
+    result.m_cost = evaluate(result.m_params, jtj, jtr);
+
+    std::vector<double> trialJtj(n * n);
+    std::vector<double> trialJtr(n);
+    std::vector<double> step(n);
+    std::vector<double> trialParams(n);
+
+    // damping update of Nielsen: shrink it smoothly after good steps, grow it geometrically after failed ones.
+    // The damping is relative to the diagonal of JtJ. Starting at 1e-2 keeps the first steps, taken far from the minimum
+    // where the linear model is poor, from overshooting into the bounds.
+    double damping{ 1e-2 };
+    double dampingGrowth{ 2.0 };
+    while (result.m_iterations < m_maxIterations && !result.m_converged)
+    {
+        ++result.m_iterations;
+        if (!dampedStep(result.m_params, jtj, jtr, damping, step))
+        {
+            damping *= dampingGrowth;
+            dampingGrowth *= 2.0;
+            continue;
+        }
+
+        // A step which leaves the box is shortened along its direction rather than cut off coordinate by coordinate,
+        // which would turn it into a poor direction and strand the parameters in a corner of the box
+        double fraction{ boundedFraction(result.m_params, step) };
+        for (std::size_t j{ 0 }; j < n; ++j)
+        {
+            trialParams[j] = result.m_params[j] + fraction * step[j];
+        }
+        clamp(trialParams);
+
+        // reduction of the cost predicted by the linear model for the step actually taken
+        double predictedReduction{ 0.0 };
+        double stepSize{ 0.0 };
+        double paramSize{ 0.0 };
+        for (std::size_t j{ 0 }; j < n; ++j)
+        {
+            step[j] = trialParams[j] - result.m_params[j];
+            double jtjStep{ 0.0 };
+            for (std::size_t k{ 0 }; k < n; ++k)
+            {
+                jtjStep += jtj[j * n + k] * step[k];
+            }
+            predictedReduction -= step[j] * (jtr[j] + 0.5 * jtjStep);
+            stepSize += step[j] * step[j];
+            paramSize += result.m_params[j] * result.m_params[j];
+        }
+
+        double trialCost{ evaluate(trialParams, trialJtj, trialJtr) };
+        double gainRatio{ (predictedReduction > 0.0) ? (result.m_cost - trialCost) / predictedReduction : -1.0 };
+        if (gainRatio > 0.0)
+        {
+            double reduction{ result.m_cost - trialCost };
+            std::swap(result.m_params, trialParams);
+            std::swap(jtj, trialJtj);
+            std::swap(jtr, trialJtr);
+            result.m_cost = trialCost;
+            damping *= std::max(1.0 / 3.0, 1.0 - std::pow(2.0 * gainRatio - 1.0, 3));
+            dampingGrowth = 2.0;
+
+            if (verbose)
+            {
+                std::cout << "Iteration " << result.m_iterations << " reduced the cost to " << result.m_cost << ".\n";
+            }
+            result.m_converged = (reduction <= m_tolerance * result.m_cost) || (std::sqrt(stepSize) <= m_tolerance * (std::sqrt(paramSize) + m_tolerance));
+        }
+        else
+        {
+            damping *= dampingGrowth;
+            dampingGrowth *= 2.0;
+            // no progress possible any more, the step is below rounding of the parameters
+            result.m_converged = std::sqrt(stepSize) <= m_tolerance * (std::sqrt(paramSize) + m_tolerance);
+        }
+    }
+
+    if (verbose)
+    {
+        std::cout << "Levenberg-Marquardt " << (result.m_converged ? "converged" : "stopped") << " after " << result.m_iterations
+            << " iterations with cost " << result.m_cost << ".\n";
+    }
+    return result;
+}
+
+
+void testLevenbergMarquardt();
+
+#endif
@@ -18,6 +18,7 @@
 #include "risk.h"
 #include "optionClass.h"
 #include "interestModels.h"
+#include "qmc.h"
 #include <iostream>
 #include <functional>
 #include <iostream>
@@ -34,15 +35,42 @@ auto main() -> int
 
 	//LabeledTable volSurface{ Volatility::Surface::testCalibration() };
 	//Saving::write_labeledTable_to_csv("Data/ArtificalVolSurface.csv", volSurface);
+	//Volatility::Implied::test();
+	//Volatility::Surface::testImplied();
+	//Volatility::Surface::testIncremental();
 
 	//FFT::UnitTests::separateModes();
 	//FFT::UnitTests::dft();
+	//FFT::UnitTests::fft();
+	//FFT::UnitTests::pricingfftSurface();
+	//FFT::UnitTests::pricingfftDual();
+	//FFT::UnitTests::frft();
+	//FFT::UnitTests::pricingfrft();
+	//COS::UnitTests::pricingcos();
+	//COS::UnitTests::pricingcosGradient();
+	//SDE::Testing::parallelMonteCarlo();
+	//SDE::Testing::pathBlockLayouts();
+	//SDE::Testing::batchKernels();
+	//SDE::Testing::characteristicFunctionArrays();
+	//SDE::Testing::samplerMoments();
+	//QMC::UnitTests::sobol();
+	//Options::varianceReductionUnitTest();
+	//Options::adaptiveMonteCarloUnitTest();
+	//Options::streamingMonteCarloUnitTest();
+	//Options::chainMonteCarloUnitTest();
+	//Options::greeksMonteCarloUnitTest();
+	//Options::batchBSMUnitTest();
+	//Options::dualNumberUnitTest();
 	//FFT::UnitTests::pricingfft();
 
 	//Calibrate::Heston::test();
+	//Calibrate::Heston::testLM();
+	//Calibrate::Heston::testAdam();
 
 	//Calibrate::BSM::test();
 	//Calibrate::MertonJump::test();
+	//Calibrate::MertonJump::testLM();
+	//Calibrate::MertonJump::testAdam();
 
 	/*
 	BSMParams bsmParams{ 0.2 };
@@ -122,8 +150,12 @@ auto main() -> int
 	//Calibrate::Bachelier::test();
 
 	//Calibrate::VarianceGamma::test();
+	//Calibrate::VarianceGamma::testLM();
 
 	//testPSO();
+	//testParallelPSO();
+	//testLevenbergMarquardt();
+	//testVectorAdam();
 
 	//SDE::Testing::saveMCsamples();
 	//SDE::Testing::saveMertonJumpPaths();
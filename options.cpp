@@ -1,6 +1,8 @@
 #include "options.h"
 #include "calibrate.h"
+#include "qmc.h"
 #include <algorithm>
+#include <cassert>
 #include <iostream>
 #include <cmath>
 #include <string>
@@ -53,6 +55,22 @@ namespace Options
 			return put(lower, spotPrice) - put(higher, spotPrice);
 		}
 
+		auto Contract::operator()(double spotPrice) const -> double
+		{
+			switch (type)
+			{
+			case Type::call: return call(strike, spotPrice);
+			case Type::put: return put(strike, spotPrice);
+			case Type::straddle: return straddle(strike, spotPrice);
+			case Type::strangle: return strangle(strike, secondStrike, spotPrice);
+			case Type::callDebitSpread: return callDebitSpread(strike, secondStrike, spotPrice);
+			case Type::callCreditSpread: return callCreditSpread(strike, secondStrike, spotPrice);
+			case Type::putDebitSpread: return putDebitSpread(strike, secondStrike, spotPrice);
+			case Type::putCreditSpread: return putCreditSpread(strike, secondStrike, spotPrice);
+			}
+			return 0.0;
+		}
+
 
 	}
 
@@ -121,17 +139,12 @@ namespace Options
 
 			auto call(double riskFreeReturn, double vol, double maturity, double strike, double spot, double dividendYield) -> double
 			{
-				double d1{ _d1(riskFreeReturn, vol, maturity, strike, spot, dividendYield) };
-				double d2{ _d2(riskFreeReturn, vol, maturity, strike, spot, dividendYield) };
-				return spot * std::exp(-dividendYield * maturity) * Distributions::CDFs::standardNormal(d1)
-					- strike * std::exp(-riskFreeReturn * maturity) * Distributions::CDFs::standardNormal(d2);
+				return call<double>(riskFreeReturn, vol, maturity, strike, spot, dividendYield);
 			}
 
-			// given the call price, we use put-call parity to price puts
 			auto put(double riskFreeReturn, double vol, double maturity, double strike, double spot, double dividendYield) -> double
 			{
-				double callPrice = Options::Pricing::BSM::call(riskFreeReturn, vol, maturity, strike, spot, dividendYield);
-				return callPrice + strike * std::exp(-riskFreeReturn * maturity) - spot * std::exp(-dividendYield * maturity);
+				return put<double>(riskFreeReturn, vol, maturity, strike, spot, dividendYield);
 			}
 
 			auto callDelta(double riskFreeReturn, double vol, double maturity, double strike, double spot, double dividendYield) -> double
@@ -218,15 +231,128 @@ namespace Options
 				return -std::exp(-riskFreeReturn * maturity) * Distributions::PDFs::standardNormal(d2) * d2derivSpot;
 			}
 
+			void batch(const BatchOptions& options, BatchGreeks& out)
+			{
+				std::size_t size{ std::size(options.types) };
+				assert(std::size(options.strikes) == size && std::size(options.maturities) == size && std::size(options.spots) == size
+					&& std::size(options.vols) == size && std::size(options.riskFreeReturns) == size && std::size(options.dividendYields) == size);
+				for (std::vector<double>* greek : { &out.price, &out.delta, &out.gamma, &out.vega, &out.theta, &out.rho, &out.vanna, &out.volga })
+				{
+					greek->resize(size);
+				}
+
+				// Blocks small enough to stay in the L1 cache. Each stage is a branch free loop over the block and the intermediate
+				// values are shared by all Greeks. gcc -O3 -march=x86-64-v3 vectorizes every stage except the first, whose std::log
+				// and std::exp are library calls, the normal CDF and PDF included (see Distributions). A put is priced by the call formulas
+				// with N(d) replaced by N(d) - 1 = -N(-d), which keeps the accuracy of deep out of the money puts.
+				constexpr std::size_t blockSize{ 256 };
+				std::array<double, blockSize> sqrtMaturity{};
+				std::array<double, blockSize> d1{};
+				std::array<double, blockSize> d2{};
+				std::array<double, blockSize> cdf1{};
+				std::array<double, blockSize> cdf2{};
+				std::array<double, blockSize> pdf1{};
+				std::array<double, blockSize> dividendDiscount{};
+				std::array<double, blockSize> discount{};
+				std::array<double, blockSize> sign{};
+				std::array<double, blockSize> signedD1{};
+				std::array<double, blockSize> signedD2{};
+				std::array<double, blockSize> forwardTerm{};
+				std::array<double, blockSize> strikeTerm{};
+
+				for (std::size_t first{ 0 }; first < size; first += blockSize)
+				{
+					std::size_t count{ std::min(blockSize, size - first) };
+
+					for (std::size_t j{ 0 }; j < count; ++j)
+					{
+						std::size_t i{ first + j };
+						double vol{ options.vols[i] };
+						double maturity{ options.maturities[i] };
+						sqrtMaturity[j] = std::sqrt(maturity);
+						d1[j] = (std::log(options.spots[i] / options.strikes[i]) + (options.riskFreeReturns[i] - options.dividendYields[i] + vol * vol / 2.) * maturity) / (vol * sqrtMaturity[j]);
+						d2[j] = d1[j] - vol * sqrtMaturity[j];
+						dividendDiscount[j] = std::exp(-options.dividendYields[i] * maturity);
+						discount[j] = std::exp(-options.riskFreeReturns[i] * maturity);
+						assert(options.types[i] == Payoffs::Type::call || options.types[i] == Payoffs::Type::put);
+					}
+					for (std::size_t j{ 0 }; j < count; ++j)
+					{
+						sign[j] = options.types[first + j] == Payoffs::Type::put ? -1.0 : 1.0;
+						signedD1[j] = sign[j] * d1[j];
+						signedD2[j] = sign[j] * d2[j];
+					}
+					Distributions::CDFs::standardNormal(std::span{ signedD1 }.first(count), std::span{ cdf1 }.first(count));
+					Distributions::CDFs::standardNormal(std::span{ signedD2 }.first(count), std::span{ cdf2 }.first(count));
+					Distributions::PDFs::standardNormal(std::span{ d1 }.first(count), std::span{ pdf1 }.first(count));
+					for (std::size_t j{ 0 }; j < count; ++j)
+					{
+						cdf1[j] *= sign[j];
+						cdf2[j] *= sign[j];
+					}
+					for (std::size_t j{ 0 }; j < count; ++j)
+					{
+						std::size_t i{ first + j };
+						forwardTerm[j] = options.spots[i] * dividendDiscount[j];
+						strikeTerm[j] = options.strikes[i] * discount[j];
+					}
+					// The Greeks are written by several short loops, gcc keeps a loop which writes all eight outputs scalar
+					// because it would need more run time checks for overlapping arrays than it allows.
+					for (std::size_t j{ 0 }; j < count; ++j)
+					{
+						std::size_t i{ first + j };
+						out.price[i] = forwardTerm[j] * cdf1[j] - strikeTerm[j] * cdf2[j];
+						out.delta[i] = dividendDiscount[j] * cdf1[j];
+					}
+					for (std::size_t j{ 0 }; j < count; ++j)
+					{
+						std::size_t i{ first + j };
+						out.gamma[i] = dividendDiscount[j] * pdf1[j] / (options.spots[i] * options.vols[i] * sqrtMaturity[j]);
+						out.vega[i] = forwardTerm[j] * pdf1[j] * sqrtMaturity[j];
+					}
+					for (std::size_t j{ 0 }; j < count; ++j)
+					{
+						std::size_t i{ first + j };
+						out.theta[i] = -forwardTerm[j] * pdf1[j] * options.vols[i] / (2.0 * sqrtMaturity[j])
+							+ options.dividendYields[i] * forwardTerm[j] * cdf1[j]
+							- options.riskFreeReturns[i] * strikeTerm[j] * cdf2[j];
+					}
+					for (std::size_t j{ 0 }; j < count; ++j)
+					{
+						std::size_t i{ first + j };
+						out.rho[i] = strikeTerm[j] * options.maturities[i] * cdf2[j];
+					}
+					for (std::size_t j{ 0 }; j < count; ++j)
+					{
+						std::size_t i{ first + j };
+						out.vanna[i] = -dividendDiscount[j] * pdf1[j] * d2[j] / options.vols[i];
+						out.volga[i] = out.vega[i] * d1[j] * d2[j] / options.vols[i];
+					}
+				}
+			}
+
+			auto batch(const BatchOptions& options) -> BatchGreeks
+			{
+				BatchGreeks out{};
+				batch(options, out);
+				return out;
+			}
+
 			auto monteCarlo(const std::function<double(double)>& payoff, double riskFreeReturn, double vol, double maturity, double spot, double dividendYield) -> double
 			{
 
 				// number of MC samples for simulation
 				std::size_t sampleNum{ 1000000 };
-				std::vector<double> predictedSpots{ SDE::BSM::monteCarlo(spot, maturity, sampleNum, riskFreeReturn - dividendYield, vol).m_yVals };
+				MonteCarloParams mcParams{};
+				mcParams.samples = sampleNum;
 
-				// compute future payoffs
-				return Options::Pricing::Utils::_discountedExpectedPayoff(payoff, predictedSpots, riskFreeReturn, maturity);
+				// stream the simulated spots into the payoff instead of storing them
+				return Streaming::monteCarlo(payoff, BSMParams{ vol }, MarketParams{ maturity, spot, riskFreeReturn, dividendYield }, mcParams).value;
+			}
+
+			auto monteCarlo(const std::function<double(double)>& payoff, double riskFreeReturn, double vol, double maturity, double spot, double dividendYield, const MonteCarloParams& mcParams, const ControlVariate& control) -> Estimate
+			{
+				return Streaming::monteCarlo(payoff, BSMParams{ vol }, MarketParams{ maturity, spot, riskFreeReturn, dividendYield }, mcParams, control);
 			}
 
 			void testMonteCarlo()
@@ -349,16 +475,12 @@ namespace Options
 
 			auto call(double riskFreeReturn, double vol, double maturity, double strike, double spot, double dividendYield) -> double
 			{
-				double dplus{ _dplus(riskFreeReturn, vol, maturity, strike, spot, dividendYield) };
-				return std::exp(-(riskFreeReturn-dividendYield) * maturity) * vol * std::sqrt(maturity) * 
-						(dplus * Distributions::CDFs::standardNormal(dplus) + Distributions::PDFs::standardNormal(dplus));
+				return call<double>(riskFreeReturn, vol, maturity, strike, spot, dividendYield);
 			}
 
 			auto put(double riskFreeReturn, double vol, double maturity, double strike, double spot, double dividendYield) -> double
 			{
-				double dminus{ _dminus(riskFreeReturn, vol, maturity, strike, spot, dividendYield) };
-				return std::exp(-riskFreeReturn * maturity) * vol * std::sqrt(maturity) *
-					(dminus * Distributions::CDFs::standardNormal(dminus) + Distributions::PDFs::standardNormal(dminus));
+				return put<double>(riskFreeReturn, vol, maturity, strike, spot, dividendYield);
 			}
 
 
@@ -393,10 +515,16 @@ namespace Options
 
 				// number of MC samples for simulation
 				std::size_t sampleNum{ 1000000 };
-				std::vector<double> predictedSpots{ SDE::Bachelier::monteCarlo(spot, maturity, sampleNum, riskFreeReturn - dividendYield, vol).m_yVals };
+				MonteCarloParams mcParams{};
+				mcParams.samples = sampleNum;
+
+				// stream the simulated spots into the payoff instead of storing them
+				return Streaming::monteCarlo(payoff, BachelierParams{ vol }, MarketParams{ maturity, spot, riskFreeReturn, dividendYield }, mcParams).value;
+			}
 
-				// compute future payoffs
-				return Options::Pricing::Utils::_discountedExpectedPayoff(payoff, predictedSpots, riskFreeReturn, maturity);
+			auto monteCarlo(const std::function<double(double)>& payoff, double riskFreeReturn, double vol, double maturity, double spot, double dividendYield, const MonteCarloParams& mcParams, const ControlVariate& control) -> Estimate
+			{
+				return Streaming::monteCarlo(payoff, BachelierParams{ vol }, MarketParams{ maturity, spot, riskFreeReturn, dividendYield }, mcParams, control);
 			}
 
 			void testMonteCarlo()
@@ -462,10 +590,17 @@ namespace Options
 				// number of MC samples for simulation
 				std::size_t sampleNum{ 1000000 };
 				std::size_t timePoints{ 100 };
-				std::vector<double> predictedSpots{ SDE::CEV::monteCarlo(spot, maturity, sampleNum, timePoints, riskFreeReturn - dividendYield, vol, exponent).m_yVals };
+				MonteCarloParams mcParams{};
+				mcParams.samples = sampleNum;
+				mcParams.timePoints = timePoints;
 
-				// compute future payoffs
-				return Options::Pricing::Utils::_discountedExpectedPayoff(payoff, predictedSpots, riskFreeReturn, maturity);
+				// stream the simulated spots into the payoff instead of storing them
+				return Streaming::monteCarlo(payoff, CEVParams{ vol, exponent }, MarketParams{ maturity, spot, riskFreeReturn, dividendYield }, mcParams).value;
+			}
+
+			auto monteCarlo(const std::function<double(double)>& payoff, double riskFreeReturn, double vol, double maturity, double spot, double dividendYield, double exponent, const MonteCarloParams& mcParams, const ControlVariate& control) -> Estimate
+			{
+				return Streaming::monteCarlo(payoff, CEVParams{ vol, exponent }, MarketParams{ maturity, spot, riskFreeReturn, dividendYield }, mcParams, control);
 			}
 
 			void test()
@@ -546,10 +681,16 @@ namespace Options
 
 				// number of MC samples for simulation
 				std::size_t sampleNum{ 10000000 };
-				std::vector<double> predictedSpots{ SDE::MertonJump::monteCarlo(spot, maturity, sampleNum, riskFreeReturn - dividendYield, volatility, meanJumpSize, stdJumpSize, expectedJumpsPerYear).m_yVals };
+				MonteCarloParams mcParams{};
+				mcParams.samples = sampleNum;
 
-				// compute future payoffs
-				return Options::Pricing::Utils::_discountedExpectedPayoff(payoff, predictedSpots, riskFreeReturn, maturity);
+				// stream the simulated spots into the payoff instead of storing them
+				return Streaming::monteCarlo(payoff, MertonJumpParams{ volatility, meanJumpSize, stdJumpSize, expectedJumpsPerYear }, MarketParams{ maturity, spot, riskFreeReturn, dividendYield }, mcParams).value;
+			}
+
+			auto monteCarlo(const std::function<double(double)>& payoff, double riskFreeReturn, double maturity, double spot, double dividendYield, double volatility, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear, const MonteCarloParams& mcParams, const ControlVariate& control) -> Estimate
+			{
+				return Streaming::monteCarlo(payoff, MertonJumpParams{ volatility, meanJumpSize, stdJumpSize, expectedJumpsPerYear }, MarketParams{ maturity, spot, riskFreeReturn, dividendYield }, mcParams, control);
 			}
 
 			auto fft(double strike, double riskFreeReturn, double maturity, double spot, double dividendYield, double volatility, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear, std::string_view type) -> double
@@ -561,6 +702,14 @@ namespace Options
 				return Calibrate::interpolatePrices(pair, std::vector<double>{strike}).back();
 			}
 
+			auto cos(double strike, double riskFreeReturn, double maturity, double spot, double dividendYield, double volatility, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear, std::string_view type) -> double
+			{
+				MertonJumpParams modelParams{ volatility, meanJumpSize, stdJumpSize, expectedJumpsPerYear };
+				MarketParams marketParams{ maturity, spot, riskFreeReturn, dividendYield };
+				COS::COSParams params{};
+				return COS::pricingcos(modelParams, marketParams, std::vector<double>{strike}, params, type).back();
+			}
+
 			void testPricing()
 			{
 				double riskFreeReturn{ 0.003 };
@@ -578,12 +727,14 @@ namespace Options
 
 				std::cout << "\n===Testing Merton Jump Model===\n";
 				std::cout << "Call price with FFT is " << fft(strike, riskFreeReturn, maturity, spot, dividendYield, volatility, meanJumpSize, stdJumpSize, expectedJumpsPerYear) << "\n";
+				std::cout << "Call price with COS is " << cos(strike, riskFreeReturn, maturity, spot, dividendYield, volatility, meanJumpSize, stdJumpSize, expectedJumpsPerYear) << "\n";
 				std::cout << "Call price with MC is " << monteCarlo(payoff, riskFreeReturn, maturity, spot, dividendYield, volatility, meanJumpSize, stdJumpSize, expectedJumpsPerYear) << "\n";
 			
 				strike = 330;
 				auto payoff2{ [&](double value) { return Options::Payoffs::put(strike, value); } };
 
 				std::cout << "Put price with FFT is " << fft(strike, riskFreeReturn, maturity, spot, dividendYield, volatility, meanJumpSize, stdJumpSize, expectedJumpsPerYear, "put") << "\n";
+				std::cout << "Put price with COS is " << cos(strike, riskFreeReturn, maturity, spot, dividendYield, volatility, meanJumpSize, stdJumpSize, expectedJumpsPerYear, "put") << "\n";
 				std::cout << "Put price with MC is " << monteCarlo(payoff2, riskFreeReturn, maturity, spot, dividendYield, volatility, meanJumpSize, stdJumpSize, expectedJumpsPerYear) << "\n";
 			
 			}
@@ -597,10 +748,17 @@ namespace Options
 				// number of MC samples for simulation
 				std::size_t sampleNum{ 10000 };
 				std::size_t timePoints{ 1000 };
-				std::vector<double> predictedSpots{ SDE::Heston::monteCarlo(spot, maturity, sampleNum, timePoints, riskFreeReturn - dividendYield, initialVariance, longVariance, correlation, reversionRate, volVol).m_yVals };
+				MonteCarloParams mcParams{};
+				mcParams.samples = sampleNum;
+				mcParams.timePoints = timePoints;
 
-				// compute future payoffs
-				return Options::Pricing::Utils::_discountedExpectedPayoff(payoff, predictedSpots, riskFreeReturn, maturity);
+				// stream the simulated spots into the payoff instead of storing them
+				return Streaming::monteCarlo(payoff, HestonParams{ reversionRate, longVariance, volVol, correlation, initialVariance }, MarketParams{ maturity, spot, riskFreeReturn, dividendYield }, mcParams).value;
+			}
+
+			auto monteCarlo(const std::function<double(double)>& payoff, double riskFreeReturn, double maturity, double spot, double dividendYield, double initialVariance, double longVariance, double correlation, double reversionRate, double volVol, const MonteCarloParams& mcParams, const ControlVariate& control) -> Estimate
+			{
+				return Streaming::monteCarlo(payoff, HestonParams{ reversionRate, longVariance, volVol, correlation, initialVariance }, MarketParams{ maturity, spot, riskFreeReturn, dividendYield }, mcParams, control);
 			}
 
 			auto fft(double strike, double riskFreeReturn, double maturity, double spot, double dividendYield, double initialVariance, double longVariance, double correlation, double reversionRate, double volVol, std::string_view type) -> double
@@ -612,6 +770,14 @@ namespace Options
 				return Calibrate::interpolatePrices(pair, std::vector<double>{strike}).back();
 			}
 
+			auto cos(double strike, double riskFreeReturn, double maturity, double spot, double dividendYield, double initialVariance, double longVariance, double correlation, double reversionRate, double volVol, std::string_view type) -> double
+			{
+				HestonParams modelParams{ reversionRate, longVariance, volVol, correlation, initialVariance };
+				MarketParams marketParams{ maturity, spot, riskFreeReturn, dividendYield };
+				COS::COSParams params{};
+				return COS::pricingcos(modelParams, marketParams, std::vector<double>{strike}, params, type).back();
+			}
+
 			void testPricing()
 			{
 				double riskFreeReturn{ 0.003 };
@@ -630,12 +796,14 @@ namespace Options
 
 				std::cout << "\n===Testing Heston Model===\n";
 				std::cout << "Call price with FFT is " << fft(strike, riskFreeReturn, maturity, spot, dividendYield, initialVariance, longVariance, correlation, reversionRate, volVol) << "\n";
+				std::cout << "Call price with COS is " << cos(strike, riskFreeReturn, maturity, spot, dividendYield, initialVariance, longVariance, correlation, reversionRate, volVol) << "\n";
 				std::cout << "Call price with MC is " << monteCarlo(payoff, riskFreeReturn, maturity, spot, dividendYield, initialVariance, longVariance, correlation, reversionRate, volVol) << "\n";
 			
 				strike = 330;
 				auto payoff2{ [&](double value) { return Options::Payoffs::put(strike, value); } };
 
 				std::cout << "Put price with FFT is " << fft(strike, riskFreeReturn, maturity, spot, dividendYield, initialVariance, longVariance, correlation, reversionRate, volVol, "put") << "\n";
+				std::cout << "Put price with COS is " << cos(strike, riskFreeReturn, maturity, spot, dividendYield, initialVariance, longVariance, correlation, reversionRate, volVol, "put") << "\n";
 				std::cout << "Put price with MC is " << monteCarlo(payoff2, riskFreeReturn, maturity, spot, dividendYield, initialVariance, longVariance, correlation, reversionRate, volVol) << "\n";
 
 			}
@@ -649,13 +817,20 @@ namespace Options
 				// number of MC samples for simulation
 				std::size_t sampleNum{ 10000 };
 				std::size_t timePoints{ 1000 };
-				std::vector<double> predictedSpots{ SDE::VarianceGamma::monteCarlo(spot, maturity, sampleNum, timePoints, riskFreeReturn - dividendYield, gammaDrift, variance, vol).m_yVals };
+				MonteCarloParams mcParams{};
+				mcParams.samples = sampleNum;
+				mcParams.timePoints = timePoints;
 
-				// compute future payoffs
-				return Options::Pricing::Utils::_discountedExpectedPayoff(payoff, predictedSpots, riskFreeReturn, maturity);
+				// stream the simulated spots into the payoff instead of storing them
+				return Streaming::monteCarlo(payoff, VarianceGammaParams{ vol, gammaDrift, variance }, MarketParams{ maturity, spot, riskFreeReturn, dividendYield }, mcParams).value;
 
 			}
 
+			auto monteCarlo(const std::function<double(double)>& payoff, double riskFreeReturn, double maturity, double spot, double dividendYield, double gammaDrift, double variance, double vol, const MonteCarloParams& mcParams, const ControlVariate& control) -> Estimate
+			{
+				return Streaming::monteCarlo(payoff, VarianceGammaParams{ vol, gammaDrift, variance }, MarketParams{ maturity, spot, riskFreeReturn, dividendYield }, mcParams, control);
+			}
+
 			auto fft(double strike, double riskFreeReturn, double maturity, double spot, double dividendYield, double gammaDrift, double variance, double vol, std::string_view type) -> double
 			{
 				VarianceGammaParams modelParams{ vol, gammaDrift, variance };
@@ -665,6 +840,14 @@ namespace Options
 				return Calibrate::interpolatePrices(pair, std::vector<double>{strike}).back();
 			}
 
+			auto cos(double strike, double riskFreeReturn, double maturity, double spot, double dividendYield, double gammaDrift, double variance, double vol, std::string_view type) -> double
+			{
+				VarianceGammaParams modelParams{ vol, gammaDrift, variance };
+				MarketParams marketParams{ maturity, spot, riskFreeReturn, dividendYield };
+				COS::COSParams params{};
+				return COS::pricingcos(modelParams, marketParams, std::vector<double>{strike}, params, type).back();
+			}
+
 			void testPricing()
 			{
 				double riskFreeReturn{ 0.003 };
@@ -681,12 +864,14 @@ namespace Options
 
 				std::cout << "\n===Testing Variance Gamma Model===\n";
 				std::cout << "Call price with FFT is " << fft(strike, riskFreeReturn, maturity, spot, dividendYield, gammaDrift, variance, vol) << "\n";
+				std::cout << "Call price with COS is " << cos(strike, riskFreeReturn, maturity, spot, dividendYield, gammaDrift, variance, vol) << "\n";
 				std::cout << "Call price with MC is " << monteCarlo(payoff, riskFreeReturn, maturity, spot, dividendYield, gammaDrift, variance, vol) << "\n";
 			
 				strike = 330;
 				auto payoff2{ [&](double value) { return Options::Payoffs::put(strike, value); } };
 
 				std::cout << "Put price with FFT is " << fft(strike, riskFreeReturn, maturity, spot, dividendYield, gammaDrift, variance, vol, "put") << "\n";
+				std::cout << "Put price with COS is " << cos(strike, riskFreeReturn, maturity, spot, dividendYield, gammaDrift, variance, vol, "put") << "\n";
 				std::cout << "Put price with MC is " << monteCarlo(payoff2, riskFreeReturn, maturity, spot, dividendYield, gammaDrift, variance, vol) << "\n";
 
 			}
@@ -694,18 +879,211 @@ namespace Options
 
 		namespace Utils
 		{
-			auto _discountedExpectedPayoff(const std::function<double(double)>& payoff, std::vector<double> predictedSpots, double riskFreeReturn, double maturity) -> double
+			auto _discountedExpectedPayoff(const std::function<double(double)>& payoff, const std::vector<double>& predictedSpots, double riskFreeReturn, double maturity) -> double
 			{
-				// compute future payoffs
-				std::vector<double> predictedPayoffs(std::size(predictedSpots));
-				for (std::size_t i{ 0 }; i < std::size(predictedSpots); ++i)
+				// compute discounted expected payoff
+				double sum{ 0.0 };
+				for (double predictedSpot : predictedSpots)
 				{
-					predictedPayoffs[i] = payoff(predictedSpots[i]);
+					sum += payoff(predictedSpot);
 				}
+				return std::exp(-riskFreeReturn * maturity) * sum / static_cast<double>(std::size(predictedSpots));
+			}
 
-				// compute discounted expected payoff
-				double price{ std::exp(-riskFreeReturn * maturity) * np::mean<double>(predictedPayoffs) };
-				return price;
+			auto _discountedPayoffObservations(const std::function<double(double)>& payoff, const WeightedSamples& samples, double riskFreeReturn, double maturity, double spot, double dividendYield, const MonteCarloParams& mcParams, const ControlVariate& control) -> std::vector<double>
+			{
+				std::size_t numSamples{ std::size(samples.m_states) };
+				double discount{ std::exp(-riskFreeReturn * maturity) };
+				std::vector<double> values(numSamples);
+				for (std::size_t i{ 0 }; i < numSamples; ++i)
+				{
+					values[i] = discount * samples.m_weights[i] * payoff(samples.m_states[i]);
+				}
+
+				if (control.vol > 0.0 && numSamples > 1)
+				{
+					// shadow BSM spots from the same Brownian motion, the regression coefficient minimizes the variance
+					double driftTerm{ (riskFreeReturn - dividendYield - 0.5 * control.vol * control.vol) * maturity };
+					double diffusion{ control.vol * std::sqrt(maturity) };
+					std::vector<double> controls(numSamples);
+					for (std::size_t i{ 0 }; i < numSamples; ++i)
+					{
+						double shadowSpot{ spot * std::exp(driftTerm + diffusion * samples.m_brownian[i]) };
+						controls[i] = discount * samples.m_weights[i] * Options::Payoffs::call(control.strike, shadowSpot);
+					}
+					double valueMean{ np::mean<double>(values) };
+					double controlMean{ np::mean<double>(controls) };
+					double covariance{ 0.0 };
+					double variance{ 0.0 };
+					for (std::size_t i{ 0 }; i < numSamples; ++i)
+					{
+						covariance += (values[i] - valueMean) * (controls[i] - controlMean);
+						variance += (controls[i] - controlMean) * (controls[i] - controlMean);
+					}
+					double coefficient{ (variance > 0.0) ? covariance / variance : 0.0 };
+					double controlPrice{ BSM::call(riskFreeReturn, control.vol, maturity, control.strike, spot, dividendYield) };
+					for (std::size_t i{ 0 }; i < numSamples; ++i)
+					{
+						values[i] -= coefficient * (controls[i] - controlPrice);
+					}
+				}
+
+				if (mcParams.sampling == "sobol")
+				{
+					// the replicates are the independent samples, the scrambled points within one are dependent
+					return QMC::replicateMeans(values);
+				}
+				if (mcParams.antithetic)
+				{
+					// the two paths of a pair are dependent, their average is one independent sample
+					for (std::size_t i{ 0 }; i + 1 < numSamples; i += 2)
+					{
+						values[i / 2] = 0.5 * (values[i] + values[i + 1]);
+					}
+					if (numSamples % 2 == 1)
+					{
+						values[numSamples / 2] = values[numSamples - 1];
+					}
+					values.resize((numSamples + 1) / 2);
+				}
+				return values;
+			}
+
+			auto _discountedExpectedPayoff(const std::function<double(double)>& payoff, const WeightedSamples& samples, double riskFreeReturn, double maturity, double spot, double dividendYield, const MonteCarloParams& mcParams, const ControlVariate& control) -> Estimate
+			{
+				RunningStatistics statistics{};
+				for (double observation : _discountedPayoffObservations(payoff, samples, riskFreeReturn, maturity, spot, dividendYield, mcParams, control))
+				{
+					statistics.add(observation);
+				}
+				return statistics.estimate();
+			}
+
+			auto importanceShift(double riskFreeReturn, double vol, double maturity, double strike, double spot, double dividendYield) -> double
+			{
+				return -BSM::_d2(riskFreeReturn, vol, maturity, strike, spot, dividendYield);
+			}
+		}
+
+		void PayoffMoments::merge(const PayoffMoments& other)
+		{
+			m_paths.merge(other.m_paths);
+			m_observations.merge(other.m_observations);
+			if (std::size(m_replicates) < std::size(other.m_replicates))
+			{
+				m_replicates.resize(std::size(other.m_replicates));
+			}
+			for (std::size_t r{ 0 }; r < std::size(other.m_replicates); ++r)
+			{
+				m_replicates[r].merge(other.m_replicates[r]);
+			}
+		}
+
+		auto PayoffMoments::estimate(double controlPrice) const -> Estimate
+		{
+			// the regression coefficient of the payoffs on the controls minimizes the variance, without control it is zero
+			double coefficient{ (m_paths.m_sumSquaresY > 0.0) ? m_paths.m_coMoment / m_paths.m_sumSquaresY : 0.0 };
+			CovarianceStatistics observations{ m_observations };
+			if (!m_replicates.empty())
+			{
+				observations = {};
+				for (const CovarianceStatistics& replicate : m_replicates)
+				{
+					if (replicate.m_count > 0) { observations.add(replicate.m_meanX, replicate.m_meanY); }
+				}
+			}
+
+			Estimate result{};
+			result.value = observations.m_meanX - coefficient * (observations.m_meanY - controlPrice);
+			if (observations.m_count > 1)
+			{
+				double sumSquares{ observations.m_sumSquaresX - 2.0 * coefficient * observations.m_coMoment + coefficient * coefficient * observations.m_sumSquaresY };
+				double count{ static_cast<double>(observations.m_count) };
+				result.standardError = std::sqrt(std::max(sumSquares, 0.0) / (count - 1.0) / count);
+			}
+			return result;
+		}
+
+		ChainAccumulator::ChainAccumulator(std::span<const Payoffs::Contract> contracts, const MarketParams& marketParams, const MonteCarloParams& mcParams, const ControlVariate& control)
+		{
+			m_accumulators.reserve(std::size(contracts));
+			for (const Payoffs::Contract& contract : contracts)
+			{
+				m_accumulators.emplace_back(contract, marketParams, mcParams, control);
+			}
+		}
+
+		auto ChainAccumulator::moments(const SampleBatch& batch) const -> std::vector<PayoffMoments>
+		{
+			std::vector<PayoffMoments> moments{};
+			moments.reserve(std::size(m_accumulators));
+			for (const auto& accumulator : m_accumulators)
+			{
+				moments.push_back(accumulator.moments(batch));
+			}
+			return moments;
+		}
+
+		void ChainAccumulator::merge(const std::vector<PayoffMoments>& moments)
+		{
+			for (std::size_t i{ 0 }; i < std::size(m_accumulators); ++i)
+			{
+				m_accumulators[i].merge(moments[i]);
+			}
+		}
+
+		auto ChainAccumulator::estimates() const -> std::vector<Estimate>
+		{
+			std::vector<Estimate> estimates{};
+			estimates.reserve(std::size(m_accumulators));
+			for (const auto& accumulator : m_accumulators)
+			{
+				estimates.push_back(accumulator.estimate());
+			}
+			return estimates;
+		}
+
+		namespace Adaptive
+		{
+			auto _monteCarlo(const std::function<double(double)>& payoff, const auto& modelParams, const MarketParams& marketParams, const AdaptiveParams& adaptiveParams, const MonteCarloParams& mcParams, const ControlVariate& control) -> AdaptiveEstimate
+			{
+				Random::Stream batchSeeds{ mcParams.seed, 0 };
+				return Utils::adaptive(adaptiveParams, [&](std::size_t, RunningStatistics& statistics)
+				{
+					MonteCarloParams batchParams{ mcParams };
+					batchParams.seed = (static_cast<std::uint64_t>(batchSeeds()) << 32) | batchSeeds();
+					WeightedSamples samples{ SDE::monteCarlo(marketParams.spot, marketParams.maturity, marketParams.riskFreeReturn - marketParams.dividendYield, modelParams, batchParams) };
+					for (double observation : Utils::_discountedPayoffObservations(payoff, samples, marketParams.riskFreeReturn, marketParams.maturity, marketParams.spot, marketParams.dividendYield, batchParams, control))
+					{
+						statistics.add(observation);
+					}
+					return batchParams.samples;
+				});
+			}
+
+			auto monteCarlo(const std::function<double(double)>& payoff, const BSMParams& modelParams, const MarketParams& marketParams, const AdaptiveParams& adaptiveParams, const MonteCarloParams& mcParams, const ControlVariate& control) -> AdaptiveEstimate
+			{
+				return _monteCarlo(payoff, modelParams, marketParams, adaptiveParams, mcParams, control);
+			}
+			auto monteCarlo(const std::function<double(double)>& payoff, const BachelierParams& modelParams, const MarketParams& marketParams, const AdaptiveParams& adaptiveParams, const MonteCarloParams& mcParams, const ControlVariate& control) -> AdaptiveEstimate
+			{
+				return _monteCarlo(payoff, modelParams, marketParams, adaptiveParams, mcParams, control);
+			}
+			auto monteCarlo(const std::function<double(double)>& payoff, const CEVParams& modelParams, const MarketParams& marketParams, const AdaptiveParams& adaptiveParams, const MonteCarloParams& mcParams, const ControlVariate& control) -> AdaptiveEstimate
+			{
+				return _monteCarlo(payoff, modelParams, marketParams, adaptiveParams, mcParams, control);
+			}
+			auto monteCarlo(const std::function<double(double)>& payoff, const MertonJumpParams& modelParams, const MarketParams& marketParams, const AdaptiveParams& adaptiveParams, const MonteCarloParams& mcParams, const ControlVariate& control) -> AdaptiveEstimate
+			{
+				return _monteCarlo(payoff, modelParams, marketParams, adaptiveParams, mcParams, control);
+			}
+			auto monteCarlo(const std::function<double(double)>& payoff, const HestonParams& modelParams, const MarketParams& marketParams, const AdaptiveParams& adaptiveParams, const MonteCarloParams& mcParams, const ControlVariate& control) -> AdaptiveEstimate
+			{
+				return _monteCarlo(payoff, modelParams, marketParams, adaptiveParams, mcParams, control);
+			}
+			auto monteCarlo(const std::function<double(double)>& payoff, const VarianceGammaParams& modelParams, const MarketParams& marketParams, const AdaptiveParams& adaptiveParams, const MonteCarloParams& mcParams, const ControlVariate& control) -> AdaptiveEstimate
+			{
+				return _monteCarlo(payoff, modelParams, marketParams, adaptiveParams, mcParams, control);
 			}
 		}
 
@@ -723,6 +1101,353 @@ namespace Options
 		std::cout << "The value of the call option is " << Options::Pricing::BinomialOneStep::call(riskFreeRate, upTick, strike, spot);
 	}
 
+	void varianceReductionUnitTest()
+	{
+		// deep out of the money BSM call, every technique on its own with the same number of samples
+		double riskFreeReturn{ 0.03 };
+		double dividendYield{ 0.01 };
+		double maturity{ 1.0 };
+		double spot{ 100.0 };
+		double strike{ 160.0 };
+		double vol{ 0.2 };
+		auto payoff{ [&](double value) { return Options::Payoffs::call(strike, value); } };
+
+		std::cout << "\n===Testing variance reduction===\n";
+		std::cout << "BSM call price with pricing formula is " << Options::Pricing::BSM::call(riskFreeReturn, vol, maturity, strike, spot, dividendYield) << "\n";
+		MonteCarloParams plain{};
+		plain.seed = 42;
+		MonteCarloParams antithetic{ plain };
+		antithetic.antithetic = true;
+		MonteCarloParams momentMatching{ plain };
+		momentMatching.momentMatching = true;
+		MonteCarloParams importance{ plain };
+		importance.importanceShift = Options::Pricing::Utils::importanceShift(riskFreeReturn, vol, maturity, strike, spot, dividendYield);
+		for (const auto& [name, mcParams] : { std::pair{ "plain", plain }, std::pair{ "antithetic", antithetic }, std::pair{ "moment matching", momentMatching }, std::pair{ "importance sampling", importance } })
+		{
+			Estimate price{ Options::Pricing::BSM::monteCarlo(payoff, riskFreeReturn, vol, maturity, spot, dividendYield, mcParams) };
+			std::cout << "Call price with MC and " << name << " is " << price.value << " +- " << price.standardError << "\n";
+		}
+
+		// at the money Heston call with a BSM call at the initial volatility as control
+		strike = 100.0;
+		double initialVariance{ 0.04 };
+		double longVariance{ 0.04 };
+		double correlation{ -0.7 };
+		double reversionRate{ 1.5 };
+		double volVol{ 0.3 };
+		MonteCarloParams heston{ plain };
+		heston.samples = 20000;
+		heston.timePoints = 100;
+		std::cout << "Heston call price with FFT is " << Options::Pricing::Heston::fft(strike, riskFreeReturn, maturity, spot, dividendYield, initialVariance, longVariance, correlation, reversionRate, volVol) << "\n";
+		Estimate plainPrice{ Options::Pricing::Heston::monteCarlo(payoff, riskFreeReturn, maturity, spot, dividendYield, initialVariance, longVariance, correlation, reversionRate, volVol, heston) };
+		std::cout << "Heston call price with MC is " << plainPrice.value << " +- " << plainPrice.standardError << "\n";
+		Estimate controlPrice{ Options::Pricing::Heston::monteCarlo(payoff, riskFreeReturn, maturity, spot, dividendYield, initialVariance, longVariance, correlation, reversionRate, volVol, heston, { strike, std::sqrt(initialVariance) }) };
+		std::cout << "Heston call price with MC and control variate is " << controlPrice.value << " +- " << controlPrice.standardError << "\n";
+	}
+
+	void adaptiveMonteCarloUnitTest()
+	{
+		// contracts of very different payoff variance priced to the same relative precision
+		MarketParams marketParams{};
+		BSMParams bsmParams{ 0.2 };
+		Options::Pricing::AdaptiveParams adaptiveParams{};
+		adaptiveParams.relativeError = 1e-3;
+		adaptiveParams.timeBudget = 10.0;
+		MonteCarloParams mcParams{};
+		mcParams.samples = 20000;
+		mcParams.seed = 42;
+
+		std::cout << "\n===Testing adaptive Monte Carlo===\n";
+		for (double strike : { 60.0, 100.0, 140.0 })
+		{
+			auto payoff{ [=](double value) { return Options::Payoffs::call(strike, value); } };
+			double truePrice{ Options::Pricing::BSM::call(marketParams.riskFreeReturn, bsmParams.vol, marketParams.maturity, strike, marketParams.spot, marketParams.dividendYield) };
+			auto price{ Options::Pricing::Adaptive::monteCarlo(payoff, bsmParams, marketParams, adaptiveParams, mcParams) };
+			std::cout << "BSM call with strike " << strike << ": " << price.value << " +- " << price.standardError << ", 95% interval [" << price.lower << ", " << price.upper
+				<< "] from " << price.samples << " samples (analytic " << truePrice << ")\n";
+		}
+
+		// a time budget caps the work when the target cannot be reached
+		adaptiveParams.relativeError = 1e-6;
+		adaptiveParams.timeBudget = 0.5;
+		auto payoff{ [](double value) { return Options::Payoffs::call(100.0, value); } };
+		auto price{ Options::Pricing::Adaptive::monteCarlo(payoff, bsmParams, marketParams, adaptiveParams, mcParams) };
+		std::cout << "BSM call with a 0.5 second budget: " << price.value << " +- " << price.standardError << " from " << price.samples << " samples\n";
+
+		// Every payoff of a deep out of the money call is zero (analytic price 2.5e-10). The zero sample variance
+		// must not stop the run after the first batch, it continues up to the sample limit.
+		adaptiveParams.relativeError = 1e-3;
+		adaptiveParams.timeBudget = 10.0;
+		adaptiveParams.maxSamples = 100000;
+		mcParams.samples = 2000;
+		auto deepPayoff{ [](double value) { return Options::Payoffs::call(400.0, value); } };
+		auto deepPrice{ Options::Pricing::Adaptive::monteCarlo(deepPayoff, bsmParams, marketParams, adaptiveParams, mcParams) };
+		std::cout << "BSM call with strike 400: " << deepPrice.value << " +- " << deepPrice.standardError << " from " << deepPrice.samples << " samples (analytic "
+			<< Options::Pricing::BSM::call(marketParams.riskFreeReturn, bsmParams.vol, marketParams.maturity, 400.0, marketParams.spot, marketParams.dividendYield) << ")\n";
+		assert(deepPrice.samples >= adaptiveParams.maxSamples);
+		adaptiveParams.maxSamples = Options::Pricing::AdaptiveParams{}.maxSamples;
+		mcParams.samples = 20000;
+
+		// arithmetic Asian call, simulated until the relative standard error is below one percent
+		adaptiveParams.relativeError = 1e-2;
+		adaptiveParams.timeBudget = 10.0;
+		auto asian{ Options::Pricing::Exotic::Asian::monteCarlo("call", 20, marketParams.riskFreeReturn, marketParams.maturity, 100.0, marketParams.spot, marketParams.dividendYield, bsmParams, adaptiveParams) };
+		std::cout << "Asian call: " << asian.value << " +- " << asian.standardError << ", 95% interval [" << asian.lower << ", " << asian.upper << "] from " << asian.samples << " samples\n";
+	}
+
+	void streamingMonteCarloUnitTest()
+	{
+		MarketParams marketParams{};
+		HestonParams hestonParams{ 1.5, 0.04, 0.3, -0.7, 0.04 };
+		MonteCarloParams mcParams{};
+		mcParams.samples = 200000;
+		mcParams.timePoints = 100;
+		mcParams.seed = 42;
+
+		std::cout << "\n===Testing streaming Monte Carlo===\n";
+		// three strikes from one pass over the simulated spots, none of them is stored
+		auto call90{ [](double value) { return Options::Payoffs::call(90.0, value); } };
+		auto call100{ [](double value) { return Options::Payoffs::call(100.0, value); } };
+		auto put100{ [](double value) { return Options::Payoffs::put(100.0, value); } };
+		Options::Pricing::PayoffAccumulator first{ call90, marketParams, mcParams };
+		Options::Pricing::PayoffAccumulator second{ call100, marketParams, mcParams };
+		Options::Pricing::PayoffAccumulator third{ put100, marketParams, mcParams };
+		Options::Pricing::Streaming::simulate(hestonParams, marketParams, mcParams, first, second, third);
+
+		// the same prices from the stored samples of the same seed
+		WeightedSamples samples{ SDE::monteCarlo(marketParams.spot, marketParams.maturity, marketParams.riskFreeReturn - marketParams.dividendYield, hestonParams, mcParams) };
+		for (const auto& [name, estimate, payoff] : { std::tuple{ "call 90", first.estimate(), std::function<double(double)>{ call90 } },
+			std::tuple{ "call 100", second.estimate(), std::function<double(double)>{ call100 } }, std::tuple{ "put 100", third.estimate(), std::function<double(double)>{ put100 } } })
+		{
+			Estimate stored{ Options::Pricing::Utils::_discountedExpectedPayoff(payoff, samples, marketParams.riskFreeReturn, marketParams.maturity, marketParams.spot, marketParams.dividendYield, mcParams, {}) };
+			std::cout << "Heston " << name << ": streamed " << estimate.value << " +- " << estimate.standardError << ", stored " << stored.value << " +- " << stored.standardError << "\n";
+		}
+		double parity{ second.estimate().value - third.estimate().value };
+		double forward{ marketParams.spot * std::exp(-marketParams.dividendYield * marketParams.maturity) - 100.0 * std::exp(-marketParams.riskFreeReturn * marketParams.maturity) };
+		std::cout << "Put call parity on common samples: " << parity << " vs " << forward << "\n";
+	}
+
+	void chainMonteCarloUnitTest()
+	{
+		// 40 calls and puts plus a few spreads of a Heston chain from a single simulation
+		MarketParams marketParams{};
+		HestonParams hestonParams{ 1.5, 0.04, 0.3, -0.7, 0.04 };
+		MonteCarloParams mcParams{};
+		mcParams.samples = 100000;
+		mcParams.timePoints = 100;
+		mcParams.seed = 42;
+
+		std::vector<Options::Payoffs::Contract> contracts{};
+		for (double strike{ 70.0 }; strike <= 130.0; strike += 3.0)
+		{
+			contracts.push_back({ Options::Payoffs::Type::call, strike });
+			contracts.push_back({ Options::Payoffs::Type::put, strike });
+		}
+		contracts.push_back({ Options::Payoffs::Type::callDebitSpread, 95.0, 105.0 });
+		contracts.push_back({ Options::Payoffs::Type::putCreditSpread, 95.0, 105.0 });
+		contracts.push_back({ Options::Payoffs::Type::strangle, 110.0, 90.0 });
+
+		std::cout << "\n===Testing option chain Monte Carlo===\n";
+		Timer timer{};
+		std::vector<Estimate> prices{ Options::Pricing::Streaming::chain(contracts, hestonParams, marketParams, mcParams) };
+		double chainTime{ timer.elapsed() };
+
+		// a few contracts priced one by one, each with its own simulation
+		std::size_t numSeparate{ 5 };
+		timer.reset();
+		for (std::size_t i{ 0 }; i < numSeparate; ++i)
+		{
+			Options::Pricing::Streaming::monteCarlo(contracts[i], hestonParams, marketParams, mcParams);
+		}
+		double separateTime{ timer.elapsed() };
+
+		for (std::size_t i{ 0 }; i < std::size(contracts); i += 10)
+		{
+			std::cout << "Contract " << i << " with strike " << contracts[i].strike << ": " << prices[i].value << " +- " << prices[i].standardError << "\n";
+		}
+		// call prices of a common sample decrease with the strike, puts increase
+		bool monotone{ true };
+		for (std::size_t i{ 2 }; i + 1 < 2 * 21; i += 2)
+		{
+			monotone = monotone && prices[i].value <= prices[i - 2].value && prices[i + 1].value >= prices[i - 1].value;
+		}
+		std::cout << "Prices monotone in the strike: " << (monotone ? "yes" : "no") << "\n";
+		std::cout << "Chain of " << std::size(contracts) << " contracts in one pass took " << chainTime << " s, " << numSeparate << " contracts separately " << separateTime << " s\n";
+	}
+
+	void greeksMonteCarloUnitTest()
+	{
+		MarketParams marketParams{};
+		marketParams.riskFreeReturn = 0.03;
+		marketParams.dividendYield = 0.01;
+		double strike{ 105.0 };
+		double vol{ 0.2 };
+		auto payoff{ [=](double value) { return Options::Payoffs::call(strike, value); } };
+		MonteCarloParams mcParams{};
+		mcParams.samples = 200000;
+		mcParams.timePoints = 50;
+		mcParams.seed = 42;
+		auto print{ [](std::string_view name, const Options::Pricing::Greeks& greeks)
+			{
+				std::cout << name << ": price " << greeks.price.value << " +- " << greeks.price.standardError << ", delta " << greeks.delta.value << " +- " << greeks.delta.standardError
+					<< ", gamma " << greeks.gamma.value << " +- " << greeks.gamma.standardError << ", vega " << greeks.vega.value << " +- " << greeks.vega.standardError << "\n";
+			} };
+
+		std::cout << "\n===Testing Monte Carlo Greeks===\n";
+		std::cout << "BSM analytic: price " << Options::Pricing::BSM::call(marketParams.riskFreeReturn, vol, marketParams.maturity, strike, marketParams.spot, marketParams.dividendYield)
+			<< ", delta " << Options::Pricing::BSM::callDelta(marketParams.riskFreeReturn, vol, marketParams.maturity, strike, marketParams.spot, marketParams.dividendYield)
+			<< ", gamma " << Options::Pricing::BSM::callGamma(marketParams.riskFreeReturn, vol, marketParams.maturity, strike, marketParams.spot, marketParams.dividendYield)
+			<< ", vega " << Options::Pricing::BSM::callVega(marketParams.riskFreeReturn, vol, marketParams.maturity, strike, marketParams.spot, marketParams.dividendYield) << "\n";
+		print("BSM one pass", Options::Pricing::Streaming::greeks(payoff, BSMParams{ vol }, marketParams, mcParams));
+		print("Bachelier one pass", Options::Pricing::Streaming::greeks(payoff, BachelierParams{ 20.0 }, marketParams, mcParams));
+		print("Merton one pass", Options::Pricing::Streaming::greeks(payoff, MertonJumpParams{ vol, -0.1, 0.1, 0.5 }, marketParams, mcParams));
+		print("CEV", Options::Pricing::Streaming::greeks(payoff, CEVParams{ 2.0, 0.5 }, marketParams, mcParams));
+		print("Variance gamma", Options::Pricing::Streaming::greeks(payoff, VarianceGammaParams{ vol, -0.1, 0.2 }, marketParams, mcParams));
+
+		// Heston against finite differences of the FFT price
+		HestonParams hestonParams{ 1.5, 0.04, 0.3, -0.7, 0.04 };
+		auto fft{ [&](double spot, const HestonParams& params) { return Options::Pricing::Heston::fft(strike, marketParams.riskFreeReturn, marketParams.maturity, spot, marketParams.dividendYield,
+			params.initialVariance, params.longVariance, params.correlation, params.reversionRate, params.volVol); } };
+		double spotBump{ 1.0 };
+		std::cout << "Heston FFT: delta " << (fft(marketParams.spot + spotBump, hestonParams) - fft(marketParams.spot - spotBump, hestonParams)) / (2.0 * spotBump)
+			<< ", gamma " << (fft(marketParams.spot + spotBump, hestonParams) - 2.0 * fft(marketParams.spot, hestonParams) + fft(marketParams.spot - spotBump, hestonParams)) / (spotBump * spotBump) << "\n";
+		print("Heston", Options::Pricing::Streaming::greeks(payoff, hestonParams, marketParams, mcParams));
+
+		// Pathwise sensitivities from one tangent run with 100 full truncation Euler steps. The discretization bias has to stay
+		// inside the statistical error, so the estimates agree with the FFT and do not all miss it on the same side.
+		MonteCarloParams sensitivityParams{ mcParams };
+		sensitivityParams.timePoints = 101;
+		std::vector<Estimate> sensitivities{ Options::Pricing::Streaming::parameterSensitivities(payoff, hestonParams, marketParams, sensitivityParams) };
+		std::array<double HestonParams::*, 5> members{ &HestonParams::reversionRate, &HestonParams::longVariance, &HestonParams::volVol, &HestonParams::correlation, &HestonParams::initialVariance };
+		std::array<std::string_view, 5> names{ "reversion rate", "long variance", "vol of vol", "correlation", "initial variance" };
+		std::size_t above{ 0 };
+		for (std::size_t i{ 0 }; i < std::size(members); ++i)
+		{
+			double bump{ 1e-2 * std::abs(hestonParams.*members[i]) };
+			HestonParams up{ hestonParams };
+			up.*members[i] += bump;
+			HestonParams down{ hestonParams };
+			down.*members[i] -= bump;
+			double reference{ (fft(marketParams.spot, up) - fft(marketParams.spot, down)) / (2.0 * bump) };
+			double deviation{ (sensitivities[i].value - reference) / sensitivities[i].standardError };
+			std::cout << "Heston sensitivity to the " << names[i] << ": " << sensitivities[i].value << " +- " << sensitivities[i].standardError
+				<< " (FFT " << reference << ", " << deviation << " standard errors apart)\n";
+			assert(std::abs(deviation) < 3.0);
+			above += (deviation > 0.0) ? 1 : 0;
+		}
+		assert(above > 0 && above < std::size(members));
+	}
+
+	void batchBSMUnitTest()
+	{
+		// a book of random calls and puts, priced with the batch kernel and with the scalar functions
+		std::size_t numOptions{ 1000000 };
+		Random::Stream stream{ 42, 0 };
+		std::vector<Options::Payoffs::Type> types(numOptions);
+		std::vector<double> strikes(numOptions);
+		std::vector<double> maturities(numOptions);
+		std::vector<double> spots(numOptions);
+		std::vector<double> vols(numOptions);
+		std::vector<double> riskFreeReturns(numOptions);
+		std::vector<double> dividendYields(numOptions);
+		for (std::size_t i{ 0 }; i < numOptions; ++i)
+		{
+			types[i] = i % 2 == 0 ? Options::Payoffs::Type::call : Options::Payoffs::Type::put;
+			strikes[i] = 50.0 + 100.0 * stream.uniform();
+			maturities[i] = 0.01 + 2.0 * stream.uniform();
+			spots[i] = 80.0 + 40.0 * stream.uniform();
+			vols[i] = 0.05 + 0.5 * stream.uniform();
+			riskFreeReturns[i] = 0.05 * stream.uniform();
+			dividendYields[i] = 0.03 * stream.uniform();
+		}
+		Options::Pricing::BSM::BatchOptions options{ types, strikes, maturities, spots, vols, riskFreeReturns, dividendYields };
+
+		std::cout << "\n===Testing batch BSM pricing===\n";
+		Timer timer{};
+		Options::Pricing::BSM::BatchGreeks greeks{ Options::Pricing::BSM::batch(options) };
+		double batchTime{ timer.elapsed() };
+
+		timer.reset();
+		double maxDeviation{ 0.0 };
+		for (std::size_t i{ 0 }; i < numOptions; ++i)
+		{
+			bool call{ types[i] == Options::Payoffs::Type::call };
+			std::array<double, 5> scalar{};
+			if (call)
+			{
+				scalar = { Options::Pricing::BSM::call(riskFreeReturns[i], vols[i], maturities[i], strikes[i], spots[i], dividendYields[i]),
+					Options::Pricing::BSM::callDelta(riskFreeReturns[i], vols[i], maturities[i], strikes[i], spots[i], dividendYields[i]),
+					Options::Pricing::BSM::callGamma(riskFreeReturns[i], vols[i], maturities[i], strikes[i], spots[i], dividendYields[i]),
+					Options::Pricing::BSM::callVega(riskFreeReturns[i], vols[i], maturities[i], strikes[i], spots[i], dividendYields[i]),
+					Options::Pricing::BSM::callTheta(riskFreeReturns[i], vols[i], maturities[i], strikes[i], spots[i], dividendYields[i]) };
+			}
+			else
+			{
+				scalar = { Options::Pricing::BSM::put(riskFreeReturns[i], vols[i], maturities[i], strikes[i], spots[i], dividendYields[i]),
+					Options::Pricing::BSM::putDelta(riskFreeReturns[i], vols[i], maturities[i], strikes[i], spots[i], dividendYields[i]),
+					Options::Pricing::BSM::putGamma(riskFreeReturns[i], vols[i], maturities[i], strikes[i], spots[i], dividendYields[i]),
+					Options::Pricing::BSM::putVega(riskFreeReturns[i], vols[i], maturities[i], strikes[i], spots[i], dividendYields[i]),
+					Options::Pricing::BSM::putTheta(riskFreeReturns[i], vols[i], maturities[i], strikes[i], spots[i], dividendYields[i]) };
+			}
+			std::array<double, 5> batched{ greeks.price[i], greeks.delta[i], greeks.gamma[i], greeks.vega[i], greeks.theta[i] };
+			for (std::size_t k{ 0 }; k < std::size(scalar); ++k)
+			{
+				maxDeviation = std::max(maxDeviation, std::abs(scalar[k] - batched[k]));
+			}
+		}
+		double scalarTime{ timer.elapsed() };
+		std::cout << "Maximal deviation from the scalar functions: " << maxDeviation << "\n";
+		std::cout << numOptions << " options with all Greeks took " << batchTime << " s in one batch, " << scalarTime << " s with the scalar functions\n";
+
+		// rho, vanna and volga against central differences of the batch itself
+		std::size_t index{ 1 };
+		double bump{ 1e-4 };
+		auto priceAt{ [&](double riskFreeReturn, double spot, double vol)
+			{
+				return types[index] == Options::Payoffs::Type::call ? Options::Pricing::BSM::call(riskFreeReturn, vol, maturities[index], strikes[index], spot, dividendYields[index])
+					: Options::Pricing::BSM::put(riskFreeReturn, vol, maturities[index], strikes[index], spot, dividendYields[index]);
+			} };
+		double r{ riskFreeReturns[index] };
+		double S{ spots[index] };
+		double v{ vols[index] };
+		std::cout << "Rho " << greeks.rho[index] << " (finite difference " << (priceAt(r + bump, S, v) - priceAt(r - bump, S, v)) / (2.0 * bump) << ")\n";
+		std::cout << "Vanna " << greeks.vanna[index] << " (finite difference "
+			<< (priceAt(r, S + bump * S, v + bump) - priceAt(r, S + bump * S, v - bump) - priceAt(r, S - bump * S, v + bump) + priceAt(r, S - bump * S, v - bump)) / (4.0 * bump * bump * S) << ")\n";
+		std::cout << "Volga " << greeks.volga[index] << " (finite difference " << (priceAt(r, S, v + bump) - 2.0 * priceAt(r, S, v) + priceAt(r, S, v - bump)) / (bump * bump) << ")\n";
+	}
+
+	void dualNumberUnitTest()
+	{
+		// one pass over the price formulas with dual numbers seeded in all six inputs gives the first order Greeks
+		using Dual = AD::Dual<6>;
+		double riskFreeReturn{ 0.03 };
+		double vol{ 0.25 };
+		double maturity{ 0.75 };
+		double strike{ 105.0 };
+		double spot{ 100.0 };
+		double dividendYield{ 0.01 };
+		Dual price{ Options::Pricing::BSM::call(Dual::variable(riskFreeReturn, 0), Dual::variable(vol, 1), Dual::variable(maturity, 2),
+			Dual::variable(strike, 3), Dual::variable(spot, 4), Dual::variable(dividendYield, 5)) };
+
+		std::cout << "\n===Testing dual number Greeks===\n";
+		std::cout << "BSM call price " << price.value << " (formula " << Options::Pricing::BSM::call(riskFreeReturn, vol, maturity, strike, spot, dividendYield) << ")\n";
+		std::cout << "Delta " << price.gradient[4] << " (formula " << Options::Pricing::BSM::callDelta(riskFreeReturn, vol, maturity, strike, spot, dividendYield) << ")\n";
+		std::cout << "Vega " << price.gradient[1] << " (formula " << Options::Pricing::BSM::callVega(riskFreeReturn, vol, maturity, strike, spot, dividendYield) << ")\n";
+		std::cout << "Theta " << -price.gradient[2] << " (formula " << Options::Pricing::BSM::callTheta(riskFreeReturn, vol, maturity, strike, spot, dividendYield) << ")\n";
+		std::cout << "Strike derivative " << price.gradient[3] << " (formula " << Options::Pricing::BSM::callStrikeDerivative(riskFreeReturn, vol, maturity, strike, spot, dividendYield) << ")\n";
+		double bump{ 1e-5 };
+		std::cout << "Rho " << price.gradient[0] << " (finite difference " << (Options::Pricing::BSM::call(riskFreeReturn + bump, vol, maturity, strike, spot, dividendYield)
+			- Options::Pricing::BSM::call(riskFreeReturn - bump, vol, maturity, strike, spot, dividendYield)) / (2.0 * bump) << ")\n";
+
+		// the normal model quotes volatility in price units
+		double normalVol{ 20.0 };
+		Dual bachelierPrice{ Options::Pricing::Bachelier::call(Dual{ riskFreeReturn }, Dual::variable(normalVol, 1), Dual{ maturity }, Dual{ strike }, Dual::variable(spot, 4), Dual{ dividendYield }) };
+		std::cout << "Bachelier call price " << bachelierPrice.value << " (formula " << Options::Pricing::Bachelier::call(riskFreeReturn, normalVol, maturity, strike, spot, dividendYield) << ")\n";
+		std::cout << "Bachelier vega " << bachelierPrice.gradient[1] << " (formula " << Options::Pricing::Bachelier::callVega(riskFreeReturn, normalVol, maturity, strike, spot, dividendYield) << ")\n";
+		std::cout << "Bachelier delta " << bachelierPrice.gradient[4] << " (finite difference " << (Options::Pricing::Bachelier::call(riskFreeReturn, normalVol, maturity, strike, spot + bump, dividendYield)
+			- Options::Pricing::Bachelier::call(riskFreeReturn, normalVol, maturity, strike, spot - bump, dividendYield)) / (2.0 * bump) << ")\n";
+	}
+
 	void strangleUnitTest()
 	{
 		std::cout << "You hold a strangle (a call and a put at different strikes) for AAPL.\n" << "Please enter the strike price of your call : ";
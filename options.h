@@ -8,7 +8,17 @@
 #include "xyvals.h"
 #include "numpy.h"
 #include "fft.h"
+#include "cos.h"
+#include "dual.h"
+#include "Timer.h"
 #include <functional>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <span>
+#include <array>
+#include <type_traits>
 #include <string_view>
 
 namespace Options
@@ -36,10 +46,52 @@ namespace Options
 		auto callCreditSpread(double lower, double higher, double spotPrice) -> double;
 		auto putDebitSpread(double lower, double higher, double spotPrice) -> double;
 		auto putCreditSpread(double lower, double higher, double spotPrice) -> double;
+
+		// A single contract of an option chain. secondStrike is the put strike of a strangle and the higher strike
+		// of a spread, the other types ignore it.
+		struct Contract
+		{
+			Type type{ Type::call };
+			double strike{ 100.0 };
+			double secondStrike{ 0.0 };
+
+			auto operator()(double spotPrice) const -> double;
+		};
 	}
 
 	namespace Pricing
 	{
+		// Control variate for the Monte Carlo pricers: a BSM call on a shadow path driven by the Brownian motion behind the
+		// first normal of every time step, whose analytic price is the known mean. A vol of zero switches it off.
+		struct ControlVariate
+		{
+			double strike{ 0.0 };
+			double vol{ 0.0 };
+		};
+
+		// Stopping rule of the adaptive Monte Carlo pricers. Batches are simulated until the standard error is at most
+		// the larger of the two targets, the time budget is used up or maxSamples paths have been simulated.
+		// The target only counts after minBatches batches and with a nonzero standard error: a deep out of the money
+		// payoff can be zero on every path of a batch, which says nothing about the precision of the estimate.
+		struct AdaptiveParams
+		{
+			double absoluteError{ 0.0 };
+			double relativeError{ 1e-3 };
+			double timeBudget{ 1.0 }; // seconds, checked after every batch
+			std::size_t maxSamples{ 10000000 };
+			std::size_t minBatches{ 4 };
+			double confidenceLevel{ 0.95 };
+		};
+
+		struct AdaptiveEstimate
+		{
+			double value{ 0.0 };
+			double standardError{ 0.0 };
+			double lower{ 0.0 }; // confidence interval at the requested level
+			double upper{ 0.0 };
+			std::size_t samples{ 0 };
+		};
+
 		namespace BinomialOneStep
 		{
 			auto call(double riskFreeRate, double upTick, double strike, double spot, double dividendYield=0.) -> double;
@@ -55,6 +107,29 @@ namespace Options
 			auto call(double riskFreeReturn, double vol, double maturity, double strike, double spot, double dividendYield=0.) -> double;
 			auto put(double riskFreeReturn, double vol, double maturity, double strike, double spot, double dividendYield=0.) -> double;
 
+			// The price formulas for any scalar type, the double versions above call them. With AD::Dual<N> they give the price
+			// together with its derivatives by whatever the inputs are seeded with, e.g. all six Greeks of first order at once with AD::Dual<6>.
+			template <typename T>
+			auto call(const T& riskFreeReturn, const T& vol, const T& maturity, const T& strike, const T& spot, const T& dividendYield = T{ 0. }) -> T
+			{
+				using std::exp, std::log, std::sqrt;
+				T d1{ (log(spot / strike) + (riskFreeReturn - dividendYield + vol * vol / 2.) * maturity) / vol / sqrt(maturity) };
+				T d2{ d1 - vol * sqrt(maturity) };
+				return spot * exp(-dividendYield * maturity) * Distributions::CDFs::standardNormal(d1)
+					- strike * exp(-riskFreeReturn * maturity) * Distributions::CDFs::standardNormal(d2);
+			}
+
+			// priced directly rather than by put-call parity, which cancels all digits of deep out of the money puts
+			template <typename T>
+			auto put(const T& riskFreeReturn, const T& vol, const T& maturity, const T& strike, const T& spot, const T& dividendYield = T{ 0. }) -> T
+			{
+				using std::exp, std::log, std::sqrt;
+				T d1{ (log(spot / strike) + (riskFreeReturn - dividendYield + vol * vol / 2.) * maturity) / vol / sqrt(maturity) };
+				T d2{ d1 - vol * sqrt(maturity) };
+				return strike * exp(-riskFreeReturn * maturity) * Distributions::CDFs::standardNormal(-d2)
+					- spot * exp(-dividendYield * maturity) * Distributions::CDFs::standardNormal(-d1);
+			}
+
 			auto callDelta(double riskFreeReturn, double vol, double maturity, double strike, double spot, double dividendYield) -> double;
 			auto putDelta(double riskFreeReturn, double vol, double maturity, double strike, double spot, double dividendYield) -> double;
 
@@ -71,7 +146,39 @@ namespace Options
 			auto callStrikeDerivativeApprox(double riskFreeReturn, double vol, double maturity, double strike, double spot, double dividendYield) -> double;
 			auto callStrikeSpotDerivativeApprox(double riskFreeReturn, double vol, double maturity, double strike, double spot, double dividendYield) -> double;
 
+			// Vanilla calls and puts as a structure of arrays, entry i of every span belongs to option i.
+			// Only Payoffs::Type::call and Payoffs::Type::put are supported.
+			struct BatchOptions
+			{
+				std::span<const Payoffs::Type> types;
+				std::span<const double> strikes;
+				std::span<const double> maturities;
+				std::span<const double> spots;
+				std::span<const double> vols;
+				std::span<const double> riskFreeReturns;
+				std::span<const double> dividendYields;
+			};
+
+			// price and sensitivities of a batch, one entry per option
+			struct BatchGreeks
+			{
+				std::vector<double> price;
+				std::vector<double> delta;
+				std::vector<double> gamma;
+				std::vector<double> vega;
+				std::vector<double> theta;
+				std::vector<double> rho;
+				std::vector<double> vanna;
+				std::vector<double> volga;
+			};
+
+			// Prices and Greeks of all options in one pass, d1, d2, the discount factors and the normal CDF and PDF values
+			// are computed once per option and shared. out is resized to the batch, its memory is reused between calls.
+			void batch(const BatchOptions& options, BatchGreeks& out);
+			auto batch(const BatchOptions& options) -> BatchGreeks;
+
 			auto monteCarlo(const std::function<double(double)>& payoff, double riskFreeReturn, double vol, double maturity, double spot, double dividendYield) -> double;
+			auto monteCarlo(const std::function<double(double)>& payoff, double riskFreeReturn, double vol, double maturity, double spot, double dividendYield, const MonteCarloParams& mcParams, const ControlVariate& control = {}) -> Estimate;
 			void testMonteCarlo();
 
 			namespace DataGeneration
@@ -88,10 +195,30 @@ namespace Options
 			auto call(double riskFreeReturn, double vol, double maturity, double strike, double spot, double dividendYield = 0.) -> double;
 			auto put(double riskFreeReturn, double vol, double maturity, double strike, double spot, double dividendYield = 0.) -> double;
 
+			// the price formulas for any scalar type, see BSM::call
+			template <typename T>
+			auto call(const T& riskFreeReturn, const T& vol, const T& maturity, const T& strike, const T& spot, const T& dividendYield = T{ 0. }) -> T
+			{
+				using std::exp, std::sqrt;
+				T dplus{ (spot * exp((riskFreeReturn - dividendYield) * maturity) - strike) / vol / sqrt(maturity) };
+				return exp(-(riskFreeReturn - dividendYield) * maturity) * vol * sqrt(maturity) *
+					(dplus * Distributions::CDFs::standardNormal(dplus) + Distributions::PDFs::standardNormal(dplus));
+			}
+
+			template <typename T>
+			auto put(const T& riskFreeReturn, const T& vol, const T& maturity, const T& strike, const T& spot, const T& dividendYield = T{ 0. }) -> T
+			{
+				using std::exp, std::sqrt;
+				T dminus{ -(spot * exp((riskFreeReturn - dividendYield) * maturity) - strike) / vol / sqrt(maturity) };
+				return exp(-riskFreeReturn * maturity) * vol * sqrt(maturity) *
+					(dminus * Distributions::CDFs::standardNormal(dminus) + Distributions::PDFs::standardNormal(dminus));
+			}
+
 			auto callVega(double riskFreeReturn, double vol, double maturity, double strike, double spot, double dividendYield) -> double;
 			auto putVega(double riskFreeReturn, double vol, double maturity, double strike, double spot, double dividendYield) -> double;
 
 			auto monteCarlo(const std::function<double(double)>& payoff, double riskFreeReturn, double vol, double maturity, double spot, double dividendYield) -> double;
+			auto monteCarlo(const std::function<double(double)>& payoff, double riskFreeReturn, double vol, double maturity, double spot, double dividendYield, const MonteCarloParams& mcParams, const ControlVariate& control = {}) -> Estimate;
 			void testMonteCarlo();
 		}
 
@@ -102,6 +229,7 @@ namespace Options
 			auto call(double riskFreeReturn, double vol, double maturity, double strike, double spot, double dividendYield, double exponent) -> double;
 			auto put(double riskFreeReturn, double vol, double maturity, double strike, double spot, double dividendYield, double exponent) -> double;
 			auto monteCarlo(const std::function<double(double)>& payoff, double riskFreeReturn, double vol, double maturity, double spot, double dividendYield, double exponent) -> double;
+			auto monteCarlo(const std::function<double(double)>& payoff, double riskFreeReturn, double vol, double maturity, double spot, double dividendYield, double exponent, const MonteCarloParams& mcParams, const ControlVariate& control = {}) -> Estimate;
 			void test();
 			void testMonteCarlo();
 		}
@@ -109,27 +237,455 @@ namespace Options
 		namespace MertonJump
 		{
 			auto monteCarlo(const std::function<double(double)>& payoff, double riskFreeReturn, double maturity, double spot, double dividendYield, double volatility, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear) -> double;
+			auto monteCarlo(const std::function<double(double)>& payoff, double riskFreeReturn, double maturity, double spot, double dividendYield, double volatility, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear, const MonteCarloParams& mcParams, const ControlVariate& control = {}) -> Estimate;
 			auto fft(double strike, double riskFreeReturn, double maturity, double spot, double dividendYield, double volatility, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear, std::string_view type = "call") -> double;
+			auto cos(double strike, double riskFreeReturn, double maturity, double spot, double dividendYield, double volatility, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear, std::string_view type = "call") -> double;
 			void testPricing();
 		}
 
 		namespace Heston
 		{
 			auto monteCarlo(const std::function<double(double)>& payoff, double riskFreeReturn, double maturity, double spot, double dividendYield, double initialVariance, double longVariance, double correlation, double reversionRate, double volVol) -> double;
+			auto monteCarlo(const std::function<double(double)>& payoff, double riskFreeReturn, double maturity, double spot, double dividendYield, double initialVariance, double longVariance, double correlation, double reversionRate, double volVol, const MonteCarloParams& mcParams, const ControlVariate& control = {}) -> Estimate;
 			auto fft(double strike, double riskFreeReturn, double maturity, double spot, double dividendYield, double initialVariance, double longVariance, double correlation, double reversionRate, double volVol, std::string_view type = "call") -> double;
+			auto cos(double strike, double riskFreeReturn, double maturity, double spot, double dividendYield, double initialVariance, double longVariance, double correlation, double reversionRate, double volVol, std::string_view type = "call") -> double;
 			void testPricing();
 		}
 
 		namespace VarianceGamma
 		{
 			auto monteCarlo(const std::function<double(double)>& payoff, double riskFreeReturn, double maturity, double spot, double dividendYield,double gammaDrift, double variance, double vol) -> double;
+			auto monteCarlo(const std::function<double(double)>& payoff, double riskFreeReturn, double maturity, double spot, double dividendYield, double gammaDrift, double variance, double vol, const MonteCarloParams& mcParams, const ControlVariate& control = {}) -> Estimate;
 			auto fft(double strike, double riskFreeReturn, double maturity, double spot, double dividendYield, double gammaDrift, double variance, double vol, std::string_view type = "call") -> double;
+			auto cos(double strike, double riskFreeReturn, double maturity, double spot, double dividendYield, double gammaDrift, double variance, double vol, std::string_view type = "call") -> double;
 			void testPricing();
 		}
 
 		namespace Utils
 		{
-			auto _discountedExpectedPayoff(const std::function<double(double)>& payoff, std::vector<double> predictedSpots, double riskFreeReturn, double maturity) -> double;
+			auto _discountedExpectedPayoff(const std::function<double(double)>& payoff, const std::vector<double>& predictedSpots, double riskFreeReturn, double maturity) -> double;
+			// price and standard error from weighted samples, with the control variate and antithetic pairs taken into account
+			auto _discountedExpectedPayoff(const std::function<double(double)>& payoff, const WeightedSamples& samples, double riskFreeReturn, double maturity, double spot, double dividendYield, const MonteCarloParams& mcParams, const ControlVariate& control) -> Estimate;
+			// importance shift which moves the median terminal BSM spot onto the strike, for deep out of the money options
+			auto importanceShift(double riskFreeReturn, double vol, double maturity, double strike, double spot, double dividendYield) -> double;
+			// discounted payoffs of weighted samples as independent observations: single samples, averages of antithetic
+			// pairs or, with Sobol points, the means of the scrambled replicates
+			auto _discountedPayoffObservations(const std::function<double(double)>& payoff, const WeightedSamples& samples, double riskFreeReturn, double maturity, double spot, double dividendYield, const MonteCarloParams& mcParams, const ControlVariate& control) -> std::vector<double>;
+
+			// Calls batchFunc(batch, statistics) for batch = 0, 1, ... until the stopping rule holds. batchFunc adds the
+			// observations of one batch to statistics and returns the number of paths it simulated.
+			template <typename BatchFunc>
+			auto adaptive(const AdaptiveParams& params, const BatchFunc& batchFunc) -> AdaptiveEstimate
+			{
+				Timer timer{};
+				RunningStatistics statistics{};
+				std::size_t samples{ 0 };
+				for (std::size_t batch{ 0 }; samples < params.maxSamples; ++batch)
+				{
+					samples += batchFunc(batch, statistics);
+					double target{ std::max(params.absoluteError, params.relativeError * std::abs(statistics.m_mean)) };
+					double standardError{ statistics.standardError() };
+					bool converged{ batch + 1 >= params.minBatches && standardError > 0.0 && standardError <= target };
+					if (converged || timer.elapsed() >= params.timeBudget)
+					{
+						break;
+					}
+				}
+				double quantile{ Distributions::InverseCDFs::standardNormal(0.5 + 0.5 * params.confidenceLevel) };
+				double halfWidth{ quantile * statistics.standardError() };
+				return { statistics.m_mean, statistics.standardError(), statistics.m_mean - halfWidth, statistics.m_mean + halfWidth, samples };
+			}
+		}
+
+		// Running moments behind a streamed price: (discounted payoff, control) per path for the control variate
+		// coefficient and per independent observation for the standard error. Independent observations are single
+		// paths, antithetic pairs or, with Sobol points, whole replicates (one entry of m_replicates each).
+		struct PayoffMoments
+		{
+			CovarianceStatistics m_paths;
+			CovarianceStatistics m_observations;
+			std::vector<CovarianceStatistics> m_replicates;
+
+			void merge(const PayoffMoments& other);
+			auto estimate(double controlPrice) const -> Estimate;
+		};
+
+		// Price of one payoff fed with the sample batches of a Monte Carlo run, see Streaming::simulate.
+		// Payoff is any callable double(double), so the loop over a batch is compiled for the concrete payoff.
+		template <typename Payoff>
+		class PayoffAccumulator
+		{
+		public:
+			PayoffAccumulator(Payoff payoff, const MarketParams& marketParams, const MonteCarloParams& mcParams, const ControlVariate& control = {})
+				: m_payoff{ std::move(payoff) }
+				, m_discount{ std::exp(-marketParams.riskFreeReturn * marketParams.maturity) }
+				, m_pairs{ mcParams.antithetic && mcParams.sampling != "sobol" }
+				, m_sobol{ mcParams.sampling == "sobol" }
+				, m_control{ control }
+				, m_spot{ marketParams.spot }
+				, m_controlDrift{ (marketParams.riskFreeReturn - marketParams.dividendYield - 0.5 * control.vol * control.vol) * marketParams.maturity }
+				, m_controlDiffusion{ control.vol * std::sqrt(marketParams.maturity) }
+				, m_controlPrice{ (control.vol > 0.0) ? BSM::call(marketParams.riskFreeReturn, control.vol, marketParams.maturity, control.strike, marketParams.spot, marketParams.dividendYield) : 0.0 }
+			{}
+
+			// moments of a single batch, safe to call from several threads at once
+			auto moments(const SampleBatch& batch) const -> PayoffMoments
+			{
+				PayoffMoments moments{};
+				if (m_sobol)
+				{
+					moments.m_replicates.resize(batch.m_replicate + 1);
+				}
+				CovarianceStatistics& observations{ m_sobol ? moments.m_replicates.back() : moments.m_observations };
+				std::size_t lanes{ std::size(batch.m_states) };
+				std::size_t step{ m_pairs ? std::size_t{ 2 } : std::size_t{ 1 } };
+				for (std::size_t j{ 0 }; j < lanes; j += step)
+				{
+					std::size_t last{ std::min(j + step, lanes) };
+					double valueSum{ 0.0 };
+					double controlSum{ 0.0 };
+					for (std::size_t k{ j }; k < last; ++k)
+					{
+						double value{ m_discount * batch.m_weights[k] * m_payoff(batch.m_states[k]) };
+						double control{ controlValue(batch.m_brownian[k], batch.m_weights[k]) };
+						moments.m_paths.add(value, control);
+						valueSum += value;
+						controlSum += control;
+					}
+					observations.add(valueSum / static_cast<double>(last - j), controlSum / static_cast<double>(last - j));
+				}
+				return moments;
+			}
+
+			void merge(const PayoffMoments& moments) { m_moments.merge(moments); }
+			auto estimate() const -> Estimate { return m_moments.estimate(m_controlPrice); }
+
+		private:
+			// the BSM call on the shadow path of the control variate
+			auto controlValue(double brownian, double weight) const -> double
+			{
+				if (m_control.vol <= 0.0) { return 0.0; }
+				return m_discount * weight * Payoffs::call(m_control.strike, m_spot * std::exp(m_controlDrift + m_controlDiffusion * brownian));
+			}
+
+			Payoff m_payoff;
+			double m_discount{ 1.0 };
+			bool m_pairs{ false };
+			bool m_sobol{ false };
+			ControlVariate m_control{};
+			double m_spot{ 0.0 };
+			double m_controlDrift{ 0.0 };
+			double m_controlDiffusion{ 0.0 };
+			double m_controlPrice{ 0.0 };
+			PayoffMoments m_moments{};
+		};
+
+		// Prices of a whole option chain from the same sample batches, one accumulator per contract
+		class ChainAccumulator
+		{
+		public:
+			ChainAccumulator(std::span<const Payoffs::Contract> contracts, const MarketParams& marketParams, const MonteCarloParams& mcParams, const ControlVariate& control = {});
+
+			auto moments(const SampleBatch& batch) const -> std::vector<PayoffMoments>;
+			void merge(const std::vector<PayoffMoments>& moments);
+			auto estimates() const -> std::vector<Estimate>;
+
+		private:
+			std::vector<PayoffAccumulator<Payoffs::Contract>> m_accumulators;
+		};
+
+		struct Greeks
+		{
+			Estimate price{};
+			Estimate delta{};
+			Estimate gamma{};
+			Estimate vega{}; // by the vol parameter, for Heston by the initial vol sqrt(initialVariance)
+		};
+
+		namespace Utils
+		{
+			// model parameters in the order of their declaration
+			template <typename ModelParams>
+			constexpr auto _parameterMembers()
+			{
+				if constexpr (std::is_same_v<ModelParams, BSMParams>) { return std::array{ &BSMParams::vol }; }
+				else if constexpr (std::is_same_v<ModelParams, BachelierParams>) { return std::array{ &BachelierParams::vol }; }
+				else if constexpr (std::is_same_v<ModelParams, CEVParams>) { return std::array{ &CEVParams::vol, &CEVParams::exponent }; }
+				else if constexpr (std::is_same_v<ModelParams, MertonJumpParams>) { return std::array{ &MertonJumpParams::vol, &MertonJumpParams::meanJumpSize, &MertonJumpParams::stdJumpSize, &MertonJumpParams::expectedJumpsPerYear }; }
+				else if constexpr (std::is_same_v<ModelParams, HestonParams>) { return std::array{ &HestonParams::reversionRate, &HestonParams::longVariance, &HestonParams::volVol, &HestonParams::correlation, &HestonParams::initialVariance }; }
+				else { return std::array{ &VarianceGammaParams::vol, &VarianceGammaParams::drift, &VarianceGammaParams::variance }; }
+			}
+		}
+
+		// Price, Greeks and parameter sensitivities of one payoff from the sample batches of a single tangent run
+		// (SDE::monteCarloTangents). Every path carries the derivatives of its terminal state by the spot and the model
+		// parameters, so each sensitivity is the payoff slope at the terminal state times that derivative (pathwise),
+		// plus the payoff times the likelihood ratio score for the jump intensity of Merton. The payoff slope is a
+		// central difference over deltaBump times the spot, which smooths kinks and jumps of the payoff. With a lognormal
+		// diffusion gamma is the pathwise delta times the likelihood ratio score of the diffusion normal, otherwise a
+		// second difference along the first and second derivative of the terminal state by the spot. The variance of
+		// variance gamma has no tangent, see Streaming::parameterSensitivities.
+		template <typename Payoff, typename ModelParams>
+		class GreeksAccumulator
+		{
+		public:
+			static constexpr std::size_t numTangents{ SDE::tangentParameters<ModelParams>() };
+			static constexpr bool lognormal{ std::is_same_v<ModelParams, BSMParams> || std::is_same_v<ModelParams, MertonJumpParams> };
+
+			// relative spot bumps of the payoff slope and of the second difference gamma
+			static constexpr double deltaBump{ 1e-4 };
+			static constexpr double gammaBump{ 1e-2 };
+
+			GreeksAccumulator(Payoff payoff, const ModelParams& modelParams, const MarketParams& marketParams, const MonteCarloParams& mcParams)
+				: m_payoff{ std::move(payoff) }
+				, m_discount{ std::exp(-marketParams.riskFreeReturn * marketParams.maturity) }
+				, m_pairs{ mcParams.antithetic && mcParams.sampling != "sobol" }
+				, m_sobol{ mcParams.sampling == "sobol" }
+				, m_spot{ marketParams.spot }
+				, m_maturity{ marketParams.maturity }
+				, m_vol{ volatility(modelParams) }
+				, m_vegaScale{ vegaScale(modelParams) }
+			{}
+
+			// moments of price, delta, gamma, vega and the parameter sensitivities of a single batch,
+			// safe to call from several threads at once
+			auto moments(const SampleBatch& batch) const -> std::array<PayoffMoments, 4 + numTangents>
+			{
+				std::array<PayoffMoments, 4 + numTangents> moments{};
+				for (PayoffMoments& greek : moments)
+				{
+					if (m_sobol) { greek.m_replicates.resize(batch.m_replicate + 1); }
+				}
+				std::size_t lanes{ std::size(batch.m_states) };
+				std::size_t step{ m_pairs ? std::size_t{ 2 } : std::size_t{ 1 } };
+				for (std::size_t j{ 0 }; j < lanes; j += step)
+				{
+					std::size_t last{ std::min(j + step, lanes) };
+					std::array<double, 4 + numTangents> sums{};
+					for (std::size_t k{ j }; k < last; ++k)
+					{
+						std::array<double, 4 + numTangents> values{ pathValues(batch, k) };
+						for (std::size_t g{ 0 }; g < std::size(sums); ++g) { sums[g] += values[g]; }
+					}
+					for (std::size_t g{ 0 }; g < std::size(sums); ++g)
+					{
+						CovarianceStatistics& observations{ m_sobol ? moments[g].m_replicates.back() : moments[g].m_observations };
+						observations.add(sums[g] / static_cast<double>(last - j), 0.0);
+					}
+				}
+				return moments;
+			}
+
+			void merge(const std::array<PayoffMoments, 4 + numTangents>& moments)
+			{
+				for (std::size_t g{ 0 }; g < std::size(moments); ++g) { m_moments[g].merge(moments[g]); }
+			}
+
+			auto greeks() const -> Greeks { return { m_moments[0].estimate(0.0), m_moments[1].estimate(0.0), m_moments[2].estimate(0.0), m_moments[3].estimate(0.0) }; }
+
+			// derivatives of the price by the first numTangents model parameters in the order of their declaration
+			auto sensitivities() const -> std::vector<Estimate>
+			{
+				std::vector<Estimate> estimates{};
+				for (std::size_t p{ 0 }; p < numTangents; ++p) { estimates.push_back(m_moments[4 + p].estimate(0.0)); }
+				return estimates;
+			}
+
+		private:
+			static auto volatility(const ModelParams& modelParams) -> double
+			{
+				if constexpr (has_vol<ModelParams>::value) { return modelParams.vol; }
+				else { return 0.0; }
+			}
+
+			// vega is the sensitivity to the vol, declared first, or for Heston 2 sqrt(initialVariance) times the last one
+			static auto vegaScale(const ModelParams& modelParams) -> double
+			{
+				if constexpr (std::is_same_v<ModelParams, HestonParams>) { return 2.0 * std::sqrt(modelParams.initialVariance); }
+				else { return 1.0; }
+			}
+
+			auto pathValues(const SampleBatch& batch, std::size_t lane) const -> std::array<double, 4 + numTangents>
+			{
+				std::size_t lanes{ std::size(batch.m_states) };
+				auto tangent{ [&](std::size_t row) { return batch.m_tangents[row * lanes + lane]; } };
+				double state{ batch.m_states[lane] };
+				double scale{ m_discount * batch.m_weights[lane] };
+				double value{ m_payoff(state) };
+				double bump{ deltaBump * m_spot };
+				double slope{ (m_payoff(state + bump) - m_payoff(state - bump)) / (2.0 * bump) };
+
+				std::array<double, 4 + numTangents> values{};
+				values[0] = scale * value;
+				values[1] = scale * slope * tangent(0);
+				if constexpr (lognormal)
+				{
+					values[2] = values[1] / m_spot * (batch.m_brownian[lane] / (m_vol * std::sqrt(m_maturity)) - 1.0);
+				}
+				else
+				{
+					double spotBump{ gammaBump * m_spot };
+					double curvature{ 0.5 * spotBump * spotBump * tangent(1) };
+					values[2] = scale * (m_payoff(state + spotBump * tangent(0) + curvature) - 2.0 * value + m_payoff(state - spotBump * tangent(0) + curvature)) / (spotBump * spotBump);
+				}
+				for (std::size_t p{ 0 }; p < numTangents; ++p)
+				{
+					double score{ std::empty(batch.m_scores) ? 0.0 : batch.m_scores[p * lanes + lane] };
+					values[4 + p] = scale * (slope * tangent(2 + p) + value * score);
+				}
+				values[3] = m_vegaScale * values[std::is_same_v<ModelParams, HestonParams> ? 3 + numTangents : 4];
+				return values;
+			}
+
+			Payoff m_payoff;
+			double m_discount{ 1.0 };
+			bool m_pairs{ false };
+			bool m_sobol{ false };
+			double m_spot{ 0.0 };
+			double m_maturity{ 0.0 };
+			double m_vol{ 0.0 };
+			double m_vegaScale{ 1.0 };
+			std::array<PayoffMoments, 4 + numTangents> m_moments{};
+		};
+
+		namespace Utils
+		{
+			// Linear combinations of prices from runs with the same seed (common random numbers), one estimate per row
+			// of coefficients. The combinations are taken observation by observation, so their standard errors reflect
+			// the strong correlation between the runs.
+			template <typename ModelParams>
+			auto _commonRandomDifferences(const std::function<double(double)>& payoff, std::span<const std::pair<ModelParams, MarketParams>> runs, const std::vector<std::vector<double>>& coefficients, const MonteCarloParams& mcParams) -> std::vector<Estimate>
+			{
+				std::vector<std::vector<double>> combinations(std::size(coefficients));
+				for (std::size_t i{ 0 }; i < std::size(runs); ++i)
+				{
+					const auto& [modelParams, marketParams] { runs[i] };
+					WeightedSamples samples{ SDE::monteCarlo(marketParams.spot, marketParams.maturity, marketParams.riskFreeReturn - marketParams.dividendYield, modelParams, mcParams) };
+					std::vector<double> observations{ _discountedPayoffObservations(payoff, samples, marketParams.riskFreeReturn, marketParams.maturity, marketParams.spot, marketParams.dividendYield, mcParams, {}) };
+					for (std::size_t c{ 0 }; c < std::size(coefficients); ++c)
+					{
+						combinations[c].resize(std::size(observations));
+						for (std::size_t j{ 0 }; j < std::size(observations); ++j)
+						{
+							combinations[c][j] += coefficients[c][i] * observations[j];
+						}
+					}
+				}
+				std::vector<Estimate> estimates{};
+				for (const std::vector<double>& combination : combinations)
+				{
+					RunningStatistics statistics{};
+					for (double value : combination) { statistics.add(value); }
+					estimates.push_back(statistics.estimate());
+				}
+				return estimates;
+			}
+
+			// Feeds the sample batches that run(sink) hands to sink to every accumulator. Batch moments are merged in path
+			// order, so the results only depend on the seed and not on the scheduling of the threads.
+			template <typename Run, typename... Accumulators>
+			void _streamInOrder(const Run& run, Accumulators&... accumulators)
+			{
+				using Moments = std::tuple<decltype(accumulators.moments(std::declval<const SampleBatch&>()))...>;
+				std::mutex mutex{};
+				std::size_t next{ 0 };
+				std::map<std::size_t, std::pair<std::size_t, Moments>> pending{};
+				run([&](const SampleBatch& batch)
+					{
+						Moments moments{ accumulators.moments(batch)... };
+						std::lock_guard<std::mutex> lock{ mutex };
+						pending.emplace(batch.m_first, std::pair{ std::size(batch.m_states), std::move(moments) });
+						// batches are handed out in path order, so only a few wait here for their predecessors
+						for (auto it{ pending.begin() }; it != pending.end() && it->first == next; it = pending.erase(it))
+						{
+							std::apply([&](const auto&... batchMoments) { (accumulators.merge(batchMoments), ...); }, it->second.second);
+							next += it->second.first;
+						}
+					});
+			}
+		}
+
+		// Monte Carlo pricing without storing the simulated samples. The simulator hands every batch of terminal
+		// states to the accumulators and forgets it, so memory does not grow with the number of samples.
+		namespace Streaming
+		{
+			// One Monte Carlo run of the model feeding every accumulator, merged in path order (see Utils::_streamInOrder)
+			template <typename ModelParams, typename... Accumulators>
+			void simulate(const ModelParams& modelParams, const MarketParams& marketParams, const MonteCarloParams& mcParams, Accumulators&... accumulators)
+			{
+				Utils::_streamInOrder([&](const SampleSink& sink) { SDE::monteCarlo(marketParams.spot, marketParams.maturity, marketParams.riskFreeReturn - marketParams.dividendYield, modelParams, mcParams, sink); }, accumulators...);
+			}
+
+			// One tangent run of the model feeding every accumulator, the batches also carry the pathwise derivatives
+			template <typename ModelParams, typename... Accumulators>
+			void simulateTangents(const ModelParams& modelParams, const MarketParams& marketParams, const MonteCarloParams& mcParams, Accumulators&... accumulators)
+			{
+				Utils::_streamInOrder([&](const SampleSink& sink) { SDE::monteCarloTangents(marketParams.spot, marketParams.maturity, marketParams.riskFreeReturn - marketParams.dividendYield, modelParams, mcParams, sink); }, accumulators...);
+			}
+
+			template <typename Payoff, typename ModelParams>
+			auto monteCarlo(const Payoff& payoff, const ModelParams& modelParams, const MarketParams& marketParams, const MonteCarloParams& mcParams, const ControlVariate& control = {}) -> Estimate
+			{
+				PayoffAccumulator<Payoff> accumulator{ payoff, marketParams, mcParams, control };
+				simulate(modelParams, marketParams, mcParams, accumulator);
+				return accumulator.estimate();
+			}
+
+			// prices of all contracts from one common set of simulated paths, so the whole chain costs a single
+			// simulation and relations between the prices (parity, monotonicity in the strike) hold sample by sample
+			template <typename ModelParams>
+			auto chain(std::span<const Payoffs::Contract> contracts, const ModelParams& modelParams, const MarketParams& marketParams, const MonteCarloParams& mcParams, const ControlVariate& control = {}) -> std::vector<Estimate>
+			{
+				ChainAccumulator accumulator{ contracts, marketParams, mcParams, control };
+				simulate(modelParams, marketParams, mcParams, accumulator);
+				return accumulator.estimates();
+			}
+
+			// price, delta, gamma and vega of every model from a single tangent run, see GreeksAccumulator
+			template <typename Payoff, typename ModelParams>
+			auto greeks(const Payoff& payoff, const ModelParams& modelParams, const MarketParams& marketParams, const MonteCarloParams& mcParams) -> Greeks
+			{
+				GreeksAccumulator<Payoff, ModelParams> accumulator{ payoff, modelParams, marketParams, mcParams };
+				simulateTangents(modelParams, marketParams, mcParams, accumulator);
+				return accumulator.greeks();
+			}
+
+			// Derivatives of the price by every model parameter in the order of their declaration. All parameters with a
+			// tangent come from a single tangent run (see GreeksAccumulator). The variance of variance gamma, which sets the
+			// distribution of the gamma time change, stays on central differences of two runs with the same seed, bumped
+			// by relativeBump times the parameter (or times one for zero).
+			template <typename Payoff, typename ModelParams>
+			auto parameterSensitivities(const Payoff& payoff, const ModelParams& modelParams, const MarketParams& marketParams, const MonteCarloParams& mcParams, double relativeBump = 1e-2) -> std::vector<Estimate>
+			{
+				GreeksAccumulator<Payoff, ModelParams> accumulator{ payoff, modelParams, marketParams, mcParams };
+				simulateTangents(modelParams, marketParams, mcParams, accumulator);
+				std::vector<Estimate> sensitivities{ accumulator.sensitivities() };
+				constexpr auto members{ Utils::_parameterMembers<ModelParams>() };
+				for (std::size_t p{ std::size(sensitivities) }; p < std::size(members); ++p)
+				{
+					auto member{ members[p] };
+					double bump{ relativeBump * ((modelParams.*member != 0.0) ? std::abs(modelParams.*member) : 1.0) };
+					ModelParams up{ modelParams };
+					up.*member += bump;
+					ModelParams down{ modelParams };
+					down.*member -= bump;
+					std::vector<std::pair<ModelParams, MarketParams>> runs{ { up, marketParams }, { down, marketParams } };
+					sensitivities.push_back(Utils::_commonRandomDifferences<ModelParams>(payoff, runs, { { 0.5 / bump, -0.5 / bump } }, mcParams)[0]);
+				}
+				return sensitivities;
+			}
+		}
+
+		// Monte Carlo pricing of European payoffs to a target precision. mcParams.samples is the batch size,
+		// every batch draws from its own seed derived from mcParams.seed, so results are reproducible.
+		namespace Adaptive
+		{
+			auto monteCarlo(const std::function<double(double)>& payoff, const BSMParams& modelParams, const MarketParams& marketParams, const AdaptiveParams& adaptiveParams, const MonteCarloParams& mcParams = {}, const ControlVariate& control = {}) -> AdaptiveEstimate;
+			auto monteCarlo(const std::function<double(double)>& payoff, const BachelierParams& modelParams, const MarketParams& marketParams, const AdaptiveParams& adaptiveParams, const MonteCarloParams& mcParams = {}, const ControlVariate& control = {}) -> AdaptiveEstimate;
+			auto monteCarlo(const std::function<double(double)>& payoff, const CEVParams& modelParams, const MarketParams& marketParams, const AdaptiveParams& adaptiveParams, const MonteCarloParams& mcParams = {}, const ControlVariate& control = {}) -> AdaptiveEstimate;
+			auto monteCarlo(const std::function<double(double)>& payoff, const MertonJumpParams& modelParams, const MarketParams& marketParams, const AdaptiveParams& adaptiveParams, const MonteCarloParams& mcParams = {}, const ControlVariate& control = {}) -> AdaptiveEstimate;
+			auto monteCarlo(const std::function<double(double)>& payoff, const HestonParams& modelParams, const MarketParams& marketParams, const AdaptiveParams& adaptiveParams, const MonteCarloParams& mcParams = {}, const ControlVariate& control = {}) -> AdaptiveEstimate;
+			auto monteCarlo(const std::function<double(double)>& payoff, const VarianceGammaParams& modelParams, const MarketParams& marketParams, const AdaptiveParams& adaptiveParams, const MonteCarloParams& mcParams = {}, const ControlVariate& control = {}) -> AdaptiveEstimate;
 		}
 
 		// Pricing method for asian options
@@ -138,34 +694,36 @@ namespace Options
 			namespace Asian
 			{
 			
+				// average over the last days prices of every simulated path
 				template <typename Params>
-				auto average(std::string_view type, std::size_t days, std::size_t numPaths, double riskFreeReturn, double maturity, double spot, double dividendYield, Params& params) -> double
+				auto pathAverages(std::string_view type, std::size_t days, std::size_t numPaths, double riskFreeReturn, double maturity, double spot, double dividendYield, Params& params) -> std::vector<double>
 				{
 
 					std::size_t timePoints{ static_cast<std::size_t>(maturity * 250) }; // one year has appr. 250 trading days
-					DataTable paths{ SDE::monteCarloPaths(spot, maturity, numPaths, timePoints, riskFreeReturn - dividendYield, params) };
+					PathBlock paths{ SDE::monteCarloPathBlock(spot, maturity, numPaths, timePoints, riskFreeReturn - dividendYield, params) };
 
-					//double sampleAverage{ 0.0 };
-					std::vector<double> pathAverages(numPaths);
-					if (type == "geometric")
-					{
-						for (std::size_t num{ 0 }; num < numPaths; ++num)
-						{
-							auto subVec{ std::vector<double>(paths.m_table[num].rbegin(), paths.m_table[num].rbegin() + static_cast<int>(days)) }; // get last prices
-							//sampleAverage += np::mean(subVec);
-							pathAverages[num] = std::exp(np::mean(np::log(subVec)));
-						}
-					}
-					else // artithmetic average
+					// average over the last prices of each path, read straight from the path block
+					std::size_t averagingPoints{ std::min(days, timePoints) };
+					bool geometric{ type == "geometric" };
+					std::vector<double> averages(numPaths);
+					for (std::size_t num{ 0 }; num < numPaths; ++num)
 					{
-						for (std::size_t num{ 0 }; num < numPaths; ++num)
+						auto path{ paths.path(num) };
+						double sum{ 0.0 };
+						for (std::size_t i{ timePoints - averagingPoints }; i < timePoints; ++i)
 						{
-							auto subVec{ std::vector<double>(paths.m_table[num].rbegin(), paths.m_table[num].rbegin() + static_cast<int>(days)) }; // get last prices
-							//sampleAverage += np::mean(subVec);
-							pathAverages[num] = np::mean(subVec);
+							sum += geometric ? std::log(path[i]) : path[i];
 						}
+						double average{ sum / static_cast<double>(averagingPoints) };
+						averages[num] = geometric ? std::exp(average) : average;
 					}
-					return np::mean(pathAverages);
+					return averages;
+				}
+
+				template <typename Params>
+				auto average(std::string_view type, std::size_t days, std::size_t numPaths, double riskFreeReturn, double maturity, double spot, double dividendYield, Params& params) -> double
+				{
+					return np::mean(pathAverages(type, days, numPaths, riskFreeReturn, maturity, spot, dividendYield, params));
 				}
 
 
@@ -184,6 +742,23 @@ namespace Options
 					double sampleAverage{ average("arithmetic", days, numPaths, riskFreeReturn, maturity, spot, dividendYield, params) };
 					return std::max(strike - sampleAverage, 0.0);
 				}
+
+				// discounted expected payoff of an arithmetic average price call or put, simulated in batches of
+				// batchSize paths until the stopping rule of adaptiveParams holds
+				template <typename Params>
+				auto monteCarlo(std::string_view type, std::size_t days, double riskFreeReturn, double maturity, double strike, double spot, double dividendYield, Params& params, const AdaptiveParams& adaptiveParams, std::size_t batchSize = 10000) -> AdaptiveEstimate
+				{
+					double discount{ std::exp(-riskFreeReturn * maturity) };
+					bool call{ type == "call" };
+					return Utils::adaptive(adaptiveParams, [&](std::size_t, RunningStatistics& statistics)
+					{
+						for (double pathAverage : pathAverages("arithmetic", days, batchSize, riskFreeReturn, maturity, spot, dividendYield, params))
+						{
+							statistics.add(discount * (call ? Payoffs::call(strike, pathAverage) : Payoffs::put(strike, pathAverage)));
+						}
+						return batchSize;
+					});
+				}
 			}
 		}
 
@@ -195,6 +770,13 @@ namespace Options
 	void strangleUnitTest();
 	void callCreditSpreadUnitTest();
 	void binomialPricingUnitTest();
+	void varianceReductionUnitTest();
+	void adaptiveMonteCarloUnitTest();
+	void streamingMonteCarloUnitTest();
+	void chainMonteCarloUnitTest();
+	void greeksMonteCarloUnitTest();
+	void batchBSMUnitTest();
+	void dualNumberUnitTest();
 
 
 
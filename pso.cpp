@@ -1,5 +1,6 @@
 #include "pso.h"
 #include "options.h"
+#include "Timer.h"
 
 
 void PSO::set_uniformRandomPositions(std::vector<double> lowerIntervalBounds, std::vector<double> higherIntervalBounds)
@@ -11,9 +12,15 @@ void PSO::set_uniformRandomPositions(std::vector<double> lowerIntervalBounds, st
         assert(lowerIntervalBounds[i] < higherIntervalBounds[i]);
     }
 
+    // the initial swarm uses its own block of streams after the ones move() draws from, so a seeded run is reproducible
     for (std::size_t i{ 0 }; i < m_swarm.m_numParticles; ++i)
     {
-        m_swarm.m_positions[i] = Random::getVector(lowerIntervalBounds, higherIntervalBounds);
+        Random::Stream stream{ m_seed, m_swarm.m_numParticles + i };
+        std::span<double> position{ m_swarm.position(i) };
+        for (std::size_t d{ 0 }; d < m_swarm.m_dimension; ++d)
+        {
+            position[d] = lowerIntervalBounds[d] + (higherIntervalBounds[d] - lowerIntervalBounds[d]) * stream.uniform();
+        }
     }
 }
 
@@ -28,8 +35,13 @@ void PSO::set_uniformRandomVelocities(std::vector<double> lowerIntervalBounds, s
 
     for (std::size_t i{ 0 }; i < m_swarm.m_numParticles; ++i)
     {
-        m_swarm.m_positions[i] = Random::getVector(np::minus(np::abs(np::add(higherIntervalBounds, lowerIntervalBounds, 1.0, -1.0))),
-            np::abs(np::add(higherIntervalBounds, lowerIntervalBounds, 1.0, -1.0)));
+        Random::Stream stream{ m_seed, 2 * m_swarm.m_numParticles + i };
+        std::span<double> velocity{ m_swarm.velocity(i) };
+        for (std::size_t d{ 0 }; d < m_swarm.m_dimension; ++d)
+        {
+            double range{ std::abs(higherIntervalBounds[d] - lowerIntervalBounds[d]) };
+            velocity[d] = range * (2.0 * stream.uniform() - 1.0);
+        }
     }
 }
 
@@ -40,7 +52,73 @@ void PSO::set_normalRandomVelocities(std::vector<double> means, std::vector<doub
 
     for (std::size_t i{ 0 }; i < m_swarm.m_numParticles; ++i)
     {
-        m_swarm.m_velocities[i] = Random::getVectorNormals(means, variances);
+        Random::Stream stream{ m_seed, 2 * m_swarm.m_numParticles + i };
+        std::span<double> velocity{ m_swarm.velocity(i) };
+        for (std::size_t d{ 0 }; d < m_swarm.m_dimension; ++d)
+        {
+            velocity[d] = stream.normal(means[d], variances[d]);
+        }
+    }
+}
+
+void PSO::set_bounds(std::vector<double> lowerBounds, std::vector<double> upperBounds)
+{
+    assert(std::size(lowerBounds) == m_swarm.m_dimension);
+    assert(std::size(upperBounds) == m_swarm.m_dimension);
+    for (std::size_t i{ 0 }; i < m_swarm.m_dimension; ++i)
+    {
+        assert(lowerBounds[i] <= upperBounds[i]);
+    }
+
+    m_lowerBounds = std::move(lowerBounds);
+    m_upperBounds = std::move(upperBounds);
+}
+
+void PSO::clampPositions()
+{
+    if (std::empty(m_lowerBounds))
+    {
+        return;
+    }
+    for (std::size_t i{ 0 }; i < m_swarm.m_numParticles; ++i)
+    {
+        std::span<double> position{ m_swarm.position(i) };
+        for (std::size_t d{ 0 }; d < m_swarm.m_dimension; ++d)
+        {
+            position[d] = std::clamp(position[d], m_lowerBounds[d], m_upperBounds[d]);
+        }
+    }
+}
+
+void PSO::move(std::size_t i, std::span<const double> bestKnownPositionSwarm, Random::Stream& stream)
+{
+    // the cognitive and social uniforms of coordinate d are at 2 * d and 2 * d + 1
+    std::span<double> uniforms{ m_swarm.m_uniforms.data() + 2 * i * m_swarm.m_dimension, 2 * m_swarm.m_dimension };
+    stream.uniforms(uniforms);
+
+    std::span<double> position{ m_swarm.position(i) };
+    std::span<double> velocity{ m_swarm.velocity(i) };
+    std::span<const double> bestKnownPosition{ m_swarm.bestKnownPosition(i) };
+    for (std::size_t d{ 0 }; d < m_swarm.m_dimension; ++d)
+    {
+        velocity[d] = m_inertiaWeight * velocity[d]
+            + m_cognitiveCoeff * uniforms[2 * d] * (bestKnownPosition[d] - position[d])
+            + m_socialCoeff * uniforms[2 * d + 1] * (bestKnownPositionSwarm[d] - position[d]);
+    }
+
+    if (std::empty(m_lowerBounds))
+    {
+        for (std::size_t d{ 0 }; d < m_swarm.m_dimension; ++d)
+        {
+            position[d] += velocity[d];
+        }
+        return;
+    }
+    for (std::size_t d{ 0 }; d < m_swarm.m_dimension; ++d)
+    {
+        double newPosition{ std::clamp(position[d] + velocity[d], m_lowerBounds[d], m_upperBounds[d]) };
+        velocity[d] = newPosition - position[d];
+        position[d] = newPosition;
     }
 }
 
@@ -71,4 +149,56 @@ void testPSO()
     std::vector<double> optVol{ pso.optimize(func,true) };
     std::cout << "PSO found vol of " << optVol[static_cast<std::size_t>(0)] << ". True vol is " << trueVol << ".\n";
 
-}
\ No newline at end of file
+}
+
+void testParallelPSO()
+{
+    // Rosenbrock function in 4 dimensions, made expensive enough to be worth spreading over threads
+    auto func
+    {
+        [](const std::vector<double>& x)
+        {
+            double value{ 0.0 };
+            for (int repeat{ 0 }; repeat < 2000; ++repeat)
+            {
+                value = 0.0;
+                for (std::size_t d{ 0 }; d + 1 < std::size(x); ++d)
+                {
+                    value += 100.0 * (x[d + 1] - x[d] * x[d]) * (x[d + 1] - x[d] * x[d]) + (1.0 - x[d]) * (1.0 - x[d]);
+                }
+            }
+            return value;
+        }
+    };
+
+    auto run
+    {
+        [&](PSO::Evaluation evaluation, ThreadPool& pool)
+        {
+            PSO pso{ 100, 4 };
+            pso.set_seed(42);
+            pso.set_uniformRandomPositions({ -2.0, -2.0, -2.0, -2.0 }, { 2.0, 2.0, 2.0, 2.0 });
+            pso.set_normalRandomVelocities({ 0.0, 0.0, 0.0, 0.0 }, { 0.1, 0.1, 0.1, 0.1 });
+            pso.set_coefficients(1.5, 1.5);
+            pso.set_inertia(0.7);
+            pso.set_evaluation(evaluation, pool);
+            Timer timer{};
+            std::vector<double> best{ pso.optimize(func) };
+            std::cout << "best value " << func(best) << " after " << timer.elapsed() << " s";
+            return best;
+        }
+    };
+
+    std::cout << "\n===Testing parallel PSO===\n";
+    ThreadPool singleThread{ 1 };
+    ThreadPool fourThreads{ 4 };
+    std::cout << "Serial: ";
+    run(PSO::Evaluation::serial, singleThread);
+    std::cout << "\nSynchronous on 1 thread: ";
+    std::vector<double> single{ run(PSO::Evaluation::synchronous, singleThread) };
+    std::cout << "\nSynchronous on 4 threads: ";
+    std::vector<double> parallel{ run(PSO::Evaluation::synchronous, fourThreads) };
+    std::cout << "\nAsynchronous on 4 threads: ";
+    run(PSO::Evaluation::asynchronous, fourThreads);
+    std::cout << "\nSynchronous results identical: " << (single == parallel ? "yes" : "no") << "\n";
+}
@@ -3,10 +3,18 @@
 
 #include "Random.h"
 #include "numpy.h"
+#include "threadPool.h"
 #include <iostream>
 #include <cmath>
 #include <vector>
 #include <cassert>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <algorithm>
+#include <concepts>
+#include <utility>
 
 // Particle Swarm Optimization (PSO) for derivative free optimization problems like calibrating a Heston model
 
@@ -18,25 +26,33 @@ public:
         : m_swarm{ Swarm(numParticles,dimension) }
     {}
 
-    // swarm struct collecting information about the particle swarm of the PSO optimizer
+    // swarm struct collecting information about the particle swarm of the PSO optimizer.
+    // The particles are stored one after another in flat arrays, coordinate d of particle i is at index i * m_dimension + d.
     struct Swarm
     {
         std::size_t m_numParticles{ 10 };
         std::size_t m_dimension{ 2 };
-        std::vector<std::vector<double>> m_positions{};
-        std::vector<std::vector<double>> m_velocities{};
-        std::vector<std::vector<double>> m_bestKnownPositions{};
+        std::vector<double> m_positions{};
+        std::vector<double> m_velocities{};
+        std::vector<double> m_bestKnownPositions{};
         std::vector<double> m_bestKnownPositionSwarm{};
+        // two uniforms per coordinate for the next move of every particle
+        std::vector<double> m_uniforms{};
 
 
         Swarm(std::size_t numParticles = 10, std::size_t dimension = 2)
             : m_numParticles{ numParticles }
             , m_dimension{ dimension }
-            , m_positions{ std::vector<std::vector<double>>(numParticles, std::vector<double>(dimension, 0)) }
-            , m_velocities{ std::vector<std::vector<double>>(numParticles, std::vector<double>(dimension, 0)) }
-            , m_bestKnownPositions{ std::vector<std::vector<double>>(numParticles, std::vector<double>(dimension, 0)) }
-            , m_bestKnownPositionSwarm{ std::vector<double>(dimension) }
+            , m_positions(numParticles * dimension, 0.0)
+            , m_velocities(numParticles * dimension, 0.0)
+            , m_bestKnownPositions(numParticles * dimension, 0.0)
+            , m_bestKnownPositionSwarm(dimension, 0.0)
+            , m_uniforms(2 * numParticles * dimension, 0.0)
         {}
+
+        auto position(std::size_t i) -> std::span<double> { return { m_positions.data() + i * m_dimension, m_dimension }; }
+        auto velocity(std::size_t i) -> std::span<double> { return { m_velocities.data() + i * m_dimension, m_dimension }; }
+        auto bestKnownPosition(std::size_t i) -> std::span<double> { return { m_bestKnownPositions.data() + i * m_dimension, m_dimension }; }
     };
 
     // setters
@@ -46,66 +62,126 @@ public:
     void set_coefficients(double cognitive, double social) { m_cognitiveCoeff = cognitive; m_socialCoeff = social; }
     void set_inertia(double inertia) { m_inertiaWeight = inertia; }
 
-    // optimization routine
+    // Keeps the particles inside the box [lowerBounds, upperBounds]. A particle which would leave it stops at the boundary
+    // and its velocity is cut to the step it actually made, so the objective is never called outside the box.
+    void set_bounds(std::vector<double> lowerBounds, std::vector<double> upperBounds);
+
+    // how the objective is evaluated for the particles of the swarm. The parallel modes call func from several threads at once.
+    enum class Evaluation
+    {
+        serial,       // one particle after the other, every move sees the best position found so far
+        synchronous,  // all particles move with the swarm best of the previous iteration and are evaluated in parallel
+        asynchronous, // every particle moves on as soon as its evaluation is done, with the swarm best at that moment
+    };
+    void set_evaluation(Evaluation evaluation, ThreadPool& pool = ThreadPool::global()) { m_evaluation = evaluation; m_pool = &pool; }
+
+    // Particle i draws its random coefficients from stream i of the seed. Serial and synchronous runs with the same seed
+    // give the same result on any number of threads, asynchronous runs only on a single thread.
+    // The random initial positions and velocities are drawn from further streams of the seed, so set it before them.
+    void set_seed(std::uint64_t seed) { m_seed = seed; }
+
+    // Optimization routine. func is called with the position of a particle as std::span<const double> if it accepts one,
+    // otherwise with a const std::vector<double>& reused for the particle.
     constexpr std::vector<double> optimize(const auto& func, bool verbose = false);
 
 private:
+    // fused velocity and position update of particle i towards its own and the swarm's best position, in place
+    void move(std::size_t i, std::span<const double> bestKnownPositionSwarm, Random::Stream& stream);
+
+    // moves all particles into the bounds, if there are any
+    void clampPositions();
+
     Swarm m_swarm{};
     double m_cognitiveCoeff{ 0.1 };
     double m_socialCoeff{ 0.1 };
     double m_inertiaWeight{ 0.1 };
+    Evaluation m_evaluation{ Evaluation::serial };
+    ThreadPool* m_pool{ &ThreadPool::global() };
+    std::uint64_t m_seed{ Random::mt() };
+    std::vector<double> m_lowerBounds{};
+    std::vector<double> m_upperBounds{};
 };
 
 
 
 constexpr std::vector<double> PSO::optimize(const auto& func, bool verbose)
 {
+    constexpr int maxIterations{ 101 };
+    constexpr double tolerance{ 1e-5 };
+
     // set best known positions to initial positions
+    clampPositions();
     m_swarm.m_bestKnownPositions = m_swarm.m_positions;
 
+    std::vector<Random::Stream> streams{};
+    for (std::size_t i{ 0 }; i < m_swarm.m_numParticles; ++i)
+    {
+        streams.emplace_back(m_seed, i);
+    }
+
+    // objectives taking a std::vector get one per particle, allocated once and overwritten for every evaluation
+    constexpr bool takesSpan{ std::invocable<decltype(func), std::span<const double>> };
+    std::vector<std::vector<double>> arguments(takesSpan ? 0 : m_swarm.m_numParticles, std::vector<double>(m_swarm.m_dimension));
+    auto evaluateParticle
+    {
+        [&](std::size_t i) -> double
+        {
+            if constexpr (takesSpan)
+            {
+                return func(std::span<const double>{ m_swarm.position(i) });
+            }
+            else
+            {
+                std::span<const double> position{ m_swarm.position(i) };
+                std::copy(std::begin(position), std::end(position), std::begin(arguments[i]));
+                return func(std::as_const(arguments[i]));
+            }
+        }
+    };
+
+    // evaluates func at the current positions of all particles, in parallel unless the evaluation is serial
+    std::vector<double> currentFuncVals(m_swarm.m_numParticles);
+    auto evaluateSwarm
+    {
+        [&]()
+        {
+            auto evaluate{ [&](std::size_t begin, std::size_t end) { for (std::size_t i{ begin }; i < end; ++i) { currentFuncVals[i] = evaluateParticle(i); } } };
+            if (m_evaluation == Evaluation::serial)
+            {
+                evaluate(0, m_swarm.m_numParticles);
+            }
+            else
+            {
+                m_pool->parallelFor(m_swarm.m_numParticles, evaluate, 1);
+            }
+        }
+    };
+
     // initialize best known position of entire swarm
     double bestFuncVal{ 1e20 };
-    double currentFuncVal{};
-    std::vector<double> bestCurrentFuncVals(m_swarm.m_numParticles);
-    std::size_t count{ 0 };
-    for (const auto& position : m_swarm.m_positions)
+    evaluateSwarm();
+    std::vector<double> bestCurrentFuncVals{ currentFuncVals };
+    for (std::size_t i{ 0 }; i < m_swarm.m_numParticles; ++i)
     {
-        currentFuncVal = func(position);
-        bestCurrentFuncVals[count] = currentFuncVal;
-        if (currentFuncVal < bestFuncVal)
+        if (currentFuncVals[i] < bestFuncVal)
         {
-            m_swarm.m_bestKnownPositionSwarm = position;
-            bestFuncVal = currentFuncVal;
+            std::ranges::copy(m_swarm.position(i), std::begin(m_swarm.m_bestKnownPositionSwarm));
+            bestFuncVal = currentFuncVals[i];
         }
-        ++count;
     }
 
-    bool converged{ false };
-    int counter{ 0 };
-    while (!converged)
+    // check new function value of particle i
+    auto updateBest
     {
-        for (std::size_t i{ 0 }; i < m_swarm.m_numParticles; ++i)
+        [&](std::size_t i, double currentFuncVal)
         {
-            std::vector<double> rp{ Random::getVector(m_swarm.m_dimension,0.0,1.0) };
-            std::vector<double> rg{ Random::getVector(m_swarm.m_dimension,0.0,1.0) };
-
-            // update velocities
-            m_swarm.m_velocities[i] = np::add(np::add(np::multiply(m_swarm.m_velocities[i], m_inertiaWeight)
-                , np::multiply(np::multiply(m_cognitiveCoeff, rp), np::add(m_swarm.m_bestKnownPositions[i], m_swarm.m_positions[i], 1.0, -1.0)))
-                , np::multiply(np::multiply(m_socialCoeff, rg), np::add(m_swarm.m_bestKnownPositionSwarm, m_swarm.m_positions[i], 1.0, -1.0)));
-
-            // update positions
-            m_swarm.m_positions[i] = np::add(m_swarm.m_positions[i], m_swarm.m_velocities[i]);
-
-            // check new function values
-            currentFuncVal = func(m_swarm.m_positions[i]);
             if (currentFuncVal < bestCurrentFuncVals[i])
             {
-                m_swarm.m_bestKnownPositions[i] = m_swarm.m_positions[i];
+                std::ranges::copy(m_swarm.position(i), std::begin(m_swarm.bestKnownPosition(i)));
                 bestCurrentFuncVals[i] = currentFuncVal;
                 if (bestCurrentFuncVals[i] < bestFuncVal)
                 {
-                    m_swarm.m_bestKnownPositionSwarm = m_swarm.m_bestKnownPositions[i];
+                    std::ranges::copy(m_swarm.bestKnownPosition(i), std::begin(m_swarm.m_bestKnownPositionSwarm));
                     bestFuncVal = bestCurrentFuncVals[i];
                     if (verbose)
                     {
@@ -114,9 +190,70 @@ constexpr std::vector<double> PSO::optimize(const auto& func, bool verbose)
                 }
             }
         }
+    };
+
+    if (m_evaluation == Evaluation::asynchronous)
+    {
+        // Every index is one move and evaluation of particle index % numParticles, the pool hands them out in order.
+        // Moves of the same particle are serialized by its lock, the swarm best is shared under the swarm lock.
+        std::mutex swarmMutex{};
+        std::vector<std::mutex> particleMutexes(m_swarm.m_numParticles);
+        std::vector<double> bestKnownPositionSwarmCopies(m_swarm.m_numParticles * m_swarm.m_dimension);
+        std::atomic<bool> converged{ bestFuncVal < tolerance };
+        m_pool->parallelFor(m_swarm.m_numParticles * maxIterations, [&](std::size_t begin, std::size_t end)
+            {
+                for (std::size_t step{ begin }; step < end && !converged; ++step)
+                {
+                    std::size_t i{ step % m_swarm.m_numParticles };
+                    std::lock_guard<std::mutex> particleLock{ particleMutexes[i] };
+                    std::span<double> bestKnownPositionSwarm{ bestKnownPositionSwarmCopies.data() + i * m_swarm.m_dimension, m_swarm.m_dimension };
+                    {
+                        std::lock_guard<std::mutex> swarmLock{ swarmMutex };
+                        std::ranges::copy(m_swarm.m_bestKnownPositionSwarm, std::begin(bestKnownPositionSwarm));
+                    }
+                    move(i, bestKnownPositionSwarm, streams[i]);
+                    double currentFuncVal{ evaluateParticle(i) };
+
+                    std::lock_guard<std::mutex> swarmLock{ swarmMutex };
+                    updateBest(i, currentFuncVal);
+                    if (bestFuncVal < tolerance)
+                    {
+                        converged = true;
+                    }
+                }
+            }, 1);
+
+        return m_swarm.m_bestKnownPositionSwarm;
+    }
+
+    bool converged{ false };
+    int counter{ 0 };
+    while (!converged)
+    {
+        if (m_evaluation == Evaluation::serial)
+        {
+            for (std::size_t i{ 0 }; i < m_swarm.m_numParticles; ++i)
+            {
+                move(i, m_swarm.m_bestKnownPositionSwarm, streams[i]);
+                updateBest(i, evaluateParticle(i));
+            }
+        }
+        else
+        {
+            // all particles move before any of them is evaluated, the results are merged in particle order
+            for (std::size_t i{ 0 }; i < m_swarm.m_numParticles; ++i)
+            {
+                move(i, m_swarm.m_bestKnownPositionSwarm, streams[i]);
+            }
+            evaluateSwarm();
+            for (std::size_t i{ 0 }; i < m_swarm.m_numParticles; ++i)
+            {
+                updateBest(i, currentFuncVals[i]);
+            }
+        }
 
         ++counter;
-        if (bestFuncVal < 1e-5 || counter > 100)
+        if (bestFuncVal < tolerance || counter >= maxIterations)
         {
             converged = true;
         }
@@ -131,5 +268,6 @@ constexpr std::vector<double> PSO::optimize(const auto& func, bool verbose)
 
 
 void testPSO();
+void testParallelPSO();
 
 #endif
@@ -0,0 +1,443 @@
+#include "qmc.h"
+#include "distributions.h"
+#include "options.h"
+#include "sdes.h"
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+#include <numeric>
+#include <iostream>
+
+namespace QMC
+{
+	namespace
+	{
+		// initial direction numbers m_1, ..., m_s of Joe and Kuo (new-joe-kuo-6.21201) for the dimensions after the first
+		const std::vector<std::vector<std::uint32_t>> joeKuoDirections
+		{
+			{ 1 }, { 1, 3 }, { 1, 3, 1 }, { 1, 1, 1 }, { 1, 1, 3, 3 }, { 1, 3, 5, 13 }, { 1, 1, 5, 5, 17 }, { 1, 1, 5, 5, 5 },
+			{ 1, 1, 7, 11, 19 }, { 1, 1, 5, 1, 1 }, { 1, 1, 1, 3, 11 }, { 1, 3, 5, 5, 31 }, { 1, 3, 3, 9, 7, 49 },
+			{ 1, 1, 1, 15, 21, 21 }, { 1, 3, 1, 13, 27, 49 }, { 1, 1, 1, 15, 7, 5 }, { 1, 3, 1, 15, 13, 25 },
+			{ 1, 1, 5, 5, 19, 61 }, { 1, 3, 7, 11, 23, 15, 103 }, { 1, 3, 7, 13, 13, 15, 69 },
+		};
+
+		// product of two polynomials over GF(2) modulo a polynomial of the given degree
+		auto multiplyModulo(std::uint64_t a, std::uint64_t b, std::uint64_t modulus, int degree) -> std::uint64_t
+		{
+			std::uint64_t result{ 0 };
+			while (b != 0)
+			{
+				if (b & 1) { result ^= a; }
+				b >>= 1;
+				a <<= 1;
+				if ((a >> degree) & 1) { a ^= modulus; }
+			}
+			return result;
+		}
+
+		// x^exponent modulo the polynomial
+		auto powerOfX(std::uint64_t exponent, std::uint64_t modulus, int degree) -> std::uint64_t
+		{
+			std::uint64_t base{ (degree == 1) ? (2 ^ modulus) : 2 };
+			std::uint64_t result{ 1 };
+			while (exponent != 0)
+			{
+				if (exponent & 1) { result = multiplyModulo(result, base, modulus, degree); }
+				base = multiplyModulo(base, base, modulus, degree);
+				exponent >>= 1;
+			}
+			return result;
+		}
+
+		// a polynomial of degree s is primitive if x has order 2^s - 1 modulo it
+		auto isPrimitive(std::uint64_t polynomial, int degree) -> bool
+		{
+			std::uint64_t order{ (std::uint64_t{ 1 } << degree) - 1 };
+			if (powerOfX(order, polynomial, degree) != 1) { return false; }
+			std::uint64_t rest{ order };
+			for (std::uint64_t factor{ 2 }; factor * factor <= rest; ++factor)
+			{
+				if (rest % factor != 0) { continue; }
+				while (rest % factor == 0) { rest /= factor; }
+				if (powerOfX(order / factor, polynomial, degree) == 1) { return false; }
+			}
+			if (rest > 1 && rest != order && powerOfX(order / rest, polynomial, degree) == 1) { return false; }
+			return true;
+		}
+
+		// Direction numbers v_1, ..., v_32 (scaled to 32 bits) for dimension d. The first dimension is the van der Corput sequence,
+		// dimension d > 0 uses the d-th primitive polynomial in order of degree and coefficients, like the tables of Joe and Kuo.
+		// Beyond the tabulated dimensions the initial numbers are odd random integers m_k < 2^k.
+		auto directionNumbers(std::size_t dimension) -> std::vector<std::array<std::uint32_t, 32>>
+		{
+			std::vector<std::array<std::uint32_t, 32>> directions(dimension);
+			if (dimension == 0) { return directions; }
+			for (std::size_t k{ 0 }; k < 32; ++k)
+			{
+				directions[0][k] = std::uint32_t{ 1 } << (31 - k);
+			}
+
+			Random::Stream initialNumbers{ 0x5eed5eed, 0 };
+			std::size_t d{ 1 };
+			for (int degree{ 1 }; d < dimension; ++degree)
+			{
+				for (std::uint64_t coefficients{ 0 }; coefficients < (std::uint64_t{ 1 } << (degree - 1)) && d < dimension; ++coefficients)
+				{
+					std::uint64_t polynomial{ (std::uint64_t{ 1 } << degree) | (coefficients << 1) | 1 };
+					if (!isPrimitive(polynomial, degree)) { continue; }
+
+					std::size_t s{ static_cast<std::size_t>(degree) };
+					std::array<std::uint32_t, 32>& v{ directions[d] };
+					for (std::size_t k{ 0 }; k < std::min<std::size_t>(s, 32); ++k)
+					{
+						std::uint32_t m{ (d - 1 < std::size(joeKuoDirections)) ? joeKuoDirections[d - 1][k] : ((initialNumbers() % (std::uint32_t{ 1 } << (k + 1))) | 1) };
+						v[k] = m << (31 - k);
+					}
+					for (std::size_t k{ s }; k < 32; ++k)
+					{
+						v[k] = v[k - s] ^ (v[k - s] >> s);
+						for (std::size_t l{ 1 }; l < s; ++l)
+						{
+							if ((coefficients >> (s - 1 - l)) & 1) { v[k] ^= v[k - l]; }
+						}
+					}
+					++d;
+				}
+			}
+			return directions;
+		}
+
+		auto reverseBits(std::uint32_t x) -> std::uint32_t
+		{
+			x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+			x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+			x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+			x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+			return (x >> 16) | (x << 16);
+		}
+
+		// Owen scrambling as a hash: on bit reversed values, every bit of the Laine-Karras permutation only depends on the lower bits
+		auto nestedUniformScramble(std::uint32_t x, std::uint32_t seed) -> std::uint32_t
+		{
+			x = reverseBits(x);
+			x += seed;
+			x ^= x * 0x6c50b47cu;
+			x ^= x * 0xb82f1e52u;
+			x ^= x * 0xc7afe638u;
+			x ^= x * 0x8d22f6e6u;
+			return reverseBits(x);
+		}
+
+		auto countTrailingZeros(std::uint32_t x) -> std::size_t
+		{
+			std::size_t count{ 0 };
+			while ((x & 1) == 0 && count < 32)
+			{
+				x >>= 1;
+				++count;
+			}
+			return count;
+		}
+
+		// Poisson by inversion of its CDF, large means by the normal approximation
+		auto poissonInverseCDF(double u, double lam) -> int
+		{
+			if (lam > 500.)
+			{
+				return static_cast<int>(std::max(std::floor(lam + std::sqrt(lam) * Distributions::InverseCDFs::standardNormal(u) + 0.5), 0.0));
+			}
+			int count{ 0 };
+			double probability{ std::exp(-lam) };
+			double cumulative{ probability };
+			while (u > cumulative && probability > 0.0)
+			{
+				++count;
+				probability *= lam / static_cast<double>(count);
+				cumulative += probability;
+			}
+			return count;
+		}
+	}
+
+	Sobol::Sobol(std::size_t dimension, std::uint64_t seed)
+		: m_directions{ directionNumbers(dimension) }
+		, m_scrambleSeeds(dimension)
+	{
+		Random::Stream seeds{ seed, 0 };
+		for (auto& scrambleSeed : m_scrambleSeeds)
+		{
+			scrambleSeed = seeds();
+		}
+	}
+
+	void Sobol::points(std::uint32_t first, std::size_t count, std::span<double> out) const
+	{
+		std::size_t dim{ dimension() };
+		assert(std::size(out) >= count * dim);
+		constexpr double scale{ 1.0 / 4294967296.0 };
+
+		// point n combines the direction numbers of the bits of its Gray code, consecutive points differ by one of them
+		std::vector<std::uint32_t> state(dim, 0);
+		std::uint32_t gray{ first ^ (first >> 1) };
+		for (std::size_t k{ 0 }; k < 32; ++k)
+		{
+			if ((gray >> k) & 1)
+			{
+				for (std::size_t d{ 0 }; d < dim; ++d) { state[d] ^= m_directions[d][k]; }
+			}
+		}
+		for (std::size_t i{ 0 }; i < count; ++i)
+		{
+			if (i > 0)
+			{
+				std::size_t bit{ countTrailingZeros(first + static_cast<std::uint32_t>(i)) };
+				for (std::size_t d{ 0 }; d < dim; ++d) { state[d] ^= m_directions[d][bit]; }
+			}
+			for (std::size_t d{ 0 }; d < dim; ++d)
+			{
+				out[i * dim + d] = (static_cast<double>(nestedUniformScramble(state[d], m_scrambleSeeds[d])) + 0.5) * scale;
+			}
+		}
+	}
+
+	BrownianBridge::BrownianBridge(std::size_t numSteps)
+		: m_bridgeIndex(numSteps)
+		, m_leftIndex(numSteps)
+		, m_rightIndex(numSteps)
+		, m_leftWeight(numSteps)
+		, m_rightWeight(numSteps)
+		, m_stdDev(numSteps)
+	{
+		// construction order of Jaeckel, times are 1, ..., numSteps. Point i of the path is known once map[i] != 0.
+		if (numSteps == 0) { return; }
+		std::vector<std::size_t> map(numSteps, 0);
+		map[numSteps - 1] = 1;
+		m_bridgeIndex[0] = numSteps - 1;
+		m_stdDev[0] = std::sqrt(static_cast<double>(numSteps));
+
+		std::size_t j{ 0 };
+		for (std::size_t i{ 1 }; i < numSteps; ++i)
+		{
+			while (map[j] != 0) { ++j; }
+			std::size_t k{ j };
+			while (map[k] == 0) { ++k; }
+			// l is the midpoint of the unknown stretch [j, k - 1], bridged between j - 1 and k
+			std::size_t l{ j + ((k - 1 - j) >> 1) };
+			map[l] = i;
+			m_bridgeIndex[i] = l;
+			m_leftIndex[i] = j;
+			m_rightIndex[i] = k;
+			double leftTime{ static_cast<double>(j) };
+			double midTime{ static_cast<double>(l + 1) };
+			double rightTime{ static_cast<double>(k + 1) };
+			m_leftWeight[i] = (rightTime - midTime) / (rightTime - leftTime);
+			m_rightWeight[i] = (midTime - leftTime) / (rightTime - leftTime);
+			m_stdDev[i] = std::sqrt((midTime - leftTime) * (rightTime - midTime) / (rightTime - leftTime));
+			j = k + 1;
+			if (j >= numSteps) { j = 0; }
+		}
+	}
+
+	void BrownianBridge::transform(std::span<const double> normals, std::span<double> increments) const
+	{
+		std::size_t n{ numSteps() };
+		assert(std::size(normals) >= n && std::size(increments) >= n);
+		if (n == 0) { return; }
+
+		// Brownian path at the times 1, ..., n in increments, then differenced in place
+		increments[n - 1] = m_stdDev[0] * normals[0];
+		for (std::size_t i{ 1 }; i < n; ++i)
+		{
+			std::size_t j{ m_leftIndex[i] };
+			std::size_t k{ m_rightIndex[i] };
+			std::size_t l{ m_bridgeIndex[i] };
+			double left{ (j != 0) ? increments[j - 1] : 0.0 };
+			increments[l] = m_leftWeight[i] * left + m_rightWeight[i] * increments[k] + m_stdDev[i] * normals[i];
+		}
+		for (std::size_t i{ n - 1 }; i > 0; --i)
+		{
+			increments[i] -= increments[i - 1];
+		}
+	}
+
+	auto dimension(std::size_t numSteps, std::span<const Dimension> stepLayout) -> std::size_t
+	{
+		return numSteps * std::size(stepLayout);
+	}
+
+	Draws::Draws(const Sobol& sobol, const BrownianBridge& bridge, std::span<const Dimension> stepLayout, std::uint32_t firstPoint, std::span<Random::Stream> streams)
+		: m_lanes{ std::size(streams) }
+		, m_slotsPerStep{ std::size(stepLayout) }
+		, m_stepLayout(stepLayout.begin(), stepLayout.end())
+		, m_values(bridge.numSteps() * std::size(stepLayout) * std::size(streams))
+		, m_streams{ streams }
+	{
+		std::size_t numSteps{ bridge.numSteps() };
+		std::size_t numBrownian{ static_cast<std::size_t>(std::count(stepLayout.begin(), stepLayout.end(), Dimension::brownian)) };
+		std::size_t numIndependent{ m_slotsPerStep - numBrownian };
+		std::size_t dim{ sobol.dimension() };
+		assert(dim >= dimension(numSteps, stepLayout));
+
+		std::vector<double> points(m_lanes * dim);
+		sobol.points(firstPoint, m_lanes, points);
+
+		// The bridge normals of all Brownian factors come first (interleaved, so all factors get good dimensions for their
+		// coarse path shape), the independent draws of all steps after them.
+		std::vector<double> bridgeNormals(numSteps);
+		std::vector<double> increments(numSteps);
+		for (std::size_t lane{ 0 }; lane < m_lanes; ++lane)
+		{
+			const double* point{ points.data() + lane * dim };
+			std::size_t factor{ 0 };
+			std::size_t independent{ 0 };
+			for (std::size_t slot{ 0 }; slot < m_slotsPerStep; ++slot)
+			{
+				if (m_stepLayout[slot] == Dimension::brownian)
+				{
+					for (std::size_t p{ 0 }; p < numSteps; ++p)
+					{
+						bridgeNormals[p] = Distributions::InverseCDFs::standardNormal(point[p * numBrownian + factor]);
+					}
+					bridge.transform(bridgeNormals, increments);
+					for (std::size_t step{ 0 }; step < numSteps; ++step)
+					{
+						m_values[(step * m_slotsPerStep + slot) * m_lanes + lane] = increments[step];
+					}
+					++factor;
+				}
+				else
+				{
+					for (std::size_t step{ 0 }; step < numSteps; ++step)
+					{
+						m_values[(step * m_slotsPerStep + slot) * m_lanes + lane] = point[numBrownian * numSteps + step * numIndependent + independent];
+					}
+					++independent;
+				}
+			}
+		}
+	}
+
+	auto Draws::next() -> std::span<const double>
+	{
+		assert((m_call + 1) * m_lanes <= std::size(m_values));
+		std::span<const double> values{ m_values.data() + m_call * m_lanes, m_lanes };
+		++m_call;
+		return values;
+	}
+
+	void Draws::normals(std::span<double> out)
+	{
+		bool brownian{ m_stepLayout[m_call % m_slotsPerStep] == Dimension::brownian };
+		std::span<const double> values{ next() };
+		for (std::size_t j{ 0 }; j < std::size(out); ++j)
+		{
+			out[j] = brownian ? values[j] : Distributions::InverseCDFs::standardNormal(values[j]);
+		}
+	}
+
+	void Draws::poissons(std::span<int> out, double lam)
+	{
+		assert(m_stepLayout[m_call % m_slotsPerStep] == Dimension::independent);
+		std::span<const double> values{ next() };
+		for (std::size_t j{ 0 }; j < std::size(out); ++j)
+		{
+			out[j] = poissonInverseCDF(values[j], lam);
+		}
+	}
+
+	void Draws::gammas(std::span<double> out, double alpha, double beta)
+	{
+		Random::gammas(m_streams, out, alpha, beta);
+	}
+
+	auto replicateMeans(std::span<const double> values, std::size_t numReplicates) -> std::vector<double>
+	{
+		std::size_t numValues{ std::size(values) };
+		numReplicates = std::clamp<std::size_t>(numReplicates, 1, std::max<std::size_t>(numValues, 1));
+		std::size_t blockSize{ (numValues + numReplicates - 1) / numReplicates };
+
+		std::vector<double> means{};
+		for (std::size_t first{ 0 }; first < numValues; first += blockSize)
+		{
+			std::size_t last{ std::min(first + blockSize, numValues) };
+			double sum{ 0.0 };
+			for (std::size_t i{ first }; i < last; ++i) { sum += values[i]; }
+			means.push_back(sum / static_cast<double>(last - first));
+		}
+		return means;
+	}
+
+	auto estimate(std::span<const double> values, std::size_t numReplicates) -> Estimate
+	{
+		std::size_t numValues{ std::size(values) };
+		Estimate result{};
+		result.value = (numValues > 0) ? std::accumulate(values.begin(), values.end(), 0.0) / static_cast<double>(numValues) : 0.0;
+
+		RunningStatistics statistics{};
+		for (double replicateMean : replicateMeans(values, numReplicates)) { statistics.add(replicateMean); }
+		result.standardError = statistics.standardError();
+		return result;
+	}
+
+	namespace UnitTests
+	{
+		void sobol()
+		{
+			// every coordinate of a scrambled Sobol net averages to 1/2 far more accurately than pseudo random numbers
+			std::size_t dim{ 64 };
+			std::size_t count{ 4096 };
+			Sobol sequence{ dim, 1 };
+			std::vector<double> points(count * dim);
+			sequence.points(0, count, points);
+			double maxDeviation{ 0.0 };
+			for (std::size_t d{ 0 }; d < dim; ++d)
+			{
+				double mean{ 0.0 };
+				for (std::size_t i{ 0 }; i < count; ++i) { mean += points[i * dim + d]; }
+				maxDeviation = std::max(maxDeviation, std::abs(mean / static_cast<double>(count) - 0.5));
+			}
+			std::cout << "Maximal deviation of the coordinate means from 1/2 in " << dim << " dimensions is " << maxDeviation << "\n";
+
+			// European call in BSM, same number of paths with pseudo random and Sobol points
+			double spot{ 100. };
+			double strike{ 105. };
+			double maturity{ 1. };
+			double riskFreeReturn{ 0.03 };
+			double vol{ 0.2 };
+			std::size_t samples{ 16384 };
+			double truePrice{ Options::Pricing::BSM::call(riskFreeReturn, vol, maturity, strike, spot, 0.0) };
+			for (std::string_view sampling : { "pseudo", "sobol" })
+			{
+				XYVals terminal{ SDE::BSM::monteCarlo(spot, maturity, samples, riskFreeReturn, vol, 7, sampling) };
+				std::vector<double> payoffs(samples);
+				for (std::size_t i{ 0 }; i < samples; ++i)
+				{
+					payoffs[i] = std::exp(-riskFreeReturn * maturity) * std::max(terminal.m_yVals[i] - strike, 0.0);
+				}
+				Estimate price{ estimate(payoffs) };
+				std::cout << "BSM call with " << samples << " " << sampling << " samples: " << price.value << " +- " << price.standardError
+					<< " (analytic " << truePrice << ")\n";
+			}
+
+			// arithmetic Asian call in Heston on 64 steps, where the Brownian bridge matters
+			HestonParams hestonParams{ 1.5, 0.04, 0.3, -0.7, 0.04 };
+			std::size_t timePoints{ 65 };
+			for (std::string_view sampling : { "pseudo", "sobol" })
+			{
+				PathBlock paths{ SDE::Heston::monteCarloPathBlock(spot, maturity, samples, timePoints, riskFreeReturn, hestonParams.initialVariance, hestonParams.longVariance,
+					hestonParams.correlation, hestonParams.reversionRate, hestonParams.volVol, 7, PathBlock::Layout::pathMajor, sampling) };
+				std::vector<double> payoffs(samples);
+				for (std::size_t num{ 0 }; num < samples; ++num)
+				{
+					auto path{ paths.path(num) };
+					double average{ 0.0 };
+					for (std::size_t i{ 1 }; i < timePoints; ++i) { average += path[i]; }
+					average /= static_cast<double>(timePoints - 1);
+					payoffs[num] = std::exp(-riskFreeReturn * maturity) * std::max(average - strike, 0.0);
+				}
+				Estimate price{ estimate(payoffs) };
+				std::cout << "Heston Asian call with " << samples << " " << sampling << " paths: " << price.value << " +- " << price.standardError << "\n";
+			}
+		}
+	}
+}
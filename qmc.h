@@ -0,0 +1,106 @@
+#ifndef QMC_H
+#define QMC_H
+#include "Random.h"
+#include "xyvals.h"
+#include <vector>
+#include <array>
+#include <span>
+#include <cstdint>
+
+// Randomized quasi Monte Carlo. Scrambled Sobol points replace pseudo random numbers, multi step paths are
+// built with a Brownian bridge so that the first (best distributed) Sobol dimensions carry most of the path variance.
+// Independent scramblings of the same point set give replicates whose spread estimates the error.
+namespace QMC
+{
+	// number of independently scrambled replicates a sample is split into
+	constexpr std::size_t defaultReplicates{ 16 };
+
+	// Sobol sequence with 32 bit precision, direction numbers of Joe and Kuo for the first dimensions.
+	// Every dimension is Owen scrambled with the hash based nested uniform scrambling of Burley (2020),
+	// different seeds give independent randomizations of the same point set.
+	class Sobol
+	{
+	public:
+		Sobol(std::size_t dimension, std::uint64_t seed);
+
+		auto dimension() const -> std::size_t { return std::size(m_directions); }
+
+		// coordinates of consecutive points, out[(i - first) * dimension() + d] is coordinate d of point i, all in (0, 1)
+		void points(std::uint32_t first, std::size_t count, std::span<double> out) const;
+
+	private:
+		std::vector<std::array<std::uint32_t, 32>> m_directions;
+		std::vector<std::uint32_t> m_scrambleSeeds;
+	};
+
+	// Brownian bridge over equidistant steps. The first normal fixes the terminal value, the following ones
+	// fill in midpoints, so the coarse shape of a path depends on the first few normals only.
+	class BrownianBridge
+	{
+	public:
+		explicit BrownianBridge(std::size_t numSteps);
+
+		auto numSteps() const -> std::size_t { return std::size(m_bridgeIndex); }
+
+		// turns standard normals in bridge order into the standard normal increments of the path in time order
+		void transform(std::span<const double> normals, std::span<double> increments) const;
+
+	private:
+		std::vector<std::size_t> m_bridgeIndex;
+		std::vector<std::size_t> m_leftIndex;
+		std::vector<std::size_t> m_rightIndex;
+		std::vector<double> m_leftWeight;
+		std::vector<double> m_rightWeight;
+		std::vector<double> m_stdDev;
+	};
+
+	// role of the random numbers a model draws per time step
+	enum class Dimension
+	{
+		brownian, // normal driving a Brownian motion, built by the Brownian bridge over all steps
+		independent, // normal or Poisson draw used as is
+	};
+
+	// Random numbers for a batch of Monte Carlo lanes from consecutive Sobol points, with the same interface as
+	// drawing from the lanes' pseudo random streams. Every call of normals or poissons takes the next entry of
+	// stepLayout for all lanes, once the layout is used up the next time step starts.
+	// Gamma variates have no cheap inverse CDF and are drawn from the lanes' streams instead.
+	class Draws
+	{
+	public:
+		Draws(const Sobol& sobol, const BrownianBridge& bridge, std::span<const Dimension> stepLayout, std::uint32_t firstPoint, std::span<Random::Stream> streams);
+
+		auto lanes() const -> std::size_t { return m_lanes; }
+		void normals(std::span<double> out);
+		void poissons(std::span<int> out, double lam);
+		void gammas(std::span<double> out, double alpha, double beta);
+
+	private:
+		auto next() -> std::span<const double>;
+
+		std::size_t m_lanes{ 0 };
+		std::size_t m_slotsPerStep{ 0 };
+		std::vector<Dimension> m_stepLayout;
+		// for every call, one standard normal (brownian) or uniform (independent) per lane
+		std::vector<double> m_values;
+		std::size_t m_call{ 0 };
+		std::span<Random::Stream> m_streams;
+	};
+
+	// Sobol dimension needed by a model with the given step layout
+	auto dimension(std::size_t numSteps, std::span<const Dimension> stepLayout) -> std::size_t;
+
+	// means of the replicates in values, which holds them one after another in equally sized blocks (the last one may be shorter)
+	auto replicateMeans(std::span<const double> values, std::size_t numReplicates = defaultReplicates) -> std::vector<double>;
+
+	// mean of values and its standard error from the spread of the replicate means,
+	// values holds the replicates one after another in equally sized blocks (the last one may be shorter)
+	auto estimate(std::span<const double> values, std::size_t numReplicates = defaultReplicates) -> Estimate;
+
+	namespace UnitTests
+	{
+		void sobol();
+	}
+}
+
+#endif
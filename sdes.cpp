@@ -1,22 +1,313 @@
 #include "Random.h"
 #include "xyvals.h"
 #include "sdes.h"
+#include "threadPool.h"
+#include "qmc.h"
 #include <cmath>
 #include <vector>
 #include <cassert>
 #include <complex>
+#include <span>
+#include <algorithm>
+#include <array>
+#include <string_view>
+#include <utility>
 
 constexpr std::complex<double> IMNUM(0.0, 1.0);
 
 
 namespace SDE
 {
+	// Monte Carlo runs are spread over the global thread pool. Sample i always draws from stream i of the seed,
+	// so the results only depend on the seed and not on the number of threads or on the scheduling.
+	namespace Parallel
+	{
+		auto samples(std::size_t numSamples, std::uint64_t seed, const auto& sampleFunc) -> XYVals
+		{
+			XYVals mcSamples{ numSamples };
+			ThreadPool::global().parallelFor(numSamples, [&](std::size_t begin, std::size_t end)
+				{
+					for (std::size_t i{ begin }; i < end; ++i)
+					{
+						Random::Stream stream{ seed, i };
+						mcSamples.m_xVals[i] = static_cast<double>(i);
+						mcSamples.m_yVals[i] = sampleFunc(stream);
+					}
+				});
+			return mcSamples;
+		}
+
+		// pathFunc(path, stream) fills the values of a single path in place
+		auto paths(std::size_t numSamples, std::size_t timePoints, std::uint64_t seed, const auto& pathFunc) -> DataTable
+		{
+			DataTable paths(numSamples, timePoints);
+			ThreadPool::global().parallelFor(numSamples, [&](std::size_t begin, std::size_t end)
+				{
+					for (std::size_t num{ begin }; num < end; ++num)
+					{
+						Random::Stream stream{ seed, num };
+						pathFunc(StridedView<double>{ paths.m_table[num].data(), timePoints }, stream);
+					}
+				});
+			return paths;
+		}
+
+		auto pathBlock(std::size_t numSamples, std::size_t timePoints, double terminalTime, PathBlock::Layout layout, std::uint64_t seed, const auto& pathFunc) -> PathBlock
+		{
+			PathBlock paths(numSamples, timePoints, terminalTime, layout);
+			ThreadPool::global().parallelFor(numSamples, [&](std::size_t begin, std::size_t end)
+				{
+					for (std::size_t num{ begin }; num < end; ++num)
+					{
+						Random::Stream stream{ seed, num };
+						pathFunc(paths.path(num), stream);
+					}
+				});
+			return paths;
+		}
+
+		// Number of paths advanced together by the batch kernels. The state and random number arrays
+		// of a batch stay in the L1 cache while the kernels sweep over them once per time step.
+		constexpr std::size_t batchSize{ 256 };
+
+		// random numbers of a batch drawn from the lanes' own streams, the pseudo random counterpart of QMC::Draws
+		struct StreamDraws
+		{
+			std::span<Random::Stream> m_streams;
+
+			auto lanes() const -> std::size_t { return std::size(m_streams); }
+			void normals(std::span<double> out) { Random::normals(m_streams, out); }
+			void poissons(std::span<int> out, double lam) { Random::poissons(m_streams, out, lam); }
+			void gammas(std::span<double> out, double alpha, double beta) { Random::gammas(m_streams, out, alpha, beta); }
+		};
+
+		// number of paths per Sobol replicate, all paths form a single replicate with pseudo random sampling
+		auto replicateLength(std::size_t numSamples, std::string_view sampling) -> std::size_t
+		{
+			std::size_t numReplicates{ (sampling == "sobol") ? std::min(QMC::defaultReplicates, std::max<std::size_t>(numSamples, 1)) : 1 };
+			return std::max<std::size_t>((numSamples + numReplicates - 1) / numReplicates, 1);
+		}
+
+		// batchFunc(first, draws) runs the lanes of one batch, draws hands out the random numbers for all lanes at once.
+		// With pseudo random sampling lane j of the batch starting at path first uses stream first + j, so batched and
+		// path wise simulations draw the same numbers. With "sobol" sampling the paths are split into QMC::defaultReplicates
+		// consecutive blocks, each with its own scrambling of the Sobol points, and batches never cross blocks.
+		// stepLayout lists the draws a model takes per time step, it only matters for Sobol points.
+		void forEachBatch(std::size_t numSamples, std::size_t numSteps, std::uint64_t seed, std::span<const QMC::Dimension> stepLayout, std::string_view sampling, const auto& batchFunc)
+		{
+			assert(sampling == "pseudo" || sampling == "sobol");
+			bool sobol{ sampling == "sobol" };
+			std::size_t replicateSize{ replicateLength(numSamples, sampling) };
+			std::size_t numReplicates{ (numSamples + replicateSize - 1) / replicateSize };
+			std::size_t batchesPerReplicate{ (replicateSize + batchSize - 1) / batchSize };
+
+			std::vector<QMC::Sobol> sequences{};
+			QMC::BrownianBridge bridge{ sobol ? numSteps : 0 };
+			if (sobol)
+			{
+				// stream numSamples is not used by any path
+				Random::Stream replicateSeeds{ seed, numSamples };
+				std::size_t dimension{ QMC::dimension(numSteps, stepLayout) };
+				for (std::size_t r{ 0 }; r < numReplicates; ++r)
+				{
+					sequences.emplace_back(dimension, (std::uint64_t{ replicateSeeds() } << 32) | replicateSeeds());
+				}
+			}
+
+			ThreadPool::global().parallelFor(numReplicates * batchesPerReplicate, [&](std::size_t begin, std::size_t end)
+				{
+					std::vector<Random::Stream> streams{};
+					streams.reserve(batchSize);
+					for (std::size_t batch{ begin }; batch < end; ++batch)
+					{
+						std::size_t replicate{ batch / batchesPerReplicate };
+						std::size_t offset{ (batch % batchesPerReplicate) * batchSize };
+						std::size_t first{ replicate * replicateSize + offset };
+						std::size_t last{ std::min({ first + batchSize, (replicate + 1) * replicateSize, numSamples }) };
+						if (first >= last) { continue; }
+						streams.clear();
+						for (std::size_t j{ first }; j < last; ++j)
+						{
+							streams.emplace_back(seed, j);
+						}
+						if (sobol)
+						{
+							QMC::Draws draws{ sequences[replicate], bridge, stepLayout, static_cast<std::uint32_t>(offset), streams };
+							batchFunc(first, draws);
+						}
+						else
+						{
+							StreamDraws draws{ streams };
+							batchFunc(first, draws);
+						}
+					}
+				}, 1);
+		}
+
+		// terminal states of all paths, batchFunc(states, draws, record) runs the lanes of one batch through all
+		// time steps and calls record(timeIndex, states) after every step
+		auto batchSamples(std::size_t numSamples, std::size_t timePoints, std::uint64_t seed, std::span<const QMC::Dimension> stepLayout, std::string_view sampling, const auto& batchFunc) -> XYVals
+		{
+			XYVals mcSamples{ numSamples };
+			forEachBatch(numSamples, timePoints - 1, seed, stepLayout, sampling, [&](std::size_t first, auto& draws)
+				{
+					std::size_t lanes{ draws.lanes() };
+					std::span<double> states{ mcSamples.m_yVals.data() + first, lanes };
+					batchFunc(states, draws, [](std::size_t, std::span<const double>) {});
+					for (std::size_t j{ 0 }; j < lanes; ++j)
+					{
+						mcSamples.m_xVals[first + j] = static_cast<double>(first + j);
+					}
+				});
+			return mcSamples;
+		}
+
+		// whole paths, in a time major block every time step of a batch is one contiguous copy
+		auto batchPathBlock(std::size_t numSamples, std::size_t timePoints, double terminalTime, PathBlock::Layout layout, std::uint64_t seed, std::span<const QMC::Dimension> stepLayout, std::string_view sampling, const auto& batchFunc) -> PathBlock
+		{
+			PathBlock paths(numSamples, timePoints, terminalTime, layout);
+			forEachBatch(numSamples, timePoints - 1, seed, stepLayout, sampling, [&](std::size_t first, auto& draws)
+				{
+					std::vector<double> states(draws.lanes());
+					batchFunc(std::span<double>{ states }, draws, [&](std::size_t timeIndex, std::span<const double> current)
+						{
+							for (std::size_t j{ 0 }; j < std::size(current); ++j)
+							{
+								paths(first + j, timeIndex) = current[j];
+							}
+						});
+				});
+			return paths;
+		}
+
+		// Applies the variance reduction of a Monte Carlo run to the normals of a batch. Every call of normals or poissons
+		// takes the next entry of the step layout. The first normal of every step drives the price, it is shifted for
+		// importance sampling and summed per lane into the Brownian motion used by control variates.
+		template <typename Draws>
+		struct ReducedDraws
+		{
+			Draws& m_draws;
+			const MonteCarloParams& m_params;
+			std::size_t m_slotsPerStep{ 1 };
+			double m_stepShift{ 0.0 };
+			std::span<double> m_brownian;
+			std::span<double> m_logWeights;
+			std::size_t m_call{ 0 };
+
+			auto lanes() const -> std::size_t { return m_draws.lanes(); }
+
+			void normals(std::span<double> out)
+			{
+				m_draws.normals(out);
+				std::size_t lanes{ std::size(out) };
+				if (m_params.antithetic)
+				{
+					for (std::size_t j{ 1 }; j < lanes; j += 2)
+					{
+						out[j] = -out[j - 1];
+					}
+				}
+				if (m_params.momentMatching && lanes > 1)
+				{
+					double mean{ 0.0 };
+					for (double value : out) { mean += value; }
+					mean /= static_cast<double>(lanes);
+					double variance{ 0.0 };
+					for (double value : out) { variance += (value - mean) * (value - mean); }
+					variance /= static_cast<double>(lanes - 1);
+					double scale{ (variance > 0.0) ? 1.0 / std::sqrt(variance) : 1.0 };
+					for (double& value : out) { value = (value - mean) * scale; }
+				}
+				if (m_call % m_slotsPerStep == 0)
+				{
+					// density ratio of N(0, 1) to N(shift, 1) at the shifted draw
+					for (std::size_t j{ 0 }; j < lanes; ++j)
+					{
+						out[j] += m_stepShift;
+						m_logWeights[j] += m_stepShift * (0.5 * m_stepShift - out[j]);
+						m_brownian[j] += out[j];
+					}
+				}
+				++m_call;
+			}
+			void poissons(std::span<int> out, double lam)
+			{
+				m_draws.poissons(out, lam);
+				++m_call;
+			}
+			void gammas(std::span<double> out, double alpha, double beta) { m_draws.gammas(out, alpha, beta); }
+		};
+
+		// terminal states with weights, batch by batch into sink. batchFunc(states, tangents, scores, draws) runs the lanes of one
+		// batch through all time steps, tangents and scores have tangentRows and scoreRows rows of one entry per lane.
+		void streamBatches(std::size_t timePoints, const MonteCarloParams& params, std::span<const QMC::Dimension> stepLayout, std::size_t tangentRows, std::size_t scoreRows, const auto& batchFunc, const SampleSink& sink)
+		{
+			std::size_t numSteps{ timePoints - 1 };
+			std::size_t replicateSize{ replicateLength(params.samples, params.sampling) };
+			forEachBatch(params.samples, numSteps, params.seed, stepLayout, params.sampling, [&](std::size_t first, auto& draws)
+				{
+					std::size_t lanes{ draws.lanes() };
+					std::array<double, batchSize> states{};
+					std::array<double, batchSize> weights{};
+					std::array<double, batchSize> brownian{};
+					std::vector<double> tangents(tangentRows * lanes);
+					std::vector<double> scores(scoreRows * lanes);
+					ReducedDraws<std::remove_reference_t<decltype(draws)>> reduced{ draws, params, std::size(stepLayout),
+						params.importanceShift / std::sqrt(static_cast<double>(numSteps)), std::span<double>{ brownian.data(), lanes }, std::span<double>{ weights.data(), lanes } };
+					batchFunc(std::span<double>{ states.data(), lanes }, std::span<double>{ tangents }, std::span<double>{ scores }, reduced);
+					for (std::size_t j{ 0 }; j < lanes; ++j)
+					{
+						weights[j] = std::exp(weights[j]);
+						brownian[j] /= std::sqrt(static_cast<double>(numSteps));
+					}
+					sink({ first, first / replicateSize, { states.data(), lanes }, { weights.data(), lanes }, { brownian.data(), lanes }, tangents, scores });
+				});
+		}
+
+		// terminal states with weights, batch by batch into sink, batchFunc(states, draws, record) as for batchSamples
+		void streamSamples(std::size_t timePoints, const MonteCarloParams& params, std::span<const QMC::Dimension> stepLayout, const auto& batchFunc, const SampleSink& sink)
+		{
+			streamBatches(timePoints, params, stepLayout, 0, 0, [&](std::span<double> states, std::span<double>, std::span<double>, auto& draws)
+				{
+					batchFunc(states, draws, [](std::size_t, std::span<const double>) {});
+				}, sink);
+		}
+
+		// tangents at the start of a tangent run: the terminal state moves one to one with the initial state
+		void initialTangents(std::span<double> tangents, std::size_t lanes)
+		{
+			std::fill(tangents.begin(), tangents.end(), 0.0);
+			std::fill_n(tangents.begin(), lanes, 1.0);
+		}
+
+		// all terminal states with weights in one WeightedSamples
+		auto weightedSamples(std::size_t timePoints, const MonteCarloParams& params, std::span<const QMC::Dimension> stepLayout, const auto& batchFunc) -> WeightedSamples
+		{
+			WeightedSamples mcSamples{ params.samples };
+			streamSamples(timePoints, params, stepLayout, batchFunc, [&](const SampleBatch& batch)
+				{
+					std::copy(batch.m_states.begin(), batch.m_states.end(), mcSamples.m_states.begin() + static_cast<std::ptrdiff_t>(batch.m_first));
+					std::copy(batch.m_weights.begin(), batch.m_weights.end(), mcSamples.m_weights.begin() + static_cast<std::ptrdiff_t>(batch.m_first));
+					std::copy(batch.m_brownian.begin(), batch.m_brownian.end(), mcSamples.m_brownian.begin() + static_cast<std::ptrdiff_t>(batch.m_first));
+				});
+			return mcSamples;
+		}
+
+		// single path with its time grid
+		auto path(double terminalTime, std::size_t timePoints, const auto& pathFunc) -> XYVals
+		{
+			XYVals spath{ timePoints, std::vector<double>(timePoints), timeGrid(terminalTime, timePoints) };
+			pathFunc(StridedView<double>{ spath.m_yVals.data(), timePoints });
+			return spath;
+		}
+	}
+
 	namespace OrnsteinUhlenbeck
 	{
 		auto simulate(double state, double time, double drift, double mean, double diffusion) -> double
 		{
 			double variance{ diffusion * diffusion * 0.5 / drift * (1.0 - std::exp(-2.0 * drift * time)) };
-			return state * std::exp(-drift * time) + mean * (1.0 - std::exp(-drift * time)) + Random::normal(0.0,variance);
+			return state * std::exp(-drift * time) + mean * (1.0 - std::exp(-drift * time)) + Random::normal(0.0, std::sqrt(variance));
 			//return state + stepSize * drift * state + std::sqrt(stepSize) * diffusion * Random::normal(0.0,1.0);
 		}
 	}
@@ -42,23 +333,127 @@ namespace SDE
 		}
 		auto monteCarlo(double initialState, double terminalTime, std::size_t samples, double drift, double volatility) -> XYVals
 		{
-			XYVals mcSamples{ samples };
-			for (std::size_t i{ 0 }; i < samples; i++)
-			{
-				mcSamples.m_xVals[i] = static_cast<double>(i);
-				mcSamples.m_yVals[i] = simulate(initialState, terminalTime, drift, volatility);
-			}
-			return mcSamples;
+			return monteCarlo(initialState, terminalTime, samples, drift, volatility, Random::seed());
 		}
 
 		auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double volatility) -> DataTable
 		{
-			DataTable paths(samples, timePoints);
-			for (std::size_t num{ 0 }; num < samples; ++num)
+			return monteCarloPaths(initialState, terminalTime, samples, timePoints, drift, volatility, Random::seed());
+		}
+
+		// overloads drawing from a given random stream
+		auto simulate(double initialState, double time, double drift, double volatility, Random::Stream& stream) -> double
+		{
+			return initialState * std::exp((drift - volatility * volatility / 2) * time + volatility * std::sqrt(time) * stream.normal());
+		}
+		// advances all lanes of a batch by one time step
+		auto stepBatch(std::span<double> states, double time, double drift, double volatility, std::span<const double> normals) -> void
+		{
+			double driftTerm{ (drift - volatility * volatility / 2) * time };
+			double diffusion{ volatility * std::sqrt(time) };
+			for (std::size_t j{ 0 }; j < std::size(states); ++j)
 			{
-				paths.m_table[num] = path(initialState, terminalTime, timePoints, drift, volatility).m_yVals;
+				states[j] = states[j] * std::exp(driftTerm + diffusion * normals[j]);
 			}
-			return paths;
+		}
+		// advances all lanes of a batch and their tangents by one time step
+		auto stepBatch(std::span<double> states, std::span<double> tangents, double time, double drift, double volatility, std::span<const double> normals) -> void
+		{
+			std::size_t lanes{ std::size(states) };
+			double driftTerm{ (drift - volatility * volatility / 2) * time };
+			double diffusion{ volatility * std::sqrt(time) };
+			for (std::size_t j{ 0 }; j < lanes; ++j)
+			{
+				double growth{ std::exp(driftTerm + diffusion * normals[j]) };
+				states[j] = states[j] * growth;
+				tangents[j] *= growth;
+				tangents[lanes + j] *= growth;
+				tangents[2 * lanes + j] = tangents[2 * lanes + j] * growth + states[j] * (std::sqrt(time) * normals[j] - volatility * time);
+			}
+		}
+		// draws per time step of simulateBatch for Sobol points
+		const std::array<QMC::Dimension, 1> sobolLayout{ QMC::Dimension::brownian };
+		// runs the lanes of a batch through all time steps, record(timeIndex, states) is called after every step
+		auto simulateBatch(std::span<double> states, auto& draws, const auto& record, double initialState, double terminalTime, std::size_t timePoints, double drift, double volatility) -> void
+		{
+			std::vector<double> normals(std::size(states));
+			std::fill(states.begin(), states.end(), initialState);
+			record(0, states);
+			double time{ terminalTime / static_cast<double>(timePoints - 1) };
+			for (std::size_t i{ 1 }; i < timePoints; ++i)
+			{
+				draws.normals(normals);
+				stepBatch(states, time, drift, volatility, normals);
+				record(i, states);
+			}
+		}
+		// runs the lanes of a batch and their tangents through all time steps with the draws of simulateBatch
+		auto simulateTangentBatch(std::span<double> states, std::span<double> tangents, auto& draws, double initialState, double terminalTime, std::size_t timePoints, double drift, double volatility) -> void
+		{
+			std::vector<double> normals(std::size(states));
+			std::fill(states.begin(), states.end(), initialState);
+			Parallel::initialTangents(tangents, std::size(states));
+			double time{ terminalTime / static_cast<double>(timePoints - 1) };
+			for (std::size_t i{ 1 }; i < timePoints; ++i)
+			{
+				draws.normals(normals);
+				stepBatch(states, tangents, time, drift, volatility, normals);
+			}
+		}
+		auto fillPath(StridedView<double> spath, double initialState, double terminalTime, double drift, double volatility, Random::Stream& stream) -> void
+		{
+			spath[0] = initialState;
+			double time{ terminalTime / static_cast<double>(spath.size() - 1) };
+			for (std::size_t i{ 1 }; i < spath.size(); ++i)
+			{
+				spath[i] = simulate(spath[i - 1], time, drift, volatility, stream);
+			}
+		}
+		auto path(double initialState, double terminalTime, std::size_t timePoints, double drift, double volatility, Random::Stream& stream) -> XYVals
+		{
+			return Parallel::path(terminalTime, timePoints, [&](StridedView<double> spath) { fillPath(spath, initialState, terminalTime, drift, volatility, stream); });
+		}
+		auto monteCarlo(double initialState, double terminalTime, std::size_t samples, double drift, double volatility, std::uint64_t seed, std::string_view sampling) -> XYVals
+		{
+			if (sampling == "sobol")
+			{
+				// the terminal value is exact after a single time step
+				return Parallel::batchSamples(samples, 2, seed, sobolLayout, sampling, [&](std::span<double> states, auto& draws, const auto& record) { simulateBatch(states, draws, record, initialState, terminalTime, 2, drift, volatility); });
+			}
+			return Parallel::samples(samples, seed, [&](Random::Stream& stream) { return simulate(initialState, terminalTime, drift, volatility, stream); });
+		}
+		auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double volatility, std::uint64_t seed, std::string_view sampling) -> DataTable
+		{
+			if (sampling == "sobol")
+			{
+				return monteCarloPathBlock(initialState, terminalTime, samples, timePoints, drift, volatility, seed, PathBlock::Layout::pathMajor, sampling).toDataTable();
+			}
+			return Parallel::paths(samples, timePoints, seed, [&](StridedView<double> spath, Random::Stream& stream) { fillPath(spath, initialState, terminalTime, drift, volatility, stream); });
+		}
+		auto monteCarloPathBlock(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double volatility, std::uint64_t seed, PathBlock::Layout layout, std::string_view sampling) -> PathBlock
+		{
+			if (layout == PathBlock::Layout::timeMajor || sampling == "sobol")
+			{
+				return Parallel::batchPathBlock(samples, timePoints, terminalTime, layout, seed, sobolLayout, sampling, [&](std::span<double> states, auto& draws, const auto& record) { simulateBatch(states, draws, record, initialState, terminalTime, timePoints, drift, volatility); });
+			}
+			return Parallel::pathBlock(samples, timePoints, terminalTime, layout, seed, [&](StridedView<double> spath, Random::Stream& stream) { fillPath(spath, initialState, terminalTime, drift, volatility, stream); });
+		}
+		// terminal states with the variance reduction of mcParams
+		auto monteCarlo(double initialState, double terminalTime, double drift, double volatility, const MonteCarloParams& mcParams) -> WeightedSamples
+		{
+			// the terminal value is exact after a single time step
+			return Parallel::weightedSamples(2, mcParams, sobolLayout, [&](std::span<double> states, auto& draws, const auto& record) { simulateBatch(states, draws, record, initialState, terminalTime, 2, drift, volatility); });
+		}
+
+		auto monteCarlo(double initialState, double terminalTime, double drift, double volatility, const MonteCarloParams& mcParams, const SampleSink& sink) -> void
+		{
+			// the terminal value is exact after a single time step
+			Parallel::streamSamples(2, mcParams, sobolLayout, [&](std::span<double> states, auto& draws, const auto& record) { simulateBatch(states, draws, record, initialState, terminalTime, 2, drift, volatility); }, sink);
+		}
+
+		auto monteCarloTangents(double initialState, double terminalTime, double drift, double volatility, const MonteCarloParams& mcParams, const SampleSink& sink) -> void
+		{
+			Parallel::streamBatches(2, mcParams, sobolLayout, 2 + tangentParameters<BSMParams>(), 0, [&](std::span<double> states, std::span<double> tangents, std::span<double>, auto& draws) { simulateTangentBatch(states, tangents, draws, initialState, terminalTime, 2, drift, volatility); }, sink);
 		}
 
 		// Overloads with Param structs
@@ -78,6 +473,24 @@ namespace SDE
 		{
 			return monteCarloPaths(initialState, terminalTime, samples, timePoints, drift, params.vol);
 		}
+		auto monteCarloPathBlock(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, BSMParams params, PathBlock::Layout layout) -> PathBlock
+		{
+			return monteCarloPathBlock(initialState, terminalTime, samples, timePoints, drift, params.vol, Random::seed(), layout);
+		}
+		auto monteCarlo(double initialState, double terminalTime, double drift, BSMParams params, const MonteCarloParams& mcParams) -> WeightedSamples
+		{
+			return monteCarlo(initialState, terminalTime, drift, params.vol, mcParams);
+		}
+
+		auto monteCarlo(double initialState, double terminalTime, double drift, BSMParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void
+		{
+			monteCarlo(initialState, terminalTime, drift, params.vol, mcParams, sink);
+		}
+
+		auto monteCarloTangents(double initialState, double terminalTime, double drift, BSMParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void
+		{
+			monteCarloTangents(initialState, terminalTime, drift, params.vol, mcParams, sink);
+		}
 	}
 
 	namespace Bachelier
@@ -104,23 +517,127 @@ namespace SDE
 
 		auto monteCarlo(double initialState, double terminalTime, std::size_t samples, double drift, double volatility) -> XYVals
 		{
-			XYVals mcSamples{ samples };
-			for (std::size_t i{ 0 }; i < samples; i++)
-			{
-				mcSamples.m_xVals[i] = static_cast<double>(i);
-				mcSamples.m_yVals[i] = simulate(initialState, terminalTime, drift, volatility);
-			}
-			return mcSamples;
+			return monteCarlo(initialState, terminalTime, samples, drift, volatility, Random::seed());
 		}
 
 		auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double volatility) -> DataTable
 		{
-			DataTable paths(samples, timePoints);
-			for (std::size_t num{ 0 }; num < samples; ++num)
+			return monteCarloPaths(initialState, terminalTime, samples, timePoints, drift, volatility, Random::seed());
+		}
+
+		// overloads drawing from a given random stream
+		auto simulate(double initialState, double time, double drift, double volatility, Random::Stream& stream) -> double
+		{
+			return initialState * std::exp(drift*time) + volatility*std::sqrt(1./2./drift*(std::exp(2*drift*time)-1.)) * stream.normal();
+		}
+		// advances all lanes of a batch by one time step
+		auto stepBatch(std::span<double> states, double time, double drift, double volatility, std::span<const double> normals) -> void
+		{
+			double growth{ std::exp(drift * time) };
+			double diffusion{ volatility * std::sqrt(1. / 2. / drift * (std::exp(2 * drift * time) - 1.)) };
+			for (std::size_t j{ 0 }; j < std::size(states); ++j)
 			{
-				paths.m_table[num] = path(initialState, terminalTime, timePoints, drift, volatility).m_yVals;
+				states[j] = states[j] * growth + diffusion * normals[j];
 			}
-			return paths;
+		}
+		// advances all lanes of a batch and their tangents by one time step
+		auto stepBatch(std::span<double> states, std::span<double> tangents, double time, double drift, double volatility, std::span<const double> normals) -> void
+		{
+			std::size_t lanes{ std::size(states) };
+			double growth{ std::exp(drift * time) };
+			double diffusionPerVol{ std::sqrt(1. / 2. / drift * (std::exp(2 * drift * time) - 1.)) };
+			double diffusion{ volatility * diffusionPerVol };
+			for (std::size_t j{ 0 }; j < lanes; ++j)
+			{
+				states[j] = states[j] * growth + diffusion * normals[j];
+				tangents[j] *= growth;
+				tangents[lanes + j] *= growth;
+				tangents[2 * lanes + j] = tangents[2 * lanes + j] * growth + diffusionPerVol * normals[j];
+			}
+		}
+		// draws per time step of simulateBatch for Sobol points
+		const std::array<QMC::Dimension, 1> sobolLayout{ QMC::Dimension::brownian };
+		// runs the lanes of a batch through all time steps, record(timeIndex, states) is called after every step
+		auto simulateBatch(std::span<double> states, auto& draws, const auto& record, double initialState, double terminalTime, std::size_t timePoints, double drift, double volatility) -> void
+		{
+			std::vector<double> normals(std::size(states));
+			std::fill(states.begin(), states.end(), initialState);
+			record(0, states);
+			double time{ terminalTime / static_cast<double>(timePoints - 1) };
+			for (std::size_t i{ 1 }; i < timePoints; ++i)
+			{
+				draws.normals(normals);
+				stepBatch(states, time, drift, volatility, normals);
+				record(i, states);
+			}
+		}
+		// runs the lanes of a batch and their tangents through all time steps with the draws of simulateBatch
+		auto simulateTangentBatch(std::span<double> states, std::span<double> tangents, auto& draws, double initialState, double terminalTime, std::size_t timePoints, double drift, double volatility) -> void
+		{
+			std::vector<double> normals(std::size(states));
+			std::fill(states.begin(), states.end(), initialState);
+			Parallel::initialTangents(tangents, std::size(states));
+			double time{ terminalTime / static_cast<double>(timePoints - 1) };
+			for (std::size_t i{ 1 }; i < timePoints; ++i)
+			{
+				draws.normals(normals);
+				stepBatch(states, tangents, time, drift, volatility, normals);
+			}
+		}
+		auto fillPath(StridedView<double> spath, double initialState, double terminalTime, double drift, double volatility, Random::Stream& stream) -> void
+		{
+			spath[0] = initialState;
+			double time{ terminalTime / static_cast<double>(spath.size() - 1) };
+			for (std::size_t i{ 1 }; i < spath.size(); ++i)
+			{
+				spath[i] = simulate(spath[i - 1], time, drift, volatility, stream);
+			}
+		}
+		auto path(double initialState, double terminalTime, std::size_t timePoints, double drift, double volatility, Random::Stream& stream) -> XYVals
+		{
+			return Parallel::path(terminalTime, timePoints, [&](StridedView<double> spath) { fillPath(spath, initialState, terminalTime, drift, volatility, stream); });
+		}
+		auto monteCarlo(double initialState, double terminalTime, std::size_t samples, double drift, double volatility, std::uint64_t seed, std::string_view sampling) -> XYVals
+		{
+			if (sampling == "sobol")
+			{
+				// the terminal value is exact after a single time step
+				return Parallel::batchSamples(samples, 2, seed, sobolLayout, sampling, [&](std::span<double> states, auto& draws, const auto& record) { simulateBatch(states, draws, record, initialState, terminalTime, 2, drift, volatility); });
+			}
+			return Parallel::samples(samples, seed, [&](Random::Stream& stream) { return simulate(initialState, terminalTime, drift, volatility, stream); });
+		}
+		auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double volatility, std::uint64_t seed, std::string_view sampling) -> DataTable
+		{
+			if (sampling == "sobol")
+			{
+				return monteCarloPathBlock(initialState, terminalTime, samples, timePoints, drift, volatility, seed, PathBlock::Layout::pathMajor, sampling).toDataTable();
+			}
+			return Parallel::paths(samples, timePoints, seed, [&](StridedView<double> spath, Random::Stream& stream) { fillPath(spath, initialState, terminalTime, drift, volatility, stream); });
+		}
+		auto monteCarloPathBlock(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double volatility, std::uint64_t seed, PathBlock::Layout layout, std::string_view sampling) -> PathBlock
+		{
+			if (layout == PathBlock::Layout::timeMajor || sampling == "sobol")
+			{
+				return Parallel::batchPathBlock(samples, timePoints, terminalTime, layout, seed, sobolLayout, sampling, [&](std::span<double> states, auto& draws, const auto& record) { simulateBatch(states, draws, record, initialState, terminalTime, timePoints, drift, volatility); });
+			}
+			return Parallel::pathBlock(samples, timePoints, terminalTime, layout, seed, [&](StridedView<double> spath, Random::Stream& stream) { fillPath(spath, initialState, terminalTime, drift, volatility, stream); });
+		}
+		// terminal states with the variance reduction of mcParams
+		auto monteCarlo(double initialState, double terminalTime, double drift, double volatility, const MonteCarloParams& mcParams) -> WeightedSamples
+		{
+			// the terminal value is exact after a single time step
+			return Parallel::weightedSamples(2, mcParams, sobolLayout, [&](std::span<double> states, auto& draws, const auto& record) { simulateBatch(states, draws, record, initialState, terminalTime, 2, drift, volatility); });
+		}
+
+		auto monteCarlo(double initialState, double terminalTime, double drift, double volatility, const MonteCarloParams& mcParams, const SampleSink& sink) -> void
+		{
+			// the terminal value is exact after a single time step
+			Parallel::streamSamples(2, mcParams, sobolLayout, [&](std::span<double> states, auto& draws, const auto& record) { simulateBatch(states, draws, record, initialState, terminalTime, 2, drift, volatility); }, sink);
+		}
+
+		auto monteCarloTangents(double initialState, double terminalTime, double drift, double volatility, const MonteCarloParams& mcParams, const SampleSink& sink) -> void
+		{
+			Parallel::streamBatches(2, mcParams, sobolLayout, 2 + tangentParameters<BachelierParams>(), 0, [&](std::span<double> states, std::span<double> tangents, std::span<double>, auto& draws) { simulateTangentBatch(states, tangents, draws, initialState, terminalTime, 2, drift, volatility); }, sink);
 		}
 
 		// Overloads with Param structs
@@ -140,6 +657,24 @@ namespace SDE
 		{
 			return monteCarloPaths(initialState, terminalTime, samples, timePoints, drift, params.vol);
 		}
+		auto monteCarloPathBlock(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, BachelierParams params, PathBlock::Layout layout) -> PathBlock
+		{
+			return monteCarloPathBlock(initialState, terminalTime, samples, timePoints, drift, params.vol, Random::seed(), layout);
+		}
+		auto monteCarlo(double initialState, double terminalTime, double drift, BachelierParams params, const MonteCarloParams& mcParams) -> WeightedSamples
+		{
+			return monteCarlo(initialState, terminalTime, drift, params.vol, mcParams);
+		}
+
+		auto monteCarlo(double initialState, double terminalTime, double drift, BachelierParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void
+		{
+			monteCarlo(initialState, terminalTime, drift, params.vol, mcParams, sink);
+		}
+
+		auto monteCarloTangents(double initialState, double terminalTime, double drift, BachelierParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void
+		{
+			monteCarloTangents(initialState, terminalTime, drift, params.vol, mcParams, sink);
+		}
 	}
 
 	namespace CEV
@@ -173,28 +708,149 @@ namespace SDE
 
 		auto monteCarlo(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double volatility, double exponent) -> XYVals
 		{
-			XYVals mcSamples{ samples };
+			return monteCarlo(initialState, terminalTime, samples, timePoints, drift, volatility, exponent, Random::seed());
+		}
 
-			// initialize samples with initial state
-			mcSamples.m_yVals = std::vector<double>(samples, initialState);
+		auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double volatility, double exponent) -> DataTable
+		{
+			return monteCarloPaths(initialState, terminalTime, samples, timePoints, drift, volatility, exponent, Random::seed());
+		}
 
-			for (std::size_t i{ 0 }; i < samples; i++)
+		// overloads drawing from a given random stream
+		auto step(double state, double time, double drift, double volatility, double exponent, Random::Stream& stream) -> double
+		{
+			double nextState{};
+			double Z{ stream.normal() };
+			// Euler Maruyama
+			nextState = state + time * drift * state + std::sqrt(time) * volatility * std::pow(state, exponent) * Z;
+			// Milstein
+			nextState += 0.5 * volatility * volatility * exponent * std::pow(state, 2 * exponent - 1) * time * (Z * Z - 1.);
+			return std::max(nextState, 0.0); // max necessary for stable simulation due to step size
+		}
+		// advances all lanes of a batch by one time step
+		auto stepBatch(std::span<double> states, double time, double drift, double volatility, double exponent, std::span<const double> normals) -> void
+		{
+			for (std::size_t j{ 0 }; j < std::size(states); ++j)
 			{
-				mcSamples.m_xVals[i] = static_cast<double>(i);
-				XYVals spath{ path(initialState, terminalTime, timePoints, drift, volatility, exponent) };
-				mcSamples.m_yVals[i] = spath.m_yVals.back();
+				double state{ states[j] };
+				double Z{ normals[j] };
+				// Euler Maruyama
+				double nextState{ state + time * drift * state + std::sqrt(time) * volatility * std::pow(state, exponent) * Z };
+				// Milstein
+				nextState += 0.5 * volatility * volatility * exponent * std::pow(state, 2 * exponent - 1) * time * (Z * Z - 1.);
+				states[j] = std::max(nextState, 0.0);
 			}
-			return mcSamples;
 		}
-
-		auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double volatility, double exponent) -> DataTable
+		// advances all lanes of a batch and their tangents by one time step, a is the derivative of the next state by the state
+		auto stepBatch(std::span<double> states, std::span<double> tangents, double time, double drift, double volatility, double exponent, std::span<const double> normals) -> void
 		{
-			DataTable paths(samples, timePoints);
-			for (std::size_t num{ 0 }; num < samples; ++num)
+			std::size_t lanes{ std::size(states) };
+			for (std::size_t j{ 0 }; j < lanes; ++j)
 			{
-				paths.m_table[num] = path(initialState, terminalTime, timePoints, drift, volatility, exponent).m_yVals;
+				double state{ states[j] };
+				double Z{ normals[j] };
+				// Euler Maruyama
+				double nextState{ state + time * drift * state + std::sqrt(time) * volatility * std::pow(state, exponent) * Z };
+				// Milstein
+				nextState += 0.5 * volatility * volatility * exponent * std::pow(state, 2 * exponent - 1) * time * (Z * Z - 1.);
+				states[j] = std::max(nextState, 0.0);
+				if (state <= 0.0 || nextState <= 0.0)
+				{
+					// absorbed or clamped lanes no longer move with the parameters
+					for (std::size_t r{ 0 }; r < 4; ++r) { tangents[r * lanes + j] = 0.0; }
+					continue;
+				}
+				double logState{ std::log(state) };
+				double milstein{ 0.5 * volatility * volatility * time * (Z * Z - 1.) };
+				double a{ 1 + time * drift + std::sqrt(time) * volatility * exponent * std::pow(state, exponent - 1) * Z
+					+ milstein * exponent * (2 * exponent - 1) * std::pow(state, 2 * exponent - 2) };
+				double aPrime{ std::sqrt(time) * volatility * exponent * (exponent - 1) * std::pow(state, exponent - 2) * Z
+					+ milstein * exponent * (2 * exponent - 1) * (2 * exponent - 2) * std::pow(state, 2 * exponent - 3) };
+				double byVol{ std::sqrt(time) * std::pow(state, exponent) * Z + volatility * time * (Z * Z - 1.) * exponent * std::pow(state, 2 * exponent - 1) };
+				double byExponent{ std::sqrt(time) * volatility * std::pow(state, exponent) * logState * Z + milstein * std::pow(state, 2 * exponent - 1) * (1 + 2 * exponent * logState) };
+				double spotTangent{ tangents[j] };
+				tangents[j] = a * spotTangent;
+				tangents[lanes + j] = a * tangents[lanes + j] + aPrime * spotTangent * spotTangent;
+				tangents[2 * lanes + j] = a * tangents[2 * lanes + j] + byVol;
+				tangents[3 * lanes + j] = a * tangents[3 * lanes + j] + byExponent;
 			}
-			return paths;
+		}
+		// draws per time step of simulateBatch for Sobol points
+		const std::array<QMC::Dimension, 1> sobolLayout{ QMC::Dimension::brownian };
+		// runs the lanes of a batch through all time steps, record(timeIndex, states) is called after every step
+		auto simulateBatch(std::span<double> states, auto& draws, const auto& record, double initialState, double terminalTime, std::size_t timePoints, double drift, double volatility, double exponent) -> void
+		{
+			std::vector<double> normals(std::size(states));
+			std::fill(states.begin(), states.end(), initialState);
+			record(0, states);
+			double time{ terminalTime / static_cast<double>(timePoints - 1) };
+			for (std::size_t i{ 1 }; i < timePoints; ++i)
+			{
+				draws.normals(normals);
+				stepBatch(states, time, drift, volatility, exponent, normals);
+				record(i, states);
+			}
+		}
+		// runs the lanes of a batch and their tangents through all time steps with the draws of simulateBatch
+		auto simulateTangentBatch(std::span<double> states, std::span<double> tangents, auto& draws, double initialState, double terminalTime, std::size_t timePoints, double drift, double volatility, double exponent) -> void
+		{
+			std::vector<double> normals(std::size(states));
+			std::fill(states.begin(), states.end(), initialState);
+			Parallel::initialTangents(tangents, std::size(states));
+			double time{ terminalTime / static_cast<double>(timePoints - 1) };
+			for (std::size_t i{ 1 }; i < timePoints; ++i)
+			{
+				draws.normals(normals);
+				stepBatch(states, tangents, time, drift, volatility, exponent, normals);
+			}
+		}
+		auto fillPath(StridedView<double> spath, double initialState, double terminalTime, double drift, double volatility, double exponent, Random::Stream& stream) -> void
+		{
+			spath[0] = initialState;
+			double time{ terminalTime / static_cast<double>(spath.size() - 1) };
+			for (std::size_t i{ 1 }; i < spath.size(); ++i)
+			{
+				spath[i] = step(spath[i - 1], time, drift, volatility, exponent, stream);
+			}
+		}
+		auto path(double initialState, double terminalTime, std::size_t timePoints, double drift, double volatility, double exponent, Random::Stream& stream) -> XYVals
+		{
+			return Parallel::path(terminalTime, timePoints, [&](StridedView<double> spath) { fillPath(spath, initialState, terminalTime, drift, volatility, exponent, stream); });
+		}
+		auto monteCarlo(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double volatility, double exponent, std::uint64_t seed, std::string_view sampling) -> XYVals
+		{
+			return Parallel::batchSamples(samples, timePoints, seed, sobolLayout, sampling, [&](std::span<double> states, auto& draws, const auto& record) { simulateBatch(states, draws, record, initialState, terminalTime, timePoints, drift, volatility, exponent); });
+		}
+		auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double volatility, double exponent, std::uint64_t seed, std::string_view sampling) -> DataTable
+		{
+			if (sampling == "sobol")
+			{
+				return monteCarloPathBlock(initialState, terminalTime, samples, timePoints, drift, volatility, exponent, seed, PathBlock::Layout::pathMajor, sampling).toDataTable();
+			}
+			return Parallel::paths(samples, timePoints, seed, [&](StridedView<double> spath, Random::Stream& stream) { fillPath(spath, initialState, terminalTime, drift, volatility, exponent, stream); });
+		}
+		auto monteCarloPathBlock(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double volatility, double exponent, std::uint64_t seed, PathBlock::Layout layout, std::string_view sampling) -> PathBlock
+		{
+			if (layout == PathBlock::Layout::timeMajor || sampling == "sobol")
+			{
+				return Parallel::batchPathBlock(samples, timePoints, terminalTime, layout, seed, sobolLayout, sampling, [&](std::span<double> states, auto& draws, const auto& record) { simulateBatch(states, draws, record, initialState, terminalTime, timePoints, drift, volatility, exponent); });
+			}
+			return Parallel::pathBlock(samples, timePoints, terminalTime, layout, seed, [&](StridedView<double> spath, Random::Stream& stream) { fillPath(spath, initialState, terminalTime, drift, volatility, exponent, stream); });
+		}
+		// terminal states with the variance reduction of mcParams
+		auto monteCarlo(double initialState, double terminalTime, double drift, double volatility, double exponent, const MonteCarloParams& mcParams) -> WeightedSamples
+		{
+			return Parallel::weightedSamples(mcParams.timePoints, mcParams, sobolLayout, [&](std::span<double> states, auto& draws, const auto& record) { simulateBatch(states, draws, record, initialState, terminalTime, mcParams.timePoints, drift, volatility, exponent); });
+		}
+
+		auto monteCarlo(double initialState, double terminalTime, double drift, double volatility, double exponent, const MonteCarloParams& mcParams, const SampleSink& sink) -> void
+		{
+			Parallel::streamSamples(mcParams.timePoints, mcParams, sobolLayout, [&](std::span<double> states, auto& draws, const auto& record) { simulateBatch(states, draws, record, initialState, terminalTime, mcParams.timePoints, drift, volatility, exponent); }, sink);
+		}
+
+		auto monteCarloTangents(double initialState, double terminalTime, double drift, double volatility, double exponent, const MonteCarloParams& mcParams, const SampleSink& sink) -> void
+		{
+			Parallel::streamBatches(mcParams.timePoints, mcParams, sobolLayout, 2 + tangentParameters<CEVParams>(), 0, [&](std::span<double> states, std::span<double> tangents, std::span<double>, auto& draws) { simulateTangentBatch(states, tangents, draws, initialState, terminalTime, mcParams.timePoints, drift, volatility, exponent); }, sink);
 		}
 
 		// overloads for param structs
@@ -210,6 +866,24 @@ namespace SDE
 		{
 			return monteCarloPaths(initialState, terminalTime, samples, timePoints, drift, params.vol, params.exponent);
 		}
+		auto monteCarloPathBlock(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, CEVParams params, PathBlock::Layout layout) -> PathBlock
+		{
+			return monteCarloPathBlock(initialState, terminalTime, samples, timePoints, drift, params.vol, params.exponent, Random::seed(), layout);
+		}
+		auto monteCarlo(double initialState, double terminalTime, double drift, CEVParams params, const MonteCarloParams& mcParams) -> WeightedSamples
+		{
+			return monteCarlo(initialState, terminalTime, drift, params.vol, params.exponent, mcParams);
+		}
+
+		auto monteCarlo(double initialState, double terminalTime, double drift, CEVParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void
+		{
+			monteCarlo(initialState, terminalTime, drift, params.vol, params.exponent, mcParams, sink);
+		}
+
+		auto monteCarloTangents(double initialState, double terminalTime, double drift, CEVParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void
+		{
+			monteCarloTangents(initialState, terminalTime, drift, params.vol, params.exponent, mcParams, sink);
+		}
 
 	}
 
@@ -252,23 +926,166 @@ namespace SDE
 		}
 		auto monteCarlo(double initialState, double terminalTime, std::size_t samples, double drift, double volatility, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear) -> XYVals
 		{
-			XYVals mcSamples{ samples };
-			for (std::size_t i{ 0 }; i < samples; i++)
+			return monteCarlo(initialState, terminalTime, samples, drift, volatility, meanJumpSize, stdJumpSize, expectedJumpsPerYear, Random::seed());
+		}
+		auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double volatility, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear) -> DataTable
+		{
+			return monteCarloPaths(initialState, terminalTime, samples, timePoints, drift, volatility, meanJumpSize, stdJumpSize, expectedJumpsPerYear, Random::seed());
+		}
+
+		// overloads drawing from a given random stream
+		auto simulate(double initialState, double time, double drift, double volatility, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear, Random::Stream& stream) -> double
+		{
+			// Drift correction term
+			double correctedDrift{ drift - 0.5 * volatility * volatility
+				- expectedJumpsPerYear * (std::exp(meanJumpSize + 0.5 * stdJumpSize * stdJumpSize) - 1) };
+
+			// Diffusion term
+			double diffusion{ volatility * std::sqrt(time) * stream.normal() };
+
+			// Number of jumps (Poisson-distributed)
+			int numJumps{ stream.poisson(expectedJumpsPerYear * time) };
+
+			// Jump term, the sum of numJumps normal log-jumps is normal itself and takes a single draw
+			double jumps{ static_cast<double>(numJumps) };
+			double jumpTerm{ jumps * meanJumpSize + std::sqrt(jumps) * stdJumpSize * stream.normal() };
+
+			// Final price
+			return initialState * std::exp(correctedDrift * time + diffusion + jumpTerm);
+		}
+		// advances all lanes of a batch by one time step, jumpTerms holds the summed log jumps of each lane
+		auto stepBatch(std::span<double> states, double time, double drift, double volatility, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear, std::span<const double> normals, std::span<const double> jumpTerms) -> void
+		{
+			double correctedDrift{ drift - 0.5 * volatility * volatility
+				- expectedJumpsPerYear * (std::exp(meanJumpSize + 0.5 * stdJumpSize * stdJumpSize) - 1) };
+			double diffusionScale{ volatility * std::sqrt(time) };
+			for (std::size_t j{ 0 }; j < std::size(states); ++j)
 			{
-				mcSamples.m_xVals[i] = static_cast<double>(i);
-				mcSamples.m_yVals[i] = simulate(initialState, terminalTime, drift, volatility, meanJumpSize, stdJumpSize, expectedJumpsPerYear);
+				states[j] = states[j] * std::exp(correctedDrift * time + diffusionScale * normals[j] + jumpTerms[j]);
 			}
-			return mcSamples;
 		}
-
-		auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double volatility, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear) -> DataTable
+		// advances all lanes of a batch, their tangents and their scores by one time step. The number of jumps does not move
+		// with the intensity along a path, its Poisson distribution does, which the score of the intensity accounts for.
+		auto stepBatch(std::span<double> states, std::span<double> tangents, std::span<double> scores, double time, double drift, double volatility, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear, std::span<const double> normals, std::span<const int> numJumps, std::span<const double> jumpNormals) -> void
 		{
-			DataTable paths(samples, timePoints);
-			for (std::size_t num{ 0 }; num < samples; ++num)
+			std::size_t lanes{ std::size(states) };
+			double jumpMean{ std::exp(meanJumpSize + 0.5 * stdJumpSize * stdJumpSize) };
+			double correctedDrift{ drift - 0.5 * volatility * volatility
+				- expectedJumpsPerYear * (std::exp(meanJumpSize + 0.5 * stdJumpSize * stdJumpSize) - 1) };
+			double diffusionScale{ volatility * std::sqrt(time) };
+			for (std::size_t j{ 0 }; j < lanes; ++j)
 			{
-				paths.m_table[num] = path(initialState, terminalTime, timePoints, drift, volatility, meanJumpSize, stdJumpSize, expectedJumpsPerYear).m_yVals;
+				double jumps{ static_cast<double>(numJumps[j]) };
+				double jumpTerm{ jumps * meanJumpSize + std::sqrt(jumps) * stdJumpSize * jumpNormals[j] };
+				double growth{ std::exp(correctedDrift * time + diffusionScale * normals[j] + jumpTerm) };
+				states[j] = states[j] * growth;
+				tangents[j] *= growth;
+				tangents[lanes + j] *= growth;
+				tangents[2 * lanes + j] = tangents[2 * lanes + j] * growth + states[j] * (std::sqrt(time) * normals[j] - volatility * time);
+				tangents[3 * lanes + j] = tangents[3 * lanes + j] * growth + states[j] * (jumps - expectedJumpsPerYear * time * jumpMean);
+				tangents[4 * lanes + j] = tangents[4 * lanes + j] * growth + states[j] * (std::sqrt(jumps) * jumpNormals[j] - expectedJumpsPerYear * time * stdJumpSize * jumpMean);
+				tangents[5 * lanes + j] = tangents[5 * lanes + j] * growth - states[j] * (jumpMean - 1) * time;
+				scores[3 * lanes + j] += ((expectedJumpsPerYear > 0.0) ? jumps / expectedJumpsPerYear : 0.0) - time;
 			}
-			return paths;
+		}
+		// draws per time step of simulateBatch for Sobol points: diffusion, number of jumps and jump size
+		const std::array<QMC::Dimension, 3> sobolLayout{ QMC::Dimension::brownian, QMC::Dimension::independent, QMC::Dimension::independent };
+		// runs the lanes of a batch through all time steps, record(timeIndex, states) is called after every step
+		auto simulateBatch(std::span<double> states, auto& draws, const auto& record, double initialState, double terminalTime, std::size_t timePoints, double drift, double volatility, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear) -> void
+		{
+			std::vector<double> normals(std::size(states));
+			std::vector<int> numJumps(std::size(states));
+			std::vector<double> jumpTerms(std::size(states));
+			std::fill(states.begin(), states.end(), initialState);
+			record(0, states);
+			double time{ terminalTime / static_cast<double>(timePoints - 1) };
+			for (std::size_t i{ 1 }; i < timePoints; ++i)
+			{
+				// diffusion normal, number of jumps and jump normal in the order of simulate
+				draws.normals(normals);
+				draws.poissons(numJumps, expectedJumpsPerYear * time);
+				draws.normals(jumpTerms);
+				for (std::size_t j{ 0 }; j < std::size(states); ++j)
+				{
+					double jumps{ static_cast<double>(numJumps[j]) };
+					jumpTerms[j] = jumps * meanJumpSize + std::sqrt(jumps) * stdJumpSize * jumpTerms[j];
+				}
+				stepBatch(states, time, drift, volatility, meanJumpSize, stdJumpSize, expectedJumpsPerYear, normals, jumpTerms);
+				record(i, states);
+			}
+		}
+		// runs the lanes of a batch, their tangents and their scores through all time steps with the draws of simulateBatch
+		auto simulateTangentBatch(std::span<double> states, std::span<double> tangents, std::span<double> scores, auto& draws, double initialState, double terminalTime, std::size_t timePoints, double drift, double volatility, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear) -> void
+		{
+			std::vector<double> normals(std::size(states));
+			std::vector<int> numJumps(std::size(states));
+			std::vector<double> jumpNormals(std::size(states));
+			std::fill(states.begin(), states.end(), initialState);
+			Parallel::initialTangents(tangents, std::size(states));
+			std::fill(scores.begin(), scores.end(), 0.0);
+			double time{ terminalTime / static_cast<double>(timePoints - 1) };
+			for (std::size_t i{ 1 }; i < timePoints; ++i)
+			{
+				draws.normals(normals);
+				draws.poissons(numJumps, expectedJumpsPerYear * time);
+				draws.normals(jumpNormals);
+				stepBatch(states, tangents, scores, time, drift, volatility, meanJumpSize, stdJumpSize, expectedJumpsPerYear, normals, numJumps, jumpNormals);
+			}
+		}
+		auto fillPath(StridedView<double> spath, double initialState, double terminalTime, double drift, double volatility, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear, Random::Stream& stream) -> void
+		{
+			spath[0] = initialState;
+			double time{ terminalTime / static_cast<double>(spath.size() - 1) };
+			for (std::size_t i{ 1 }; i < spath.size(); ++i)
+			{
+				spath[i] = simulate(spath[i - 1], time, drift, volatility, meanJumpSize, stdJumpSize, expectedJumpsPerYear, stream);
+			}
+		}
+		auto path(double initialState, double terminalTime, std::size_t timePoints, double drift, double volatility, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear, Random::Stream& stream) -> XYVals
+		{
+			return Parallel::path(terminalTime, timePoints, [&](StridedView<double> spath) { fillPath(spath, initialState, terminalTime, drift, volatility, meanJumpSize, stdJumpSize, expectedJumpsPerYear, stream); });
+		}
+		auto monteCarlo(double initialState, double terminalTime, std::size_t samples, double drift, double volatility, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear, std::uint64_t seed, std::string_view sampling) -> XYVals
+		{
+			if (sampling == "sobol")
+			{
+				// the terminal value is exact after a single time step
+				return Parallel::batchSamples(samples, 2, seed, sobolLayout, sampling, [&](std::span<double> states, auto& draws, const auto& record) { simulateBatch(states, draws, record, initialState, terminalTime, 2, drift, volatility, meanJumpSize, stdJumpSize, expectedJumpsPerYear); });
+			}
+			return Parallel::samples(samples, seed, [&](Random::Stream& stream) { return simulate(initialState, terminalTime, drift, volatility, meanJumpSize, stdJumpSize, expectedJumpsPerYear, stream); });
+		}
+		auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double volatility, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear, std::uint64_t seed, std::string_view sampling) -> DataTable
+		{
+			if (sampling == "sobol")
+			{
+				return monteCarloPathBlock(initialState, terminalTime, samples, timePoints, drift, volatility, meanJumpSize, stdJumpSize, expectedJumpsPerYear, seed, PathBlock::Layout::pathMajor, sampling).toDataTable();
+			}
+			return Parallel::paths(samples, timePoints, seed, [&](StridedView<double> spath, Random::Stream& stream) { fillPath(spath, initialState, terminalTime, drift, volatility, meanJumpSize, stdJumpSize, expectedJumpsPerYear, stream); });
+		}
+		auto monteCarloPathBlock(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double volatility, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear, std::uint64_t seed, PathBlock::Layout layout, std::string_view sampling) -> PathBlock
+		{
+			if (layout == PathBlock::Layout::timeMajor || sampling == "sobol")
+			{
+				return Parallel::batchPathBlock(samples, timePoints, terminalTime, layout, seed, sobolLayout, sampling, [&](std::span<double> states, auto& draws, const auto& record) { simulateBatch(states, draws, record, initialState, terminalTime, timePoints, drift, volatility, meanJumpSize, stdJumpSize, expectedJumpsPerYear); });
+			}
+			return Parallel::pathBlock(samples, timePoints, terminalTime, layout, seed, [&](StridedView<double> spath, Random::Stream& stream) { fillPath(spath, initialState, terminalTime, drift, volatility, meanJumpSize, stdJumpSize, expectedJumpsPerYear, stream); });
+		}
+		// terminal states with the variance reduction of mcParams
+		auto monteCarlo(double initialState, double terminalTime, double drift, double volatility, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear, const MonteCarloParams& mcParams) -> WeightedSamples
+		{
+			// the terminal value is exact after a single time step
+			return Parallel::weightedSamples(2, mcParams, sobolLayout, [&](std::span<double> states, auto& draws, const auto& record) { simulateBatch(states, draws, record, initialState, terminalTime, 2, drift, volatility, meanJumpSize, stdJumpSize, expectedJumpsPerYear); });
+		}
+
+		auto monteCarlo(double initialState, double terminalTime, double drift, double volatility, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear, const MonteCarloParams& mcParams, const SampleSink& sink) -> void
+		{
+			// the terminal value is exact after a single time step
+			Parallel::streamSamples(2, mcParams, sobolLayout, [&](std::span<double> states, auto& draws, const auto& record) { simulateBatch(states, draws, record, initialState, terminalTime, 2, drift, volatility, meanJumpSize, stdJumpSize, expectedJumpsPerYear); }, sink);
+		}
+
+		auto monteCarloTangents(double initialState, double terminalTime, double drift, double volatility, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear, const MonteCarloParams& mcParams, const SampleSink& sink) -> void
+		{
+			Parallel::streamBatches(2, mcParams, sobolLayout, 2 + tangentParameters<MertonJumpParams>(), tangentParameters<MertonJumpParams>(), [&](std::span<double> states, std::span<double> tangents, std::span<double> scores, auto& draws) { simulateTangentBatch(states, tangents, scores, draws, initialState, terminalTime, 2, drift, volatility, meanJumpSize, stdJumpSize, expectedJumpsPerYear); }, sink);
 		}
 
 		// Overloads with Param structs
@@ -288,20 +1105,42 @@ namespace SDE
 		{
 			return monteCarloPaths(initialState, terminalTime, samples, timePoints, drift, params.vol, params.meanJumpSize, params.stdJumpSize, params.expectedJumpsPerYear);
 		}
+		auto monteCarloPathBlock(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, MertonJumpParams params, PathBlock::Layout layout) -> PathBlock
+		{
+			return monteCarloPathBlock(initialState, terminalTime, samples, timePoints, drift, params.vol, params.meanJumpSize, params.stdJumpSize, params.expectedJumpsPerYear, Random::seed(), layout);
+		}
+		auto monteCarlo(double initialState, double terminalTime, double drift, MertonJumpParams params, const MonteCarloParams& mcParams) -> WeightedSamples
+		{
+			return monteCarlo(initialState, terminalTime, drift, params.vol, params.meanJumpSize, params.stdJumpSize, params.expectedJumpsPerYear, mcParams);
+		}
+
+		auto monteCarlo(double initialState, double terminalTime, double drift, MertonJumpParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void
+		{
+			monteCarlo(initialState, terminalTime, drift, params.vol, params.meanJumpSize, params.stdJumpSize, params.expectedJumpsPerYear, mcParams, sink);
+		}
+
+		auto monteCarloTangents(double initialState, double terminalTime, double drift, MertonJumpParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void
+		{
+			monteCarloTangents(initialState, terminalTime, drift, params.vol, params.meanJumpSize, params.stdJumpSize, params.expectedJumpsPerYear, mcParams, sink);
+		}
 	}
 
 
 	namespace Heston
 	{
 		// TODO: This can be made exact like the price step, since this is an OU process
+		// Full truncation Euler step (Lord, Koekkoek and van Dijk): the variance may become negative and only its positive part
+		// enters the drift, the diffusion and the price step. Its bias is far smaller than that of reflecting the variance at zero.
 		auto varianceStep(double initialVariance, double stepSize, double longVariance, double correlatedNormal, double reversionRate, double volVol) -> double
 		{
-			return std::abs(initialVariance + stepSize * reversionRate * (longVariance - initialVariance) * stepSize + std::sqrt(stepSize * initialVariance) * volVol * correlatedNormal);
+			double variance{ std::max(initialVariance, 0.0) };
+			return initialVariance + stepSize * reversionRate * (longVariance - variance) + std::sqrt(stepSize * variance) * volVol * correlatedNormal;
 		}
 
 		auto priceStep(double initialState, double stepSize, double drift, double variance, double correlatedNormal) -> double
 		{
 			// return initialState + stepSize * drift * initialState + std::sqrt(stepSize * variance) * correlatedNormal;
+			variance = std::max(variance, 0.0);
 			return initialState * std::exp((drift - variance / 2) * stepSize + std::sqrt(variance) * std::sqrt(stepSize) * correlatedNormal);
 		}
 		// careful: the step is only accurate for very small time steps
@@ -335,33 +1174,187 @@ namespace SDE
 				// make step with variance process for next step
 				var = varianceStep(var, time, longVariance, increment2, reversionRate, volVol);
 			}
-			return spath;
+			return spath;
+		}
+
+		auto monteCarlo(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double initialVariance, double longVariance, double correlation, double reversionRate, double volVol) -> XYVals
+		{
+			return monteCarlo(initialState, terminalTime, samples, timePoints, drift, initialVariance, longVariance, correlation, reversionRate, volVol, Random::seed());
+		}
+
+		auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double initialVariance, double longVariance, double correlation, double reversionRate, double volVol) -> DataTable
+		{
+			return monteCarloPaths(initialState, terminalTime, samples, timePoints, drift, initialVariance, longVariance, correlation, reversionRate, volVol, Random::seed());
+		}
+
+		// overloads drawing from a given random stream. The Feller condition is checked once per Monte Carlo run instead of once per path.
+		// advances all lanes of a batch by one time step, spots and variances are updated in place
+		auto stepBatch(std::span<double> spots, std::span<double> variances, double stepSize, double drift, double longVariance, double correlation, double reversionRate, double volVol, std::span<const double> normals1, std::span<const double> normals2) -> void
+		{
+			// the first normal drives the price, the variance normal is correlated to it
+			double independentWeight{ std::sqrt(1 - correlation * correlation) };
+			for (std::size_t j{ 0 }; j < std::size(spots); ++j)
+			{
+				double increment1{ normals1[j] };
+				double increment2{ correlation * normals1[j] + independentWeight * normals2[j] };
+				spots[j] = priceStep(spots[j], stepSize, drift, variances[j], increment1);
+				variances[j] = varianceStep(variances[j], stepSize, longVariance, increment2, reversionRate, volVol);
+			}
+		}
+		// advances all lanes of a batch and their tangents by one time step. Both steps see the variance through its positive
+		// part only, so where it is negative the tangents do not move with it.
+		auto stepBatch(std::span<double> spots, std::span<double> variances, std::span<double> spotTangents, std::span<double> varianceTangents, double stepSize, double drift, double longVariance, double correlation, double reversionRate, double volVol, std::span<const double> normals1, std::span<const double> normals2) -> void
+		{
+			std::size_t lanes{ std::size(spots) };
+			double independentWeight{ std::sqrt(1 - correlation * correlation) };
+			// derivative of the variance normal by the correlation, the independent normal is dropped at |correlation| = 1
+			double independentSlope{ (independentWeight > 0.0) ? -correlation / independentWeight : 0.0 };
+			for (std::size_t j{ 0 }; j < lanes; ++j)
+			{
+				double increment1{ normals1[j] };
+				double increment2{ correlation * normals1[j] + independentWeight * normals2[j] };
+				double variance{ variances[j] };
+				double positive{ (variance > 0.0) ? 1.0 : 0.0 };
+				double truncated{ std::max(variance, 0.0) };
+				double sqrtSlope{ (variance > 0.0) ? 0.5 / std::sqrt(variance) : 0.0 };
+				double spot{ spots[j] };
+				spots[j] = priceStep(spot, stepSize, drift, variance, increment1);
+				variances[j] = varianceStep(variance, stepSize, longVariance, increment2, reversionRate, volVol);
+
+				double growth{ spots[j] / spot };
+				double spotByVariance{ spots[j] * (-0.5 * stepSize * positive + std::sqrt(stepSize) * increment1 * sqrtSlope) };
+				double varianceByVariance{ 1 - stepSize * reversionRate * positive + volVol * std::sqrt(stepSize) * increment2 * sqrtSlope };
+				const std::array<double, 5> explicitTerms{ stepSize * (longVariance - truncated), stepSize * reversionRate, std::sqrt(stepSize * truncated) * increment2,
+					std::sqrt(stepSize * truncated) * volVol * (normals1[j] + independentSlope * normals2[j]), 0.0 };
+				spotTangents[j] *= growth;
+				spotTangents[lanes + j] *= growth;
+				for (std::size_t p{ 0 }; p < 5; ++p)
+				{
+					double varianceTangent{ varianceTangents[p * lanes + j] };
+					spotTangents[(2 + p) * lanes + j] = spotTangents[(2 + p) * lanes + j] * growth + spotByVariance * varianceTangent;
+					varianceTangents[p * lanes + j] = varianceByVariance * varianceTangent + explicitTerms[p];
+				}
+			}
+		}
+		// draws per time step of simulateBatch for Sobol points, both normals drive Brownian motions
+		const std::array<QMC::Dimension, 2> sobolLayout{ QMC::Dimension::brownian, QMC::Dimension::brownian };
+		// runs the lanes of a batch through all time steps, record(timeIndex, spots) is called after every step
+		auto simulateBatch(std::span<double> spots, auto& draws, const auto& record, double initialState, double terminalTime, std::size_t timePoints, double drift, double initialVariance, double longVariance, double correlation, double reversionRate, double volVol) -> void
+		{
+			std::vector<double> variances(std::size(spots), initialVariance);
+			std::vector<double> normals1(std::size(spots));
+			std::vector<double> normals2(std::size(spots));
+			std::fill(spots.begin(), spots.end(), initialState);
+			record(0, spots);
+			double time{ terminalTime / static_cast<double>(timePoints - 1) };
+			for (std::size_t i{ 1 }; i < timePoints; ++i)
+			{
+				draws.normals(normals1);
+				draws.normals(normals2);
+				stepBatch(spots, variances, time, drift, longVariance, correlation, reversionRate, volVol, normals1, normals2);
+				record(i, spots);
+			}
+		}
+		// runs the lanes of a batch and their tangents through all time steps with the draws of simulateBatch
+		auto simulateTangentBatch(std::span<double> spots, std::span<double> tangents, auto& draws, double initialState, double terminalTime, std::size_t timePoints, double drift, double initialVariance, double longVariance, double correlation, double reversionRate, double volVol) -> void
+		{
+			std::size_t lanes{ std::size(spots) };
+			std::vector<double> variances(lanes, initialVariance);
+			// the derivatives of the variances by the parameters, the initial variance last
+			std::vector<double> varianceTangents(5 * lanes);
+			std::fill_n(varianceTangents.begin() + static_cast<std::ptrdiff_t>(4 * lanes), lanes, 1.0);
+			std::vector<double> normals1(lanes);
+			std::vector<double> normals2(lanes);
+			std::fill(spots.begin(), spots.end(), initialState);
+			Parallel::initialTangents(tangents, lanes);
+			double time{ terminalTime / static_cast<double>(timePoints - 1) };
+			for (std::size_t i{ 1 }; i < timePoints; ++i)
+			{
+				draws.normals(normals1);
+				draws.normals(normals2);
+				stepBatch(spots, variances, tangents, varianceTangents, time, drift, longVariance, correlation, reversionRate, volVol, normals1, normals2);
+			}
+		}
+		auto fillPath(StridedView<double> spath, double initialState, double terminalTime, double drift, double initialVariance, double longVariance, double correlation, double reversionRate, double volVol, Random::Stream& stream) -> void
+		{
+			spath[0] = initialState;
+			double time{ terminalTime / static_cast<double>(spath.size() - 1) };
+			double var{ initialVariance };
+			for (std::size_t i{ 1 }; i < spath.size(); ++i)
+			{
+				// generate correlated standard normals
+				double normal1{ stream.normal() };
+				double normal2{ stream.normal() };
+				double increment1{ normal1 };
+				double increment2{ correlation * normal1 + std::sqrt(1 - correlation * correlation) * normal2 };
+				// update values
+				spath[i] = priceStep(spath[i - 1], time, drift, var, increment1);
+				// make step with variance process for next step
+				var = varianceStep(var, time, longVariance, increment2, reversionRate, volVol);
+			}
+		}
+		auto path(double initialState, double terminalTime, std::size_t timePoints, double drift, double initialVariance, double longVariance, double correlation, double reversionRate, double volVol, Random::Stream& stream) -> XYVals
+		{
+			return Parallel::path(terminalTime, timePoints, [&](StridedView<double> spath) { fillPath(spath, initialState, terminalTime, drift, initialVariance, longVariance, correlation, reversionRate, volVol, stream); });
+		}
+		auto monteCarlo(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double initialVariance, double longVariance, double correlation, double reversionRate, double volVol, std::uint64_t seed, std::string_view sampling) -> XYVals
+		{
+			if (2 * reversionRate * longVariance <= volVol * volVol)
+			{
+				std::cout << "Warning: Feller condition of Heston model not satisfied, variance can become zero.\n";
+			}
+			return Parallel::batchSamples(samples, timePoints, seed, sobolLayout, sampling, [&](std::span<double> states, auto& draws, const auto& record) { simulateBatch(states, draws, record, initialState, terminalTime, timePoints, drift, initialVariance, longVariance, correlation, reversionRate, volVol); });
+		}
+		auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double initialVariance, double longVariance, double correlation, double reversionRate, double volVol, std::uint64_t seed, std::string_view sampling) -> DataTable
+		{
+			if (sampling == "sobol")
+			{
+				return monteCarloPathBlock(initialState, terminalTime, samples, timePoints, drift, initialVariance, longVariance, correlation, reversionRate, volVol, seed, PathBlock::Layout::pathMajor, sampling).toDataTable();
+			}
+			if (2 * reversionRate * longVariance <= volVol * volVol)
+			{
+				std::cout << "Warning: Feller condition of Heston model not satisfied, variance can become zero.\n";
+			}
+			return Parallel::paths(samples, timePoints, seed, [&](StridedView<double> spath, Random::Stream& stream) { fillPath(spath, initialState, terminalTime, drift, initialVariance, longVariance, correlation, reversionRate, volVol, stream); });
+		}
+		auto monteCarloPathBlock(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double initialVariance, double longVariance, double correlation, double reversionRate, double volVol, std::uint64_t seed, PathBlock::Layout layout, std::string_view sampling) -> PathBlock
+		{
+			if (2 * reversionRate * longVariance <= volVol * volVol)
+			{
+				std::cout << "Warning: Feller condition of Heston model not satisfied, variance can become zero.\n";
+			}
+			if (layout == PathBlock::Layout::timeMajor || sampling == "sobol")
+			{
+				return Parallel::batchPathBlock(samples, timePoints, terminalTime, layout, seed, sobolLayout, sampling, [&](std::span<double> states, auto& draws, const auto& record) { simulateBatch(states, draws, record, initialState, terminalTime, timePoints, drift, initialVariance, longVariance, correlation, reversionRate, volVol); });
+			}
+			return Parallel::pathBlock(samples, timePoints, terminalTime, layout, seed, [&](StridedView<double> spath, Random::Stream& stream) { fillPath(spath, initialState, terminalTime, drift, initialVariance, longVariance, correlation, reversionRate, volVol, stream); });
 		}
-
-		auto monteCarlo(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double initialVariance, double longVariance, double correlation, double reversionRate, double volVol) -> XYVals
+		// terminal states with the variance reduction of mcParams
+		auto monteCarlo(double initialState, double terminalTime, double drift, double initialVariance, double longVariance, double correlation, double reversionRate, double volVol, const MonteCarloParams& mcParams) -> WeightedSamples
 		{
-			XYVals mcSamples{ samples };
-
-			// initialize samples with initial state
-			mcSamples.m_yVals = std::vector<double>(samples, initialState);
+			if (2 * reversionRate * longVariance <= volVol * volVol)
+			{
+				std::cout << "Warning: Feller condition of Heston model not satisfied, variance can become zero.\n";
+			}
+			return Parallel::weightedSamples(mcParams.timePoints, mcParams, sobolLayout, [&](std::span<double> states, auto& draws, const auto& record) { simulateBatch(states, draws, record, initialState, terminalTime, mcParams.timePoints, drift, initialVariance, longVariance, correlation, reversionRate, volVol); });
+		}
 
-			for (std::size_t i{ 0 }; i < samples; i++)
+		auto monteCarlo(double initialState, double terminalTime, double drift, double initialVariance, double longVariance, double correlation, double reversionRate, double volVol, const MonteCarloParams& mcParams, const SampleSink& sink) -> void
+		{
+			if (2 * reversionRate * longVariance <= volVol * volVol)
 			{
-				mcSamples.m_xVals[i] = static_cast<double>(i);
-				XYVals spath{ path(initialState, terminalTime, timePoints, drift, initialVariance, longVariance, correlation, reversionRate, volVol) };
-				mcSamples.m_yVals[i] = spath.m_yVals.back();
+				std::cout << "Warning: Feller condition of Heston model not satisfied, variance can become zero.\n";
 			}
-			return mcSamples;
+			Parallel::streamSamples(mcParams.timePoints, mcParams, sobolLayout, [&](std::span<double> states, auto& draws, const auto& record) { simulateBatch(states, draws, record, initialState, terminalTime, mcParams.timePoints, drift, initialVariance, longVariance, correlation, reversionRate, volVol); }, sink);
 		}
 
-		auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double initialVariance, double longVariance, double correlation, double reversionRate, double volVol) -> DataTable
+		auto monteCarloTangents(double initialState, double terminalTime, double drift, double initialVariance, double longVariance, double correlation, double reversionRate, double volVol, const MonteCarloParams& mcParams, const SampleSink& sink) -> void
 		{
-			DataTable paths(samples, timePoints);
-			for (std::size_t num{ 0 }; num < samples; ++num)
+			if (2 * reversionRate * longVariance <= volVol * volVol)
 			{
-				paths.m_table[num] = path(initialState, terminalTime, timePoints, drift, initialVariance, longVariance, correlation, reversionRate, volVol).m_yVals;
+				std::cout << "Warning: Feller condition of Heston model not satisfied, variance can become zero.\n";
 			}
-			return paths;
+			Parallel::streamBatches(mcParams.timePoints, mcParams, sobolLayout, 2 + tangentParameters<HestonParams>(), 0, [&](std::span<double> states, std::span<double> tangents, std::span<double>, auto& draws) { simulateTangentBatch(states, tangents, draws, initialState, terminalTime, mcParams.timePoints, drift, initialVariance, longVariance, correlation, reversionRate, volVol); }, sink);
 		}
 
 		
@@ -377,6 +1370,24 @@ namespace SDE
 		{
 			return monteCarloPaths(initialState, terminalTime, samples, timePoints, drift, params.initialVariance, params.longVariance, params.correlation, params.reversionRate, params.volVol);
 		}
+		auto monteCarloPathBlock(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, HestonParams params, PathBlock::Layout layout) -> PathBlock
+		{
+			return monteCarloPathBlock(initialState, terminalTime, samples, timePoints, drift, params.initialVariance, params.longVariance, params.correlation, params.reversionRate, params.volVol, Random::seed(), layout);
+		}
+		auto monteCarlo(double initialState, double terminalTime, double drift, HestonParams params, const MonteCarloParams& mcParams) -> WeightedSamples
+		{
+			return monteCarlo(initialState, terminalTime, drift, params.initialVariance, params.longVariance, params.correlation, params.reversionRate, params.volVol, mcParams);
+		}
+
+		auto monteCarlo(double initialState, double terminalTime, double drift, HestonParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void
+		{
+			monteCarlo(initialState, terminalTime, drift, params.initialVariance, params.longVariance, params.correlation, params.reversionRate, params.volVol, mcParams, sink);
+		}
+
+		auto monteCarloTangents(double initialState, double terminalTime, double drift, HestonParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void
+		{
+			monteCarloTangents(initialState, terminalTime, drift, params.initialVariance, params.longVariance, params.correlation, params.reversionRate, params.volVol, mcParams, sink);
+		}
 	}
 
 	namespace VarianceGamma
@@ -408,27 +1419,134 @@ namespace SDE
 		}
 		auto monteCarlo(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double gammaDrift, double variance, double vol) -> XYVals
 		{
-			XYVals mcSamples{ samples };
+			return monteCarlo(initialState, terminalTime, samples, timePoints, drift, gammaDrift, variance, vol, Random::seed());
+		}
 
-			// initialize samples with initial state
-			mcSamples.m_yVals = std::vector<double>(samples, initialState);
+		auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double gammaDrift, double variance, double vol) -> DataTable
+		{
+			return monteCarloPaths(initialState, terminalTime, samples, timePoints, drift, gammaDrift, variance, vol, Random::seed());
+		}
 
-			for (std::size_t i{ 0 }; i < samples; i++)
+		// overloads drawing from a given random stream
+		auto step(double initialState, double stepSize, double drift, double gammaDrift, double variance, double vol, Random::Stream& stream) -> double
+		{
+			double gammaIncrement{ stream.gamma(stepSize / variance, variance) };
+			double normalIncrement{ stream.normal() };
+			double VGIncrement{ gammaDrift * gammaIncrement + vol * std::sqrt(gammaIncrement) * normalIncrement };
+			double omega{ std::log(1 - gammaDrift * variance - vol * vol * variance * 0.5) / variance };
+			double logIncrement{ (drift + omega) * stepSize + VGIncrement };
+			return initialState * std::exp(logIncrement);
+		}
+		// advances all lanes of a batch by one time step
+		auto stepBatch(std::span<double> states, double stepSize, double drift, double gammaDrift, double variance, double vol, std::span<const double> gammaIncrements, std::span<const double> normals) -> void
+		{
+			double omega{ std::log(1 - gammaDrift * variance - vol * vol * variance * 0.5) / variance };
+			double driftTerm{ (drift + omega) * stepSize };
+			for (std::size_t j{ 0 }; j < std::size(states); ++j)
 			{
-				mcSamples.m_xVals[i] = static_cast<double>(i);
-				XYVals spath{ path(initialState, terminalTime, timePoints, drift, gammaDrift, variance, vol) };
-				mcSamples.m_yVals[i] = spath.m_yVals.back();
+				double VGIncrement{ gammaDrift * gammaIncrements[j] + vol * std::sqrt(gammaIncrements[j]) * normals[j] };
+				states[j] = states[j] * std::exp(driftTerm + VGIncrement);
 			}
-			return mcSamples;
 		}
-		auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double gammaDrift, double variance, double vol) -> DataTable
+		// advances all lanes of a batch and their tangents by one time step, the variance only enters through the gamma increments
+		auto stepBatch(std::span<double> states, std::span<double> tangents, double stepSize, double drift, double gammaDrift, double variance, double vol, std::span<const double> gammaIncrements, std::span<const double> normals) -> void
 		{
-			DataTable paths(samples, timePoints);
-			for (std::size_t num{ 0 }; num < samples; ++num)
+			std::size_t lanes{ std::size(states) };
+			double omega{ std::log(1 - gammaDrift * variance - vol * vol * variance * 0.5) / variance };
+			double driftTerm{ (drift + omega) * stepSize };
+			double compensator{ 1 - gammaDrift * variance - vol * vol * variance * 0.5 };
+			for (std::size_t j{ 0 }; j < lanes; ++j)
 			{
-				paths.m_table[num] = path(initialState, terminalTime, timePoints, drift, gammaDrift, variance, vol).m_yVals;
+				double VGIncrement{ gammaDrift * gammaIncrements[j] + vol * std::sqrt(gammaIncrements[j]) * normals[j] };
+				double growth{ std::exp(driftTerm + VGIncrement) };
+				states[j] = states[j] * growth;
+				tangents[j] *= growth;
+				tangents[lanes + j] *= growth;
+				tangents[2 * lanes + j] = tangents[2 * lanes + j] * growth + states[j] * (std::sqrt(gammaIncrements[j]) * normals[j] - vol / compensator * stepSize);
+				tangents[3 * lanes + j] = tangents[3 * lanes + j] * growth + states[j] * (gammaIncrements[j] - stepSize / compensator);
 			}
-			return paths;
+		}
+		// draws per time step of simulateBatch for Sobol points, the gamma time change comes from the streams
+		const std::array<QMC::Dimension, 1> sobolLayout{ QMC::Dimension::brownian };
+		// runs the lanes of a batch through all time steps, record(timeIndex, states) is called after every step
+		auto simulateBatch(std::span<double> states, auto& draws, const auto& record, double initialState, double terminalTime, std::size_t timePoints, double drift, double gammaDrift, double variance, double vol) -> void
+		{
+			std::vector<double> gammaIncrements(std::size(states));
+			std::vector<double> normals(std::size(states));
+			std::fill(states.begin(), states.end(), initialState);
+			record(0, states);
+			double time{ terminalTime / static_cast<double>(timePoints - 1) };
+			for (std::size_t i{ 1 }; i < timePoints; ++i)
+			{
+				// each lane draws its gamma increment before its normal, as in step
+				draws.gammas(gammaIncrements, time / variance, variance);
+				draws.normals(normals);
+				stepBatch(states, time, drift, gammaDrift, variance, vol, gammaIncrements, normals);
+				record(i, states);
+			}
+		}
+		// runs the lanes of a batch and their tangents through all time steps with the draws of simulateBatch
+		auto simulateTangentBatch(std::span<double> states, std::span<double> tangents, auto& draws, double initialState, double terminalTime, std::size_t timePoints, double drift, double gammaDrift, double variance, double vol) -> void
+		{
+			std::vector<double> gammaIncrements(std::size(states));
+			std::vector<double> normals(std::size(states));
+			std::fill(states.begin(), states.end(), initialState);
+			Parallel::initialTangents(tangents, std::size(states));
+			double time{ terminalTime / static_cast<double>(timePoints - 1) };
+			for (std::size_t i{ 1 }; i < timePoints; ++i)
+			{
+				draws.gammas(gammaIncrements, time / variance, variance);
+				draws.normals(normals);
+				stepBatch(states, tangents, time, drift, gammaDrift, variance, vol, gammaIncrements, normals);
+			}
+		}
+		auto fillPath(StridedView<double> spath, double initialState, double terminalTime, double drift, double gammaDrift, double variance, double vol, Random::Stream& stream) -> void
+		{
+			spath[0] = initialState;
+			double time{ terminalTime / static_cast<double>(spath.size() - 1) };
+			for (std::size_t i{ 1 }; i < spath.size(); ++i)
+			{
+				spath[i] = step(spath[i - 1], time, drift, gammaDrift, variance, vol, stream);
+			}
+		}
+		auto path(double initialState, double terminalTime, std::size_t timePoints, double drift, double gammaDrift, double variance, double vol, Random::Stream& stream) -> XYVals
+		{
+			return Parallel::path(terminalTime, timePoints, [&](StridedView<double> spath) { fillPath(spath, initialState, terminalTime, drift, gammaDrift, variance, vol, stream); });
+		}
+		auto monteCarlo(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double gammaDrift, double variance, double vol, std::uint64_t seed, std::string_view sampling) -> XYVals
+		{
+			return Parallel::batchSamples(samples, timePoints, seed, sobolLayout, sampling, [&](std::span<double> states, auto& draws, const auto& record) { simulateBatch(states, draws, record, initialState, terminalTime, timePoints, drift, gammaDrift, variance, vol); });
+		}
+		auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double gammaDrift, double variance, double vol, std::uint64_t seed, std::string_view sampling) -> DataTable
+		{
+			if (sampling == "sobol")
+			{
+				return monteCarloPathBlock(initialState, terminalTime, samples, timePoints, drift, gammaDrift, variance, vol, seed, PathBlock::Layout::pathMajor, sampling).toDataTable();
+			}
+			return Parallel::paths(samples, timePoints, seed, [&](StridedView<double> spath, Random::Stream& stream) { fillPath(spath, initialState, terminalTime, drift, gammaDrift, variance, vol, stream); });
+		}
+		auto monteCarloPathBlock(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double gammaDrift, double variance, double vol, std::uint64_t seed, PathBlock::Layout layout, std::string_view sampling) -> PathBlock
+		{
+			if (layout == PathBlock::Layout::timeMajor || sampling == "sobol")
+			{
+				return Parallel::batchPathBlock(samples, timePoints, terminalTime, layout, seed, sobolLayout, sampling, [&](std::span<double> states, auto& draws, const auto& record) { simulateBatch(states, draws, record, initialState, terminalTime, timePoints, drift, gammaDrift, variance, vol); });
+			}
+			return Parallel::pathBlock(samples, timePoints, terminalTime, layout, seed, [&](StridedView<double> spath, Random::Stream& stream) { fillPath(spath, initialState, terminalTime, drift, gammaDrift, variance, vol, stream); });
+		}
+		// terminal states with the variance reduction of mcParams
+		auto monteCarlo(double initialState, double terminalTime, double drift, double gammaDrift, double variance, double vol, const MonteCarloParams& mcParams) -> WeightedSamples
+		{
+			return Parallel::weightedSamples(mcParams.timePoints, mcParams, sobolLayout, [&](std::span<double> states, auto& draws, const auto& record) { simulateBatch(states, draws, record, initialState, terminalTime, mcParams.timePoints, drift, gammaDrift, variance, vol); });
+		}
+
+		auto monteCarlo(double initialState, double terminalTime, double drift, double gammaDrift, double variance, double vol, const MonteCarloParams& mcParams, const SampleSink& sink) -> void
+		{
+			Parallel::streamSamples(mcParams.timePoints, mcParams, sobolLayout, [&](std::span<double> states, auto& draws, const auto& record) { simulateBatch(states, draws, record, initialState, terminalTime, mcParams.timePoints, drift, gammaDrift, variance, vol); }, sink);
+		}
+
+		auto monteCarloTangents(double initialState, double terminalTime, double drift, double gammaDrift, double variance, double vol, const MonteCarloParams& mcParams, const SampleSink& sink) -> void
+		{
+			Parallel::streamBatches(mcParams.timePoints, mcParams, sobolLayout, 2 + tangentParameters<VarianceGammaParams>(), 0, [&](std::span<double> states, std::span<double> tangents, std::span<double>, auto& draws) { simulateTangentBatch(states, tangents, draws, initialState, terminalTime, mcParams.timePoints, drift, gammaDrift, variance, vol); }, sink);
 		}
 
 		// overloads for param structs
@@ -444,6 +1562,24 @@ namespace SDE
 		{
 			return monteCarloPaths(initialState, terminalTime, samples, timePoints, drift, params.drift, params.variance, params.vol);
 		}
+		auto monteCarloPathBlock(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, VarianceGammaParams params, PathBlock::Layout layout) -> PathBlock
+		{
+			return monteCarloPathBlock(initialState, terminalTime, samples, timePoints, drift, params.drift, params.variance, params.vol, Random::seed(), layout);
+		}
+		auto monteCarlo(double initialState, double terminalTime, double drift, VarianceGammaParams params, const MonteCarloParams& mcParams) -> WeightedSamples
+		{
+			return monteCarlo(initialState, terminalTime, drift, params.drift, params.variance, params.vol, mcParams);
+		}
+
+		auto monteCarlo(double initialState, double terminalTime, double drift, VarianceGammaParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void
+		{
+			monteCarlo(initialState, terminalTime, drift, params.drift, params.variance, params.vol, mcParams, sink);
+		}
+
+		auto monteCarloTangents(double initialState, double terminalTime, double drift, VarianceGammaParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void
+		{
+			monteCarloTangents(initialState, terminalTime, drift, params.drift, params.variance, params.vol, mcParams, sink);
+		}
 	
 	}
 
@@ -500,31 +1636,127 @@ namespace SDE
 		std::size_t timePoints{ 1000 };
 		return SDE::VarianceGamma::monteCarlo(initialState, terminalTime, samples, timePoints, drift, params);
 	}
+	auto monteCarlo(double initialState, double terminalTime, double drift, BSMParams params, const MonteCarloParams& mcParams) -> WeightedSamples
+	{
+		return SDE::BSM::monteCarlo(initialState, terminalTime, drift, params, mcParams);
+	}
+	auto monteCarlo(double initialState, double terminalTime, double drift, BachelierParams params, const MonteCarloParams& mcParams) -> WeightedSamples
+	{
+		return SDE::Bachelier::monteCarlo(initialState, terminalTime, drift, params, mcParams);
+	}
+	auto monteCarlo(double initialState, double terminalTime, double drift, CEVParams params, const MonteCarloParams& mcParams) -> WeightedSamples
+	{
+		return SDE::CEV::monteCarlo(initialState, terminalTime, drift, params, mcParams);
+	}
+	auto monteCarlo(double initialState, double terminalTime, double drift, MertonJumpParams params, const MonteCarloParams& mcParams) -> WeightedSamples
+	{
+		return SDE::MertonJump::monteCarlo(initialState, terminalTime, drift, params, mcParams);
+	}
+	auto monteCarlo(double initialState, double terminalTime, double drift, HestonParams params, const MonteCarloParams& mcParams) -> WeightedSamples
+	{
+		return SDE::Heston::monteCarlo(initialState, terminalTime, drift, params, mcParams);
+	}
+	auto monteCarlo(double initialState, double terminalTime, double drift, VarianceGammaParams params, const MonteCarloParams& mcParams) -> WeightedSamples
+	{
+		return SDE::VarianceGamma::monteCarlo(initialState, terminalTime, drift, params, mcParams);
+	}
+	auto monteCarlo(double initialState, double terminalTime, double drift, BSMParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void
+	{
+		SDE::BSM::monteCarlo(initialState, terminalTime, drift, params, mcParams, sink);
+	}
+	auto monteCarlo(double initialState, double terminalTime, double drift, BachelierParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void
+	{
+		SDE::Bachelier::monteCarlo(initialState, terminalTime, drift, params, mcParams, sink);
+	}
+	auto monteCarlo(double initialState, double terminalTime, double drift, CEVParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void
+	{
+		SDE::CEV::monteCarlo(initialState, terminalTime, drift, params, mcParams, sink);
+	}
+	auto monteCarlo(double initialState, double terminalTime, double drift, MertonJumpParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void
+	{
+		SDE::MertonJump::monteCarlo(initialState, terminalTime, drift, params, mcParams, sink);
+	}
+	auto monteCarlo(double initialState, double terminalTime, double drift, HestonParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void
+	{
+		SDE::Heston::monteCarlo(initialState, terminalTime, drift, params, mcParams, sink);
+	}
+	auto monteCarlo(double initialState, double terminalTime, double drift, VarianceGammaParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void
+	{
+		SDE::VarianceGamma::monteCarlo(initialState, terminalTime, drift, params, mcParams, sink);
+	}
+	auto monteCarloTangents(double initialState, double terminalTime, double drift, BSMParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void
+	{
+		SDE::BSM::monteCarloTangents(initialState, terminalTime, drift, params, mcParams, sink);
+	}
+	auto monteCarloTangents(double initialState, double terminalTime, double drift, BachelierParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void
+	{
+		SDE::Bachelier::monteCarloTangents(initialState, terminalTime, drift, params, mcParams, sink);
+	}
+	auto monteCarloTangents(double initialState, double terminalTime, double drift, CEVParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void
+	{
+		SDE::CEV::monteCarloTangents(initialState, terminalTime, drift, params, mcParams, sink);
+	}
+	auto monteCarloTangents(double initialState, double terminalTime, double drift, MertonJumpParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void
+	{
+		SDE::MertonJump::monteCarloTangents(initialState, terminalTime, drift, params, mcParams, sink);
+	}
+	auto monteCarloTangents(double initialState, double terminalTime, double drift, HestonParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void
+	{
+		SDE::Heston::monteCarloTangents(initialState, terminalTime, drift, params, mcParams, sink);
+	}
+	auto monteCarloTangents(double initialState, double terminalTime, double drift, VarianceGammaParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void
+	{
+		SDE::VarianceGamma::monteCarloTangents(initialState, terminalTime, drift, params, mcParams, sink);
+	}
 
 	auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, BSMParams& params) -> DataTable
 	{
 		return SDE::BSM::monteCarloPaths(initialState, terminalTime, samples, timePoints, drift, params);
 	}
+	auto monteCarloPathBlock(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, BSMParams& params, PathBlock::Layout layout) -> PathBlock
+	{
+		return SDE::BSM::monteCarloPathBlock(initialState, terminalTime, samples, timePoints, drift, params, layout);
+	}
 	auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, BachelierParams& params) -> DataTable
 	{
 		return SDE::Bachelier::monteCarloPaths(initialState, terminalTime, samples, timePoints, drift, params);
 	}
+	auto monteCarloPathBlock(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, BachelierParams& params, PathBlock::Layout layout) -> PathBlock
+	{
+		return SDE::Bachelier::monteCarloPathBlock(initialState, terminalTime, samples, timePoints, drift, params, layout);
+	}
 	auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, CEVParams& params) -> DataTable
 	{
 		return SDE::CEV::monteCarloPaths(initialState, terminalTime, samples, timePoints, drift, params);
 	}
+	auto monteCarloPathBlock(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, CEVParams& params, PathBlock::Layout layout) -> PathBlock
+	{
+		return SDE::CEV::monteCarloPathBlock(initialState, terminalTime, samples, timePoints, drift, params, layout);
+	}
 	auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, MertonJumpParams& params) -> DataTable
 	{
 		return SDE::MertonJump::monteCarloPaths(initialState, terminalTime, samples, timePoints, drift, params);
 	}
+	auto monteCarloPathBlock(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, MertonJumpParams& params, PathBlock::Layout layout) -> PathBlock
+	{
+		return SDE::MertonJump::monteCarloPathBlock(initialState, terminalTime, samples, timePoints, drift, params, layout);
+	}
 	auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, HestonParams& params) -> DataTable
 	{
 		return SDE::Heston::monteCarloPaths(initialState, terminalTime, samples, timePoints, drift, params);
 	}
+	auto monteCarloPathBlock(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, HestonParams& params, PathBlock::Layout layout) -> PathBlock
+	{
+		return SDE::Heston::monteCarloPathBlock(initialState, terminalTime, samples, timePoints, drift, params, layout);
+	}
 	auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, VarianceGammaParams& params) -> DataTable
 	{
 		return SDE::VarianceGamma::monteCarloPaths(initialState, terminalTime, samples, timePoints, drift, params);
 	}
+	auto monteCarloPathBlock(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, VarianceGammaParams& params, PathBlock::Layout layout) -> PathBlock
+	{
+		return SDE::VarianceGamma::monteCarloPathBlock(initialState, terminalTime, samples, timePoints, drift, params, layout);
+	}
 
 
 
@@ -533,38 +1765,22 @@ namespace SDE
 	{
 		auto BSM(std::complex<double> argument, double riskFreeReturn, double vol, double maturity, double spot, double dividendYield) -> std::complex<double>
 		{
-			return std::exp(IMNUM * (std::log(spot) + (riskFreeReturn - dividendYield - vol * vol / 2.0) * maturity) * argument
-				- vol * vol * argument * argument * maturity / 2.0);
+			return BSM<double>(argument, riskFreeReturn, vol, maturity, spot, dividendYield);
 		}
 
 		auto MertonJump(std::complex<double> argument, double riskFreeReturn, double vol, double maturity, double spot, double dividendYield, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear) -> std::complex<double>
 		{
-			double omega{riskFreeReturn-dividendYield-vol*vol/2. - expectedJumpsPerYear*(std::exp(meanJumpSize+stdJumpSize*stdJumpSize/2.)-1.)};
-			std::complex<double> term1{ IMNUM*argument*std::log(spot) + IMNUM*argument*omega*maturity - 0.5*argument*argument*vol*vol*maturity};
-			std::complex<double> term2{expectedJumpsPerYear*maturity*(std::exp(IMNUM*argument*meanJumpSize-argument*argument*stdJumpSize*stdJumpSize/2.)-1.)};
-			return std::exp(term1 + term2);
+			return MertonJump<double>(argument, riskFreeReturn, vol, maturity, spot, dividendYield, meanJumpSize, stdJumpSize, expectedJumpsPerYear);
 		}
 
 		auto Heston(std::complex<double> argument, double riskFreeReturn, double initialVariance, double longVariance, double correlation, double reversionRate, double volVol, double maturity, double spot, double dividendYield) -> std::complex<double>
 		{
-
-			std::complex<double> tmp{ (reversionRate - IMNUM * correlation * volVol * argument) };
-			std::complex<double> g{ std::sqrt((volVol * volVol) * (argument * argument + IMNUM * argument) + tmp * tmp) };
-			double pow1{ 2 * reversionRate * longVariance / (volVol * volVol) };
-			std::complex<double> numer1{ (reversionRate * longVariance * maturity * tmp) / (volVol * volVol) + IMNUM * argument * maturity * (riskFreeReturn - dividendYield) + IMNUM * argument * std::log(spot) };
-			std::complex<double> log_denum1{ pow1 * std::log(std::cosh(g * maturity / 2.0) + (tmp / g) * std::sinh(g * maturity / 2.0)) };
-			std::complex<double> tmp2{ ((argument * argument + IMNUM * argument) * initialVariance) / (g / std::tanh(g * maturity / 2.0) + tmp) };
-			std::complex<double> log_phi{ numer1 - log_denum1 - tmp2 };
-			std::complex<double> phi{ std::exp(log_phi) };
-			return phi;
+			return Heston<double>(argument, riskFreeReturn, initialVariance, longVariance, correlation, reversionRate, volVol, maturity, spot, dividendYield);
 		}
 
 		auto VarianceGamma(std::complex<double> argument, double riskFreeReturn, double maturity, double spot, double dividendYield, double volatility, double drift, double variance) -> std::complex<double>
 		{
-			double omega{ std::log(1-drift*variance - volatility*volatility*variance*0.5) / variance};
-			std::complex<double> factor1{ std::exp(IMNUM * argument * (std::log(spot)+(riskFreeReturn-dividendYield+omega)*maturity)) };
-			std::complex<double> factor2{ std::pow(1.0-IMNUM*argument*drift*variance + volatility*volatility*argument*argument*variance*0.5,-maturity/variance) };
-			return factor1 * factor2;
+			return VarianceGamma<double>(argument, riskFreeReturn, maturity, spot, dividendYield, volatility, drift, variance);
 		}
 
 		auto generalCF(std::complex<double> argument, const HestonParams& modelParams, const MarketParams& marketParams) -> std::complex<double>
@@ -591,6 +1807,323 @@ namespace SDE
 				marketParams.spot, marketParams.dividendYield, modelParams.vol, modelParams.drift, modelParams.variance);
 		}
 
+		// Complex arithmetic on separate real and imaginary parts, inlined into the loops over frequency grids below.
+		// The loops still call the real exp, log, sqrt, sin, cos and atan2 of the library, so gcc -O3 does not vectorize them.
+		// They are two to three times faster than the scalar functions on 4096 frequencies because everything that does not
+		// depend on the argument is hoisted out of the loop.
+		namespace ComplexMath
+		{
+			struct ReIm
+			{
+				double re{ 0.0 };
+				double im{ 0.0 };
+			};
+
+			inline auto mul(ReIm x, ReIm y) -> ReIm
+			{
+				return { x.re * y.re - x.im * y.im, x.re * y.im + x.im * y.re };
+			}
+
+			inline auto div(ReIm x, ReIm y) -> ReIm
+			{
+				double denom{ 1.0 / (y.re * y.re + y.im * y.im) };
+				return { (x.re * y.re + x.im * y.im) * denom, (x.im * y.re - x.re * y.im) * denom };
+			}
+
+			inline auto exp(ReIm x) -> ReIm
+			{
+				double modulus{ std::exp(x.re) };
+				return { modulus * std::cos(x.im), modulus * std::sin(x.im) };
+			}
+
+			// principal branch, like std::log
+			inline auto log(ReIm x) -> ReIm
+			{
+				return { 0.5 * std::log(x.re * x.re + x.im * x.im), std::atan2(x.im, x.re) };
+			}
+
+			// principal branch, like std::sqrt. Written without cancellation for negative real parts.
+			inline auto sqrt(ReIm x) -> ReIm
+			{
+				double modulus{ std::sqrt(x.re * x.re + x.im * x.im) };
+				double larger{ std::sqrt(0.5 * (modulus + std::abs(x.re))) };
+				double smaller{ (larger > 0.0) ? 0.5 * x.im / larger : 0.0 };
+				return (x.re >= 0.0) ? ReIm{ larger, smaller } : ReIm{ std::abs(smaller), std::copysign(larger, x.im) };
+			}
+		}
+
+		auto BSM(const ComplexArray& arguments, double riskFreeReturn, double vol, double maturity, double spot, double dividendYield) -> ComplexArray
+		{
+			// exp(i u mean - variance u^2 / 2), with everything but u hoisted out of the loop
+			double mean{ std::log(spot) + (riskFreeReturn - dividendYield - vol * vol / 2.0) * maturity };
+			double halfVariance{ vol * vol * maturity / 2.0 };
+
+			std::size_t length{ arguments.size() };
+			ComplexArray result(length);
+			const double* argRe{ arguments.real.data() };
+			const double* argIm{ arguments.imag.data() };
+			double* resRe{ result.real.data() };
+			double* resIm{ result.imag.data() };
+			for (std::size_t j{ 0 }; j < length; ++j)
+			{
+				double a{ argRe[j] };
+				double b{ argIm[j] };
+				ComplexMath::ReIm exponent{ -b * mean - halfVariance * (a * a - b * b), a * mean - 2.0 * halfVariance * a * b };
+				ComplexMath::ReIm phi{ ComplexMath::exp(exponent) };
+				resRe[j] = phi.re;
+				resIm[j] = phi.im;
+			}
+			return result;
+		}
+
+		auto MertonJump(const ComplexArray& arguments, double riskFreeReturn, double vol, double maturity, double spot, double dividendYield, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear) -> ComplexArray
+		{
+			double omega{ riskFreeReturn - dividendYield - vol * vol / 2. - expectedJumpsPerYear * (std::exp(meanJumpSize + stdJumpSize * stdJumpSize / 2.) - 1.) };
+			double mean{ std::log(spot) + omega * maturity };
+			double halfVariance{ 0.5 * vol * vol * maturity };
+			double halfJumpVariance{ 0.5 * stdJumpSize * stdJumpSize };
+			double jumpIntensity{ expectedJumpsPerYear * maturity };
+
+			std::size_t length{ arguments.size() };
+			ComplexArray result(length);
+			const double* argRe{ arguments.real.data() };
+			const double* argIm{ arguments.imag.data() };
+			double* resRe{ result.real.data() };
+			double* resIm{ result.imag.data() };
+			for (std::size_t j{ 0 }; j < length; ++j)
+			{
+				double a{ argRe[j] };
+				double b{ argIm[j] };
+				double squareRe{ a * a - b * b };
+				double squareIm{ 2.0 * a * b };
+				// characteristic function of a single jump
+				ComplexMath::ReIm jumpCF{ ComplexMath::exp({ -b * meanJumpSize - halfJumpVariance * squareRe, a * meanJumpSize - halfJumpVariance * squareIm }) };
+				ComplexMath::ReIm exponent{ -b * mean - halfVariance * squareRe + jumpIntensity * (jumpCF.re - 1.),
+											a * mean - halfVariance * squareIm + jumpIntensity * jumpCF.im };
+				ComplexMath::ReIm phi{ ComplexMath::exp(exponent) };
+				resRe[j] = phi.re;
+				resIm[j] = phi.im;
+			}
+			return result;
+		}
+
+		auto Heston(const ComplexArray& arguments, double riskFreeReturn, double initialVariance, double longVariance, double correlation, double reversionRate, double volVol, double maturity, double spot, double dividendYield) -> ComplexArray
+		{
+			// same little Heston trap formulation as the scalar version
+			double volVolSquared{ volVol * volVol };
+			double inverseVolVolSquared{ 1.0 / volVolSquared };
+			double driftTerm{ std::log(spot) + (riskFreeReturn - dividendYield) * maturity };
+			double meanReversionTerm{ reversionRate * longVariance * inverseVolVolSquared };
+			double rhoSigma{ correlation * volVol };
+
+			std::size_t length{ arguments.size() };
+			ComplexArray result(length);
+			const double* argRe{ arguments.real.data() };
+			const double* argIm{ arguments.imag.data() };
+			double* resRe{ result.real.data() };
+			double* resIm{ result.imag.data() };
+			for (std::size_t j{ 0 }; j < length; ++j)
+			{
+				double a{ argRe[j] };
+				double b{ argIm[j] };
+				// xi = kappa - i rho sigma u
+				ComplexMath::ReIm xi{ reversionRate + rhoSigma * b, -rhoSigma * a };
+				// u^2 + i u
+				ComplexMath::ReIm quadratic{ a * a - b * b - b, 2.0 * a * b + a };
+				ComplexMath::ReIm d{ ComplexMath::sqrt({ xi.re * xi.re - xi.im * xi.im + volVolSquared * quadratic.re,
+														 2.0 * xi.re * xi.im + volVolSquared * quadratic.im }) };
+				ComplexMath::ReIm xiMinusD{ xi.re - d.re, xi.im - d.im };
+				ComplexMath::ReIm g{ ComplexMath::div(xiMinusD, { xi.re + d.re, xi.im + d.im }) };
+				ComplexMath::ReIm expDT{ ComplexMath::exp({ -d.re * maturity, -d.im * maturity }) };
+				ComplexMath::ReIm gExpDT{ ComplexMath::mul(g, expDT) };
+				ComplexMath::ReIm oneMinusGExpDT{ 1.0 - gExpDT.re, -gExpDT.im };
+
+				ComplexMath::ReIm logRatio{ ComplexMath::log(ComplexMath::div(oneMinusGExpDT, { 1.0 - g.re, -g.im })) };
+				ComplexMath::ReIm varianceFactor{ ComplexMath::div(ComplexMath::mul(xiMinusD, { 1.0 - expDT.re, -expDT.im }), oneMinusGExpDT) };
+
+				// i u (log S + (r - q) T) + kappa theta / sigma^2 ((xi - d) T - 2 log(...)) + v0 / sigma^2 (xi - d)(1 - e^{-dT}) / (1 - g e^{-dT})
+				ComplexMath::ReIm exponent{
+					-b * driftTerm + meanReversionTerm * (xiMinusD.re * maturity - 2.0 * logRatio.re) + initialVariance * inverseVolVolSquared * varianceFactor.re,
+					a * driftTerm + meanReversionTerm * (xiMinusD.im * maturity - 2.0 * logRatio.im) + initialVariance * inverseVolVolSquared * varianceFactor.im };
+				ComplexMath::ReIm phi{ ComplexMath::exp(exponent) };
+				resRe[j] = phi.re;
+				resIm[j] = phi.im;
+			}
+			return result;
+		}
+
+		auto VarianceGamma(const ComplexArray& arguments, double riskFreeReturn, double maturity, double spot, double dividendYield, double volatility, double drift, double variance) -> ComplexArray
+		{
+			double omega{ std::log(1 - drift * variance - volatility * volatility * variance * 0.5) / variance };
+			double mean{ std::log(spot) + (riskFreeReturn - dividendYield + omega) * maturity };
+			double driftVariance{ drift * variance };
+			double halfVolVariance{ volatility * volatility * variance * 0.5 };
+			double power{ -maturity / variance };
+
+			std::size_t length{ arguments.size() };
+			ComplexArray result(length);
+			const double* argRe{ arguments.real.data() };
+			const double* argIm{ arguments.imag.data() };
+			double* resRe{ result.real.data() };
+			double* resIm{ result.imag.data() };
+			for (std::size_t j{ 0 }; j < length; ++j)
+			{
+				double a{ argRe[j] };
+				double b{ argIm[j] };
+				// exp(i u mean) * (1 - i u drift variance + vol^2 variance u^2 / 2)^power
+				ComplexMath::ReIm base{ 1.0 + b * driftVariance + halfVolVariance * (a * a - b * b), -a * driftVariance + 2.0 * halfVolVariance * a * b };
+				ComplexMath::ReIm logBase{ ComplexMath::log(base) };
+				ComplexMath::ReIm phi{ ComplexMath::exp({ -b * mean + power * logBase.re, a * mean + power * logBase.im }) };
+				resRe[j] = phi.re;
+				resIm[j] = phi.im;
+			}
+			return result;
+		}
+
+		auto generalCF(const ComplexArray& arguments, const HestonParams& modelParams, const MarketParams& marketParams) -> ComplexArray
+		{
+			return Heston(arguments, marketParams.riskFreeReturn, modelParams.initialVariance, modelParams.longVariance,
+							modelParams.correlation, modelParams.reversionRate, modelParams.volVol,
+							marketParams.maturity, marketParams.spot, marketParams.dividendYield);
+		}
+
+		auto generalCF(const ComplexArray& arguments, const BSMParams& modelParams, const MarketParams& marketParams) -> ComplexArray
+		{
+			return BSM(arguments, marketParams.riskFreeReturn, modelParams.vol, marketParams.maturity,
+						marketParams.spot, marketParams.dividendYield);
+		}
+
+		auto generalCF(const ComplexArray& arguments, const MertonJumpParams& modelParams, const MarketParams& marketParams) -> ComplexArray
+		{
+			return MertonJump(arguments, marketParams.riskFreeReturn, modelParams.vol, marketParams.maturity,
+				marketParams.spot, marketParams.dividendYield, modelParams.meanJumpSize, modelParams.stdJumpSize, modelParams.expectedJumpsPerYear);
+		}
+
+		auto generalCF(const ComplexArray& arguments, const VarianceGammaParams& modelParams, const MarketParams& marketParams) -> ComplexArray
+		{
+			return VarianceGamma(arguments, marketParams.riskFreeReturn, marketParams.maturity,
+				marketParams.spot, marketParams.dividendYield, modelParams.vol, modelParams.drift, modelParams.variance);
+		}
+
+		auto generalCFDual(std::complex<double> argument, const HestonParams& modelParams, const MarketParams& marketParams) -> AD::ComplexDual<5>
+		{
+			using Dual = AD::Dual<5>;
+			return Heston(argument, Dual{ marketParams.riskFreeReturn }, Dual::variable(modelParams.initialVariance, 4), Dual::variable(modelParams.longVariance, 1),
+				Dual::variable(modelParams.correlation, 3), Dual::variable(modelParams.reversionRate, 0), Dual::variable(modelParams.volVol, 2),
+				Dual{ marketParams.maturity }, Dual{ marketParams.spot }, Dual{ marketParams.dividendYield });
+		}
+
+		auto generalCFDual(std::complex<double> argument, const BSMParams& modelParams, const MarketParams& marketParams) -> AD::ComplexDual<1>
+		{
+			using Dual = AD::Dual<1>;
+			return BSM(argument, Dual{ marketParams.riskFreeReturn }, Dual::variable(modelParams.vol, 0), Dual{ marketParams.maturity },
+				Dual{ marketParams.spot }, Dual{ marketParams.dividendYield });
+		}
+
+		auto generalCFDual(std::complex<double> argument, const MertonJumpParams& modelParams, const MarketParams& marketParams) -> AD::ComplexDual<4>
+		{
+			using Dual = AD::Dual<4>;
+			return MertonJump(argument, Dual{ marketParams.riskFreeReturn }, Dual::variable(modelParams.vol, 0), Dual{ marketParams.maturity },
+				Dual{ marketParams.spot }, Dual{ marketParams.dividendYield }, Dual::variable(modelParams.meanJumpSize, 1),
+				Dual::variable(modelParams.stdJumpSize, 2), Dual::variable(modelParams.expectedJumpsPerYear, 3));
+		}
+
+		auto generalCFDual(std::complex<double> argument, const VarianceGammaParams& modelParams, const MarketParams& marketParams) -> AD::ComplexDual<3>
+		{
+			using Dual = AD::Dual<3>;
+			return VarianceGamma(argument, Dual{ marketParams.riskFreeReturn }, Dual{ marketParams.maturity }, Dual{ marketParams.spot },
+				Dual{ marketParams.dividendYield }, Dual::variable(modelParams.vol, 0), Dual::variable(modelParams.drift, 1), Dual::variable(modelParams.variance, 2));
+		}
+
+		// The gradients are phi times the derivatives of log phi, which are simpler and have no branch cut problems
+		// beyond those of log phi itself.
+
+		auto generalCFGradient(std::complex<double> argument, const HestonParams& modelParams, const MarketParams& marketParams) -> std::vector<std::complex<double>>
+		{
+			// the little Heston trap formulation of the scalar CF, differentiated through beta = kappa - i rho sigma u, d and g
+			double reversionRate{ modelParams.reversionRate };
+			double longVariance{ modelParams.longVariance };
+			double volVol{ modelParams.volVol };
+			double correlation{ modelParams.correlation };
+			double maturity{ marketParams.maturity };
+			double volVolSquared{ volVol * volVol };
+
+			std::complex<double> phi{ generalCF(argument, modelParams, marketParams) };
+			std::complex<double> quadratic{ argument * argument + IMNUM * argument };
+			std::complex<double> beta{ reversionRate - IMNUM * correlation * volVol * argument };
+			std::complex<double> d{ std::sqrt(volVolSquared * quadratic + beta * beta) };
+			std::complex<double> g{ (beta - d) / (beta + d) };
+			std::complex<double> expDT{ std::exp(-d * maturity) };
+			std::complex<double> oneMinusGExp{ 1.0 - g * expDT };
+			std::complex<double> ratio{ (1.0 - expDT) / oneMinusGExp };
+			std::complex<double> bracket{ (beta - d) * maturity - 2.0 * std::log(oneMinusGExp / (1.0 - g)) };
+			double meanReversionTerm{ reversionRate * longVariance / volVolSquared };
+			double initialVarianceTerm{ modelParams.initialVariance / volVolSquared };
+
+			// derivative of log phi for given derivatives of beta, sigma and of the two prefactors
+			auto logDerivative
+			{
+				[&](std::complex<double> dBeta, double dVolVol, double dMeanReversionTerm, double dInitialVarianceTerm)
+				{
+					std::complex<double> dD{ (volVol * dVolVol * quadratic + beta * dBeta) / d };
+					std::complex<double> dG{ 2.0 * (d * dBeta - beta * dD) / ((beta + d) * (beta + d)) };
+					std::complex<double> dExpDT{ -maturity * expDT * dD };
+					std::complex<double> dLog{ -(dG * expDT + g * dExpDT) / oneMinusGExp + dG / (1.0 - g) };
+					std::complex<double> dRatio{ (-dExpDT * oneMinusGExp + (1.0 - expDT) * (dG * expDT + g * dExpDT)) / (oneMinusGExp * oneMinusGExp) };
+					return dMeanReversionTerm * bracket + meanReversionTerm * ((dBeta - dD) * maturity - 2.0 * dLog)
+						+ dInitialVarianceTerm * (beta - d) * ratio + initialVarianceTerm * ((dBeta - dD) * ratio + (beta - d) * dRatio);
+				}
+			};
+
+			return {
+				phi * logDerivative(1.0, 0.0, longVariance / volVolSquared, 0.0),
+				phi * logDerivative(0.0, 0.0, reversionRate / volVolSquared, 0.0),
+				phi * logDerivative(-IMNUM * correlation * argument, 1.0, -2.0 * meanReversionTerm / volVol, -2.0 * initialVarianceTerm / volVol),
+				phi * logDerivative(-IMNUM * volVol * argument, 0.0, 0.0, 0.0),
+				phi * (beta - d) * ratio / volVolSquared };
+		}
+
+		auto generalCFGradient(std::complex<double> argument, const BSMParams& modelParams, const MarketParams& marketParams) -> std::vector<std::complex<double>>
+		{
+			std::complex<double> phi{ generalCF(argument, modelParams, marketParams) };
+			return { phi * (-IMNUM * argument - argument * argument) * modelParams.vol * marketParams.maturity };
+		}
+
+		auto generalCFGradient(std::complex<double> argument, const MertonJumpParams& modelParams, const MarketParams& marketParams) -> std::vector<std::complex<double>>
+		{
+			double maturity{ marketParams.maturity };
+			double jumpCompensator{ std::exp(modelParams.meanJumpSize + modelParams.stdJumpSize * modelParams.stdJumpSize / 2.) };
+			std::complex<double> phi{ generalCF(argument, modelParams, marketParams) };
+			std::complex<double> jumpCF{ std::exp(IMNUM * argument * modelParams.meanJumpSize - argument * argument * modelParams.stdJumpSize * modelParams.stdJumpSize / 2.) };
+			double jumpIntensity{ modelParams.expectedJumpsPerYear * maturity };
+
+			return {
+				phi * (-IMNUM * argument - argument * argument) * modelParams.vol * maturity,
+				phi * jumpIntensity * (jumpCF - jumpCompensator) * IMNUM * argument,
+				phi * jumpIntensity * modelParams.stdJumpSize * (-IMNUM * argument * jumpCompensator - argument * argument * jumpCF),
+				phi * maturity * (jumpCF - 1. - IMNUM * argument * (jumpCompensator - 1.)) };
+		}
+
+		auto generalCFGradient(std::complex<double> argument, const VarianceGammaParams& modelParams, const MarketParams& marketParams) -> std::vector<std::complex<double>>
+		{
+			// log phi = i u (log S + (r - q + omega) T) - T / nu log(1 - i u theta nu + sigma^2 u^2 nu / 2)
+			// with omega = log(1 - theta nu - sigma^2 nu / 2) / nu
+			double vol{ modelParams.vol };
+			double drift{ modelParams.drift };
+			double variance{ modelParams.variance };
+			double maturity{ marketParams.maturity };
+			double martingaleTerm{ 1. - drift * variance - vol * vol * variance * 0.5 };
+			std::complex<double> phi{ generalCF(argument, modelParams, marketParams) };
+			std::complex<double> base{ 1.0 - IMNUM * argument * drift * variance + vol * vol * argument * argument * variance * 0.5 };
+			std::complex<double> driftFactor{ IMNUM * argument * maturity };
+
+			return {
+				phi * (-driftFactor * vol / martingaleTerm - maturity * vol * argument * argument / base),
+				phi * (-driftFactor / martingaleTerm + driftFactor / base),
+				phi * (driftFactor * ((-drift - vol * vol * 0.5) / (martingaleTerm * variance) - std::log(martingaleTerm) / (variance * variance))
+					+ maturity / (variance * variance) * std::log(base) - maturity / variance * (-IMNUM * argument * drift + vol * vol * argument * argument * 0.5) / base) };
+		}
+
 
 	}
 
@@ -687,5 +2220,204 @@ namespace SDE
 			Saving::write_xyvals_to_csv("Data/MJstockPath3.csv", spath4);
 		}
 
+		auto parallelMonteCarlo() -> void
+		{
+			// known answer of Philox4x32-10 from the Random123 test vectors
+			std::array<std::uint32_t, 4> philox{ Random::philox4x32({ 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344 }, { 0xa4093822, 0x299f31d0 }) };
+			std::array<std::uint32_t, 4> expected{ 0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1 };
+			std::cout << "Philox known answer test " << ((philox == expected) ? "passed" : "failed") << "\n";
+
+			// the parallel run has to reproduce a serial loop over the same streams exactly
+			double initialState{ 100. };
+			double terminalTime{ 0.5 };
+			std::size_t samples{ 100000 };
+			double drift{ 0.03 };
+			double volatility{ 0.2 };
+			std::uint64_t seed{ 42 };
+			XYVals mcSamples{ BSM::monteCarlo(initialState, terminalTime, samples, drift, volatility, seed) };
+			std::size_t mismatches{ 0 };
+			for (std::size_t i{ 0 }; i < samples; ++i)
+			{
+				Random::Stream stream{ seed, i };
+				if (BSM::simulate(initialState, terminalTime, drift, volatility, stream) != mcSamples.m_yVals[i]) { ++mismatches; }
+			}
+			std::cout << "Samples differing from the serial run: " << mismatches << " of " << samples << " on " << ThreadPool::global().size() << " threads\n";
+
+			double mean{ 0.0 };
+			for (double sample : mcSamples.m_yVals) { mean += sample; }
+			mean /= static_cast<double>(samples);
+			std::cout << "Monte Carlo mean " << mean << ", expected " << initialState * std::exp(drift * terminalTime) << "\n";
+		}
+
+		auto pathBlockLayouts() -> void
+		{
+			// both layouts and the row per path table hold the same paths for the same seed
+			MertonJumpParams params{ 0.2, -0.05, 0.1, 1. };
+			std::size_t samples{ 1000 };
+			std::size_t timePoints{ 250 };
+			std::uint64_t seed{ 7 };
+			PathBlock pathMajor{ MertonJump::monteCarloPathBlock(100., 1., samples, timePoints, 0.03, params.vol, params.meanJumpSize, params.stdJumpSize, params.expectedJumpsPerYear, seed, PathBlock::Layout::pathMajor) };
+			PathBlock timeMajor{ MertonJump::monteCarloPathBlock(100., 1., samples, timePoints, 0.03, params.vol, params.meanJumpSize, params.stdJumpSize, params.expectedJumpsPerYear, seed, PathBlock::Layout::timeMajor) };
+			DataTable table{ MertonJump::monteCarloPaths(100., 1., samples, timePoints, 0.03, params.vol, params.meanJumpSize, params.stdJumpSize, params.expectedJumpsPerYear, seed) };
+
+			// the time major block comes from the batch kernels, which may round differently once vectorized
+			std::size_t mismatches{ 0 };
+			double maxDeviation{ 0.0 };
+			for (std::size_t num{ 0 }; num < samples; ++num)
+			{
+				for (std::size_t i{ 0 }; i < timePoints; ++i)
+				{
+					if (pathMajor(num, i) != table.m_table[num][i]) { ++mismatches; }
+					maxDeviation = std::max(maxDeviation, std::abs(pathMajor(num, i) - timeMajor(num, i)) / pathMajor(num, i));
+				}
+			}
+			std::cout << "Path values differing between path block and table: " << mismatches << "\n";
+			std::cout << "Maximal relative deviation between path wise and batched paths: " << maxDeviation << "\n";
+
+			// mean across paths at maturity, contiguous in the time major layout
+			auto terminalPrices{ timeMajor.timeStep(timePoints - 1) };
+			double mean{ 0.0 };
+			for (std::size_t num{ 0 }; num < terminalPrices.size(); ++num) { mean += terminalPrices[num]; }
+			std::cout << "Mean terminal price " << mean / static_cast<double>(samples) << " at time " << timeMajor.m_times.back() << "\n";
+		}
+
+		auto batchKernels() -> void
+		{
+			// The path major block runs the per path steppers on stream num, the time major block runs the batch kernels
+			// with lane j of a batch on the same stream. 1000 paths leave a partial last batch.
+			std::size_t samples{ 1000 };
+			std::size_t timePoints{ 100 };
+			std::uint64_t seed{ 13 };
+			auto maxDeviation = [&](const PathBlock& pathWise, const PathBlock& batched) -> double
+			{
+				double deviation{ 0.0 };
+				for (std::size_t num{ 0 }; num < samples; ++num)
+				{
+					for (std::size_t i{ 0 }; i < timePoints; ++i)
+					{
+						double scale{ std::max(std::abs(pathWise(num, i)), 1.0) };
+						deviation = std::max(deviation, std::abs(pathWise(num, i) - batched(num, i)) / scale);
+					}
+				}
+				return deviation;
+			};
+
+			CEVParams cevParams{ 0.3, 0.8 };
+			double cevDeviation{ maxDeviation(
+				CEV::monteCarloPathBlock(100., 1., samples, timePoints, 0.03, cevParams.vol, cevParams.exponent, seed, PathBlock::Layout::pathMajor),
+				CEV::monteCarloPathBlock(100., 1., samples, timePoints, 0.03, cevParams.vol, cevParams.exponent, seed, PathBlock::Layout::timeMajor)) };
+			HestonParams hestonParams{ 1.5, 0.06, 0.3, -0.7, 0.04 };
+			double hestonDeviation{ maxDeviation(
+				Heston::monteCarloPathBlock(100., 1., samples, timePoints, 0.03, hestonParams.initialVariance, hestonParams.longVariance, hestonParams.correlation,
+					hestonParams.reversionRate, hestonParams.volVol, seed, PathBlock::Layout::pathMajor),
+				Heston::monteCarloPathBlock(100., 1., samples, timePoints, 0.03, hestonParams.initialVariance, hestonParams.longVariance, hestonParams.correlation,
+					hestonParams.reversionRate, hestonParams.volVol, seed, PathBlock::Layout::timeMajor)) };
+			VarianceGammaParams vgParams{ 0.2, -0.1, 0.2 };
+			double vgDeviation{ maxDeviation(
+				VarianceGamma::monteCarloPathBlock(100., 1., samples, timePoints, 0.03, vgParams.drift, vgParams.variance, vgParams.vol, seed, PathBlock::Layout::pathMajor),
+				VarianceGamma::monteCarloPathBlock(100., 1., samples, timePoints, 0.03, vgParams.drift, vgParams.variance, vgParams.vol, seed, PathBlock::Layout::timeMajor)) };
+
+			// identical draws, only the rounding of the kernel arithmetic may differ
+			std::cout << "Maximal relative deviation between per path steppers and batch kernels: CEV " << cevDeviation
+				<< ", Heston " << hestonDeviation << ", Variance Gamma " << vgDeviation << "\n";
+			assert(cevDeviation < 1e-12 && hestonDeviation < 1e-12 && vgDeviation < 1e-12);
+		}
+
+		auto characteristicFunctionArrays() -> void
+		{
+			// the grid overloads against the scalar characteristic functions, on the real frequencies of the COS method
+			// and on the frequencies shifted into the lower half plane by the damping of the Carr-Madan FFT
+			MarketParams marketParams{ 0.5, 100., 0.03, 0.01 };
+			std::size_t length{ 4096 };
+			ComplexArray realArguments(length);
+			ComplexArray dampedArguments(length);
+			for (std::size_t j{ 0 }; j < length; ++j)
+			{
+				realArguments.real[j] = 0.05 * static_cast<double>(j);
+				dampedArguments.real[j] = 0.05 * static_cast<double>(j);
+				dampedArguments.imag[j] = -1.75;
+			}
+
+			// deviation relative to the largest modulus on the grid, since far out in the tails both sides underflow
+			auto maxDeviation = [](const ComplexArray& arguments, const auto& modelParams, const MarketParams& market) -> double
+			{
+				ComplexArray values{ CharacteristicFunctions::generalCF(arguments, modelParams, market) };
+				double deviation{ 0.0 };
+				double scale{ 0.0 };
+				for (std::size_t j{ 0 }; j < arguments.size(); ++j)
+				{
+					std::complex<double> scalar{ CharacteristicFunctions::generalCF(std::complex<double>{ arguments.real[j], arguments.imag[j] }, modelParams, market) };
+					deviation = std::max(deviation, std::abs(scalar - std::complex<double>{ values.real[j], values.imag[j] }));
+					scale = std::max(scale, std::abs(scalar));
+				}
+				return deviation / scale;
+			};
+
+			HestonParams hestonParams{ 1.5, 0.06, 0.5, -0.7, 0.04 };
+			BSMParams bsmParams{ 0.2 };
+			MertonJumpParams mertonParams{ 0.2, -0.05, 0.1, 1. };
+			VarianceGammaParams vgParams{ 0.2, -0.1, 0.2 };
+			double deviations[]{
+				maxDeviation(realArguments, hestonParams, marketParams), maxDeviation(dampedArguments, hestonParams, marketParams),
+				maxDeviation(realArguments, bsmParams, marketParams), maxDeviation(dampedArguments, bsmParams, marketParams),
+				maxDeviation(realArguments, mertonParams, marketParams), maxDeviation(dampedArguments, mertonParams, marketParams),
+				maxDeviation(realArguments, vgParams, marketParams), maxDeviation(dampedArguments, vgParams, marketParams) };
+			std::cout << "Maximal relative deviation between grid and scalar characteristic functions, real and damped frequencies:\n";
+			std::cout << "Heston " << deviations[0] << ", " << deviations[1] << "\n";
+			std::cout << "BSM " << deviations[2] << ", " << deviations[3] << "\n";
+			std::cout << "Merton jump " << deviations[4] << ", " << deviations[5] << "\n";
+			std::cout << "Variance Gamma " << deviations[6] << ", " << deviations[7] << "\n";
+			for (double deviation : deviations) { assert(deviation < 1e-14); }
+		}
+
+		auto samplerMoments() -> void
+		{
+			// sample mean and variance of the Poisson and gamma samplers against the exact moments, in standard errors.
+			// The Poisson means cover inversion and PTRS, the gamma shapes both sides of the boost for shapes below one.
+			auto standardErrors = [](std::span<const double> samples, double mean, double variance, double fourthCentralMoment) -> std::pair<double, double>
+			{
+				double sampleMean{ 0.0 };
+				for (double sample : samples) { sampleMean += sample; }
+				sampleMean /= static_cast<double>(std::size(samples));
+				double sampleVariance{ 0.0 };
+				for (double sample : samples) { sampleVariance += (sample - sampleMean) * (sample - sampleMean); }
+				sampleVariance /= static_cast<double>(std::size(samples) - 1);
+				double count{ static_cast<double>(std::size(samples)) };
+				return { (sampleMean - mean) / std::sqrt(variance / count),
+						 (sampleVariance - variance) / std::sqrt((fourthCentralMoment - variance * variance) / count) };
+			};
+			auto report = [](std::string_view name, double parameter, std::pair<double, double> errors)
+			{
+				std::cout << name << " " << parameter << ": mean off by " << errors.first << ", variance off by " << errors.second << " standard errors\n";
+				assert(std::abs(errors.first) < 6.0 && std::abs(errors.second) < 6.0);
+			};
+
+			std::size_t samples{ 1000000 };
+			std::size_t globalSamples{ 100000 };
+			Random::Stream stream{ 11, 0 };
+			std::vector<int> counts(samples);
+			std::vector<double> values(samples);
+			for (double lam : { 0.5, 4., 10., 30., 1000. })
+			{
+				// excess kurtosis 1 / lambda
+				double fourthCentralMoment{ 3. * lam * lam + lam };
+				stream.poissons(counts, lam);
+				std::transform(counts.begin(), counts.end(), values.begin(), [](int count) { return static_cast<double>(count); });
+				report("Poisson stream, mean", lam, standardErrors(values, lam, lam, fourthCentralMoment));
+				std::generate_n(values.begin(), globalSamples, [lam] { return static_cast<double>(Random::poisson(lam)); });
+				report("Poisson global generator, mean", lam, standardErrors(std::span{ values }.first(globalSamples), lam, lam, fourthCentralMoment));
+			}
+			double scale{ 0.5 };
+			for (double alpha : { 0.3, 1., 2.5, 20. })
+			{
+				// excess kurtosis 6 / alpha
+				double variance{ alpha * scale * scale };
+				double fourthCentralMoment{ variance * variance * (3. + 6. / alpha) };
+				stream.gammas(values, alpha, scale);
+				report("Gamma stream, shape", alpha, standardErrors(values, alpha * scale, variance, fourthCentralMoment));
+				std::generate_n(values.begin(), globalSamples, [alpha, scale] { return Random::gamma(alpha, scale); });
+				report("Gamma global generator, shape", alpha, standardErrors(std::span{ values }.first(globalSamples), alpha * scale, variance, fourthCentralMoment));
+			}
+		}
 	}
 }
\ No newline at end of file
@@ -2,10 +2,16 @@
 #define SDES_H
 #include "xyvals.h"
 #include "saving.h"
+#include "Random.h"
+#include "dual.h"
 #include <vector>
 #include <complex>
+#include <cstdint>
+#include <span>
+#include <string_view>
 #include <iostream>
 #include <type_traits>
+#include <functional>
 
 // Helper template to check if a type T has a member named 'vol'
 template<typename T, typename = void>
@@ -97,8 +103,90 @@ struct MarketParams
 	double dividendYield{ 0.005 };
 };
 
+// Complex numbers in structure of arrays layout, for evaluating characteristic functions on whole frequency grids.
+struct ComplexArray
+{
+	std::vector<double> real{};
+	std::vector<double> imag{};
+
+	ComplexArray() = default;
+	explicit ComplexArray(std::size_t length)
+		: real(length)
+		, imag(length)
+	{}
+
+	auto size() const -> std::size_t { return std::size(real); }
+};
+
+// Settings of a Monte Carlo run with variance reduction, shared by all models.
+// Antithetic sampling gives lane 2k + 1 the negated normals of lane 2k. Moment matching shifts and scales every set
+// of normals of a batch to sample mean 0 and variance 1. A nonzero importanceShift moves the mean of the standardized
+// terminal Brownian motion behind the first normal of each time step, which drives the price in every model,
+// by that many standard deviations and compensates with likelihood ratio weights.
+struct MonteCarloParams
+{
+	std::size_t samples{ 100000 };
+	std::size_t timePoints{ 250 }; // time grid of the models without exact terminal distribution
+	std::uint64_t seed{ Random::seed() };
+	std::string_view sampling{ "pseudo" };
+	bool antithetic{ false };
+	bool momentMatching{ false };
+	double importanceShift{ 0.0 };
+};
+
+// Terminal states of a Monte Carlo run with their likelihood ratio weights (all one without importance sampling)
+// and the standardized terminal value of the Brownian motion behind the first normal of each step
+struct WeightedSamples
+{
+	std::vector<double> m_states;
+	std::vector<double> m_weights;
+	std::vector<double> m_brownian;
+
+	WeightedSamples(std::size_t length)
+		: m_states(length)
+		, m_weights(length, 1.0)
+		, m_brownian(length)
+	{}
+};
+
+// Terminal states of one batch of consecutive paths, handed to a SampleSink as soon as the batch is simulated.
+// Sinks are called from several threads at once and must not keep the spans. replicate is the Sobol replicate
+// of the batch, batches never cross replicates (always 0 with pseudo random sampling). Tangents and scores are
+// only filled by tangent runs, see SDE::tangentParameters.
+struct SampleBatch
+{
+	std::size_t m_first{ 0 };
+	std::size_t m_replicate{ 0 };
+	std::span<const double> m_states;
+	std::span<const double> m_weights;
+	std::span<const double> m_brownian;
+	std::span<const double> m_tangents;
+	std::span<const double> m_scores;
+};
+
+using SampleSink = std::function<void(const SampleBatch&)>;
+
+// The seeded Monte Carlo functions take sampling = "pseudo" (independent random streams) or "sobol"
+// (randomized quasi Monte Carlo, see qmc.h). Sobol samples come in QMC::defaultReplicates consecutive blocks
+// of independently scrambled points, QMC::estimate turns payoffs of these samples into a price and its error.
 namespace SDE
 {
+	// Tangent runs carry the pathwise derivatives of every path through the time steps next to its state and hand them
+	// to the sink with the terminal states. SampleBatch::m_tangents holds rows of one entry per lane, entry j of row r at
+	// r * lanes + j: the derivative of the terminal state by the initial state, its second derivative by the initial state
+	// and the derivatives by the first tangentParameters<Params>() model parameters in the order of their declaration.
+	// The jump intensity of Merton also moves the distribution of the number of jumps, so m_scores holds the likelihood
+	// ratio score of every path by each of its parameters, zero for the others (empty for the other models). The variance
+	// of variance gamma sets the distribution of the gamma time change itself and has no tangent.
+	template <typename Params>
+	constexpr auto tangentParameters() -> std::size_t
+	{
+		if constexpr (std::is_same_v<Params, CEVParams> || std::is_same_v<Params, VarianceGammaParams>) { return 2; }
+		else if constexpr (std::is_same_v<Params, MertonJumpParams>) { return 4; }
+		else if constexpr (std::is_same_v<Params, HestonParams>) { return 5; }
+		else { return 1; }
+	}
+
 	namespace OrnsteinUhlenbeck
 	{
 		auto simulate(double state, double time, double drift, double mean, double diffusion) -> double;
@@ -110,11 +198,33 @@ namespace SDE
 		auto monteCarlo(double initialState, double terminalTime, std::size_t samples, double drift, double volatility) -> XYVals;
 		auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double volatility) -> DataTable;
 	
+		// overloads drawing from a given random stream, Monte Carlo runs are parallel and reproducible for a given seed
+		auto simulate(double initialState, double time, double drift, double volatility, Random::Stream& stream) -> double;
+		auto fillPath(StridedView<double> spath, double initialState, double terminalTime, double drift, double volatility, Random::Stream& stream) -> void;
+		// advances a batch of paths by one time step, all arrays hold one entry per path
+		auto stepBatch(std::span<double> states, double time, double drift, double volatility, std::span<const double> normals) -> void;
+		auto path(double initialState, double terminalTime, std::size_t timePoints, double drift, double volatility, Random::Stream& stream) -> XYVals;
+		auto monteCarlo(double initialState, double terminalTime, std::size_t samples, double drift, double volatility, std::uint64_t seed, std::string_view sampling = "pseudo") -> XYVals;
+		auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double volatility, std::uint64_t seed, std::string_view sampling = "pseudo") -> DataTable;
+		auto monteCarloPathBlock(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double volatility, std::uint64_t seed, PathBlock::Layout layout = PathBlock::Layout::pathMajor, std::string_view sampling = "pseudo") -> PathBlock;
+		// terminal states with the variance reduction of mcParams
+		auto monteCarlo(double initialState, double terminalTime, double drift, double volatility, const MonteCarloParams& mcParams) -> WeightedSamples;
+		auto monteCarlo(double initialState, double terminalTime, double drift, double volatility, const MonteCarloParams& mcParams, const SampleSink& sink) -> void;
+
+		// advances the tangents of a batch with its states, rows as in tangentParameters
+		auto stepBatch(std::span<double> states, std::span<double> tangents, double time, double drift, double volatility, std::span<const double> normals) -> void;
+		// tangent run, the same paths as monteCarlo for the same mcParams
+		auto monteCarloTangents(double initialState, double terminalTime, double drift, double volatility, const MonteCarloParams& mcParams, const SampleSink& sink) -> void;
+
 		// overloads with param structs
 		auto simulate(double initialState, double time, double drift, BSMParams params) -> double;
 		auto path(double initialState, double terminalTime, std::size_t timePoints, double drift, BSMParams params) -> XYVals;
 		auto monteCarlo(double initialState, double terminalTime, std::size_t samples, double drift, BSMParams params) -> XYVals;
 		auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, BSMParams params) -> DataTable;
+		auto monteCarloPathBlock(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, BSMParams params, PathBlock::Layout layout = PathBlock::Layout::pathMajor) -> PathBlock;
+		auto monteCarlo(double initialState, double terminalTime, double drift, BSMParams params, const MonteCarloParams& mcParams) -> WeightedSamples;
+		auto monteCarlo(double initialState, double terminalTime, double drift, BSMParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void;
+		auto monteCarloTangents(double initialState, double terminalTime, double drift, BSMParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void;
 
 
 	}
@@ -123,11 +233,34 @@ namespace SDE
 		auto simulate(double initialState, double time, double drift, double volatility) -> double;
 		auto path(double initialState, double terminalTime, std::size_t timePoints, double drift, double volatility) -> XYVals;
 		auto monteCarlo(double initialState, double terminalTime, std::size_t samples, double drift, double volatility) -> XYVals;
+		auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double volatility) -> DataTable;
+
+		// overloads drawing from a given random stream, Monte Carlo runs are parallel and reproducible for a given seed
+		auto simulate(double initialState, double time, double drift, double volatility, Random::Stream& stream) -> double;
+		auto fillPath(StridedView<double> spath, double initialState, double terminalTime, double drift, double volatility, Random::Stream& stream) -> void;
+		// advances a batch of paths by one time step, all arrays hold one entry per path
+		auto stepBatch(std::span<double> states, double time, double drift, double volatility, std::span<const double> normals) -> void;
+		auto path(double initialState, double terminalTime, std::size_t timePoints, double drift, double volatility, Random::Stream& stream) -> XYVals;
+		auto monteCarlo(double initialState, double terminalTime, std::size_t samples, double drift, double volatility, std::uint64_t seed, std::string_view sampling = "pseudo") -> XYVals;
+		auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double volatility, std::uint64_t seed, std::string_view sampling = "pseudo") -> DataTable;
+		auto monteCarloPathBlock(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double volatility, std::uint64_t seed, PathBlock::Layout layout = PathBlock::Layout::pathMajor, std::string_view sampling = "pseudo") -> PathBlock;
+		// terminal states with the variance reduction of mcParams
+		auto monteCarlo(double initialState, double terminalTime, double drift, double volatility, const MonteCarloParams& mcParams) -> WeightedSamples;
+		auto monteCarlo(double initialState, double terminalTime, double drift, double volatility, const MonteCarloParams& mcParams, const SampleSink& sink) -> void;
+		// advances the tangents of a batch with its states, rows as in tangentParameters
+		auto stepBatch(std::span<double> states, std::span<double> tangents, double time, double drift, double volatility, std::span<const double> normals) -> void;
+		// tangent run, the same paths as monteCarlo for the same mcParams
+		auto monteCarloTangents(double initialState, double terminalTime, double drift, double volatility, const MonteCarloParams& mcParams, const SampleSink& sink) -> void;
 	
 		// Overloads with Param structs
 		auto simulate(double initialState, double time, double drift, BachelierParams params) -> double;
 		auto path(double initialState, double terminalTime, std::size_t timePoints, double drift, BachelierParams params) -> XYVals;
 		auto monteCarlo(double initialState, double terminalTime, std::size_t samples, double drift, BachelierParams params) -> XYVals;
+		auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, BachelierParams params) -> DataTable;
+		auto monteCarloPathBlock(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, BachelierParams params, PathBlock::Layout layout = PathBlock::Layout::pathMajor) -> PathBlock;
+		auto monteCarlo(double initialState, double terminalTime, double drift, BachelierParams params, const MonteCarloParams& mcParams) -> WeightedSamples;
+		auto monteCarlo(double initialState, double terminalTime, double drift, BachelierParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void;
+		auto monteCarloTangents(double initialState, double terminalTime, double drift, BachelierParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void;
 	}
 	namespace CEV
 	{
@@ -136,10 +269,31 @@ namespace SDE
 		auto monteCarlo(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double volatility, double exponent) -> XYVals;
 		auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double volatility, double exponent) -> DataTable;
 
+		// overloads drawing from a given random stream, Monte Carlo runs are parallel and reproducible for a given seed
+		auto step(double state, double time, double drift, double volatility, double exponent, Random::Stream& stream) -> double;
+		auto fillPath(StridedView<double> spath, double initialState, double terminalTime, double drift, double volatility, double exponent, Random::Stream& stream) -> void;
+		// advances a batch of paths by one time step, all arrays hold one entry per path
+		auto stepBatch(std::span<double> states, double time, double drift, double volatility, double exponent, std::span<const double> normals) -> void;
+		auto path(double initialState, double terminalTime, std::size_t timePoints, double drift, double volatility, double exponent, Random::Stream& stream) -> XYVals;
+		auto monteCarlo(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double volatility, double exponent, std::uint64_t seed, std::string_view sampling = "pseudo") -> XYVals;
+		auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double volatility, double exponent, std::uint64_t seed, std::string_view sampling = "pseudo") -> DataTable;
+		auto monteCarloPathBlock(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double volatility, double exponent, std::uint64_t seed, PathBlock::Layout layout = PathBlock::Layout::pathMajor, std::string_view sampling = "pseudo") -> PathBlock;
+		// terminal states with the variance reduction of mcParams
+		auto monteCarlo(double initialState, double terminalTime, double drift, double volatility, double exponent, const MonteCarloParams& mcParams) -> WeightedSamples;
+		auto monteCarlo(double initialState, double terminalTime, double drift, double volatility, double exponent, const MonteCarloParams& mcParams, const SampleSink& sink) -> void;
+		// advances the tangents of a batch with its states, rows as in tangentParameters. Lanes at zero keep zero tangents.
+		auto stepBatch(std::span<double> states, std::span<double> tangents, double time, double drift, double volatility, double exponent, std::span<const double> normals) -> void;
+		// tangent run, the same paths as monteCarlo for the same mcParams
+		auto monteCarloTangents(double initialState, double terminalTime, double drift, double volatility, double exponent, const MonteCarloParams& mcParams, const SampleSink& sink) -> void;
+
 		// overloads for param structs
 		auto path(double initialState, double terminalTime, std::size_t timePoints, double drift, CEVParams params) -> XYVals;
 		auto monteCarlo(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, CEVParams params) -> XYVals;
 		auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, CEVParams params) -> DataTable;
+		auto monteCarloPathBlock(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, CEVParams params, PathBlock::Layout layout = PathBlock::Layout::pathMajor) -> PathBlock;
+		auto monteCarlo(double initialState, double terminalTime, double drift, CEVParams params, const MonteCarloParams& mcParams) -> WeightedSamples;
+		auto monteCarlo(double initialState, double terminalTime, double drift, CEVParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void;
+		auto monteCarloTangents(double initialState, double terminalTime, double drift, CEVParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void;
 
 	}
 	namespace MertonJump
@@ -149,11 +303,33 @@ namespace SDE
 		auto monteCarlo(double initialState, double terminalTime, std::size_t samples, double drift, double volatility, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear) -> XYVals;
 		auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double volatility, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear) -> DataTable;
 
+		// overloads drawing from a given random stream, Monte Carlo runs are parallel and reproducible for a given seed
+		auto simulate(double initialState, double time, double drift, double volatility, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear, Random::Stream& stream) -> double;
+		auto fillPath(StridedView<double> spath, double initialState, double terminalTime, double drift, double volatility, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear, Random::Stream& stream) -> void;
+		// advances a batch of paths by one time step, all arrays hold one entry per path
+		auto stepBatch(std::span<double> states, double time, double drift, double volatility, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear, std::span<const double> normals, std::span<const double> jumpTerms) -> void;
+		auto path(double initialState, double terminalTime, std::size_t timePoints, double drift, double volatility, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear, Random::Stream& stream) -> XYVals;
+		auto monteCarlo(double initialState, double terminalTime, std::size_t samples, double drift, double volatility, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear, std::uint64_t seed, std::string_view sampling = "pseudo") -> XYVals;
+		auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double volatility, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear, std::uint64_t seed, std::string_view sampling = "pseudo") -> DataTable;
+		auto monteCarloPathBlock(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double volatility, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear, std::uint64_t seed, PathBlock::Layout layout = PathBlock::Layout::pathMajor, std::string_view sampling = "pseudo") -> PathBlock;
+		// terminal states with the variance reduction of mcParams
+		auto monteCarlo(double initialState, double terminalTime, double drift, double volatility, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear, const MonteCarloParams& mcParams) -> WeightedSamples;
+		auto monteCarlo(double initialState, double terminalTime, double drift, double volatility, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear, const MonteCarloParams& mcParams, const SampleSink& sink) -> void;
+		// advances the tangents and the likelihood ratio scores of a batch with its states, rows as in tangentParameters.
+		// numJumps and jumpNormals are the number of jumps of each lane and the normal behind their summed log jumps.
+		auto stepBatch(std::span<double> states, std::span<double> tangents, std::span<double> scores, double time, double drift, double volatility, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear, std::span<const double> normals, std::span<const int> numJumps, std::span<const double> jumpNormals) -> void;
+		// tangent run, the same paths as monteCarlo for the same mcParams
+		auto monteCarloTangents(double initialState, double terminalTime, double drift, double volatility, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear, const MonteCarloParams& mcParams, const SampleSink& sink) -> void;
+
 		// Overloads with Param structs
 		auto simulate(double initialState, double time, double drift, MertonJumpParams params) -> double;
 		auto path(double initialState, double terminalTime, std::size_t timePoints, double drift, MertonJumpParams params) -> XYVals;
 		auto monteCarlo(double initialState, double terminalTime, std::size_t samples, double drift, MertonJumpParams params) -> XYVals;
 		auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, MertonJumpParams params) -> DataTable;
+		auto monteCarloPathBlock(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, MertonJumpParams params, PathBlock::Layout layout = PathBlock::Layout::pathMajor) -> PathBlock;
+		auto monteCarlo(double initialState, double terminalTime, double drift, MertonJumpParams params, const MonteCarloParams& mcParams) -> WeightedSamples;
+		auto monteCarlo(double initialState, double terminalTime, double drift, MertonJumpParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void;
+		auto monteCarloTangents(double initialState, double terminalTime, double drift, MertonJumpParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void;
 	}
 	namespace Heston
 	{
@@ -163,10 +339,31 @@ namespace SDE
 		auto monteCarlo(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double initialVariance, double longVariance, double correlation, double reversionRate, double volVol) -> XYVals;
 		auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double initialVariance, double longVariance, double correlation, double reversionRate, double volVol) -> DataTable;
 
+		// overloads drawing from a given random stream, Monte Carlo runs are parallel and reproducible for a given seed
+		auto fillPath(StridedView<double> spath, double initialState, double terminalTime, double drift, double initialVariance, double longVariance, double correlation, double reversionRate, double volVol, Random::Stream& stream) -> void;
+		// advances a batch of paths by one time step, all arrays hold one entry per path
+		auto stepBatch(std::span<double> spots, std::span<double> variances, double stepSize, double drift, double longVariance, double correlation, double reversionRate, double volVol, std::span<const double> normals1, std::span<const double> normals2) -> void;
+		auto path(double initialState, double terminalTime, std::size_t timePoints, double drift, double initialVariance, double longVariance, double correlation, double reversionRate, double volVol, Random::Stream& stream) -> XYVals;
+		auto monteCarlo(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double initialVariance, double longVariance, double correlation, double reversionRate, double volVol, std::uint64_t seed, std::string_view sampling = "pseudo") -> XYVals;
+		auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double initialVariance, double longVariance, double correlation, double reversionRate, double volVol, std::uint64_t seed, std::string_view sampling = "pseudo") -> DataTable;
+		auto monteCarloPathBlock(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double initialVariance, double longVariance, double correlation, double reversionRate, double volVol, std::uint64_t seed, PathBlock::Layout layout = PathBlock::Layout::pathMajor, std::string_view sampling = "pseudo") -> PathBlock;
+		// terminal states with the variance reduction of mcParams
+		auto monteCarlo(double initialState, double terminalTime, double drift, double initialVariance, double longVariance, double correlation, double reversionRate, double volVol, const MonteCarloParams& mcParams) -> WeightedSamples;
+		auto monteCarlo(double initialState, double terminalTime, double drift, double initialVariance, double longVariance, double correlation, double reversionRate, double volVol, const MonteCarloParams& mcParams, const SampleSink& sink) -> void;
+		// advances the tangents of a batch with its states, spotTangents has the rows of tangentParameters and varianceTangents
+		// the derivatives of the variances by the model parameters
+		auto stepBatch(std::span<double> spots, std::span<double> variances, std::span<double> spotTangents, std::span<double> varianceTangents, double stepSize, double drift, double longVariance, double correlation, double reversionRate, double volVol, std::span<const double> normals1, std::span<const double> normals2) -> void;
+		// tangent run, the same paths as monteCarlo for the same mcParams
+		auto monteCarloTangents(double initialState, double terminalTime, double drift, double initialVariance, double longVariance, double correlation, double reversionRate, double volVol, const MonteCarloParams& mcParams, const SampleSink& sink) -> void;
+
 		// overloads for param structs
 		auto path(double initialState, double terminalTime, std::size_t timePoints, double drift, HestonParams params) -> XYVals;
 		auto monteCarlo(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, HestonParams params) -> XYVals;
 		auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, HestonParams params) -> DataTable;
+		auto monteCarloPathBlock(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, HestonParams params, PathBlock::Layout layout = PathBlock::Layout::pathMajor) -> PathBlock;
+		auto monteCarlo(double initialState, double terminalTime, double drift, HestonParams params, const MonteCarloParams& mcParams) -> WeightedSamples;
+		auto monteCarlo(double initialState, double terminalTime, double drift, HestonParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void;
+		auto monteCarloTangents(double initialState, double terminalTime, double drift, HestonParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void;
 
 	}
 	namespace VarianceGamma
@@ -176,10 +373,31 @@ namespace SDE
 		auto monteCarlo(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double gammaDrift, double variance, double vol) -> XYVals;
 		auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double gammaDrift, double variance, double vol) -> DataTable;
 
+		// overloads drawing from a given random stream, Monte Carlo runs are parallel and reproducible for a given seed
+		auto step(double initialState, double stepSize, double drift, double gammaDrift, double variance, double vol, Random::Stream& stream) -> double;
+		auto fillPath(StridedView<double> spath, double initialState, double terminalTime, double drift, double gammaDrift, double variance, double vol, Random::Stream& stream) -> void;
+		// advances a batch of paths by one time step, all arrays hold one entry per path
+		auto stepBatch(std::span<double> states, double stepSize, double drift, double gammaDrift, double variance, double vol, std::span<const double> gammaIncrements, std::span<const double> normals) -> void;
+		auto path(double initialState, double terminalTime, std::size_t timePoints, double drift, double gammaDrift, double variance, double vol, Random::Stream& stream) -> XYVals;
+		auto monteCarlo(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double gammaDrift, double variance, double vol, std::uint64_t seed, std::string_view sampling = "pseudo") -> XYVals;
+		auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double gammaDrift, double variance, double vol, std::uint64_t seed, std::string_view sampling = "pseudo") -> DataTable;
+		auto monteCarloPathBlock(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, double gammaDrift, double variance, double vol, std::uint64_t seed, PathBlock::Layout layout = PathBlock::Layout::pathMajor, std::string_view sampling = "pseudo") -> PathBlock;
+		// terminal states with the variance reduction of mcParams
+		auto monteCarlo(double initialState, double terminalTime, double drift, double gammaDrift, double variance, double vol, const MonteCarloParams& mcParams) -> WeightedSamples;
+		auto monteCarlo(double initialState, double terminalTime, double drift, double gammaDrift, double variance, double vol, const MonteCarloParams& mcParams, const SampleSink& sink) -> void;
+		// advances the tangents of a batch with its states, rows as in tangentParameters
+		auto stepBatch(std::span<double> states, std::span<double> tangents, double stepSize, double drift, double gammaDrift, double variance, double vol, std::span<const double> gammaIncrements, std::span<const double> normals) -> void;
+		// tangent run, the same paths as monteCarlo for the same mcParams
+		auto monteCarloTangents(double initialState, double terminalTime, double drift, double gammaDrift, double variance, double vol, const MonteCarloParams& mcParams, const SampleSink& sink) -> void;
+
 		// overloads for param structs
 		auto path(double initialState, double terminalTime, std::size_t timePoints, double drift, VarianceGammaParams params) -> XYVals;
 		auto monteCarlo(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, VarianceGammaParams params) -> XYVals;
 		auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, VarianceGammaParams params) -> DataTable;
+		auto monteCarloPathBlock(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, VarianceGammaParams params, PathBlock::Layout layout = PathBlock::Layout::pathMajor) -> PathBlock;
+		auto monteCarlo(double initialState, double terminalTime, double drift, VarianceGammaParams params, const MonteCarloParams& mcParams) -> WeightedSamples;
+		auto monteCarlo(double initialState, double terminalTime, double drift, VarianceGammaParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void;
+		auto monteCarloTangents(double initialState, double terminalTime, double drift, VarianceGammaParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void;
 
 	}
 
@@ -194,6 +412,86 @@ namespace SDE
 		auto generalCF(std::complex<double> argument, const BSMParams& modelParams, const MarketParams& marketParams) -> std::complex<double>;
 		auto generalCF(std::complex<double> argument, const MertonJumpParams& modelParams, const MarketParams& marketParams) -> std::complex<double>;
 		auto generalCF(std::complex<double> argument, const VarianceGammaParams& modelParams, const MarketParams& marketParams) -> std::complex<double>;
+
+		// partial derivatives of the characteristic function with respect to the model parameters,
+		// in the order of the parameters' constructor arguments
+		auto generalCFGradient(std::complex<double> argument, const HestonParams& modelParams, const MarketParams& marketParams) -> std::vector<std::complex<double>>;
+		auto generalCFGradient(std::complex<double> argument, const BSMParams& modelParams, const MarketParams& marketParams) -> std::vector<std::complex<double>>;
+		auto generalCFGradient(std::complex<double> argument, const MertonJumpParams& modelParams, const MarketParams& marketParams) -> std::vector<std::complex<double>>;
+		auto generalCFGradient(std::complex<double> argument, const VarianceGammaParams& modelParams, const MarketParams& marketParams) -> std::vector<std::complex<double>>;
+
+		// The characteristic functions for any scalar type, the double versions above call them. With AD::Dual<N> the derivatives
+		// by whatever the inputs are seeded with come along with the value.
+		template <typename T>
+		auto BSM(std::complex<double> argument, const T& riskFreeReturn, const T& vol, const T& maturity, const T& spot, const T& dividendYield) -> AD::Complex<T>
+		{
+			using std::exp, std::log;
+			AD::Complex<T> u{ argument };
+			AD::Complex<T> i{ 0.0, 1.0 };
+			return exp(i * (log(spot) + (riskFreeReturn - dividendYield - vol * vol / 2.0) * maturity) * u
+				- vol * vol * u * u * maturity / 2.0);
+		}
+
+		template <typename T>
+		auto MertonJump(std::complex<double> argument, const T& riskFreeReturn, const T& vol, const T& maturity, const T& spot, const T& dividendYield,
+			const T& meanJumpSize, const T& stdJumpSize, const T& expectedJumpsPerYear) -> AD::Complex<T>
+		{
+			using std::exp, std::log;
+			AD::Complex<T> u{ argument };
+			AD::Complex<T> i{ 0.0, 1.0 };
+			T omega{ riskFreeReturn - dividendYield - vol * vol / 2. - expectedJumpsPerYear * (exp(meanJumpSize + stdJumpSize * stdJumpSize / 2.) - 1.) };
+			AD::Complex<T> term1{ i * u * log(spot) + i * u * omega * maturity - 0.5 * u * u * vol * vol * maturity };
+			AD::Complex<T> term2{ expectedJumpsPerYear * maturity * (exp(i * u * meanJumpSize - u * u * stdJumpSize * stdJumpSize / 2.) - 1.) };
+			return exp(term1 + term2);
+		}
+
+		template <typename T>
+		auto Heston(std::complex<double> argument, const T& riskFreeReturn, const T& initialVariance, const T& longVariance, const T& correlation,
+			const T& reversionRate, const T& volVol, const T& maturity, const T& spot, const T& dividendYield) -> AD::Complex<T>
+		{
+			using std::exp, std::log, std::sqrt;
+			// formulation of Albrecher et al. ("the little Heston trap"): only exp(-d T) with Re(d) >= 0 appears,
+			// so the principal branch of the logarithm is continuous in the argument, also for long maturities
+			AD::Complex<T> u{ argument };
+			AD::Complex<T> i{ 0.0, 1.0 };
+			AD::Complex<T> tmp{ reversionRate - i * correlation * volVol * u };
+			AD::Complex<T> d{ sqrt((volVol * volVol) * (u * u + i * u) + tmp * tmp) };
+			AD::Complex<T> g{ (tmp - d) / (tmp + d) };
+			AD::Complex<T> expDT{ exp(-d * maturity) };
+			AD::Complex<T> numer1{ i * u * maturity * (riskFreeReturn - dividendYield) + i * u * log(spot) };
+			AD::Complex<T> term2{ reversionRate * longVariance / (volVol * volVol) * ((tmp - d) * maturity - 2.0 * log((1.0 - g * expDT) / (1.0 - g))) };
+			AD::Complex<T> term3{ initialVariance / (volVol * volVol) * (tmp - d) * (1.0 - expDT) / (1.0 - g * expDT) };
+			return exp(numer1 + term2 + term3);
+		}
+
+		template <typename T>
+		auto VarianceGamma(std::complex<double> argument, const T& riskFreeReturn, const T& maturity, const T& spot, const T& dividendYield,
+			const T& volatility, const T& drift, const T& variance) -> AD::Complex<T>
+		{
+			using std::exp, std::log, std::pow;
+			AD::Complex<T> u{ argument };
+			AD::Complex<T> i{ 0.0, 1.0 };
+			T omega{ log(1. - drift * variance - volatility * volatility * variance * 0.5) / variance };
+			AD::Complex<T> factor1{ exp(i * u * (log(spot) + (riskFreeReturn - dividendYield + omega) * maturity)) };
+			AD::Complex<T> factor2{ pow(1.0 - i * u * drift * variance + volatility * volatility * u * u * variance * 0.5, -maturity / variance) };
+			return factor1 * factor2;
+		}
+
+		// the characteristic function with its derivatives by the model parameters, in the order of the parameters' constructor arguments
+		auto generalCFDual(std::complex<double> argument, const HestonParams& modelParams, const MarketParams& marketParams) -> AD::ComplexDual<5>;
+		auto generalCFDual(std::complex<double> argument, const BSMParams& modelParams, const MarketParams& marketParams) -> AD::ComplexDual<1>;
+		auto generalCFDual(std::complex<double> argument, const MertonJumpParams& modelParams, const MarketParams& marketParams) -> AD::ComplexDual<4>;
+		auto generalCFDual(std::complex<double> argument, const VarianceGammaParams& modelParams, const MarketParams& marketParams) -> AD::ComplexDual<3>;
+
+		// overloads evaluating the CF on a whole grid of arguments at once
+		auto BSM(const ComplexArray& arguments, double riskFreeReturn, double vol, double maturity, double spot, double dividendYield) -> ComplexArray;
+		auto Heston(const ComplexArray& arguments, double riskFreeReturn, double initialVariance, double longVariance, double correlation, double reversionRate, double volVol, double maturity, double spot, double dividendYield) -> ComplexArray;
+		auto MertonJump(const ComplexArray& arguments, double riskFreeReturn, double vol, double maturity, double spot, double dividendYield, double meanJumpSize, double stdJumpSize, double expectedJumpsPerYear) -> ComplexArray;
+		auto VarianceGamma(const ComplexArray& arguments, double riskFreeReturn, double maturity, double spot, double dividendYield, double volatility, double drift, double variance) -> ComplexArray;
+		auto generalCF(const ComplexArray& arguments, const HestonParams& modelParams, const MarketParams& marketParams) -> ComplexArray;
+		auto generalCF(const ComplexArray& arguments, const BSMParams& modelParams, const MarketParams& marketParams) -> ComplexArray;
+		auto generalCF(const ComplexArray& arguments, const MertonJumpParams& modelParams, const MarketParams& marketParams) -> ComplexArray;
+		auto generalCF(const ComplexArray& arguments, const VarianceGammaParams& modelParams, const MarketParams& marketParams) -> ComplexArray;
 	}
 
 	namespace Testing
@@ -202,6 +500,11 @@ namespace SDE
 		auto saveHestonPaths() -> void;
 		auto saveVarianceGammaPaths() -> void;
 		auto saveMertonJumpPaths() -> void;
+		auto parallelMonteCarlo() -> void;
+		auto pathBlockLayouts() -> void;
+		auto batchKernels() -> void;
+		auto characteristicFunctionArrays() -> void;
+		auto samplerMoments() -> void;
 	}
 
 	// general overload for includsion into ModelStock class
@@ -218,6 +521,24 @@ namespace SDE
 	auto monteCarlo(double initialState, double terminalTime, std::size_t samples, double drift, MertonJumpParams params) -> XYVals;
 	auto monteCarlo(double initialState, double terminalTime, std::size_t samples, double drift, HestonParams params) -> XYVals;
 	auto monteCarlo(double initialState, double terminalTime, std::size_t samples, double drift, VarianceGammaParams params) -> XYVals;
+	auto monteCarlo(double initialState, double terminalTime, double drift, BSMParams params, const MonteCarloParams& mcParams) -> WeightedSamples;
+	auto monteCarlo(double initialState, double terminalTime, double drift, BachelierParams params, const MonteCarloParams& mcParams) -> WeightedSamples;
+	auto monteCarlo(double initialState, double terminalTime, double drift, CEVParams params, const MonteCarloParams& mcParams) -> WeightedSamples;
+	auto monteCarlo(double initialState, double terminalTime, double drift, MertonJumpParams params, const MonteCarloParams& mcParams) -> WeightedSamples;
+	auto monteCarlo(double initialState, double terminalTime, double drift, HestonParams params, const MonteCarloParams& mcParams) -> WeightedSamples;
+	auto monteCarlo(double initialState, double terminalTime, double drift, VarianceGammaParams params, const MonteCarloParams& mcParams) -> WeightedSamples;
+	auto monteCarlo(double initialState, double terminalTime, double drift, BSMParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void;
+	auto monteCarlo(double initialState, double terminalTime, double drift, BachelierParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void;
+	auto monteCarlo(double initialState, double terminalTime, double drift, CEVParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void;
+	auto monteCarlo(double initialState, double terminalTime, double drift, MertonJumpParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void;
+	auto monteCarlo(double initialState, double terminalTime, double drift, HestonParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void;
+	auto monteCarlo(double initialState, double terminalTime, double drift, VarianceGammaParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void;
+	auto monteCarloTangents(double initialState, double terminalTime, double drift, BSMParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void;
+	auto monteCarloTangents(double initialState, double terminalTime, double drift, BachelierParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void;
+	auto monteCarloTangents(double initialState, double terminalTime, double drift, CEVParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void;
+	auto monteCarloTangents(double initialState, double terminalTime, double drift, MertonJumpParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void;
+	auto monteCarloTangents(double initialState, double terminalTime, double drift, HestonParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void;
+	auto monteCarloTangents(double initialState, double terminalTime, double drift, VarianceGammaParams params, const MonteCarloParams& mcParams, const SampleSink& sink) -> void;
 
 	auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, BSMParams& params) -> DataTable;
 	auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, BachelierParams& params) -> DataTable;
@@ -225,6 +546,12 @@ namespace SDE
 	auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, MertonJumpParams& params) -> DataTable;
 	auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, HestonParams& params) -> DataTable;
 	auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, VarianceGammaParams& params) -> DataTable;
+	auto monteCarloPathBlock(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, BSMParams& params, PathBlock::Layout layout = PathBlock::Layout::pathMajor) -> PathBlock;
+	auto monteCarloPathBlock(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, BachelierParams& params, PathBlock::Layout layout = PathBlock::Layout::pathMajor) -> PathBlock;
+	auto monteCarloPathBlock(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, CEVParams& params, PathBlock::Layout layout = PathBlock::Layout::pathMajor) -> PathBlock;
+	auto monteCarloPathBlock(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, MertonJumpParams& params, PathBlock::Layout layout = PathBlock::Layout::pathMajor) -> PathBlock;
+	auto monteCarloPathBlock(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, HestonParams& params, PathBlock::Layout layout = PathBlock::Layout::pathMajor) -> PathBlock;
+	auto monteCarloPathBlock(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, VarianceGammaParams& params, PathBlock::Layout layout = PathBlock::Layout::pathMajor) -> PathBlock;
 	template <typename Params>
 	auto monteCarloPaths(double initialState, double terminalTime, std::size_t samples, std::size_t timePoints, double drift, Params& params) -> DataTable
 	{
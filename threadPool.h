@@ -0,0 +1,155 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for data parallel loops.
+// parallelFor hands out chunks of the index range through an atomic counter, so fast threads
+// simply take more chunks. Which thread computes an index never influences the result,
+// as long as the loop body only writes to its own indices.
+class ThreadPool
+{
+public:
+	explicit ThreadPool(std::size_t numThreads = std::max<std::size_t>(std::thread::hardware_concurrency(), 1))
+	{
+		// the calling thread works as well, so it needs one worker less
+		for (std::size_t i{ 1 }; i < numThreads; ++i)
+		{
+			m_workers.emplace_back([this]() { workerLoop(); });
+		}
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock{ m_mutex };
+			m_stop = true;
+		}
+		m_condition.notify_all();
+		for (auto& worker : m_workers)
+		{
+			worker.join();
+		}
+	}
+
+	// number of threads working on a parallelFor, including the calling thread
+	auto size() const -> std::size_t { return std::size(m_workers) + 1; }
+
+	// calls func(begin, end) on consecutive chunks which cover [0, count) and waits until all of them are done.
+	// Nested calls from inside a loop body run serially on the calling thread.
+	void parallelFor(std::size_t count, const std::function<void(std::size_t, std::size_t)>& func, std::size_t chunkSize = 0)
+	{
+		if (count == 0) { return; }
+		if (chunkSize == 0)
+		{
+			// a few chunks per thread balance the load without too much scheduling overhead
+			chunkSize = std::max<std::size_t>(count / (8 * size()), 1);
+		}
+		std::size_t numChunks{ (count + chunkSize - 1) / chunkSize };
+		if (numChunks == 1 || size() == 1 || t_insideWorker)
+		{
+			func(0, count);
+			return;
+		}
+
+		auto state{ std::make_shared<LoopState>() };
+		auto runChunks
+		{
+			[state, count, chunkSize, &func]()
+			{
+				for (std::size_t begin{ state->next.fetch_add(chunkSize) }; begin < count; begin = state->next.fetch_add(chunkSize))
+				{
+					try
+					{
+						func(begin, std::min(begin + chunkSize, count));
+					}
+					catch (...)
+					{
+						std::lock_guard<std::mutex> lock{ state->mutex };
+						if (!state->error) { state->error = std::current_exception(); }
+					}
+				}
+			}
+		};
+
+		std::size_t numTasks{ std::min(numChunks, size()) - 1 };
+		state->pendingTasks = numTasks;
+		{
+			std::lock_guard<std::mutex> lock{ m_mutex };
+			for (std::size_t i{ 0 }; i < numTasks; ++i)
+			{
+				m_tasks.push([state, runChunks]()
+					{
+						runChunks();
+						std::lock_guard<std::mutex> taskLock{ state->mutex };
+						if (--state->pendingTasks == 0) { state->done.notify_one(); }
+					});
+			}
+		}
+		m_condition.notify_all();
+
+		// the calling thread takes chunks too and then waits for the workers
+		t_insideWorker = true;
+		runChunks();
+		t_insideWorker = false;
+		std::unique_lock<std::mutex> lock{ state->mutex };
+		state->done.wait(lock, [&state]() { return state->pendingTasks == 0; });
+		if (state->error) { std::rethrow_exception(state->error); }
+	}
+
+	// pool shared by the whole program
+	static auto global() -> ThreadPool&
+	{
+		static ThreadPool pool{};
+		return pool;
+	}
+
+private:
+	struct LoopState
+	{
+		std::atomic<std::size_t> next{ 0 };
+		std::size_t pendingTasks{ 0 };
+		std::mutex mutex{};
+		std::condition_variable done{};
+		std::exception_ptr error{};
+	};
+
+	void workerLoop()
+	{
+		t_insideWorker = true;
+		while (true)
+		{
+			std::function<void()> task{};
+			{
+				std::unique_lock<std::mutex> lock{ m_mutex };
+				m_condition.wait(lock, [this]() { return m_stop || !m_tasks.empty(); });
+				if (m_stop && m_tasks.empty()) { return; }
+				task = std::move(m_tasks.front());
+				m_tasks.pop();
+			}
+			task();
+		}
+	}
+
+	std::vector<std::thread> m_workers{};
+	std::queue<std::function<void()>> m_tasks{};
+	std::mutex m_mutex{};
+	std::condition_variable m_condition{};
+	bool m_stop{ false };
+	static inline thread_local bool t_insideWorker{ false };
+};
+
+#endif
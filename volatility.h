@@ -5,13 +5,85 @@
 #include "saving.h"
 #include "reading.h"
 #include "pso.h"
+#include "sdes.h"
+#include "threadPool.h"
+#include <limits>
+#include <span>
+#include <string>
 #include <string_view>
+#include <vector>
 
 namespace Volatility
 {
+	namespace Implied
+	{
+		// the implied vol with the number of iterations it took. Prices outside the arbitrage bounds give NaN and are not converged.
+		struct Solution
+		{
+			double vol{ std::numeric_limits<double>::quiet_NaN() };
+			int iterations{ 0 };
+			bool converged{ false };
+		};
+
+		// initialVol > 0 replaces the asymptotic initial guess, e.g. by the vol of the previous quote
+		auto solve(double price, double riskFreeReturn, double maturity, double strike, double spot, double dividendYield, std::string_view type = "call", double initialVol = 0.) -> Solution;
+		// BSM implied volatility of a call or put price to machine precision, NaN for prices outside the arbitrage bounds
+		auto bsm(double price, double riskFreeReturn, double maturity, double strike, double spot, double dividendYield, std::string_view type = "call") -> double;
+		auto test() -> void;
+	}
+
 	namespace Surface
 	{
-		auto bsm(const LabeledTable& priceSurface, double riskFreeReturn, double spot, double dividendYield, std::string_view type = "call", std::string_view optimizer = "adam") -> LabeledTable;
+		struct ImpliedSurface
+		{
+			LabeledTable vols;
+			std::vector<std::vector<Implied::Solution>> solutions; // same rows and columns as vols
+		};
+
+		// Implied vols of every cell of the price surfaces (rows are maturities, columns strikes) on the threads of the pool.
+		// The cells of all surfaces are solved together, the maturities of marketParams are not used. Nothing is printed.
+		auto implied(std::span<const LabeledTable> priceSurfaces, std::span<const MarketParams> marketParams, std::string_view type = "call", ThreadPool& pool = ThreadPool::global()) -> std::vector<ImpliedSurface>;
+		auto implied(const LabeledTable& priceSurface, double riskFreeReturn, double spot, double dividendYield, std::string_view type = "call", ThreadPool& pool = ThreadPool::global()) -> ImpliedSurface;
+		auto testImplied() -> void;
+
+		// Implied vol surface that is kept up to date quote by quote. Changed prices mark their cell dirty, reading the vols solves
+		// the dirty cells only, warm started from their previous vol. ATM vol and skew per expiry are recomputed when read after a change.
+		class Incremental
+		{
+		public:
+			Incremental(const LabeledTable& priceSurface, const MarketParams& marketParams, std::string_view type = "call", ThreadPool& pool = ThreadPool::global());
+
+			void setPrice(std::size_t row, std::size_t col, double price);
+			// new spot or rates change every cell
+			void setMarketParams(const MarketParams& marketParams);
+
+			auto vols() -> const LabeledTable&;
+			auto solution(std::size_t row, std::size_t col) -> const Implied::Solution&;
+			// vol at the forward and its slope in log strike, interpolated between the neighbouring strikes of the expiry in row
+			auto atmVol(std::size_t row) -> double;
+			auto skew(std::size_t row) -> double;
+			auto numDirty() const -> std::size_t { return std::size(m_dirtyCells); }
+
+		private:
+			void markDirty(std::size_t cell);
+			void update();
+			void updateRow(std::size_t row);
+
+			LabeledTable m_prices;
+			MarketParams m_marketParams;
+			std::string m_type;
+			ThreadPool& m_pool;
+			ImpliedSurface m_surface;
+			std::vector<std::size_t> m_dirtyCells{}; // cells are numbered row by row
+			std::vector<bool> m_isDirty;
+			std::vector<bool> m_rowIsStale;
+			std::vector<double> m_atmVols;
+			std::vector<double> m_skews;
+		};
+		auto testIncremental() -> void;
+
+		// optimizer is "rational" (Implied::bsm for every cell), "adam" or "bruteForce"
+		auto bsm(const LabeledTable& priceSurface, double riskFreeReturn, double spot, double dividendYield, std::string_view type = "call", std::string_view optimizer = "rational") -> LabeledTable;
 		auto testCalibration() -> LabeledTable;
 		auto sanityCheck() -> void;
 	}
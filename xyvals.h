@@ -4,6 +4,9 @@
 #include<string>
 #include<string_view>
 #include<list>
+#include<cstddef>
+#include<new>
+#include<cmath>
 
 struct XYVals
 {
@@ -39,6 +42,183 @@ struct DataTable
 	{}
 };
 
+// allocator handing out memory aligned to whole cache lines
+template <typename T, std::size_t Alignment = 64>
+struct AlignedAllocator
+{
+	using value_type = T;
+	template <typename U>
+	struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+	AlignedAllocator() = default;
+	template <typename U>
+	AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+	auto allocate(std::size_t n) -> T* { return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t{ Alignment })); }
+	void deallocate(T* ptr, std::size_t) { ::operator delete(ptr, std::align_val_t{ Alignment }); }
+
+	template <typename U>
+	auto operator==(const AlignedAllocator<U, Alignment>&) const -> bool { return true; }
+};
+
+// view of every stride-th element of a buffer, e.g. a single path or a single time step of a PathBlock
+template <typename T>
+struct StridedView
+{
+	T* m_data{ nullptr };
+	std::size_t m_size{ 0 };
+	std::size_t m_stride{ 1 };
+
+	StridedView(T* data, std::size_t size, std::size_t stride = 1)
+		: m_data{ data }
+		, m_size{ size }
+		, m_stride{ stride }
+	{}
+
+	auto operator[](std::size_t index) const -> T& { return m_data[index * m_stride]; }
+	auto size() const -> std::size_t { return m_size; }
+};
+
+// equidistant time grid from 0 to terminalTime
+inline auto timeGrid(double terminalTime, std::size_t timePoints) -> std::vector<double>
+{
+	std::vector<double> times(timePoints);
+	double stepSize{ (timePoints > 1) ? terminalTime / static_cast<double>(timePoints - 1) : 0.0 };
+	for (std::size_t i{ 0 }; i < timePoints; ++i)
+	{
+		times[i] = static_cast<double>(i) * stepSize;
+	}
+	return times;
+}
+
+// Monte Carlo paths in one contiguous, cache line aligned buffer with a shared time grid.
+// Path major storage keeps each path contiguous (path wise payoffs like averages),
+// time major storage keeps each time step contiguous (reductions across paths).
+struct PathBlock
+{
+	enum class Layout
+	{
+		pathMajor,
+		timeMajor,
+	};
+
+	std::size_t m_numPaths{ 1 };
+	std::size_t m_timePoints{ 1 };
+	Layout m_layout{ Layout::pathMajor };
+	std::vector<double> m_times;
+	std::vector<double, AlignedAllocator<double>> m_values;
+
+	PathBlock(std::size_t numPaths, std::size_t timePoints, double terminalTime, Layout layout = Layout::pathMajor)
+		: m_numPaths{ numPaths }
+		, m_timePoints{ timePoints }
+		, m_layout{ layout }
+		, m_times{ timeGrid(terminalTime, timePoints) }
+		, m_values(numPaths * timePoints)
+	{}
+
+	// distance in the buffer between consecutive time steps of a path and between consecutive paths
+	auto timeStride() const -> std::size_t { return (m_layout == Layout::pathMajor) ? 1 : m_numPaths; }
+	auto pathStride() const -> std::size_t { return (m_layout == Layout::pathMajor) ? m_timePoints : 1; }
+
+	auto operator()(std::size_t path, std::size_t timeIndex) -> double& { return m_values[path * pathStride() + timeIndex * timeStride()]; }
+	auto operator()(std::size_t path, std::size_t timeIndex) const -> double { return m_values[path * pathStride() + timeIndex * timeStride()]; }
+
+	auto path(std::size_t num) -> StridedView<double> { return { m_values.data() + num * pathStride(), m_timePoints, timeStride() }; }
+	auto path(std::size_t num) const -> StridedView<const double> { return { m_values.data() + num * pathStride(), m_timePoints, timeStride() }; }
+	auto timeStep(std::size_t index) -> StridedView<double> { return { m_values.data() + index * timeStride(), m_numPaths, pathStride() }; }
+	auto timeStep(std::size_t index) const -> StridedView<const double> { return { m_values.data() + index * timeStride(), m_numPaths, pathStride() }; }
+
+	// copy into the row per path table used for saving
+	auto toDataTable() const -> DataTable
+	{
+		DataTable table(m_numPaths, m_timePoints);
+		for (std::size_t num{ 0 }; num < m_numPaths; ++num)
+		{
+			for (std::size_t i{ 0 }; i < m_timePoints; ++i)
+			{
+				table.m_table[num][i] = (*this)(num, i);
+			}
+		}
+		return table;
+	}
+};
+
+// Monte Carlo estimate together with its standard error
+struct Estimate
+{
+	double value{ 0.0 };
+	double standardError{ 0.0 };
+};
+
+// running mean and variance of a stream of observations, updated with the algorithm of Welford,
+// two accumulators are merged with the pairwise update of Chan, Golub and LeVeque
+struct RunningStatistics
+{
+	std::size_t m_count{ 0 };
+	double m_mean{ 0.0 };
+	double m_sumSquares{ 0.0 }; // sum of squared deviations from the mean
+
+	void add(double value)
+	{
+		++m_count;
+		double delta{ value - m_mean };
+		m_mean += delta / static_cast<double>(m_count);
+		m_sumSquares += delta * (value - m_mean);
+	}
+
+	void merge(const RunningStatistics& other)
+	{
+		if (other.m_count == 0) { return; }
+		double count{ static_cast<double>(m_count + other.m_count) };
+		double delta{ other.m_mean - m_mean };
+		m_mean += delta * static_cast<double>(other.m_count) / count;
+		m_sumSquares += other.m_sumSquares + delta * delta * static_cast<double>(m_count) * static_cast<double>(other.m_count) / count;
+		m_count += other.m_count;
+	}
+
+	auto variance() const -> double { return (m_count > 1) ? m_sumSquares / static_cast<double>(m_count - 1) : 0.0; }
+	auto standardError() const -> double { return (m_count > 1) ? std::sqrt(variance() / static_cast<double>(m_count)) : 0.0; }
+	auto estimate() const -> Estimate { return { m_mean, standardError() }; }
+};
+
+// running means, variances and covariance of pairs of observations (x, y), with the same updates as RunningStatistics
+struct CovarianceStatistics
+{
+	std::size_t m_count{ 0 };
+	double m_meanX{ 0.0 };
+	double m_meanY{ 0.0 };
+	double m_sumSquaresX{ 0.0 };
+	double m_sumSquaresY{ 0.0 };
+	double m_coMoment{ 0.0 }; // sum of products of the deviations from the means
+
+	void add(double x, double y)
+	{
+		++m_count;
+		double deltaX{ x - m_meanX };
+		double deltaY{ y - m_meanY };
+		m_meanX += deltaX / static_cast<double>(m_count);
+		m_meanY += deltaY / static_cast<double>(m_count);
+		m_sumSquaresX += deltaX * (x - m_meanX);
+		m_sumSquaresY += deltaY * (y - m_meanY);
+		m_coMoment += deltaX * (y - m_meanY);
+	}
+
+	void merge(const CovarianceStatistics& other)
+	{
+		if (other.m_count == 0) { return; }
+		double count{ static_cast<double>(m_count + other.m_count) };
+		double deltaX{ other.m_meanX - m_meanX };
+		double deltaY{ other.m_meanY - m_meanY };
+		double factor{ static_cast<double>(m_count) * static_cast<double>(other.m_count) / count };
+		m_meanX += deltaX * static_cast<double>(other.m_count) / count;
+		m_meanY += deltaY * static_cast<double>(other.m_count) / count;
+		m_sumSquaresX += other.m_sumSquaresX + deltaX * deltaX * factor;
+		m_sumSquaresY += other.m_sumSquaresY + deltaY * deltaY * factor;
+		m_coMoment += other.m_coMoment + deltaX * deltaY * factor;
+		m_count += other.m_count;
+	}
+};
+
 struct LabeledTable
 {
 	std::string m_tableName{ "None" };